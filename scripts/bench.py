@@ -0,0 +1,405 @@
+# Developer script: headless benchmark of optixPathTracer over the shipped scenes and generated stress scenes
+#
+# Usage: python bench.py <optixPathTracer binary> [options]     (see --help, or build the 'bench' target)
+#
+# Every scene is rendered without a window at a fixed resolution and sample count. Per scene the script records
+# the load time (scene file, meshes, textures), the build time (kernel compilation and acceleration structures,
+# from the --profile trace), Msamples/s and Mrays/s of the render, the peak resident memory of the process and
+# the RMSE against a stored reference image. The samples are seeded by pixel and frame, so a reference rendered
+# with the same settings by a trusted build differs only where the code changed the result.
+#
+# The results are written to <output>/bench.csv and <output>/bench.json. With --baseline (an earlier bench.json)
+# the script exits with 1 when a metric got worse by more than --threshold, or when the relative RMSE exceeds
+# --max-rmse. Scenes whose assets are missing (the meshes of data.rar are not unpacked) are skipped.
+#
+# --render-args adds options to the timed render, which measures the cost of a feature against a run without it:
+#   python bench.py <binary> --output bench_plain
+#   python bench.py <binary> --output bench_aov --render-args="--aov normal" --baseline bench_plain/bench.json
+
+from __future__ import print_function
+
+import argparse
+import array
+import glob
+import json
+import math
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+SCRIPT_DIR = os.path.dirname( os.path.abspath( __file__ ) )
+DATA_DIR   = os.path.normpath( os.path.join( SCRIPT_DIR, "..", "src", "data" ) )
+
+# Samples of the run which counts the rays per sample, with --ray-stats. The timed run does not count.
+RAY_STATS_SPP = 16
+
+# Time differences below this many seconds are noise, not regressions.
+TIME_TOLERANCE = 0.05
+
+# Metrics compared with the baseline: name, and whether higher or lower is better.
+METRICS = [ ( "load_seconds",        "lower"  ),
+            ( "build_seconds",       "lower"  ),
+            ( "msamples_per_second", "higher" ),
+            ( "mrays_per_second",    "higher" ),
+            ( "peak_rss_mb",         "lower"  ) ]
+
+COLUMNS = [ "scene", "status", "width", "height", "spp", "load_seconds", "build_seconds", "render_seconds",
+            "msamples_per_second", "rays_per_sample", "mrays_per_second", "peak_rss_mb", "rmse", "relative_rmse",
+            "regressions" ]
+
+
+# --------------------------------------------------------------------------------------------------------------------
+# Synthetic stress scenes. The scene loader resolves mesh and texture paths relative to the data directory.
+
+def scene_path( path ):
+    return os.path.relpath( path, DATA_DIR ).replace( os.sep, "/" )
+
+def write_obj( filename, vertices, texcoords, triangles ):
+    lines = [ "v %g %g %g" % v for v in vertices ]
+    lines += [ "vt %g %g" % t for t in texcoords ]
+    if texcoords:
+        lines += [ "f %d/%d %d/%d %d/%d" % ( a + 1, a + 1, b + 1, b + 1, c + 1, c + 1 ) for ( a, b, c ) in triangles ]
+    else:
+        lines += [ "f %d %d %d" % ( a + 1, b + 1, c + 1 ) for ( a, b, c ) in triangles ]
+    with open( filename, "w" ) as obj:
+        obj.write( "\n".join( lines ) + "\n" )
+
+def write_quad( filename, x0, z0, x1, z1, y ):
+    write_obj( filename, [ ( x0, y, z0 ), ( x1, y, z0 ), ( x1, y, z1 ), ( x0, y, z1 ) ],
+               [ ( 0, 0 ), ( 1, 0 ), ( 1, 1 ), ( 0, 1 ) ], [ ( 0, 2, 1 ), ( 0, 3, 2 ) ] )
+
+def write_box( filename, x, z, size, height ):
+    s = size * 0.5
+    vertices = [ ( x + dx * s, dy * height, z + dz * s ) for dx in ( -1, 1 ) for dy in ( 0, 1 ) for dz in ( -1, 1 ) ]
+    faces = [ ( 0, 1, 3, 2 ), ( 4, 6, 7, 5 ), ( 0, 4, 5, 1 ), ( 2, 3, 7, 6 ), ( 0, 2, 6, 4 ), ( 1, 5, 7, 3 ) ]
+    write_obj( filename, vertices, [], [ t for ( a, b, c, d ) in faces for t in ( ( a, b, c ), ( a, c, d ) ) ] )
+
+def write_sphere( filename, cx, cy, cz, radius, rings, segments ):
+    vertices = []
+    for i in range( rings + 1 ):
+        theta = math.pi * i / rings
+        for j in range( segments ):
+            phi = 2.0 * math.pi * j / segments
+            vertices.append( ( cx + radius * math.sin( theta ) * math.cos( phi ), cy + radius * math.cos( theta ),
+                               cz + radius * math.sin( theta ) * math.sin( phi ) ) )
+    triangles = []
+    for i in range( rings ):
+        for j in range( segments ):
+            a = i * segments + j
+            b = i * segments + ( j + 1 ) % segments
+            # Counter-clockwise seen from outside, the normals face out.
+            triangles.append( ( a, b, a + segments ) )
+            triangles.append( ( b, b + segments, a + segments ) )
+    write_obj( filename, vertices, [], triangles )
+
+def write_texture( filename, size, seed ):
+    # Checkerboard with a different cell size and colour per texture, as binary PPM.
+    cell = 8 << ( seed % 4 )
+    color = bytearray( [ 64 + ( seed * 53 ) % 192, 64 + ( seed * 97 ) % 192, 64 + ( seed * 31 ) % 192 ] )
+    white = bytearray( [ 230, 230, 230 ] )
+    rows = []
+    for parity in range( 2 ):
+        row = bytearray()
+        for x in range( size ):
+            row += color if ( ( x // cell ) + parity ) % 2 else white
+        rows.append( bytes( row ) )
+    with open( filename, "wb" ) as ppm:
+        ppm.write( ( "P6\n%d %d\n255\n" % ( size, size ) ).encode( "ascii" ) )
+        for y in range( size ):
+            ppm.write( rows[ ( y // cell ) % 2 ] )
+
+def ceiling_light( x, z, size, height, emission ):
+    # The loader takes the normal from cross(v1 - position, v2 - position), this one faces down.
+    return ( "light\n{\n\tposition %g %g %g\n\temission %g %g %g\n\tv1 %g %g %g\n\tv2 %g %g %g\n\ttype Quad\n}\n"
+             % ( x, height, z, emission, emission, emission, x, height, z + size, x - size, height, z ) )
+
+def material( name, lines ):
+    return "material %s\n{\n%s}\n\n" % ( name, "".join( "\t" + line + "\n" for line in lines ) )
+
+def mesh( filename, material_name ):
+    return "mesh\n{\n\tfile %s\n\tmaterial %s\n}\n\n" % ( scene_path( filename ), material_name )
+
+def generate_many_lights( directory ):
+    floor = os.path.join( directory, "floor.obj" )
+    write_quad( floor, -500, -500, 500, 500, 0 )
+    ball = os.path.join( directory, "ball.obj" )
+    write_sphere( ball, 0, 150, 0, 150, 32, 64 )
+    text = material( "grey", [ "color 0.6 0.6 0.6" ] ) + mesh( floor, "grey" ) + mesh( ball, "grey" )
+    for i in range( 16 ):
+        for j in range( 16 ):
+            text += ceiling_light( -450 + 60 * i, -450 + 60 * j, 20, 600, 40.0 )
+    return text
+
+def generate_many_instances( directory ):
+    floor = os.path.join( directory, "floor.obj" )
+    write_quad( floor, -600, -600, 600, 600, 0 )
+    text = material( "grey", [ "color 0.6 0.6 0.6" ] ) + material( "orange", [ "color 0.8 0.35 0.05", "roughness 0.2" ] )
+    text += mesh( floor, "grey" )
+    # The loader has no instance transforms, every box is a mesh and geometry instance of its own.
+    for i in range( 20 ):
+        for j in range( 20 ):
+            box = os.path.join( directory, "box_%02d_%02d.obj" % ( i, j ) )
+            write_box( box, -570 + 60 * i, -570 + 60 * j, 30, 30 + ( i * 7 + j * 13 ) % 60 )
+            text += mesh( box, "orange" )
+    return text + ceiling_light( 100, -100, 200, 800, 20.0 )
+
+def generate_dense_mesh( directory ):
+    floor = os.path.join( directory, "floor.obj" )
+    write_quad( floor, -500, -500, 500, 500, 0 )
+    sphere = os.path.join( directory, "sphere.obj" )
+    write_sphere( sphere, 0, 250, 0, 250, 512, 1024 ) # About one million triangles.
+    text = material( "grey", [ "color 0.6 0.6 0.6" ] ) + material( "glass", [ "color 1.0 1.0 1.0", "brdf 1" ] )
+    return text + mesh( floor, "grey" ) + mesh( sphere, "glass" ) + ceiling_light( 100, -100, 200, 800, 20.0 )
+
+def generate_heavy_textures( directory ):
+    text = ""
+    meshes = ""
+    for i in range( 8 ):
+        texture = os.path.join( directory, "texture_%d.ppm" % i )
+        write_texture( texture, 2048, i )
+        quad = os.path.join( directory, "quad_%d.obj" % i )
+        write_quad( quad, -400 + 200 * ( i % 4 ), -200 + 200 * ( i // 4 ), -210 + 200 * ( i % 4 ), -10 + 200 * ( i // 4 ), 0 )
+        text += material( "textured_%d" % i, [ "color 1.0 1.0 1.0", "albedoTex " + scene_path( texture ) ] )
+        meshes += mesh( quad, "textured_%d" % i )
+    return text + meshes + ceiling_light( 100, -100, 200, 800, 20.0 )
+
+STRESS_SCENES = [ ( "stress_many_lights",     generate_many_lights ),
+                  ( "stress_many_instances",  generate_many_instances ),
+                  ( "stress_dense_mesh",      generate_dense_mesh ),
+                  ( "stress_heavy_textures",  generate_heavy_textures ) ]
+
+def stress_scenes( output ):
+    # Generated once into the output directory and reused, the files do not change between runs.
+    scenes = []
+    for ( name, generate ) in STRESS_SCENES:
+        directory = os.path.join( output, "stress", name )
+        scene = os.path.join( directory, name + ".scene" )
+        if not os.path.isfile( scene ):
+            print( "Generating " + scene )
+            if not os.path.isdir( directory ):
+                os.makedirs( directory )
+            text = generate( directory )
+            with open( scene + ".tmp", "w" ) as out:
+                out.write( text )
+            os.rename( scene + ".tmp", scene )
+        scenes.append( scene )
+    return scenes
+
+
+# --------------------------------------------------------------------------------------------------------------------
+# Rendering and metrics
+
+def missing_assets( scene ):
+    missing = []
+    with open( scene ) as text:
+        for line in text:
+            match = re.match( r"\s*(file|albedoTex)\s+(\S+)", line )
+            if match and not os.path.isfile( os.path.join( DATA_DIR, match.group(2) ) ):
+                missing.append( match.group(2) )
+    return missing
+
+def run( args ):
+    process = subprocess.Popen( args, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True )
+    log = process.communicate()[0]
+    return process.returncode, log
+
+def find_number( pattern, log ):
+    match = re.search( pattern, log, re.MULTILINE )
+    return float( match.group(1) ) if match else None
+
+def trace_seconds( filename ):
+    # Total duration per stage of a --profile Chrome trace, in seconds.
+    with open( filename ) as trace:
+        events = json.load( trace )["traceEvents"]
+    seconds = {}
+    for event in events:
+        seconds[event["name"]] = seconds.get( event["name"], 0.0 ) + event["dur"] * 1e-6
+    return seconds
+
+def read_pfm( filename ):
+    with open( filename, "rb" ) as pfm:
+        header = pfm.readline().strip()
+        size = pfm.readline().split()
+        scale = float( pfm.readline() )
+        values = array.array( "f" )
+        if hasattr( values, "frombytes" ):
+            values.frombytes( pfm.read() )
+        else:
+            values.fromstring( pfm.read() )
+    if ( scale < 0 ) != ( sys.byteorder == "little" ):
+        values.byteswap()
+    channels = 3 if header == b"PF" else 1
+    return int( size[0] ), int( size[1] ), channels, values
+
+def compare_images( image, reference ):
+    # RMSE over all channels, and relative to the RMS of the reference.
+    a = read_pfm( image )
+    b = read_pfm( reference )
+    if a[:3] != b[:3]:
+        return None, None
+    squared = 0.0
+    energy = 0.0
+    for x, y in zip( a[3], b[3] ):
+        squared += ( x - y ) * ( x - y )
+        energy += y * y
+    rmse = math.sqrt( squared / len( b[3] ) )
+    rms = math.sqrt( energy / len( b[3] ) )
+    return rmse, ( rmse / rms if rms > 0.0 else rmse )
+
+def bench_scene( options, scene ):
+    name = os.path.splitext( os.path.basename( scene ) )[0]
+    result = dict( ( column, None ) for column in COLUMNS )
+    result.update( { "scene": name, "width": options.resolution[0], "height": options.resolution[1], "spp": options.spp,
+                     "regressions": [] } )
+
+    missing = missing_assets( scene )
+    if missing:
+        print( "Skipping %s, %d missing assets such as %s" % ( name, len( missing ), missing[0] ) )
+        result["status"] = "skipped"
+        return result
+
+    image = os.path.join( options.output, "images", name + ".pfm" )
+    trace = os.path.join( options.output, "images", name + ".trace.json" )
+    common = [ options.binary, "--scene", scene, "--resolution", str( options.resolution[0] ), str( options.resolution[1] ),
+               "--samples-per-launch", str( options.samples_per_launch ) ]
+
+    print( "Rendering %s at %dx%d, %d spp" % ( name, options.resolution[0], options.resolution[1], options.spp ) )
+    sys.stdout.flush()
+    code, log = run( common + [ "--file", image, "--spp", str( options.spp ), "--profile", trace ] + options.render_args.split() )
+    if code != 0 or not os.path.isfile( trace ):
+        print( "Render failed: " + " ".join( common ) )
+        print( log )
+        result["status"] = "failed"
+        return result
+
+    stages = trace_seconds( trace )
+    build = stages.get( "compile and build acceleration", 0.0 )
+    result["build_seconds"]       = build
+    result["load_seconds"]        = stages.get( "createSession", 0.0 ) - build
+    result["render_seconds"]      = stages.get( "launch", 0.0 )
+    result["msamples_per_second"] = find_number( r"([0-9.eE+-]+) Msamples/s", log )
+    result["peak_rss_mb"]         = find_number( r"Peak resident ([0-9.eE+-]+) MB", log )
+
+    # Counting slows the launches down, so the rays per sample come from a separate, shorter render.
+    counted = os.path.join( options.output, "images", name + ".raystats.pfm" )
+    code, log = run( common + [ "--file", counted, "--spp", str( min( options.spp, RAY_STATS_SPP ) ), "--ray-stats" ] )
+    rays = find_number( r"^\s*total\s+([0-9]+) rays", log )
+    if code == 0 and rays is not None and result["msamples_per_second"] is not None:
+        samples = float( options.resolution[0] ) * options.resolution[1] * min( options.spp, RAY_STATS_SPP )
+        result["rays_per_sample"] = rays / samples
+        result["mrays_per_second"] = result["msamples_per_second"] * result["rays_per_sample"]
+    if os.path.isfile( counted ):
+        os.remove( counted )
+
+    reference = os.path.join( options.references, name + ".pfm" )
+    if options.update_references:
+        if not os.path.isdir( options.references ):
+            os.makedirs( options.references )
+        shutil.copyfile( image, reference )
+        print( "Updated the reference " + reference )
+    elif os.path.isfile( reference ):
+        result["rmse"], result["relative_rmse"] = compare_images( image, reference )
+        if result["rmse"] is None:
+            result["regressions"].append( "image size differs from the reference" )
+        elif result["relative_rmse"] > options.max_rmse:
+            result["regressions"].append( "relative RMSE %.4g > %.4g" % ( result["relative_rmse"], options.max_rmse ) )
+
+    result["status"] = "ok"
+    return result
+
+def check_baseline( result, baseline, threshold ):
+    # A metric regresses when it got worse than the baseline by more than the threshold fraction.
+    for ( metric, better ) in METRICS:
+        now = result.get( metric )
+        before = baseline.get( metric )
+        if now is None or before is None or before <= 0.0:
+            continue
+        change = ( now - before ) / before
+        worse = -change if better == "higher" else change
+        if metric.endswith( "seconds" ) and abs( now - before ) < TIME_TOLERANCE:
+            continue
+        if worse > threshold:
+            result["regressions"].append( "%s %.4g -> %.4g (%+.1f%%)" % ( metric, before, now, 100.0 * change ) )
+
+def write_results( options, results ):
+    csv = os.path.join( options.output, "bench.csv" )
+    with open( csv, "w" ) as out:
+        out.write( ",".join( COLUMNS ) + "\n" )
+        for result in results:
+            row = []
+            for column in COLUMNS:
+                value = result[column]
+                if column == "regressions":
+                    value = "; ".join( value )
+                row.append( "" if value is None else ( "%.6g" % value if isinstance( value, float ) else str( value ) ) )
+            out.write( ",".join( '"%s"' % field if "," in field else field for field in row ) + "\n" )
+    report = { "settings": { "width": options.resolution[0], "height": options.resolution[1], "spp": options.spp,
+                             "samples_per_launch": options.samples_per_launch, "threshold": options.threshold,
+                             "max_rmse": options.max_rmse, "render_args": options.render_args },
+               "results": results }
+    with open( os.path.join( options.output, "bench.json" ), "w" ) as out:
+        json.dump( report, out, indent=2, sort_keys=True )
+    print( "Wrote " + csv + " and bench.json" )
+
+def main():
+    parser = argparse.ArgumentParser( description="Headless benchmark of optixPathTracer." )
+    parser.add_argument( "binary", help="optixPathTracer executable" )
+    parser.add_argument( "--output", default="bench", help="directory of the results, images and stress scenes (default ./bench)" )
+    parser.add_argument( "--resolution", type=int, nargs=2, default=[ 512, 512 ], metavar=( "W", "H" ) )
+    parser.add_argument( "--spp", type=int, default=64, help="samples per pixel (default 64)" )
+    parser.add_argument( "--samples-per-launch", type=int, default=1 )
+    parser.add_argument( "--scenes", default="*", help="glob of the scene names to run, e.g. 'stress_*' (default all)" )
+    parser.add_argument( "--no-stress", action="store_true", help="only the scenes in src/data" )
+    parser.add_argument( "--references", default=os.path.join( SCRIPT_DIR, "bench_references" ),
+                         help="directory of the reference images <scene>.pfm" )
+    parser.add_argument( "--update-references", action="store_true", help="store the rendered images as the references" )
+    parser.add_argument( "--baseline", help="bench.json of an earlier run to compare with" )
+    parser.add_argument( "--threshold", type=float, default=0.10, help="allowed regression against the baseline (default 0.10 = 10%%)" )
+    parser.add_argument( "--max-rmse", type=float, default=0.01, help="allowed RMSE relative to the RMS of the reference (default 0.01)" )
+    parser.add_argument( "--render-args", default="", help="options added to the timed render, e.g. --render-args=\"--ray-stats\"" )
+    options = parser.parse_args()
+
+    images = os.path.join( options.output, "images" )
+    if not os.path.isdir( images ):
+        os.makedirs( images )
+
+    scenes = sorted( glob.glob( os.path.join( DATA_DIR, "*.scene" ) ) )
+    if not options.no_stress:
+        scenes += stress_scenes( options.output )
+    pattern = re.compile( "^" + re.escape( options.scenes ).replace( r"\*", ".*" ).replace( r"\?", "." ) + "$" )
+    scenes = [ scene for scene in scenes if pattern.match( os.path.splitext( os.path.basename( scene ) )[0] ) ]
+
+    baseline = {}
+    if options.baseline:
+        with open( options.baseline ) as text:
+            baseline = dict( ( result["scene"], result ) for result in json.load( text )["results"] )
+
+    results = []
+    for scene in scenes:
+        result = bench_scene( options, scene )
+        if result["status"] == "ok" and result["scene"] in baseline:
+            check_baseline( result, baseline[result["scene"]], options.threshold )
+        results.append( result )
+        if result["status"] == "ok":
+            print( "  load %.3f s, build %.3f s, %s Msamples/s, %s Mrays/s, peak %s MB, relative RMSE %s" %
+                   ( result["load_seconds"], result["build_seconds"],
+                     "-" if result["msamples_per_second"] is None else "%.1f" % result["msamples_per_second"],
+                     "-" if result["mrays_per_second"] is None else "%.1f" % result["mrays_per_second"],
+                     "-" if result["peak_rss_mb"] is None else "%.0f" % result["peak_rss_mb"],
+                     "-" if result["relative_rmse"] is None else "%.4g" % result["relative_rmse"] ) )
+        for regression in result["regressions"]:
+            print( "  REGRESSION: " + regression )
+        sys.stdout.flush()
+
+    write_results( options, results )
+
+    failed = [ result["scene"] for result in results if result["status"] == "failed" ]
+    regressed = [ result["scene"] for result in results if result["regressions"] ]
+    print( "%d scenes, %d skipped, %d failed, %d regressed" %
+           ( len( results ), sum( 1 for result in results if result["status"] == "skipped" ), len( failed ), len( regressed ) ) )
+    return 1 if failed or regressed else 0
+
+if __name__ == "__main__":
+    sys.exit( main() )
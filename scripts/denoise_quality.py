@@ -0,0 +1,177 @@
+# Developer script: image quality of optixPathTracer over samples per pixel, with and without --denoise
+#
+# Usage: python denoise_quality.py <optixPathTracer binary> <optixImageDiff binary> [options]     (see --help)
+#
+# Every scene is rendered headless at each sample count twice, without and with the host denoiser, and compared
+# to a reference with optixImageDiff. The samples are seeded by pixel and frame, so the reference is rendered from
+# frames after the largest tested sample count (--sample-range, merged into an image with optixMergePartials).
+# Otherwise the reference would contain the samples of the tested images and flatter them. The reference is one
+# partial, whose merge is exact. A merge of several partials would differ from one render by float rounding,
+# up to about 2^-24 relative per frame (see PartialImage.h), which is far below what SSIM and PSNR resolve.
+#
+# The table of SSIM and PSNR per scene and sample count is written to <output>/denoise_quality.csv. For each
+# --target-ssim the script prints the smallest tested sample count which reaches it, raw and denoised, and how
+# many times fewer samples the denoiser needs.
+
+from __future__ import print_function
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+SCRIPT_DIR = os.path.dirname( os.path.abspath( __file__ ) )
+DATA_DIR   = os.path.normpath( os.path.join( SCRIPT_DIR, "..", "src", "data" ) )
+
+COLUMNS = [ "scene", "spp", "ssim_raw", "ssim_denoised", "psnr_raw", "psnr_denoised", "render_seconds", "denoise_seconds" ]
+
+def run( args ):
+    process = subprocess.Popen( args, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True )
+    log = process.communicate()[0]
+    return process.returncode, log
+
+def find_number( pattern, log ):
+    match = re.search( pattern, log, re.MULTILINE )
+    return float( match.group(1) ) if match else None
+
+def render( options, scene, image, extra ):
+    args = [ options.pathtracer, "--scene", scene, "--resolution", str( options.resolution[0] ), str( options.resolution[1] ),
+             "--samples-per-launch", str( options.samples_per_launch ), "--file", image ] + extra
+    code, log = run( args )
+    if code != 0 or not os.path.isfile( image ):
+        print( "Render failed: " + " ".join( args ) )
+        print( log )
+        return None
+    return log
+
+def reference_image( options, scene, name ):
+    # Frames [max spp, max spp + reference spp), disjoint from the frames of every tested image. Kept between runs.
+    reference = os.path.join( options.output, "images", name + ".reference.pfm" )
+    first = max( options.spp )
+    tag = "%dx%d frames %d-%d" % ( options.resolution[0], options.resolution[1], first, first + options.reference_spp )
+    stamp = reference + ".txt"
+    if os.path.isfile( reference ) and os.path.isfile( stamp ):
+        with open( stamp ) as text:
+            if text.read().strip() == tag:
+                return reference
+
+    print( "Rendering the reference of %s, %s" % ( name, tag ) )
+    sys.stdout.flush()
+    partial = os.path.join( options.output, "images", name + ".reference.partial" )
+    if render( options, scene, partial, [ "--sample-range", str( first ), str( options.reference_spp ) ] ) is None:
+        return None
+    code, log = run( [ options.merger, reference, partial ] )
+    os.remove( partial )
+    if code != 0:
+        print( "Merging the reference failed:" )
+        print( log )
+        return None
+    with open( stamp, "w" ) as text:
+        text.write( tag + "\n" )
+    return reference
+
+def compare( options, image, reference ):
+    # optixImageDiff exits with 1 for different images, only 2 is an error.
+    code, log = run( [ options.imagediff, reference, image ] )
+    if code not in ( 0, 1 ):
+        print( "Comparison failed:" )
+        print( log )
+        return None, None
+    return find_number( r"^ssim\s+(\S+)", log ), find_number( r"^psnr\s+(\S+)", log )
+
+def measure_scene( options, scene ):
+    name = os.path.splitext( os.path.basename( scene ) )[0]
+    reference = reference_image( options, scene, name )
+    if reference is None:
+        return []
+
+    rows = []
+    for spp in options.spp:
+        row = dict( ( column, None ) for column in COLUMNS )
+        row.update( { "scene": name, "spp": spp } )
+        print( "Rendering %s at %d spp" % ( name, spp ) )
+        sys.stdout.flush()
+        for ( suffix, extra ) in ( ( "raw", [] ), ( "denoised", [ "--denoise" ] ) ):
+            image = os.path.join( options.output, "images", "%s.%d.%s.pfm" % ( name, spp, suffix ) )
+            log = render( options, scene, image, [ "--spp", str( spp ) ] + extra )
+            if log is None:
+                continue
+            row["ssim_" + suffix], row["psnr_" + suffix] = compare( options, image, reference )
+            if suffix == "raw":
+                row["render_seconds"] = find_number( r"\(render ([0-9.eE+-]+) s", log )
+            else:
+                row["denoise_seconds"] = find_number( r"Denoised in ([0-9.eE+-]+) s", log )
+            if not options.keep_images:
+                os.remove( image )
+        print( "  SSIM %s raw, %s denoised" % ( "-" if row["ssim_raw"] is None else "%.4f" % row["ssim_raw"],
+                                                 "-" if row["ssim_denoised"] is None else "%.4f" % row["ssim_denoised"] ) )
+        rows.append( row )
+    return rows
+
+def spp_to_reach( rows, column, target ):
+    for row in rows:
+        if row[column] is not None and row[column] >= target:
+            return row["spp"]
+    return None
+
+def write_results( options, rows ):
+    csv = os.path.join( options.output, "denoise_quality.csv" )
+    with open( csv, "w" ) as out:
+        out.write( ",".join( COLUMNS ) + "\n" )
+        for row in rows:
+            values = [ row[column] for column in COLUMNS ]
+            out.write( ",".join( "" if value is None else ( "%.6g" % value if isinstance( value, float ) else str( value ) )
+                                 for value in values ) + "\n" )
+    print( "Wrote " + csv )
+
+def print_summary( options, rows ):
+    print( "\nSamples per pixel to reach the target SSIM (- when no tested count reaches it):" )
+    print( "%-24s %8s %8s %10s %8s" % ( "scene", "target", "raw", "denoised", "saving" ) )
+    for scene in sorted( set( row["scene"] for row in rows ) ):
+        scene_rows = [ row for row in rows if row["scene"] == scene ]
+        for target in options.target_ssim:
+            raw = spp_to_reach( scene_rows, "ssim_raw", target )
+            denoised = spp_to_reach( scene_rows, "ssim_denoised", target )
+            saving = "%.1fx" % ( float( raw ) / denoised ) if raw and denoised else "-"
+            print( "%-24s %8.3f %8s %10s %8s" % ( scene, target, raw or "-", denoised or "-", saving ) )
+
+def main():
+    parser = argparse.ArgumentParser( description="SSIM of optixPathTracer over samples per pixel, with and without --denoise." )
+    parser.add_argument( "pathtracer", help="optixPathTracer executable" )
+    parser.add_argument( "imagediff", help="optixImageDiff executable" )
+    parser.add_argument( "--merger", help="optixMergePartials executable (default: next to optixImageDiff)" )
+    parser.add_argument( "--output", default="denoise_quality", help="directory of the table and images (default ./denoise_quality)" )
+    parser.add_argument( "--scenes", nargs="+", default=[ os.path.join( DATA_DIR, "cornell.scene" ) ], help="scene files" )
+    parser.add_argument( "--resolution", type=int, nargs=2, default=[ 512, 512 ], metavar=( "W", "H" ) )
+    parser.add_argument( "--spp", type=int, nargs="+", default=[ 1, 2, 4, 8, 16, 32, 64, 128, 256 ],
+                         help="tested samples per pixel (default 1 2 4 ... 256)" )
+    parser.add_argument( "--reference-spp", type=int, default=8192, help="samples per pixel of the reference (default 8192)" )
+    parser.add_argument( "--samples-per-launch", type=int, default=4 )
+    parser.add_argument( "--target-ssim", type=float, nargs="+", default=[ 0.90, 0.95, 0.98 ] )
+    parser.add_argument( "--keep-images", action="store_true", help="keep the tested images in <output>/images" )
+    options = parser.parse_args()
+    options.spp = sorted( set( options.spp ) )
+
+    if not options.merger:
+        # All executables are built into the same bin directory.
+        options.merger = os.path.join( os.path.dirname( os.path.abspath( options.imagediff ) ),
+                                       "optixMergePartials" + os.path.splitext( options.imagediff )[1] )
+
+    images = os.path.join( options.output, "images" )
+    if not os.path.isdir( images ):
+        os.makedirs( images )
+
+    rows = []
+    for scene in options.scenes:
+        rows += measure_scene( options, scene )
+    if not rows:
+        print( "Nothing was measured." )
+        return 1
+
+    write_results( options, rows )
+    print_summary( options, rows )
+    return 0
+
+if __name__ == "__main__":
+    sys.exit( main() )
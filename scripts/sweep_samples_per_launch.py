@@ -0,0 +1,62 @@
+# Developer script: render throughput of optixPathTracer over samples per launch and resolution
+#
+# Usage: python sweep_samples_per_launch.py <optixPathTracer binary> [scene file] [samples]
+#
+# Renders the scene headless at every resolution with every samples per launch setting and prints a table
+# of Msamples/s as reported by the renderer. The images are written to a temporary file and discarded.
+
+from __future__ import print_function
+
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+RESOLUTIONS = [ (64, 64), (128, 128), (256, 256), (512, 512), (1024, 1024), (2048, 2048) ]
+SAMPLES_PER_LAUNCH = [ 1, 2, 4, 8, 16, 32, 64 ]
+
+def render( binary, scene, width, height, samples, samples_per_launch, output ):
+    args = [ binary, "--file", output, "--resolution", str(width), str(height),
+             "--sample-range", "0", str(samples), "--samples-per-launch", str(samples_per_launch) ]
+    if scene:
+        args += [ "--scene", scene ]
+    process = subprocess.Popen( args, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True )
+    log = process.communicate()[0]
+    match = re.search( r"([0-9.eE+-]+) Msamples/s", log )
+    if process.returncode != 0 or not match:
+        print( "Render failed: " + " ".join( args ) )
+        print( log )
+        return None
+    return float( match.group(1) )
+
+def main():
+    if len(sys.argv) < 2:
+        print( "Usage: " + sys.argv[0] + " <optixPathTracer binary> [scene file] [samples]" )
+        return 1
+    binary  = sys.argv[1]
+    scene   = sys.argv[2] if len(sys.argv) > 2 else None
+    samples = int( sys.argv[3] ) if len(sys.argv) > 3 else 256
+
+    # A partial holds the plain sample sums, nothing is tonemapped or encoded.
+    handle, output = tempfile.mkstemp( suffix=".partial" )
+    os.close( handle )
+
+    print( "Msamples/s, " + str(samples) + " samples per pixel" )
+    print( "resolution  " + "".join( "%9d" % n for n in SAMPLES_PER_LAUNCH ) )
+    failed = False
+    try:
+        for (width, height) in RESOLUTIONS:
+            row = "%-12s" % ( "%dx%d" % (width, height) )
+            for n in SAMPLES_PER_LAUNCH:
+                rate = render( binary, scene, width, height, samples, n, output )
+                failed = failed or rate is None
+                row += "%9s" % ( "-" if rate is None else "%.1f" % rate )
+                sys.stdout.flush()
+            print( row )
+    finally:
+        os.remove( output )
+    return 1 if failed else 0
+
+if __name__ == "__main__":
+    sys.exit( main() )
@@ -91,6 +91,22 @@ def ppm_compare( name1, name2, diffname, diff_threshold_in, allowed_percentage_i
     return(0)
 
 
+# Uses optixImageDiff from the binary directory when it was built, which is much faster on large images.
+# The native tool writes the absolute difference as the diff image instead of marking the differing pixels.
+def image_compare( name1, name2, diffname, diff_threshold, allowed_percentage ):
+
+    tool = bindir + 'optixImageDiff'
+    if not os.path.isfile( tool ) and not os.path.isfile( tool + '.exe' ):
+        return ppm_compare( name1, name2, diffname, diff_threshold, allowed_percentage )
+
+    # Half a code of margin, the native tool compares channels as floats in [0, 1].
+    cmd_args = [tool, '--pixel-threshold', str( ( float(diff_threshold) + 0.5 ) / 255.0 ),
+                '--max-differing', str( allowed_percentage ), '--diff', diffname, name2, name1]
+    print( "\tRunning cmd <<<{0}>>>".format( ' '.join( cmd_args ) ) )
+    # Exit code 1: images differ, 2: missing or invalid files.
+    return subprocess.call( cmd_args )
+
+
 # Constants
 diff_threshold = 1  # out of 255
 allowed_percentage = 3
@@ -126,7 +142,7 @@ for s in samples:
     # Diff result against gold image
     gold_file = golddir + s + '.gold.ppm' 
     diff_file = tmpdir + s + '.diff.ppm'
-    if ppm_compare( result_file, gold_file, diff_file, diff_threshold, allowed_percentage ):
+    if image_compare( result_file, gold_file, diff_file, diff_threshold, allowed_percentage ):
         print "Rendered file: " + result_file
         print "    Gold file: " + gold_file
         print "    Diff file: " + diff_file
@@ -0,0 +1,134 @@
+# Developer script: optixPathTracer --resume after the process was killed in the middle of a --sequence
+#
+# Usage: python test_resume.py <optixPathTracer binary> [options]     (see --help)
+#
+# Renders a short turntable once without interruption as the reference. The same render is then started with
+# frequent checkpoints and killed as soon as a checkpoint of an image after the first one exists. At that point
+# every image before the checkpointed one has to be on disk, because --resume skips them. The render is resumed
+# and every image has to equal the reference bit for bit: the samples are seeded by pixel and frame, and the
+# resumed launches add the same samples in the same order.
+#
+# Exits with 0 when the test passes and 1 when it fails.
+
+from __future__ import print_function
+
+import argparse
+import filecmp
+import os
+import shutil
+import struct
+import subprocess
+import sys
+import time
+
+# CheckpointHeader of Checkpoint.cpp: magic, version, width, height, format, image, frame, reserved, 3 x 64-bit.
+CHECKPOINT_HEADER = struct.Struct( "<4s7I3Q" )
+
+def sequence_filename( pattern, index ):
+    # Like sutil::FrameWriter::sequenceFilename() for patterns without a printf conversion.
+    base, extension = os.path.splitext( pattern )
+    return "%s_%04d%s" % ( base, index, extension )
+
+def checkpoint_image( filename ):
+    # Image index of a complete checkpoint file, None while there is none. Files are renamed into place whole.
+    try:
+        with open( filename, "rb" ) as ckpt:
+            data = ckpt.read( CHECKPOINT_HEADER.size )
+    except IOError:
+        return None
+    if len( data ) != CHECKPOINT_HEADER.size:
+        return None
+    fields = CHECKPOINT_HEADER.unpack( data )
+    return fields[5] if fields[0] == b"PTCK" else None
+
+def render( options, image, extra ):
+    args = [ options.binary, "--file", image, "--sequence", str( options.sequence ), "--spp", str( options.spp ),
+             "--resolution", str( options.resolution[0] ), str( options.resolution[1] ) ] + extra
+    if options.scene:
+        args += [ "--scene", options.scene ]
+    return args
+
+def main():
+    parser = argparse.ArgumentParser( description="Kill optixPathTracer after a checkpoint of a later image and resume it." )
+    parser.add_argument( "binary", help="optixPathTracer executable" )
+    parser.add_argument( "--scene", help="scene file (default: the renderer's default scene)" )
+    parser.add_argument( "--output", default="test_resume", help="directory of the images (default ./test_resume)" )
+    parser.add_argument( "--resolution", type=int, nargs=2, default=[ 256, 256 ], metavar=( "W", "H" ) )
+    parser.add_argument( "--sequence", type=int, default=4, help="images of the turntable (default 4)" )
+    parser.add_argument( "--spp", type=int, default=256, help="samples per pixel, enough for several checkpoints per image" )
+    parser.add_argument( "--kill-image", type=int, default=2, help="kill after a checkpoint of this image or a later one (default 2)" )
+    parser.add_argument( "--timeout", type=float, default=600.0, help="seconds to wait for that checkpoint (default 600)" )
+    options = parser.parse_args()
+    if not 0 < options.kill_image < options.sequence:
+        parser.error( "--kill-image has to be an image after the first one" )
+
+    if os.path.isdir( options.output ):
+        shutil.rmtree( options.output )
+    reference_dir = os.path.join( options.output, "reference" )
+    resumed_dir = os.path.join( options.output, "resumed" )
+    os.makedirs( reference_dir )
+    os.makedirs( resumed_dir )
+
+    reference = os.path.join( reference_dir, "image.pfm" )
+    print( "Rendering the reference" )
+    sys.stdout.flush()
+    if subprocess.call( render( options, reference, [] ) ) != 0:
+        print( "FAIL: the reference render failed" )
+        return 1
+
+    resumed = os.path.join( resumed_dir, "image.pfm" )
+    checkpoint = resumed + ".ckpt"
+    print( "Rendering with checkpoints until image %d is checkpointed" % options.kill_image )
+    sys.stdout.flush()
+    process = subprocess.Popen( render( options, resumed, [ "--checkpoint-interval", "0.001" ] ) )
+    deadline = time.time() + options.timeout
+    image = None
+    while process.poll() is None and time.time() < deadline:
+        image = checkpoint_image( checkpoint )
+        if image is not None and image >= options.kill_image:
+            break
+        time.sleep( 0.001 )
+    if process.poll() is not None:
+        print( "FAIL: the render ended before image %d was checkpointed, raise --spp" % options.kill_image )
+        return 1
+    process.kill()
+    process.wait()
+
+    # Read again, a checkpoint may have been renamed into place between the poll and the kill.
+    image = checkpoint_image( checkpoint )
+    if image is None or image < options.kill_image:
+        print( "FAIL: no checkpoint of image %d or later after the kill" % options.kill_image )
+        return 1
+    print( "Killed with a checkpoint of image %d" % image )
+
+    missing = [ sequence_filename( resumed, index ) for index in range( image )
+                if not os.path.isfile( sequence_filename( resumed, index ) ) ]
+    if missing:
+        print( "FAIL: the checkpoint skips images which were never written: " + ", ".join( missing ) )
+        return 1
+
+    print( "Resuming" )
+    sys.stdout.flush()
+    if subprocess.call( render( options, resumed, [ "--resume" ] ) ) != 0:
+        print( "FAIL: the resumed render failed" )
+        return 1
+
+    failures = 0
+    for index in range( options.sequence ):
+        expected = sequence_filename( reference, index )
+        actual = sequence_filename( resumed, index )
+        if not os.path.isfile( actual ):
+            print( "FAIL: %s is missing" % actual )
+            failures += 1
+        elif not filecmp.cmp( expected, actual, shallow=False ):
+            print( "FAIL: %s differs from %s" % ( actual, expected ) )
+            failures += 1
+    if os.path.isfile( checkpoint ):
+        print( "FAIL: the checkpoint %s was not removed after the last image" % checkpoint )
+        failures += 1
+
+    print( "PASS" if failures == 0 else "%d failures" % failures )
+    return 1 if failures else 0
+
+if __name__ == "__main__":
+    sys.exit( main() )
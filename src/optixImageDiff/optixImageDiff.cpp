@@ -0,0 +1,332 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//-----------------------------------------------------------------------------
+//
+// optixImageDiff: Compare rendered images against gold images.
+//
+//-----------------------------------------------------------------------------
+
+#include <optixu/optixpp_namespace.h>
+
+#include <sutil.h>
+#include <ImageDiff.h>
+#include <ImageReader.h>
+#include <ImageWriter.h>
+#include <Profiler.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace optix;
+
+// Exit codes for regression scripts.
+const int EXIT_MATCH     = 0;
+const int EXIT_DIFFERENT = 1; // A limit was exceeded.
+const int EXIT_ERROR     = 2; // Unreadable images, different sizes or bad arguments.
+
+
+void printUsageAndExit( const std::string& argv0 )
+{
+    std::cerr << "\nUsage: " << argv0 << " [options] <reference> <test>\n";
+    std::cerr <<
+        "Compares an image against a reference image and prints the differences. Images can be .png (8 or 16-bit),\n"
+        ".ppm, .pgm, .pfm or .exr. The exit code is 0 when the images are within all given limits, 1 when they are not\n"
+        "and 2 on errors.\n"
+        "Options:\n"
+        "  -h | --help                  Print this usage message and exit.\n"
+        "  --max-abs <value>            Limit of the largest difference of a channel.\n"
+        "  --max-relative <value>       Limit of the largest difference of a channel relative to the reference value.\n"
+        "                               E.g. 2e-5 for a merge of partials against one render of the same frames.\n"
+        "  --max-mean-abs <value>       Limit of the mean absolute difference.\n"
+        "  --max-rmse <value>           Limit of the RMSE.\n"
+        "  --min-psnr <dB>              Lower limit of the PSNR.\n"
+        "  --min-ssim <value>           Lower limit of the mean SSIM.\n"
+        "  --max-flip <value>           Limit of the mean FLIP error.\n"
+        "  --pixel-threshold <value>    A pixel differs when a channel differs by more (default 0).\n"
+        "  --max-differing <percent>    Limit of the differing pixels.\n"
+        "  --ppd <value>                Pixels per degree of visual angle for FLIP (default 67).\n"
+        "  --diff <file>                Write the absolute difference, .exr and .pfm as float, .png and .ppm 8-bit.\n"
+        "  --diff-scale <value>         Scale of the written difference (default 1).\n"
+        "  --heatmap <file>             Write the FLIP error per pixel in false colour (.png or .ppm).\n"
+        "  --profile                    Print the time spent reading and comparing.\n"
+        "Differences are taken in linear values when both images are linear (.exr, .pfm), otherwise in sRGB\n"
+        "encoding in [0, 1]. SSIM and FLIP compare the clamped, sRGB encoded images.\n"
+        << std::endl;
+
+    exit( EXIT_ERROR );
+}
+
+
+static bool hasSuffix( const std::string& filename, const std::string& suffix )
+{
+    return filename.length() >= suffix.length() &&
+           filename.compare( filename.length() - suffix.length(), suffix.length(), suffix ) == 0;
+}
+
+
+static float floatArgument( int& i, int argc, char** argv )
+{
+    if( i == argc-1 )
+    {
+        std::cerr << "Option '" << argv[i] << "' requires additional argument.\n";
+        printUsageAndExit( argv[0] );
+    }
+    return static_cast<float>( atof( argv[++i] ) );
+}
+
+
+// Piecewise linear approximation of the magma colour map, the convention of FLIP error maps.
+static void magma( float t, float* rgb )
+{
+    static const float keys[5][3] = {
+        { 0.001f, 0.000f, 0.014f },
+        { 0.232f, 0.060f, 0.438f },
+        { 0.550f, 0.161f, 0.506f },
+        { 0.869f, 0.288f, 0.409f },
+        { 0.987f, 0.991f, 0.749f } };
+    const float s = std::min( std::max( t, 0.0f ), 1.0f ) * 4.0f;
+    const int   k = std::min( static_cast<int>( s ), 3 );
+    for( int c = 0; c < 3; ++c )
+        rgb[c] = keys[k][c] + ( s - k ) * ( keys[k + 1][c] - keys[k][c] );
+}
+
+
+// Top-down RGB to the bottom-up 8-bit output of writeImageToFile(). Throws on failure.
+static void writeImage8( const std::string& filename, const std::vector<float>& rgb, unsigned int width, unsigned int height )
+{
+    std::vector<float> bottom_up( rgb.size() );
+    const size_t       row = size_t( width ) * 3;
+    for( unsigned int y = 0; y < height; ++y )
+        std::copy( rgb.begin() + y * row, rgb.begin() + ( y + 1 ) * row, bottom_up.begin() + ( height - 1 - y ) * row );
+    sutil::writeImageToFile( filename.c_str(), bottom_up.data(), width, height, RT_FORMAT_FLOAT3 );
+}
+
+
+static bool writeDiff( const std::string& filename, std::vector<float>& diff, float scale, unsigned int width, unsigned int height )
+{
+    for( size_t i = 0; i < diff.size(); ++i )
+        diff[i] *= scale;
+    if( hasSuffix( filename, ".exr" ) )
+        return sutil::writeEXR( filename.c_str(), diff.data(), width, height, 3, false, true, sutil::EXR_COMPRESSION_ZIP );
+    if( hasSuffix( filename, ".pfm" ) )
+        return sutil::writePFM( filename.c_str(), diff.data(), width, height, 3, false );
+    writeImage8( filename, diff, width, height );
+    return true;
+}
+
+
+static void writeHeatmap( const std::string& filename, const std::vector<float>& error, unsigned int width, unsigned int height )
+{
+    std::vector<float> rgb( error.size() * 3 );
+    for( size_t i = 0; i < error.size(); ++i )
+        magma( error[i], &rgb[3 * i] );
+    writeImage8( filename, rgb, width, height );
+}
+
+
+// Prints the check and returns whether it passed.
+static bool checkLimit( const char* name, double value, double limit, bool upper )
+{
+    const bool pass = upper ? value <= limit : value >= limit;
+    if( !pass )
+        std::cout << "FAIL " << name << " " << value << ( upper ? " > " : " < " ) << limit << std::endl;
+    return pass;
+}
+
+
+int main( int argc, char** argv )
+{
+    std::vector<std::string> files;
+    sutil::ImageDiffSettings settings;
+    std::string diff_file;
+    std::string heatmap_file;
+    float diff_scale = 1.0f;
+
+    // Negative limits are not checked.
+    double max_abs       = -1.0;
+    double max_relative  = -1.0;
+    double max_mean_abs  = -1.0;
+    double max_rmse      = -1.0;
+    double min_psnr      = -1.0;
+    double min_ssim      = -1.0;
+    double max_flip      = -1.0;
+    double max_differing = -1.0;
+
+    for( int i = 1; i < argc; ++i )
+    {
+        const std::string arg( argv[i] );
+
+        if( arg == "-h" || arg == "--help" )
+        {
+            printUsageAndExit( argv[0] );
+        }
+        else if( arg == "--max-abs" )
+        {
+            max_abs = floatArgument( i, argc, argv );
+        }
+        else if( arg == "--max-relative" )
+        {
+            max_relative = floatArgument( i, argc, argv );
+        }
+        else if( arg == "--max-mean-abs" )
+        {
+            max_mean_abs = floatArgument( i, argc, argv );
+        }
+        else if( arg == "--max-rmse" )
+        {
+            max_rmse = floatArgument( i, argc, argv );
+        }
+        else if( arg == "--min-psnr" )
+        {
+            min_psnr = floatArgument( i, argc, argv );
+        }
+        else if( arg == "--min-ssim" )
+        {
+            min_ssim = floatArgument( i, argc, argv );
+        }
+        else if( arg == "--max-flip" )
+        {
+            max_flip = floatArgument( i, argc, argv );
+        }
+        else if( arg == "--pixel-threshold" )
+        {
+            settings.pixel_threshold = floatArgument( i, argc, argv );
+        }
+        else if( arg == "--max-differing" )
+        {
+            max_differing = floatArgument( i, argc, argv );
+        }
+        else if( arg == "--ppd" )
+        {
+            settings.pixels_per_degree = floatArgument( i, argc, argv );
+            if( settings.pixels_per_degree <= 0.0f )
+            {
+                std::cerr << "Option '" << arg << "' requires a positive value.\n";
+                printUsageAndExit( argv[0] );
+            }
+        }
+        else if( arg == "--diff-scale" )
+        {
+            diff_scale = floatArgument( i, argc, argv );
+        }
+        else if( arg == "--profile" )
+        {
+            sutil::setProfilingEnabled( true );
+        }
+        else if( arg == "--diff" || arg == "--heatmap" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            ( arg == "--diff" ? diff_file : heatmap_file ) = argv[++i];
+        }
+        else if( arg[0] == '-' )
+        {
+            std::cerr << "Unknown option '" << arg << "'\n";
+            printUsageAndExit( argv[0] );
+        }
+        else
+        {
+            files.push_back( arg );
+        }
+    }
+
+    if( files.size() != 2 )
+        printUsageAndExit( argv[0] );
+
+    try
+    {
+        const double start_time = sutil::currentTime();
+
+        sutil::FloatImage reference, test;
+        if( !sutil::readImageFile( files[0], reference ) || !sutil::readImageFile( files[1], test ) )
+            return EXIT_ERROR;
+
+        sutil::ImageDiffStats stats;
+        std::vector<float> diff, flip;
+        if( !sutil::compareImages( reference, test, settings, stats, diff_file.empty() ? 0 : &diff, heatmap_file.empty() ? 0 : &flip ) )
+            return EXIT_ERROR;
+
+        const double compare_time = sutil::currentTime() - start_time;
+        std::cerr << "Compared " << files[1] << " to " << files[0] << " (" << reference.width << "x" << reference.height
+                  << ") in " << compare_time << " s" << std::endl;
+        if( sutil::profilingEnabled() )
+            sutil::printProfileSummary( std::cerr );
+
+        const double pixels    = double( reference.width ) * reference.height;
+        const double differing = 100.0 * stats.differing_pixels / pixels;
+        std::cout << "max_abs " << stats.max_abs << "\n"
+                  << "max_relative " << stats.max_relative << "\n"
+                  << "mean_abs " << stats.mean_abs << "\n"
+                  << "rmse " << stats.rmse << "\n"
+                  << "psnr " << stats.psnr << "\n"
+                  << "ssim " << stats.ssim << "\n"
+                  << "flip_mean " << stats.flip_mean << "\n"
+                  << "flip_max " << stats.flip_max << "\n"
+                  << "differing_pixels " << stats.differing_pixels << " (" << differing << "%)" << std::endl;
+
+        if( !diff_file.empty() && !writeDiff( diff_file, diff, diff_scale, reference.width, reference.height ) )
+            return EXIT_ERROR;
+        if( !heatmap_file.empty() )
+            writeHeatmap( heatmap_file, flip, reference.width, reference.height );
+
+        bool pass = true;
+        if( max_abs >= 0.0 )
+            pass = checkLimit( "max_abs", stats.max_abs, max_abs, true ) && pass;
+        if( max_relative >= 0.0 )
+            pass = checkLimit( "max_relative", stats.max_relative, max_relative, true ) && pass;
+        if( max_mean_abs >= 0.0 )
+            pass = checkLimit( "mean_abs", stats.mean_abs, max_mean_abs, true ) && pass;
+        if( max_rmse >= 0.0 )
+            pass = checkLimit( "rmse", stats.rmse, max_rmse, true ) && pass;
+        if( min_psnr >= 0.0 )
+            pass = checkLimit( "psnr", stats.psnr, min_psnr, false ) && pass;
+        if( min_ssim >= 0.0 )
+            pass = checkLimit( "ssim", stats.ssim, min_ssim, false ) && pass;
+        if( max_flip >= 0.0 )
+            pass = checkLimit( "flip_mean", stats.flip_mean, max_flip, true ) && pass;
+        if( max_differing >= 0.0 )
+            pass = checkLimit( "differing_percent", differing, max_differing, true ) && pass;
+
+        std::cout << ( pass ? "Images considered equivalent." : "Images considered different." ) << std::endl;
+        return pass ? EXIT_MATCH : EXIT_DIFFERENT;
+    }
+    catch( const Exception& e )
+    {
+        std::cerr << "ERROR: " << e.getErrorString() << std::endl;
+        return EXIT_ERROR;
+    }
+}
@@ -0,0 +1,181 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//-----------------------------------------------------------------------------
+//
+// optixMergePartials: Combine partial renders of optixPathTracer --sample-range.
+//
+//-----------------------------------------------------------------------------
+
+#include <optixu/optixpp_namespace.h>
+
+#include <sutil.h>
+#include <ImageWriter.h>
+#include <PartialImage.h>
+#include <ToneMap.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace optix;
+
+
+void printUsageAndExit( const std::string& argv0 )
+{
+    std::cerr << "\nUsage: " << argv0 << " [options] <output_file> <partial> [<partial> ...]\n";
+    std::cerr <<
+        "Merges partial renders of disjoint frame ranges of the same image. The order of the partials does not matter.\n"
+        "Several partials differ from a single render of their frames by float rounding, up to about frames * 6e-8\n"
+        "relative (1.5e-5 for 256 frames). Compare them with optixImageDiff --max-relative.\n"
+        "The output type follows the extension:\n"
+        "  .partial                     Merged partial, can be merged again.\n"
+        "  .exr, .pfm                   Linear mean radiance.\n"
+        "  .png, .ppm                   Tonemapped 8-bit image (16-bit .png with --png16).\n"
+        "Options:\n"
+        "  -h | --help                  Print this usage message and exit.\n"
+        "  --png16                      Save .png files with 16 bits per channel.\n"
+        "  --tonemap <operator>         linear, reinhard (default), aces or filmic.\n"
+        "  --exposure <stops>           Exposure applied before the tonemap operator (default 0).\n"
+        "  --no-dither                  Quantize 8-bit output without dithering.\n"
+        << std::endl;
+
+    exit(1);
+}
+
+
+static bool hasSuffix( const std::string& filename, const std::string& suffix )
+{
+    return filename.length() >= suffix.length() &&
+           filename.compare( filename.length() - suffix.length(), suffix.length(), suffix ) == 0;
+}
+
+
+int main( int argc, char** argv )
+{
+    std::vector<std::string> files;
+    sutil::ToneMapSettings tonemap_settings;
+    bool png16 = false;
+
+    for( int i = 1; i < argc; ++i )
+    {
+        const std::string arg( argv[i] );
+
+        if( arg == "-h" || arg == "--help" )
+        {
+            printUsageAndExit( argv[0] );
+        }
+        else if( arg == "--png16" )
+        {
+            png16 = true;
+        }
+        else if( arg == "--tonemap" )
+        {
+            if( i == argc-1 || !sutil::toneMapOperatorFromName( argv[++i], tonemap_settings.op ) )
+            {
+                std::cerr << "Option '" << arg << "' requires linear, reinhard, aces or filmic.\n";
+                printUsageAndExit( argv[0] );
+            }
+        }
+        else if( arg == "--exposure" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            tonemap_settings.exposure = static_cast<float>( atof( argv[++i] ) );
+        }
+        else if( arg == "--no-dither" )
+        {
+            tonemap_settings.dither = false;
+        }
+        else if( arg[0] == '-' )
+        {
+            std::cerr << "Unknown option '" << arg << "'\n";
+            printUsageAndExit( argv[0] );
+        }
+        else
+        {
+            files.push_back( arg );
+        }
+    }
+
+    if( files.size() < 2 )
+        printUsageAndExit( argv[0] );
+
+    const std::string out_file = files.front();
+    files.erase( files.begin() );
+
+    try
+    {
+        const double start_time = sutil::currentTime();
+
+        sutil::PartialImageInfo info;
+        std::vector<float> sum_count;
+        if( !sutil::mergePartialImages( files, info, sum_count ) )
+            return 1;
+
+        const double merge_time = sutil::currentTime() - start_time;
+        std::cerr << "Merged " << files.size() << " partials, frames " << info.frame_begin << " to " << info.frame_end - 1
+                  << " (" << info.width << "x" << info.height << ") in " << merge_time << " s" << std::endl;
+
+        bool success = true;
+        if( hasSuffix( out_file, ".partial" ) )
+        {
+            success = sutil::writePartialImage( out_file, info, sum_count.data() );
+        }
+        else
+        {
+            std::vector<float> mean;
+            sutil::resolvePartialImage( sum_count, mean );
+
+            if( hasSuffix( out_file, ".exr" ) || hasSuffix( out_file, ".pfm" ) || ( png16 && hasSuffix( out_file, ".png" ) ) )
+            {
+                success = sutil::writeFloatImageToFile( out_file.c_str(), mean.data(), info.width, info.height, 4 );
+            }
+            else
+            {
+                std::vector<unsigned char> pixels( mean.size() );
+                sutil::toneMap( mean.data(), info.width, info.height, 4, tonemap_settings, pixels.data() );
+                sutil::writeImageToFile( out_file.c_str(), pixels.data(), info.width, info.height, RT_FORMAT_UNSIGNED_BYTE4 );
+            }
+        }
+
+        if( !success )
+            return 1;
+        std::cerr << "Wrote " << out_file << std::endl;
+        return 0;
+    }
+    catch( const Exception& e )
+    {
+        std::cerr << "ERROR: " << e.getErrorString() << std::endl;
+        return 1;
+    }
+}
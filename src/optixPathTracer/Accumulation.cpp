@@ -0,0 +1,99 @@
+#include "Accumulation.h"
+
+#include <iostream>
+
+#include "rgb9e5.h"
+
+
+const char* accumulationFormatName(AccumulationFormat format)
+{
+  switch (format)
+  {
+    case ACCUMULATION_RGB9E5:
+      return "rgb9e5";
+    default:
+      return "float";
+  }
+}
+
+bool accumulationFormatFromName(const std::string& name, AccumulationFormat& format)
+{
+  if (name == "float")
+  {
+    format = ACCUMULATION_FLOAT;
+    return true;
+  }
+  if (name == "rgb9e5")
+  {
+    format = ACCUMULATION_RGB9E5;
+    return true;
+  }
+  return false;
+}
+
+RTformat accumulationBufferFormat(AccumulationFormat format)
+{
+  return (format == ACCUMULATION_RGB9E5) ? RT_FORMAT_UNSIGNED_INT : RT_FORMAT_FLOAT4;
+}
+
+unsigned int accumulationBytesPerPixel(AccumulationFormat format)
+{
+  return (format == ACCUMULATION_RGB9E5) ? 4 : 16;
+}
+
+const char* accumulationBufferName(AccumulationFormat format)
+{
+  return (format == ACCUMULATION_RGB9E5) ? "accum_preview_buffer" : "accum_buffer";
+}
+
+const char* accumulationRayGenerationProgram(AccumulationFormat format)
+{
+  return (format == ACCUMULATION_RGB9E5) ? "pinhole_camera_preview" : "pinhole_camera";
+}
+
+const char* accumulationToneMapProgram(AccumulationFormat format)
+{
+  return (format == ACCUMULATION_RGB9E5) ? "tonemap_preview" : "tonemap";
+}
+
+bool resolveAccumulation(optix::Buffer buffer, std::vector<float>& rgba)
+{
+  RTsize width;
+  RTsize height;
+  buffer->getSize(width, height);
+  const size_t numPixels = width * height;
+
+  const RTformat format = buffer->getFormat();
+  if (format != RT_FORMAT_FLOAT4 && format != RT_FORMAT_UNSIGNED_INT)
+  {
+    std::cerr << "ERROR: resolveAccumulation() unexpected buffer format " << format << std::endl;
+    return false;
+  }
+
+  rgba.resize(numPixels * 4);
+
+  const void* data = buffer->map(0, RT_BUFFER_MAP_READ);
+  if (format == RT_FORMAT_FLOAT4)
+  {
+    const float* src = static_cast<const float*>(data);
+    for (size_t i = 0; i < numPixels; ++i, src += 4)
+    {
+      const float invCount = (0.0f < src[3]) ? 1.0f / src[3] : 0.0f;
+      rgba[i * 4 + 0] = src[0] * invCount;
+      rgba[i * 4 + 1] = src[1] * invCount;
+      rgba[i * 4 + 2] = src[2] * invCount;
+      rgba[i * 4 + 3] = 1.0f;
+    }
+  }
+  else
+  {
+    const unsigned int* src = static_cast<const unsigned int*>(data);
+    for (size_t i = 0; i < numPixels; ++i)
+    {
+      decodeRGB9E5(src[i], rgba[i * 4 + 0], rgba[i * 4 + 1], rgba[i * 4 + 2]);
+      rgba[i * 4 + 3] = 1.0f;
+    }
+  }
+  buffer->unmap();
+  return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#ifndef ACCUMULATION_H
+#define ACCUMULATION_H
+
+#include <optixu/optixpp_namespace.h>
+
+#include <string>
+#include <vector>
+
+// Storage of the progressive accumulation.
+// ACCUMULATION_FLOAT:  RT_FORMAT_FLOAT4, sum of the samples in xyz and the per-pixel sample count in w (16 bytes per pixel).
+//                      Sums of partial renders can be added, and pixels may hold different numbers of samples.
+// ACCUMULATION_RGB9E5: RT_FORMAT_UNSIGNED_INT, running mean in RGB9E5 with stochastic rounding (4 bytes per pixel).
+//                      Every pixel holds the same number of samples. About 1% error, meant for interactive preview.
+enum AccumulationFormat
+{
+  ACCUMULATION_FLOAT,
+  ACCUMULATION_RGB9E5
+};
+
+const char* accumulationFormatName(AccumulationFormat format);
+bool        accumulationFormatFromName(const std::string& name, AccumulationFormat& format); // "float" or "rgb9e5".
+
+RTformat     accumulationBufferFormat(AccumulationFormat format);
+unsigned int accumulationBytesPerPixel(AccumulationFormat format);
+
+// Name of the context variable holding the buffer and of the ray generation and tonemap programs using it.
+const char* accumulationBufferName(AccumulationFormat format);
+const char* accumulationRayGenerationProgram(AccumulationFormat format);
+const char* accumulationToneMapProgram(AccumulationFormat format);
+
+// Convert an accumulation buffer of either format into the mean radiance as RGBA floats (alpha 1) in buffer row order.
+// Pixels without samples are black. The buffer must be readable on the host.
+bool resolveAccumulation(optix::Buffer buffer, std::vector<float>& rgba);
+
+#endif // ACCUMULATION_H
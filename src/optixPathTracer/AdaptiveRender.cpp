@@ -0,0 +1,197 @@
+#include "AdaptiveRender.h"
+
+#include "Aov.h"
+#include "Renderer.h"
+
+#include <sutil.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+
+AdaptiveRenderSettings::AdaptiveRenderSettings()
+: m_timeBudget(0.0)
+, m_targetRmse(0.0)
+, m_minFrames(16)
+, m_maxFrames(65536)
+{
+}
+
+AdaptiveRenderStats::AdaptiveRenderStats()
+: m_frames(0)
+, m_seconds(0.0)
+, m_estimateSeconds(0.0)
+, m_estimates(0)
+, m_rmse(-1.0)
+, m_stopReason("max_frames")
+{
+}
+
+double estimateRmse(const float* variance, size_t pixels)
+{
+  double sum   = 0.0;
+  size_t count = 0;
+  for (size_t i = 0; i < pixels; ++i)
+  {
+    const float* value = variance + i * 4;
+    if (value[0] >= 0.0f && value[1] >= 2.0f)
+    {
+      sum += value[0];
+      ++count;
+    }
+  }
+  return count ? sqrt(sum / count) : -1.0;
+}
+
+// Reads the variance AOV back and updates the estimate of the stats. Returns the seconds it took, < 0 on errors.
+static double updateEstimate(const Session& session, std::vector<float>& variance, AdaptiveRenderStats& stats)
+{
+  const double start = sutil::currentTime();
+  if (!session.readAov(AOV_INDEX_VARIANCE, variance))
+  {
+    return -1.0;
+  }
+  stats.m_rmse = estimateRmse(variance.data(), variance.size() / 4);
+  ++stats.m_estimates;
+  const double seconds = sutil::currentTime() - start;
+  stats.m_estimateSeconds += seconds;
+  return seconds;
+}
+
+bool renderAdaptive(Session& session, const AdaptiveRenderSettings& settings, AdaptiveRenderStats& stats)
+{
+  const double startTime = sutil::currentTime();
+
+  const unsigned int maxFrames = std::max(1u, settings.m_maxFrames);
+  const unsigned int minFrames = std::min(std::max(2u, settings.m_minFrames), maxFrames);
+  const bool         budget    = settings.m_timeBudget > 0.0;
+  const bool         target    = settings.m_targetRmse > 0.0;
+
+  stats = AdaptiveRenderStats();
+  session.resetAccumulation();
+
+  // The first estimate also measures the cost of one, a time budget keeps that much for the final estimate.
+  std::vector<float> variance;
+  double       launchSeconds  = 0.0;
+  double       estimateCost   = 0.0;
+  unsigned int estimateFrames = 0;
+  unsigned int nextEstimate   = minFrames;
+  while (stats.m_frames < maxFrames)
+  {
+    unsigned int frames = std::min(session.getSamplesPerLaunch(), std::min(maxFrames, nextEstimate) - stats.m_frames);
+    if (budget && stats.m_frames > 0)
+    {
+      // Throughput of the launches so far, the next launch only runs as far as it fits.
+      const double remaining = settings.m_timeBudget - (sutil::currentTime() - startTime) - estimateCost;
+      const double perFrame  = launchSeconds / stats.m_frames;
+      frames = static_cast<unsigned int>(std::max(0.0, std::min(static_cast<double>(frames), floor(remaining / perFrame))));
+      if (frames == 0)
+      {
+        stats.m_stopReason = "time_budget";
+        break;
+      }
+    }
+
+    const double launchStart = sutil::currentTime();
+    session.render(frames);
+    launchSeconds  += sutil::currentTime() - launchStart;
+    stats.m_frames += frames;
+
+    if (stats.m_frames == nextEstimate && stats.m_frames < maxFrames)
+    {
+      estimateCost = updateEstimate(session, variance, stats);
+      if (estimateCost < 0.0)
+      {
+        return false;
+      }
+      estimateFrames = stats.m_frames;
+      if (!target)
+      {
+        nextEstimate = maxFrames;
+        continue;
+      }
+      if (0.0 <= stats.m_rmse && stats.m_rmse <= settings.m_targetRmse)
+      {
+        stats.m_stopReason = "target_rmse";
+        break;
+      }
+      // The error falls with 1/sqrt(frames). Noisy early estimates may predict too much, so the steps are limited.
+      const double predicted = (stats.m_rmse > 0.0) ? stats.m_frames * (stats.m_rmse / settings.m_targetRmse) * (stats.m_rmse / settings.m_targetRmse)
+                                                    : 2.0 * stats.m_frames;
+      const double next = std::min(4.0 * stats.m_frames, std::max(stats.m_frames + 1.0, ceil(predicted)));
+      nextEstimate = static_cast<unsigned int>(std::min(next, static_cast<double>(maxFrames)));
+    }
+  }
+
+  // The reported error belongs to the final accumulation.
+  if (estimateFrames != stats.m_frames && 2 <= stats.m_frames)
+  {
+    if (updateEstimate(session, variance, stats) < 0.0)
+    {
+      return false;
+    }
+    if (target && stats.m_rmse <= settings.m_targetRmse && stats.m_frames < maxFrames)
+    {
+      stats.m_stopReason = "target_rmse";
+    }
+  }
+  stats.m_seconds = sutil::currentTime() - startTime;
+  return true;
+}
+
+static std::string jsonString(const std::string& text)
+{
+  std::string quoted = "\"";
+  for (size_t i = 0; i < text.size(); ++i)
+  {
+    const char c = text[i];
+    if (c == '"' || c == '\\')
+    {
+      quoted += '\\';
+    }
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+static std::string jsonNumber(double value, bool present)
+{
+  if (!present)
+  {
+    return "null";
+  }
+  std::ostringstream number;
+  number << value;
+  return number.str();
+}
+
+bool writeRenderReport(const std::string& filename, const std::string& image, unsigned int width, unsigned int height,
+                       const AdaptiveRenderSettings& settings, const AdaptiveRenderStats& stats, double totalSeconds)
+{
+  std::ofstream file(filename.c_str());
+  file << "{\n"
+       << "  \"image\": " << jsonString(image) << ",\n"
+       << "  \"width\": " << width << ",\n"
+       << "  \"height\": " << height << ",\n"
+       << "  \"spp\": " << stats.m_frames << ",\n"
+       << "  \"render_seconds\": " << stats.m_seconds << ",\n"
+       << "  \"estimate_seconds\": " << stats.m_estimateSeconds << ",\n"
+       << "  \"total_seconds\": " << totalSeconds << ",\n"
+       << "  \"seconds_per_spp\": " << jsonNumber((stats.m_seconds - stats.m_estimateSeconds) / stats.m_frames, 0 < stats.m_frames) << ",\n"
+       << "  \"estimated_rmse\": " << jsonNumber(stats.m_rmse, 0.0 <= stats.m_rmse) << ",\n"
+       << "  \"time_budget\": " << jsonNumber(settings.m_timeBudget, 0.0 < settings.m_timeBudget) << ",\n"
+       << "  \"target_rmse\": " << jsonNumber(settings.m_targetRmse, 0.0 < settings.m_targetRmse) << ",\n"
+       << "  \"stop_reason\": " << jsonString(stats.m_stopReason) << "\n"
+       << "}\n";
+  file.close();
+  if (!file)
+  {
+    std::cerr << "ERROR: writeRenderReport() cannot write " << filename << std::endl;
+    return false;
+  }
+  return true;
+}
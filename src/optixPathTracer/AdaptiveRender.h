@@ -0,0 +1,54 @@
+#pragma once
+
+#ifndef ADAPTIVE_RENDER_H
+#define ADAPTIVE_RENDER_H
+
+#include <string>
+
+// Batch rendering until a deadline or a noise level instead of a fixed sample count.
+// The session renders whole launches and measures the time per frame (one sample per pixel). With a time budget
+// the next launch is shrunk or skipped when it would not finish in time. With a target RMSE the variance AOV is
+// read back at intervals: the error of a mean falls with 1/sqrt(samples), so each estimate predicts the frame count
+// that meets the target and the render continues to it, at most quadrupling the frames between two estimates.
+//
+// The estimated RMSE is the root of the mean variance of the pixel means, in linear luminance. It ignores the bias
+// of the path length limit and is itself noisy at low sample counts.
+
+class Session;
+
+struct AdaptiveRenderSettings
+{
+  AdaptiveRenderSettings();
+
+  double       m_timeBudget; // Seconds of rendering, including the estimates. 0: no limit.
+  double       m_targetRmse; // 0: no target.
+  unsigned int m_minFrames;  // Before the first estimate.
+  unsigned int m_maxFrames;  // Stops there when neither limit is reached.
+};
+
+struct AdaptiveRenderStats
+{
+  AdaptiveRenderStats();
+
+  unsigned int m_frames;          // Samples per pixel.
+  double       m_seconds;         // Launches and estimates.
+  double       m_estimateSeconds; // Variance readbacks.
+  unsigned int m_estimates;
+  double       m_rmse;            // Of the final accumulation, < 0 without an estimate.
+  const char*  m_stopReason;      // "time_budget", "target_rmse" or "max_frames".
+};
+
+// Starts a new accumulation of the session's camera. The session needs a readable accumulation and the
+// AOV_VARIANCE AOV. Returns false with a message on std::cerr when the variance cannot be read.
+bool renderAdaptive(Session& session, const AdaptiveRenderSettings& settings, AdaptiveRenderStats& stats);
+
+// Root mean variance of the pixel means from resolved AOV_INDEX_VARIANCE values, over the pixels with an estimate.
+// Returns -1 when no pixel has one.
+double estimateRmse(const float* variance, size_t pixels);
+
+// Sidecar JSON of a batch render for job schedulers: image size, achieved samples per pixel, render and total time,
+// estimated error and the limits it was rendered with.
+bool writeRenderReport(const std::string& filename, const std::string& image, unsigned int width, unsigned int height,
+                       const AdaptiveRenderSettings& settings, const AdaptiveRenderStats& stats, double totalSeconds);
+
+#endif // ADAPTIVE_RENDER_H
@@ -0,0 +1,159 @@
+#include "Aov.h"
+
+#include <ImageWriter.h>
+#include <Profiler.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+
+struct AovLayer
+{
+  const char* name;
+  const char* buffer;
+  const char* layer;    // Channel name prefix.
+  const char* channels; // One letter per channel, from x.
+  bool        half;
+};
+
+// In AovIndex order.
+static const AovLayer AOV_LAYERS[AOV_COUNT] =
+{
+  { "depth",    "depth_buffer",    "",            "Z",   false },
+  { "normal",   "normal_buffer",   "normal.",     "XYZ", true  },
+  { "albedo",   "albedo_buffer",   "albedo.",     "RGB", true  },
+  { "material", "material_buffer", "materialId.", "V",   false },
+  { "direct",   "direct_buffer",   "direct.",     "RGB", true  },
+  { "indirect", "indirect_buffer", "indirect.",   "RGB", true  },
+  { "variance", "variance_buffer", "variance.",   "V",   false },
+  { "cost",     "cost_buffer",     "cost.",       "RIC", false },
+  { "samples",  nullptr,           "samples.",    "V",   false }
+};
+
+
+const char* aovName(unsigned int index)
+{
+  return index < AOV_COUNT ? AOV_LAYERS[index].name : "unknown";
+}
+
+bool aovsFromNames(const std::string& names, unsigned int& mask)
+{
+  mask = 0;
+  std::istringstream list(names);
+  std::string name;
+  while (std::getline(list, name, ','))
+  {
+    if (name == "all")
+    {
+      mask |= (1u << AOV_COUNT) - 1;
+      continue;
+    }
+    unsigned int index = 0;
+    while (index < AOV_COUNT && name != AOV_LAYERS[index].name)
+    {
+      ++index;
+    }
+    if (index == AOV_COUNT)
+    {
+      std::cerr << "ERROR: Unknown AOV '" << name << "'" << std::endl;
+      return false;
+    }
+    mask |= 1u << index;
+  }
+  return mask != 0;
+}
+
+const char* aovBufferName(unsigned int index)
+{
+  return index < AOV_COUNT ? AOV_LAYERS[index].buffer : nullptr;
+}
+
+void resolveAov(unsigned int index, const float* sums, size_t pixels, std::vector<float>& values)
+{
+  values.assign(pixels * 4, 0.0f);
+  for (size_t i = 0; i < pixels; ++i)
+  {
+    const float* sum   = sums + i * 4;
+    float*       value = &values[i * 4];
+    if (sum[3] <= 0.0f)
+    {
+      continue;
+    }
+    if (index == AOV_INDEX_DEPTH)
+    {
+      value[0] = (sum[1] > 0.0f) ? sum[0] / sum[1] : 0.0f; // Mean over the samples which hit.
+    }
+    else if (index == AOV_INDEX_MATERIAL)
+    {
+      value[0] = sum[0];
+    }
+    else if (index == AOV_INDEX_VARIANCE)
+    {
+      // Unbiased sample variance of the luminance, divided by the count for the variance of the mean.
+      const double n    = sum[3];
+      const double mean = sum[0] / n;
+      value[0] = (n > 1.0) ? static_cast<float>(std::max(0.0, (sum[1] - sum[0] * mean) / (n - 1.0)) / n) : -1.0f;
+      value[1] = sum[3];
+    }
+    else if (index == AOV_INDEX_SAMPLES)
+    {
+      value[0] = sum[3];
+    }
+    else
+    {
+      float scale = 1.0f / sum[3];
+      if (index == AOV_INDEX_NORMAL)
+      {
+        const float length = sqrtf(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+        scale = (length > 0.0f) ? 1.0f / length : 0.0f;
+      }
+      value[0] = sum[0] * scale;
+      value[1] = sum[1] * scale;
+      value[2] = sum[2] * scale;
+    }
+  }
+}
+
+bool writeAovImage(const std::string& filename, const std::vector<float>& rgba, const std::vector<float> aovs[AOV_COUNT], unsigned int mask,
+                   unsigned int width, unsigned int height)
+{
+  sutil::ProfileScope profile("write image", filename);
+  const size_t pixels = size_t(width) * height;
+  std::vector<sutil::ExrChannel> channels;
+
+  const char* const color = "RGB";
+  for (int c = 0; c < 3; ++c)
+  {
+    sutil::ExrChannel channel;
+    channel.name   = std::string(1, color[c]);
+    channel.pixels = rgba.data() + c;
+    channel.stride = 4;
+    channels.push_back(channel);
+  }
+
+  for (unsigned int index = 0; index < AOV_COUNT; ++index)
+  {
+    if (!(mask & (1u << index)))
+    {
+      continue;
+    }
+    if (aovs[index].size() < pixels * 4)
+    {
+      std::cerr << "ERROR: writeAovImage() has no " << aovName(index) << " values for " << filename << std::endl;
+      return false;
+    }
+    const AovLayer& layer = AOV_LAYERS[index];
+    for (int c = 0; layer.channels[c]; ++c)
+    {
+      sutil::ExrChannel channel;
+      channel.name   = std::string(layer.layer) + layer.channels[c];
+      channel.pixels = aovs[index].data() + c;
+      channel.stride = 4;
+      channel.half   = layer.half;
+      channels.push_back(channel);
+    }
+  }
+  return sutil::writeEXR(filename.c_str(), channels, width, height, true, sutil::EXR_COMPRESSION_ZIP);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#ifndef AOV_H
+#define AOV_H
+
+#include "aov_flags.h"
+
+#include <string>
+#include <vector>
+
+// Host side of the arbitrary output variables. The AOVs are identified by their AovIndex, masks hold AovFlag bits.
+
+const char* aovName(unsigned int index); // "depth", "normal", "albedo", "material", "direct", "indirect", "variance", "cost", "samples".
+
+// Comma separated AOV names, or "all". Returns false with a message on std::cerr for unknown names.
+bool aovsFromNames(const std::string& names, unsigned int& mask);
+
+// Context variable of the device buffer, nullptr for AOV_SAMPLES.
+const char* aovBufferName(unsigned int index);
+
+// Per-pixel values of an AOV from its device sums (or from the float accumulation for AOV_SAMPLES), 4 floats per pixel:
+// depth in x (0 where no sample hit), the normalized mean normal in xyz, mean colors in xyz, the material index or the
+// sample count in x. The variance of the mean luminance, an estimate of the squared error of the pixel, is in x and
+// its sample count in y; pixels with one sample have no estimate and -1. The cost holds the rays, intersection tests
+// and device cycles per sample in xyz. Pixels without samples are 0.
+void resolveAov(unsigned int index, const float* sums, size_t pixels, std::vector<float>& values);
+
+// Multi-layer OpenEXR (ZIP) with the color in R, G, B and one layer per AOV of mask: Z, normal.XYZ, albedo.RGB,
+// materialId.V, direct.RGB, indirect.RGB, variance.V, cost.RIC (rays, intersections, cycles) and samples.V. Depth,
+// material, variance, cost and samples are 32-bit floats, the rest half.
+// rgba and the AOVs hold 4 floats per pixel in buffer row order.
+bool writeAovImage(const std::string& filename, const std::vector<float>& rgba, const std::vector<float> aovs[AOV_COUNT], unsigned int mask,
+                   unsigned int width, unsigned int height);
+
+#endif // AOV_H
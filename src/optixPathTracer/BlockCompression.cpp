@@ -0,0 +1,949 @@
+#include "BlockCompression.h"
+
+#include <sutil/Parallel.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+#include <sys/stat.h>
+
+#include "MyAssert.h"
+
+
+CompressedImage::CompressedImage()
+: m_format(BLOCK_FORMAT_NONE)
+, m_width(0)
+, m_height(0)
+, m_blocksX(0)
+, m_blocksY(0)
+{
+}
+
+CompressionReport::CompressionReport()
+: m_uncompressedBytes(0)
+, m_compressedBytes(0)
+, m_psnr(0.0)
+, m_seconds(0.0)
+, m_fromCache(false)
+{
+}
+
+unsigned int blockSize(BlockFormat format)
+{
+  switch (format)
+  {
+    case BLOCK_FORMAT_BC1:
+    case BLOCK_FORMAT_BC4:
+      return 8;
+    case BLOCK_FORMAT_BC7:
+      return 16;
+    default:
+      return 0;
+  }
+}
+
+const char* blockFormatName(BlockFormat format)
+{
+  switch (format)
+  {
+    case BLOCK_FORMAT_BC1:
+      return "bc1";
+    case BLOCK_FORMAT_BC4:
+      return "bc4";
+    case BLOCK_FORMAT_BC7:
+      return "bc7";
+    default:
+      return "none";
+  }
+}
+
+BlockFormat blockFormatFromName(const std::string& name)
+{
+  if (name == "bc1")
+  {
+    return BLOCK_FORMAT_BC1;
+  }
+  if (name == "bc4")
+  {
+    return BLOCK_FORMAT_BC4;
+  }
+  if (name == "bc7")
+  {
+    return BLOCK_FORMAT_BC7;
+  }
+  return BLOCK_FORMAT_NONE;
+}
+
+
+// Helpers shared by the encoders.
+
+static inline int clampInt(int v, int lo, int hi)
+{
+  return (v < lo) ? lo : ((hi < v) ? hi : v);
+}
+
+static inline float clampFloat(float v, float lo, float hi)
+{
+  return (v < lo) ? lo : ((hi < v) ? hi : v);
+}
+
+// Principal axis of the block's texel distribution via power iteration on the covariance matrix.
+// Returns the mean in 'mean' and the normalized axis in 'axis'. 'channels' is 3 (RGB) or 4 (RGBA).
+static void principalAxis(const float (*px)[4], unsigned int channels, float* mean, float* axis)
+{
+  for (unsigned int c = 0; c < channels; ++c)
+  {
+    mean[c] = 0.0f;
+    for (unsigned int i = 0; i < 16; ++i)
+    {
+      mean[c] += px[i][c];
+    }
+    mean[c] *= 1.0f / 16.0f;
+  }
+
+  float cov[4][4] = {};
+  for (unsigned int i = 0; i < 16; ++i)
+  {
+    float d[4];
+    for (unsigned int c = 0; c < channels; ++c)
+    {
+      d[c] = px[i][c] - mean[c];
+    }
+    for (unsigned int r = 0; r < channels; ++r)
+    {
+      for (unsigned int c = 0; c < channels; ++c)
+      {
+        cov[r][c] += d[r] * d[c];
+      }
+    }
+  }
+
+  // Start with the diagonal of the bounding box which is a good guess for most blocks.
+  float v[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+  for (int iteration = 0; iteration < 8; ++iteration)
+  {
+    float w[4] = {};
+    for (unsigned int r = 0; r < channels; ++r)
+    {
+      for (unsigned int c = 0; c < channels; ++c)
+      {
+        w[r] += cov[r][c] * v[c];
+      }
+    }
+    float len = 0.0f;
+    for (unsigned int c = 0; c < channels; ++c)
+    {
+      len = std::max(len, fabsf(w[c]));
+    }
+    if (len < 1e-8f) // Constant block, any axis will do.
+    {
+      break;
+    }
+    for (unsigned int c = 0; c < channels; ++c)
+    {
+      v[c] = w[c] / len;
+    }
+  }
+
+  float len = 0.0f;
+  for (unsigned int c = 0; c < channels; ++c)
+  {
+    len += v[c] * v[c];
+  }
+  len = sqrtf(len);
+  for (unsigned int c = 0; c < channels; ++c)
+  {
+    axis[c] = (0.0f < len) ? v[c] / len : 0.0f;
+  }
+}
+
+// Least squares fit of two endpoints for fixed interpolation weights: texel[i] ~= (1 - w[i]) * e0 + w[i] * e1.
+// Returns false when the system is singular (all weights equal).
+static bool fitEndpoints(const float (*px)[4], const float* weights, unsigned int channels, float* e0, float* e1)
+{
+  float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+  float ax[4] = {}, bx[4] = {};
+  for (unsigned int i = 0; i < 16; ++i)
+  {
+    const float b = weights[i];
+    const float a = 1.0f - b;
+    aa += a * a;
+    ab += a * b;
+    bb += b * b;
+    for (unsigned int c = 0; c < channels; ++c)
+    {
+      ax[c] += a * px[i][c];
+      bx[c] += b * px[i][c];
+    }
+  }
+  const float det = aa * bb - ab * ab;
+  if (fabsf(det) < 1e-6f)
+  {
+    return false;
+  }
+  const float inv = 1.0f / det;
+  for (unsigned int c = 0; c < channels; ++c)
+  {
+    e0[c] = clampFloat((bb * ax[c] - ab * bx[c]) * inv, 0.0f, 255.0f);
+    e1[c] = clampFloat((aa * bx[c] - ab * ax[c]) * inv, 0.0f, 255.0f);
+  }
+  return true;
+}
+
+static void loadTexels(const unsigned char* texels, float (*px)[4])
+{
+  for (unsigned int i = 0; i < 16; ++i)
+  {
+    for (unsigned int c = 0; c < 4; ++c)
+    {
+      px[i][c] = float(texels[i * 4 + c]);
+    }
+  }
+}
+
+// Initial endpoints from the extent of the texels projected onto the principal axis.
+static void axisEndpoints(const float (*px)[4], unsigned int channels, float* e0, float* e1)
+{
+  float mean[4];
+  float axis[4];
+  principalAxis(px, channels, mean, axis);
+
+  float tMin = std::numeric_limits<float>::max();
+  float tMax = -tMin;
+  for (unsigned int i = 0; i < 16; ++i)
+  {
+    float t = 0.0f;
+    for (unsigned int c = 0; c < channels; ++c)
+    {
+      t += (px[i][c] - mean[c]) * axis[c];
+    }
+    tMin = std::min(tMin, t);
+    tMax = std::max(tMax, t);
+  }
+  for (unsigned int c = 0; c < channels; ++c)
+  {
+    e0[c] = clampFloat(mean[c] + axis[c] * tMin, 0.0f, 255.0f);
+    e1[c] = clampFloat(mean[c] + axis[c] * tMax, 0.0f, 255.0f);
+  }
+}
+
+
+// BC1
+
+static inline unsigned short packRGB565(const float* rgb)
+{
+  const int r = clampInt(int(rgb[0] * (31.0f / 255.0f) + 0.5f), 0, 31);
+  const int g = clampInt(int(rgb[1] * (63.0f / 255.0f) + 0.5f), 0, 63);
+  const int b = clampInt(int(rgb[2] * (31.0f / 255.0f) + 0.5f), 0, 31);
+  return (unsigned short) ((r << 11) | (g << 5) | b);
+}
+
+static inline void unpackRGB565(unsigned short c, int* rgb)
+{
+  const int r = (c >> 11) & 31;
+  const int g = (c >> 5) & 63;
+  const int b = c & 31;
+  rgb[0] = (r << 3) | (r >> 2);
+  rgb[1] = (g << 2) | (g >> 4);
+  rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Palette as decoded by the hardware for the given endpoint pair.
+static void paletteBC1(unsigned short c0, unsigned short c1, int (*palette)[4])
+{
+  unpackRGB565(c0, palette[0]);
+  unpackRGB565(c1, palette[1]);
+  palette[0][3] = 255;
+  palette[1][3] = 255;
+  if (c1 < c0)
+  {
+    for (unsigned int c = 0; c < 3; ++c)
+    {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+    palette[2][3] = 255;
+    palette[3][3] = 255;
+  }
+  else
+  {
+    for (unsigned int c = 0; c < 3; ++c)
+    {
+      palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+      palette[3][c] = 0;
+    }
+    palette[2][3] = 255;
+    palette[3][3] = 0; // Transparent black.
+  }
+}
+
+// Pick the closest four-colour palette entry per texel. Returns the summed squared error.
+static int indicesBC1(const unsigned char* texels, unsigned short c0, unsigned short c1, unsigned int* indices)
+{
+  int palette[4][4];
+  paletteBC1(c0, c1, palette);
+
+  int error = 0;
+  *indices = 0;
+  for (unsigned int i = 0; i < 16; ++i)
+  {
+    int best = std::numeric_limits<int>::max();
+    unsigned int bestIndex = 0;
+    for (unsigned int j = 0; j < 4; ++j)
+    {
+      if (palette[j][3] == 0) // Never pick the transparent entry for opaque data.
+      {
+        continue;
+      }
+      int e = 0;
+      for (unsigned int c = 0; c < 3; ++c)
+      {
+        const int d = int(texels[i * 4 + c]) - palette[j][c];
+        e += d * d;
+      }
+      if (e < best)
+      {
+        best = e;
+        bestIndex = j;
+      }
+    }
+    error += best;
+    *indices |= bestIndex << (2 * i);
+  }
+  return error;
+}
+
+void encodeBlockBC1(const unsigned char* texels, unsigned char* block)
+{
+  static const float weightOfIndex[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f }; // Fraction of c1 per index in four-colour mode.
+
+  float px[16][4];
+  loadTexels(texels, px);
+
+  float e0[4];
+  float e1[4];
+  axisEndpoints(px, 3, e0, e1);
+
+  unsigned short bestC0 = 0;
+  unsigned short bestC1 = 0;
+  unsigned int   bestIndices = 0;
+  int            bestError = std::numeric_limits<int>::max();
+
+  // Each refinement step refits the endpoints to the chosen indices and keeps the best quantized result.
+  for (int iteration = 0; iteration < 3; ++iteration)
+  {
+    unsigned short c0 = packRGB565(e1); // Larger endpoint first selects the four-colour mode.
+    unsigned short c1 = packRGB565(e0);
+    if (c0 < c1)
+    {
+      std::swap(c0, c1);
+    }
+
+    unsigned int indices;
+    const int error = indicesBC1(texels, c0, c1, &indices);
+    if (error < bestError)
+    {
+      bestError = error;
+      bestC0 = c0;
+      bestC1 = c1;
+      bestIndices = indices;
+    }
+    if (bestError == 0 || c0 == c1)
+    {
+      break;
+    }
+
+    float weights[16];
+    for (unsigned int i = 0; i < 16; ++i)
+    {
+      weights[i] = 1.0f - weightOfIndex[(indices >> (2 * i)) & 3]; // Fraction of c0, which was packed from e1.
+    }
+    if (!fitEndpoints(px, weights, 3, e0, e1))
+    {
+      break;
+    }
+  }
+
+  block[0] = (unsigned char) (bestC0 & 0xFF);
+  block[1] = (unsigned char) (bestC0 >> 8);
+  block[2] = (unsigned char) (bestC1 & 0xFF);
+  block[3] = (unsigned char) (bestC1 >> 8);
+  block[4] = (unsigned char) (bestIndices & 0xFF);
+  block[5] = (unsigned char) ((bestIndices >> 8) & 0xFF);
+  block[6] = (unsigned char) ((bestIndices >> 16) & 0xFF);
+  block[7] = (unsigned char) (bestIndices >> 24);
+}
+
+void decodeBlockBC1(const unsigned char* block, unsigned char* texels)
+{
+  const unsigned short c0 = (unsigned short) (block[0] | (block[1] << 8));
+  const unsigned short c1 = (unsigned short) (block[2] | (block[3] << 8));
+  const unsigned int indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((unsigned int) block[7] << 24);
+
+  int palette[4][4];
+  paletteBC1(c0, c1, palette);
+
+  for (unsigned int i = 0; i < 16; ++i)
+  {
+    const int* p = palette[(indices >> (2 * i)) & 3];
+    texels[i * 4    ] = (unsigned char) p[0];
+    texels[i * 4 + 1] = (unsigned char) p[1];
+    texels[i * 4 + 2] = (unsigned char) p[2];
+    texels[i * 4 + 3] = (unsigned char) p[3];
+  }
+}
+
+
+// BC4
+
+void encodeBlockBC4(const unsigned char* texels, unsigned char* block)
+{
+  int lo = 255;
+  int hi = 0;
+  for (unsigned int i = 0; i < 16; ++i)
+  {
+    lo = std::min(lo, int(texels[i * 4]));
+    hi = std::max(hi, int(texels[i * 4]));
+  }
+
+  // red0 > red1 selects the eight value mode: index 0 = red0, 1 = red1, 2..7 interpolate from red0 towards red1.
+  block[0] = (unsigned char) hi;
+  block[1] = (unsigned char) lo;
+
+  unsigned long long bits = 0;
+  if (lo < hi)
+  {
+    const float scale = 7.0f / float(hi - lo);
+    for (unsigned int i = 0; i < 16; ++i)
+    {
+      const int step = clampInt(int((texels[i * 4] - lo) * scale + 0.5f), 0, 7); // 0 at red1, 7 at red0.
+      const unsigned int index = (step == 7) ? 0 : ((step == 0) ? 1 : 8 - step);
+      bits |= (unsigned long long) index << (3 * i);
+    }
+  }
+
+  for (unsigned int i = 0; i < 6; ++i)
+  {
+    block[2 + i] = (unsigned char) ((bits >> (8 * i)) & 0xFF);
+  }
+}
+
+void decodeBlockBC4(const unsigned char* block, unsigned char* texels)
+{
+  const int r0 = block[0];
+  const int r1 = block[1];
+
+  int palette[8];
+  palette[0] = r0;
+  palette[1] = r1;
+  if (r1 < r0)
+  {
+    for (int i = 2; i < 8; ++i)
+    {
+      palette[i] = ((8 - i) * r0 + (i - 1) * r1) / 7;
+    }
+  }
+  else
+  {
+    for (int i = 2; i < 6; ++i)
+    {
+      palette[i] = ((6 - i) * r0 + (i - 1) * r1) / 5;
+    }
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+
+  unsigned long long bits = 0;
+  for (unsigned int i = 0; i < 6; ++i)
+  {
+    bits |= (unsigned long long) block[2 + i] << (8 * i);
+  }
+
+  for (unsigned int i = 0; i < 16; ++i)
+  {
+    const unsigned char v = (unsigned char) palette[(bits >> (3 * i)) & 7];
+    texels[i * 4    ] = v;
+    texels[i * 4 + 1] = v;
+    texels[i * 4 + 2] = v;
+    texels[i * 4 + 3] = 255;
+  }
+}
+
+
+// BC7 mode 6: one subset, RGBA endpoints with 7 bits per channel plus one p-bit per endpoint, 4-bit indices.
+
+static const int bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static inline int bc7Interpolate(int e0, int e1, int index)
+{
+  return ((64 - bc7Weights4[index]) * e0 + bc7Weights4[index] * e1 + 32) >> 6;
+}
+
+// Quantize one endpoint to 7 bits per channel with the p-bit giving the lower error. Returns the 8-bit values in q.
+static void quantizeEndpointBC7(const float* e, int* q, int* pbit)
+{
+  float bestError = std::numeric_limits<float>::max();
+  for (int p = 0; p < 2; ++p)
+  {
+    int candidate[4];
+    float error = 0.0f;
+    for (unsigned int c = 0; c < 4; ++c)
+    {
+      const int v = clampInt(int((e[c] - float(p)) * 0.5f + 0.5f), 0, 127);
+      candidate[c] = (v << 1) | p;
+      const float d = e[c] - float(candidate[c]);
+      error += d * d;
+    }
+    if (error < bestError)
+    {
+      bestError = error;
+      *pbit = p;
+      for (unsigned int c = 0; c < 4; ++c)
+      {
+        q[c] = candidate[c];
+      }
+    }
+  }
+}
+
+static int indicesBC7(const unsigned char* texels, const int* q0, const int* q1, unsigned char* indices)
+{
+  int palette[16][4];
+  for (int j = 0; j < 16; ++j)
+  {
+    for (unsigned int c = 0; c < 4; ++c)
+    {
+      palette[j][c] = bc7Interpolate(q0[c], q1[c], j);
+    }
+  }
+
+  int error = 0;
+  for (unsigned int i = 0; i < 16; ++i)
+  {
+    int best = std::numeric_limits<int>::max();
+    for (int j = 0; j < 16; ++j)
+    {
+      int e = 0;
+      for (unsigned int c = 0; c < 4; ++c)
+      {
+        const int d = int(texels[i * 4 + c]) - palette[j][c];
+        e += d * d;
+      }
+      if (e < best)
+      {
+        best = e;
+        indices[i] = (unsigned char) j;
+      }
+    }
+    error += best;
+  }
+  return error;
+}
+
+// Little-endian bit writer/reader for the 128-bit BC7 block.
+static inline void putBits(unsigned char* block, unsigned int& pos, unsigned int value, unsigned int count)
+{
+  for (unsigned int i = 0; i < count; ++i, ++pos)
+  {
+    if (value & (1u << i))
+    {
+      block[pos >> 3] |= (unsigned char) (1u << (pos & 7));
+    }
+  }
+}
+
+static inline unsigned int getBits(const unsigned char* block, unsigned int& pos, unsigned int count)
+{
+  unsigned int value = 0;
+  for (unsigned int i = 0; i < count; ++i, ++pos)
+  {
+    value |= ((block[pos >> 3] >> (pos & 7)) & 1u) << i;
+  }
+  return value;
+}
+
+void encodeBlockBC7(const unsigned char* texels, unsigned char* block)
+{
+  float px[16][4];
+  loadTexels(texels, px);
+
+  float e0[4];
+  float e1[4];
+  axisEndpoints(px, 4, e0, e1);
+
+  int bestQ0[4] = {};
+  int bestQ1[4] = {};
+  int bestP0 = 0;
+  int bestP1 = 0;
+  unsigned char bestIndices[16] = {};
+  int bestError = std::numeric_limits<int>::max();
+
+  for (int iteration = 0; iteration < 3; ++iteration)
+  {
+    int q0[4];
+    int q1[4];
+    int p0;
+    int p1;
+    quantizeEndpointBC7(e0, q0, &p0);
+    quantizeEndpointBC7(e1, q1, &p1);
+
+    unsigned char indices[16];
+    const int error = indicesBC7(texels, q0, q1, indices);
+    if (error < bestError)
+    {
+      bestError = error;
+      memcpy(bestQ0, q0, sizeof(q0));
+      memcpy(bestQ1, q1, sizeof(q1));
+      bestP0 = p0;
+      bestP1 = p1;
+      memcpy(bestIndices, indices, sizeof(indices));
+    }
+    if (bestError == 0)
+    {
+      break;
+    }
+
+    float weights[16];
+    for (unsigned int i = 0; i < 16; ++i)
+    {
+      weights[i] = float(bc7Weights4[indices[i]]) / 64.0f;
+    }
+    if (!fitEndpoints(px, weights, 4, e0, e1))
+    {
+      break;
+    }
+  }
+
+  // The anchor index (texel 0) is stored with its most significant bit implied zero. Swap the endpoints if necessary.
+  if (8 <= bestIndices[0])
+  {
+    std::swap(bestQ0, bestQ1);
+    std::swap(bestP0, bestP1);
+    for (unsigned int i = 0; i < 16; ++i)
+    {
+      bestIndices[i] = (unsigned char) (15 - bestIndices[i]);
+    }
+  }
+
+  memset(block, 0, 16);
+  unsigned int pos = 0;
+  putBits(block, pos, 1u << 6, 7); // Mode 6 is encoded as six zero bits followed by a one.
+  for (unsigned int c = 0; c < 4; ++c)
+  {
+    putBits(block, pos, (unsigned int) (bestQ0[c] >> 1), 7);
+    putBits(block, pos, (unsigned int) (bestQ1[c] >> 1), 7);
+  }
+  putBits(block, pos, (unsigned int) bestP0, 1);
+  putBits(block, pos, (unsigned int) bestP1, 1);
+  putBits(block, pos, bestIndices[0], 3);
+  for (unsigned int i = 1; i < 16; ++i)
+  {
+    putBits(block, pos, bestIndices[i], 4);
+  }
+  MY_ASSERT(pos == 128);
+}
+
+// Only mode 6 is decoded, which is the only mode written by encodeBlockBC7().
+// Blocks in other modes decode to opaque magenta to make that obvious.
+void decodeBlockBC7(const unsigned char* block, unsigned char* texels)
+{
+  if ((block[0] & 0x7F) != 0x40)
+  {
+    for (unsigned int i = 0; i < 16; ++i)
+    {
+      texels[i * 4    ] = 255;
+      texels[i * 4 + 1] = 0;
+      texels[i * 4 + 2] = 255;
+      texels[i * 4 + 3] = 255;
+    }
+    return;
+  }
+
+  unsigned int pos = 7;
+  int q0[4];
+  int q1[4];
+  for (unsigned int c = 0; c < 4; ++c)
+  {
+    q0[c] = int(getBits(block, pos, 7)) << 1;
+    q1[c] = int(getBits(block, pos, 7)) << 1;
+  }
+  const int p0 = int(getBits(block, pos, 1));
+  const int p1 = int(getBits(block, pos, 1));
+  for (unsigned int c = 0; c < 4; ++c)
+  {
+    q0[c] |= p0;
+    q1[c] |= p1;
+  }
+
+  for (unsigned int i = 0; i < 16; ++i)
+  {
+    const int index = int(getBits(block, pos, (i == 0) ? 3 : 4));
+    for (unsigned int c = 0; c < 4; ++c)
+    {
+      texels[i * 4 + c] = (unsigned char) bc7Interpolate(q0[c], q1[c], index);
+    }
+  }
+}
+
+
+// Whole images.
+
+typedef void (*PFNENCODEBLOCK)(const unsigned char* texels, unsigned char* block);
+typedef void (*PFNDECODEBLOCK)(const unsigned char* block, unsigned char* texels);
+
+static PFNENCODEBLOCK blockEncoder(BlockFormat format)
+{
+  switch (format)
+  {
+    case BLOCK_FORMAT_BC1:
+      return encodeBlockBC1;
+    case BLOCK_FORMAT_BC4:
+      return encodeBlockBC4;
+    case BLOCK_FORMAT_BC7:
+      return encodeBlockBC7;
+    default:
+      return nullptr;
+  }
+}
+
+static PFNDECODEBLOCK blockDecoder(BlockFormat format)
+{
+  switch (format)
+  {
+    case BLOCK_FORMAT_BC1:
+      return decodeBlockBC1;
+    case BLOCK_FORMAT_BC4:
+      return decodeBlockBC4;
+    case BLOCK_FORMAT_BC7:
+      return decodeBlockBC7;
+    default:
+      return nullptr;
+  }
+}
+
+bool compressImage(const unsigned char* rgba, unsigned int width, unsigned int height, BlockFormat format,
+                   CompressedImage& image, CompressionReport* report)
+{
+  PFNENCODEBLOCK encode = blockEncoder(format);
+  if (encode == nullptr || rgba == nullptr || width == 0 || height == 0)
+  {
+    return false;
+  }
+
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  image.m_format  = format;
+  image.m_width   = width;
+  image.m_height  = height;
+  image.m_blocksX = (width  + 3) / 4;
+  image.m_blocksY = (height + 3) / 4;
+  image.m_blocks.resize(size_t(image.m_blocksX) * image.m_blocksY * blockSize(format));
+
+  const unsigned int bytesPerBlock = blockSize(format);
+  const unsigned int blocksX = image.m_blocksX;
+
+  // One block row per work item. Partial blocks at the right and bottom edges replicate the last texel.
+  sutil::parallelFor(image.m_blocksY, [&](size_t begin, size_t end)
+  {
+    unsigned char texels[16 * 4];
+    for (size_t by = begin; by < end; ++by)
+    {
+      for (unsigned int bx = 0; bx < blocksX; ++bx)
+      {
+        for (unsigned int y = 0; y < 4; ++y)
+        {
+          const unsigned int sy = std::min(unsigned(by) * 4 + y, height - 1);
+          for (unsigned int x = 0; x < 4; ++x)
+          {
+            const unsigned int sx = std::min(bx * 4 + x, width - 1);
+            memcpy(texels + (y * 4 + x) * 4, rgba + (size_t(sy) * width + sx) * 4, 4);
+          }
+        }
+        encode(texels, &image.m_blocks[(by * blocksX + bx) * bytesPerBlock]);
+      }
+    }
+  });
+
+  if (report != nullptr)
+  {
+    report->m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    report->m_uncompressedBytes = size_t(width) * height * 4;
+    report->m_compressedBytes   = image.m_blocks.size();
+    report->m_fromCache         = false;
+
+    std::vector<unsigned char> decoded(size_t(width) * height * 4);
+    decompressImage(image, decoded.data());
+    const unsigned int channels = (format == BLOCK_FORMAT_BC4) ? 1 : ((format == BLOCK_FORMAT_BC1) ? 3 : 4);
+    report->m_psnr = computePSNR(rgba, decoded.data(), size_t(width) * height, channels);
+  }
+  return true;
+}
+
+void decompressImage(const CompressedImage& image, unsigned char* rgba)
+{
+  PFNDECODEBLOCK decode = blockDecoder(image.m_format);
+  if (decode == nullptr || rgba == nullptr)
+  {
+    return;
+  }
+
+  const unsigned int bytesPerBlock = blockSize(image.m_format);
+
+  sutil::parallelFor(image.m_blocksY, [&](size_t begin, size_t end)
+  {
+    unsigned char texels[16 * 4];
+    for (size_t by = begin; by < end; ++by)
+    {
+      for (unsigned int bx = 0; bx < image.m_blocksX; ++bx)
+      {
+        decode(&image.m_blocks[(by * image.m_blocksX + bx) * bytesPerBlock], texels);
+
+        for (unsigned int y = 0; y < 4 && by * 4 + y < image.m_height; ++y)
+        {
+          for (unsigned int x = 0; x < 4 && bx * 4 + x < image.m_width; ++x)
+          {
+            memcpy(rgba + ((by * 4 + y) * image.m_width + bx * 4 + x) * 4, texels + (y * 4 + x) * 4, 4);
+          }
+        }
+      }
+    }
+  });
+}
+
+double computePSNR(const unsigned char* a, const unsigned char* b, size_t numTexels, unsigned int channels)
+{
+  double sum = 0.0;
+  for (size_t i = 0; i < numTexels; ++i)
+  {
+    for (unsigned int c = 0; c < channels; ++c)
+    {
+      const double d = double(a[i * 4 + c]) - double(b[i * 4 + c]);
+      sum += d * d;
+    }
+  }
+  if (sum == 0.0)
+  {
+    return std::numeric_limits<double>::infinity();
+  }
+  const double mse = sum / double(numTexels * channels);
+  return 10.0 * log10(255.0 * 255.0 / mse);
+}
+
+
+// Cache files.
+
+struct CompressedCacheHeader
+{
+  char               magic[4];   // "BCNC"
+  unsigned int       version;
+  unsigned int       format;     // BlockFormat
+  unsigned int       width;
+  unsigned int       height;
+  unsigned int       reserved;
+  unsigned long long sourceSize; // Identify the source file version this cache was created from.
+  long long          sourceTime;
+  double             psnr;       // Of the blocks against the source, so cache hits need not decode them.
+};
+
+static const unsigned int compressedCacheVersion = 2;
+
+static bool sourceStamp(const std::string& sourceFilename, unsigned long long& size, long long& time)
+{
+  struct stat info;
+  if (stat(sourceFilename.c_str(), &info) != 0)
+  {
+    return false;
+  }
+  size = (unsigned long long) info.st_size;
+  time = (long long) info.st_mtime;
+  return true;
+}
+
+std::string compressedCacheFilename(const std::string& sourceFilename, BlockFormat format)
+{
+  return sourceFilename + "." + blockFormatName(format);
+}
+
+bool loadCompressedImage(const std::string& cacheFilename, const std::string& sourceFilename, BlockFormat format, CompressedImage& image,
+                         double* psnr) // = nullptr
+{
+  unsigned long long size;
+  long long time;
+  if (!sourceStamp(sourceFilename, size, time))
+  {
+    return false;
+  }
+
+  FILE* file = fopen(cacheFilename.c_str(), "rb");
+  if (!file)
+  {
+    return false;
+  }
+
+  bool success = false;
+  CompressedCacheHeader header;
+  if (fread(&header, sizeof(header), 1, file) == 1 &&
+      memcmp(header.magic, "BCNC", 4) == 0 &&
+      header.version    == compressedCacheVersion &&
+      (header.format == (unsigned int) format || (format == BLOCK_FORMAT_BC1 && header.format == BLOCK_FORMAT_BC7)) &&
+      header.sourceSize == size &&
+      header.sourceTime == time &&
+      0 < header.width && 0 < header.height)
+  {
+    image.m_format  = (BlockFormat) header.format;
+    image.m_width   = header.width;
+    image.m_height  = header.height;
+    image.m_blocksX = (header.width  + 3) / 4;
+    image.m_blocksY = (header.height + 3) / 4;
+    image.m_blocks.resize(size_t(image.m_blocksX) * image.m_blocksY * blockSize(image.m_format));
+    success = fread(image.m_blocks.data(), 1, image.m_blocks.size(), file) == image.m_blocks.size();
+    if (psnr != nullptr)
+    {
+      *psnr = header.psnr;
+    }
+  }
+  fclose(file);
+  return success;
+}
+
+bool saveCompressedImage(const std::string& cacheFilename, const std::string& sourceFilename, const CompressedImage& image, double psnr)
+{
+  CompressedCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "BCNC", 4);
+  header.version = compressedCacheVersion;
+  header.format  = (unsigned int) image.m_format;
+  header.width   = image.m_width;
+  header.height  = image.m_height;
+  header.psnr    = psnr;
+  if (!sourceStamp(sourceFilename, header.sourceSize, header.sourceTime))
+  {
+    return false;
+  }
+
+  // Write to a temporary file first so a concurrent reader never sees a partial cache file.
+  const std::string tempFilename = cacheFilename + ".tmp";
+  FILE* file = fopen(tempFilename.c_str(), "wb");
+  if (!file)
+  {
+    return false;
+  }
+  bool success = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                 fwrite(image.m_blocks.data(), 1, image.m_blocks.size(), file) == image.m_blocks.size();
+  success = (fclose(file) == 0) && success;
+
+  if (success)
+  {
+    remove(cacheFilename.c_str()); // rename() does not replace existing files on Windows.
+    success = rename(tempFilename.c_str(), cacheFilename.c_str()) == 0;
+  }
+  if (!success)
+  {
+    remove(tempFilename.c_str());
+  }
+  return success;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <string>
+#include <vector>
+
+// Block compressed (BCn) texture formats. All of them store 4x4 texel blocks.
+// BC1: RGB with 5:6:5 endpoints and 2-bit indices,     8 bytes per block (0.5 byte per texel).
+// BC4: single channel with 8-bit endpoints,             8 bytes per block (0.5 byte per texel).
+// BC7: RGBA, mode 6 only (7777.1 endpoints, 4-bit indices), 16 bytes per block (1 byte per texel).
+enum BlockFormat
+{
+  BLOCK_FORMAT_NONE,
+  BLOCK_FORMAT_BC1,
+  BLOCK_FORMAT_BC4,
+  BLOCK_FORMAT_BC7
+};
+
+struct CompressedImage
+{
+  CompressedImage();
+
+  BlockFormat  m_format;
+  unsigned int m_width;   // In texels.
+  unsigned int m_height;
+  unsigned int m_blocksX; // In 4x4 blocks, rounded up.
+  unsigned int m_blocksY;
+
+  std::vector<unsigned char> m_blocks; // m_blocksX * m_blocksY * blockSize(m_format) bytes, row-major.
+};
+
+// Quality and size statistics of one compression run, filled by compressImage().
+struct CompressionReport
+{
+  CompressionReport();
+
+  size_t m_uncompressedBytes; // RGBA8 size of the source.
+  size_t m_compressedBytes;
+  double m_psnr;              // Over the channels stored by the format, in dB. Infinity for lossless results.
+  double m_seconds;           // Encoding time.
+  bool   m_fromCache;         // True when the blocks were read from a cache file instead of being encoded.
+};
+
+unsigned int blockSize(BlockFormat format);
+const char*  blockFormatName(BlockFormat format);
+BlockFormat  blockFormatFromName(const std::string& name); // "bc1", "bc4", "bc7", anything else is BLOCK_FORMAT_NONE.
+
+// Encode tightly packed RGBA8 texels. The blocks are encoded in parallel.
+// BC4 encodes the red channel. When report is not nullptr the PSNR is calculated by decoding the result again.
+bool compressImage(const unsigned char* rgba, unsigned int width, unsigned int height, BlockFormat format,
+                   CompressedImage& image, CompressionReport* report = nullptr);
+
+// Decode into tightly packed RGBA8 texels (width * height * 4 bytes).
+// BC4 is expanded to (L, L, L, 255). This is the lookup path for host side consumers of compressed textures.
+void decompressImage(const CompressedImage& image, unsigned char* rgba);
+
+// Single block codecs. texels are 16 RGBA8 values in row-major order.
+void encodeBlockBC1(const unsigned char* texels, unsigned char* block);
+void encodeBlockBC4(const unsigned char* texels, unsigned char* block); // Red channel.
+void encodeBlockBC7(const unsigned char* texels, unsigned char* block);
+void decodeBlockBC1(const unsigned char* block, unsigned char* texels);
+void decodeBlockBC4(const unsigned char* block, unsigned char* texels);
+void decodeBlockBC7(const unsigned char* block, unsigned char* texels);
+
+// Peak signal to noise ratio between two RGBA8 images, over the first 'channels' channels.
+double computePSNR(const unsigned char* a, const unsigned char* b, size_t numTexels, unsigned int channels);
+
+// Cache files hold the encoded blocks of one source image and their PSNR.
+// They are keyed by the source file's size and modification time so a changed source is re-encoded.
+// format is the requested format. A BC1 cache holds BC7 blocks when the source has alpha, image.m_format tells.
+std::string compressedCacheFilename(const std::string& sourceFilename, BlockFormat format);
+bool loadCompressedImage(const std::string& cacheFilename, const std::string& sourceFilename, BlockFormat format, CompressedImage& image,
+                         double* psnr = nullptr);
+bool saveCompressedImage(const std::string& cacheFilename, const std::string& sourceFilename, const CompressedImage& image, double psnr);
+
+#endif // BLOCK_COMPRESSION_H
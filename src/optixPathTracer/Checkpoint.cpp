@@ -0,0 +1,240 @@
+#include "Checkpoint.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#if defined(_WIN32)
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+
+// File layout: CheckpointHeader, then m_dataBytes of the raw accumulation buffer.
+struct CheckpointHeader
+{
+  char               m_magic[4];
+  unsigned int       m_version;
+  unsigned int       m_width;
+  unsigned int       m_height;
+  unsigned int       m_format;
+  unsigned int       m_image;
+  unsigned int       m_frame;
+  unsigned int       m_reserved;
+  unsigned long long m_hash;
+  unsigned long long m_dataBytes;
+  unsigned long long m_dataHash; // Detects truncated or damaged files.
+};
+
+static const unsigned int checkpointVersion = 1;
+
+
+unsigned long long hashBytes(const void* data, size_t size, unsigned long long hash)
+{
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+bool hashFile(const std::string& filename, unsigned long long& hash)
+{
+  FILE* file = fopen(filename.c_str(), "rb");
+  if (!file)
+  {
+    return false;
+  }
+  unsigned char buffer[65536];
+  size_t count;
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) != 0)
+  {
+    hash = hashBytes(buffer, count, hash);
+  }
+  const bool success = !ferror(file);
+  fclose(file);
+  return success;
+}
+
+
+CheckpointState::CheckpointState()
+: m_width(0)
+, m_height(0)
+, m_format(0)
+, m_image(0)
+, m_frame(0)
+, m_hash(0)
+{
+}
+
+
+bool loadCheckpoint(const std::string& filename, CheckpointState& state, std::vector<unsigned char>& data)
+{
+  FILE* file = fopen(filename.c_str(), "rb");
+  if (!file)
+  {
+    return false;
+  }
+
+  CheckpointHeader header;
+  bool success = fread(&header, sizeof(header), 1, file) == 1 &&
+                 memcmp(header.m_magic, "PTCK", 4) == 0 &&
+                 header.m_version == checkpointVersion;
+  if (success)
+  {
+    if (header.m_hash != state.m_hash || header.m_width != state.m_width || header.m_height != state.m_height || header.m_format != state.m_format)
+    {
+      std::cerr << "Checkpoint " << filename << " belongs to a different scene, camera or settings, ignored." << std::endl;
+      fclose(file);
+      return false;
+    }
+    data.resize(header.m_dataBytes);
+    success = fread(data.data(), 1, data.size(), file) == data.size() &&
+              hashBytes(data.data(), data.size()) == header.m_dataHash;
+  }
+  fclose(file);
+
+  if (!success)
+  {
+    std::cerr << "ERROR: loadCheckpoint() " << filename << " is damaged, ignored." << std::endl;
+    return false;
+  }
+
+  state.m_image = header.m_image;
+  state.m_frame = header.m_frame;
+  return true;
+}
+
+
+CheckpointWriter::CheckpointWriter(const std::string& filename)
+: m_filename(filename)
+, m_pending(false)
+, m_failed(false)
+, m_quit(false)
+, m_seconds(0.0)
+{
+  m_thread = std::thread(&CheckpointWriter::worker, this);
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cond.wait(lock, [this]() { return !m_pending; });
+    m_quit = true;
+  }
+  m_cond.notify_all();
+  m_thread.join();
+}
+
+void CheckpointWriter::write(const CheckpointState& state, const void* data, size_t size)
+{
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cond.wait(lock, [this]() { return !m_pending; });
+    m_state = state;
+    m_data.resize(size);
+    memcpy(m_data.data(), data, size);
+    m_pending = true;
+  }
+  m_cond.notify_all();
+}
+
+bool CheckpointWriter::wait()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_cond.wait(lock, [this]() { return !m_pending; });
+  return !m_failed;
+}
+
+void CheckpointWriter::remove()
+{
+  wait();
+  ::remove(m_filename.c_str());
+}
+
+double CheckpointWriter::writeSeconds() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_seconds;
+}
+
+void CheckpointWriter::worker()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  for (;;)
+  {
+    m_cond.wait(lock, [this]() { return m_pending || m_quit; });
+    if (!m_pending)
+    {
+      return;
+    }
+
+    // m_state and m_data are not touched by write() while m_pending is set.
+    lock.unlock();
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const bool success = writeFile();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    lock.lock();
+
+    m_failed  = m_failed || !success;
+    m_seconds += seconds;
+    m_pending = false;
+    m_cond.notify_all();
+  }
+}
+
+bool CheckpointWriter::writeFile()
+{
+  CheckpointHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.m_magic, "PTCK", 4);
+  header.m_version   = checkpointVersion;
+  header.m_width     = m_state.m_width;
+  header.m_height    = m_state.m_height;
+  header.m_format    = m_state.m_format;
+  header.m_image     = m_state.m_image;
+  header.m_frame     = m_state.m_frame;
+  header.m_hash      = m_state.m_hash;
+  header.m_dataBytes = m_data.size();
+  header.m_dataHash  = hashBytes(m_data.data(), m_data.size());
+
+  const std::string tempFilename = m_filename + ".tmp";
+  FILE* file = fopen(tempFilename.c_str(), "wb");
+  if (!file)
+  {
+    std::cerr << "ERROR: CheckpointWriter failed to create " << tempFilename << std::endl;
+    return false;
+  }
+
+  bool success = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                 fwrite(m_data.data(), 1, m_data.size(), file) == m_data.size() &&
+                 fflush(file) == 0;
+  // Make the data durable before the rename publishes it, a preempted node may not flush its page cache.
+#if defined(_WIN32)
+  success = success && _commit(_fileno(file)) == 0;
+#else
+  success = success && fsync(fileno(file)) == 0;
+#endif
+  success = (fclose(file) == 0) && success;
+
+  if (success)
+  {
+#if defined(_WIN32)
+    success = MoveFileExA(tempFilename.c_str(), m_filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    success = rename(tempFilename.c_str(), m_filename.c_str()) == 0; // Atomically replaces the previous checkpoint.
+#endif
+  }
+  if (!success)
+  {
+    std::cerr << "ERROR: CheckpointWriter failed to write " << m_filename << std::endl;
+    ::remove(tempFilename.c_str());
+  }
+  return success;
+}
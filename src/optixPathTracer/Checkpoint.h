@@ -0,0 +1,80 @@
+#pragma once
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Checkpoints of a progressive batch render.
+// A checkpoint holds the raw accumulation buffer and the position in the render (image of a sequence and
+// the next frame index). The per-sample random numbers are derived from the pixel and the frame index,
+// so the frame index is the complete sampler state and a resumed render continues with the same samples.
+// The hash identifies everything else which influences the samples (scene, camera, settings).
+
+// 64-bit FNV-1a.
+const unsigned long long checkpointHashSeed = 14695981039346656037ull;
+unsigned long long hashBytes(const void* data, size_t size, unsigned long long hash = checkpointHashSeed);
+bool               hashFile(const std::string& filename, unsigned long long& hash); // Continues hash with the file contents.
+
+struct CheckpointState
+{
+  CheckpointState();
+
+  unsigned int       m_width;
+  unsigned int       m_height;
+  unsigned int       m_format; // AccumulationFormat
+  unsigned int       m_image;  // Image of a sequence being accumulated.
+  unsigned int       m_frame;  // Next frame to launch for m_image.
+  unsigned long long m_hash;
+};
+
+// Returns false when the file does not exist, is damaged, or does not belong to expected
+// (different hash, size or format). m_image and m_frame are taken from the file.
+bool loadCheckpoint(const std::string& filename, CheckpointState& state, std::vector<unsigned char>& data);
+
+// Writes checkpoints on a background thread. The data is copied by write() so the caller can
+// continue rendering immediately. Each file is written to a temporary name first and renamed, so
+// a process killed at any point leaves either the previous or the new checkpoint behind.
+class CheckpointWriter
+{
+public:
+  explicit CheckpointWriter(const std::string& filename);
+  ~CheckpointWriter(); // Waits for a pending write.
+
+  // Waits for the previous write to finish when it is still running.
+  void write(const CheckpointState& state, const void* data, size_t size);
+
+  // Waits for a pending write. Returns false when any write failed so far.
+  bool wait();
+
+  // Waits for a pending write and deletes the checkpoint, e.g. after the final image was saved.
+  void remove();
+
+  double writeSeconds() const; // Background time spent writing files.
+
+private:
+  CheckpointWriter(const CheckpointWriter&);
+  CheckpointWriter& operator=(const CheckpointWriter&);
+
+  void worker();
+  bool writeFile();
+
+private:
+  std::string                m_filename;
+  CheckpointState            m_state;
+  std::vector<unsigned char> m_data;
+  bool                       m_pending;
+  bool                       m_failed;
+  bool                       m_quit;
+  double                     m_seconds;
+
+  mutable std::mutex         m_mutex;
+  std::condition_variable    m_cond;
+  std::thread                m_thread;
+};
+
+#endif // CHECKPOINT_H
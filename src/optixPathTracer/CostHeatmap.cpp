@@ -0,0 +1,87 @@
+#include "CostHeatmap.h"
+
+#include <ImageWriter.h>
+#include <sutil.h>
+
+#include <algorithm>
+#include <iostream>
+
+
+CostHeatmapStats::CostHeatmapStats()
+: m_meanRays(0.0)
+, m_meanIntersections(0.0)
+, m_meanCycles(0.0)
+, m_maxCycles(0.0)
+, m_scale(0.0)
+{
+}
+
+// Polynomial fit of the Turbo colour map, t in [0, 1]. Written as BGRA like the output buffer.
+static void falseColor(float t, unsigned char* bgra)
+{
+  t = std::min(std::max(t, 0.0f), 1.0f);
+  const float r = 0.13572138f + t * (4.61539260f + t * (-42.66032258f + t * (132.13108234f + t * (-152.94239396f + t * 59.28637943f))));
+  const float g = 0.09140261f + t * (2.19418839f + t * (4.84296658f + t * (-14.18503333f + t * (4.27729857f + t * 2.82956604f))));
+  const float b = 0.10667330f + t * (12.64194608f + t * (-60.58204836f + t * (110.36276771f + t * (-89.90310912f + t * 27.34824973f))));
+  bgra[0] = static_cast<unsigned char>(std::min(std::max(b, 0.0f), 1.0f) * 255.0f + 0.5f);
+  bgra[1] = static_cast<unsigned char>(std::min(std::max(g, 0.0f), 1.0f) * 255.0f + 0.5f);
+  bgra[2] = static_cast<unsigned char>(std::min(std::max(r, 0.0f), 1.0f) * 255.0f + 0.5f);
+  bgra[3] = 255;
+}
+
+bool writeCostHeatmap(const std::string& name, const std::vector<float>& cost, unsigned int width, unsigned int height,
+                      CostHeatmapStats& stats)
+{
+  stats = CostHeatmapStats();
+  const size_t pixels = size_t(width) * height;
+  if (cost.size() < pixels * 4)
+  {
+    std::cerr << "ERROR: writeCostHeatmap() has no cost values for " << name << std::endl;
+    return false;
+  }
+
+  // Pixels without samples resolve to 0 and stay out of the statistics.
+  std::vector<float> cycles;
+  cycles.reserve(pixels);
+  for (size_t i = 0; i < pixels; ++i)
+  {
+    const float* value = &cost[i * 4];
+    if (value[2] > 0.0f)
+    {
+      stats.m_meanRays          += value[0];
+      stats.m_meanIntersections += value[1];
+      stats.m_meanCycles        += value[2];
+      stats.m_maxCycles          = std::max(stats.m_maxCycles, double(value[2]));
+      cycles.push_back(value[2]);
+    }
+  }
+  if (!cycles.empty())
+  {
+    stats.m_meanRays          /= cycles.size();
+    stats.m_meanIntersections /= cycles.size();
+    stats.m_meanCycles        /= cycles.size();
+    std::vector<float>::iterator percentile = cycles.begin() + (cycles.size() - 1) * 99 / 100;
+    std::nth_element(cycles.begin(), percentile, cycles.end());
+    stats.m_scale = *percentile;
+  }
+
+  const float scale = (stats.m_scale > 0.0) ? static_cast<float>(1.0 / stats.m_scale) : 0.0f;
+  std::vector<unsigned char> bgra(pixels * 4);
+  std::vector<float> raw(pixels * 3);
+  for (size_t i = 0; i < pixels; ++i)
+  {
+    const float* value = &cost[i * 4];
+    falseColor(value[2] * scale, &bgra[i * 4]);
+    raw[i * 3 + 0] = value[0];
+    raw[i * 3 + 1] = value[1];
+    raw[i * 3 + 2] = value[2];
+  }
+
+  sutil::writeImageToFile((name + ".png").c_str(), bgra.data(), width, height, RT_FORMAT_UNSIGNED_BYTE4);
+  if (!sutil::writePFM((name + ".pfm").c_str(), raw.data(), width, height, 3, true))
+  {
+    std::cerr << "ERROR: writeCostHeatmap() cannot write " << name << ".pfm" << std::endl;
+    return false;
+  }
+  return true;
+}
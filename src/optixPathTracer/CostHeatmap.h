@@ -0,0 +1,30 @@
+#pragma once
+
+#ifndef COST_HEATMAP_H
+#define COST_HEATMAP_H
+
+#include <string>
+#include <vector>
+
+// Where the path tracer spends its time, from the resolved AOV_INDEX_COST values (rays, intersection tests and
+// device cycles per sample, 4 floats per pixel in buffer row order).
+
+struct CostHeatmapStats
+{
+  CostHeatmapStats();
+
+  double m_meanRays;          // Per sample, over the pixels with samples.
+  double m_meanIntersections;
+  double m_meanCycles;
+  double m_maxCycles;
+  double m_scale;             // Cycles per sample at the top of the colour ramp.
+};
+
+// Writes <name>.png, the cycles per sample in a false-colour ramp from dark blue (cheap) over green to dark red,
+// scaled to the 99th percentile so a few outliers do not flatten the rest, and <name>.pfm with the rays, intersection
+// tests and cycles per sample as raw floats. Returns false with a message on std::cerr when the PFM cannot be
+// written, the PNG throws like sutil::writeImageToFile().
+bool writeCostHeatmap(const std::string& name, const std::vector<float>& cost, unsigned int width, unsigned int height,
+                      CostHeatmapStats& stats);
+
+#endif // COST_HEATMAP_H
@@ -0,0 +1,127 @@
+#pragma once
+
+#ifndef LRU_CACHE_H
+#define LRU_CACHE_H
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+// Least recently used cache of values with a size in bytes.
+// The cache does not own anything behind the values: evicted values are handed back to the caller,
+// which releases them (e.g. destroys OptiX objects).
+template <typename T>
+class LruCache
+{
+public:
+  explicit LruCache(size_t budgetBytes)
+  : m_budget(budgetBytes)
+  , m_bytes(0)
+  {
+  }
+
+  // Returns nullptr when key is not cached. A hit makes the value the most recently used one.
+  T* find(const std::string& key)
+  {
+    typename Index::iterator it = m_index.find(key);
+    if (it == m_index.end())
+    {
+      return nullptr;
+    }
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return &it->second->m_value;
+  }
+
+  // Inserts value as the most recently used one and evicts least recently used values until the
+  // total fits the budget. The new value always stays, even when it alone exceeds the budget.
+  // Returns the evicted values, least recently used first, including a replaced value of the same key.
+  std::vector<T> insert(const std::string& key, const T& value, size_t bytes)
+  {
+    std::vector<T> evicted;
+    typename Index::iterator it = m_index.find(key);
+    if (it != m_index.end())
+    {
+      evicted.push_back(it->second->m_value);
+      m_bytes -= it->second->m_bytes;
+      m_entries.erase(it->second);
+      m_index.erase(it);
+    }
+
+    Entry entry;
+    entry.m_key   = key;
+    entry.m_value = value;
+    entry.m_bytes = bytes;
+    m_entries.push_front(entry);
+    m_index[key] = m_entries.begin();
+    m_bytes += bytes;
+
+    evictToBudget(evicted);
+    return evicted;
+  }
+
+  // Changes the size of a cached value, e.g. after its buffers were resized, and makes it the most recently
+  // used one. Returns the values evicted to fit the budget again, never the value of key itself.
+  std::vector<T> setBytes(const std::string& key, size_t bytes)
+  {
+    std::vector<T> evicted;
+    typename Index::iterator it = m_index.find(key);
+    if (it == m_index.end())
+    {
+      return evicted;
+    }
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    m_bytes = m_bytes - it->second->m_bytes + bytes;
+    it->second->m_bytes = bytes;
+
+    evictToBudget(evicted);
+    return evicted;
+  }
+
+  // Removes all values and returns them, least recently used first.
+  std::vector<T> clear()
+  {
+    std::vector<T> values;
+    for (typename std::list<Entry>::reverse_iterator it = m_entries.rbegin(); it != m_entries.rend(); ++it)
+    {
+      values.push_back(it->m_value);
+    }
+    m_entries.clear();
+    m_index.clear();
+    m_bytes = 0;
+    return values;
+  }
+
+  size_t size() const   { return m_entries.size(); }
+  size_t bytes() const  { return m_bytes; }
+  size_t budget() const { return m_budget; }
+
+private:
+  // Evicts least recently used values, but never the most recently used one.
+  void evictToBudget(std::vector<T>& evicted)
+  {
+    while (m_bytes > m_budget && m_entries.size() > 1)
+    {
+      const Entry& last = m_entries.back();
+      evicted.push_back(last.m_value);
+      m_bytes -= last.m_bytes;
+      m_index.erase(last.m_key);
+      m_entries.pop_back();
+    }
+  }
+
+  struct Entry
+  {
+    std::string m_key;
+    T           m_value;
+    size_t      m_bytes;
+  };
+  typedef std::map<std::string, typename std::list<Entry>::iterator> Index;
+
+  size_t           m_budget;
+  size_t           m_bytes;
+  std::list<Entry> m_entries; // Most recently used first.
+  Index            m_index;
+};
+
+#endif // LRU_CACHE_H
@@ -38,6 +38,7 @@
 #include <cctype>
 #include <cstring>
 #include <iostream>
+#include <mutex>
 
 #include "MyAssert.h"
 
@@ -240,6 +241,11 @@ bool Picture::load(const std::string& filename)
   bool isDDS = (ext == std::string(".dds")); // .dds images need special handling
   m_isCube = false;
   
+  // DevIL keeps the bound image and the load options in global state.
+  // Render sessions may load textures on several threads at once.
+  static std::mutex ilMutex;
+  std::lock_guard<std::mutex> lock(ilMutex);
+
   unsigned int imageID;
 
   ilGenImages(1, (ILuint *) &imageID);
@@ -0,0 +1,103 @@
+#include "RayStats.h"
+
+#include <iomanip>
+#include <string>
+
+
+RayStats::RayStats()
+: m_seconds(0.0)
+{
+  for (int i = 0; i < RAY_COUNTER_COUNT; ++i)
+  {
+    m_counters[i] = 0;
+  }
+}
+
+void RayStats::add(const RayStats& other)
+{
+  for (int i = 0; i < RAY_COUNTER_COUNT; ++i)
+  {
+    m_counters[i] += other.m_counters[i];
+  }
+  m_seconds += other.m_seconds;
+}
+
+unsigned long long RayStats::rays() const
+{
+  return m_counters[RAY_COUNTER_PRIMARY] + m_counters[RAY_COUNTER_BOUNCE] + m_counters[RAY_COUNTER_SHADOW];
+}
+
+double RayStats::rate(unsigned long long count) const
+{
+  return (m_seconds > 0.0) ? count / m_seconds : 0.0;
+}
+
+const char* rayStatsProgramName(int programId)
+{
+  // The order of the BRDF callable programs in Session::createContext().
+  static const char* const names[] = { "disney", "glass", "lambert" };
+  return (0 <= programId && programId < int(sizeof(names) / sizeof(names[0]))) ? names[programId] : nullptr;
+}
+
+static double percent(unsigned long long count, unsigned long long total)
+{
+  return total ? 100.0 * count / total : 0.0;
+}
+
+void printRayStats(std::ostream& out, const RayStats& stats)
+{
+  static const char* const rayNames[3] = { "primary", "bounce", "shadow" };
+  static const char* const endNames[4] = { "miss", "light hit", "pdf <= 0", "max depth" };
+
+  const std::ios::fmtflags flags = out.flags();
+  const std::streamsize precision = out.precision();
+  out << std::fixed << std::setprecision(2);
+
+  out << "Ray statistics, " << stats.m_seconds << " s of launches:" << std::endl;
+  for (int i = 0; i < 3; ++i)
+  {
+    const unsigned long long count = stats.m_counters[RAY_COUNTER_PRIMARY + i];
+    out << "  " << std::left << std::setw(10) << rayNames[i] << std::right << std::setw(14) << count
+        << " rays " << std::setw(10) << stats.rate(count) * 1.0e-6 << " Mrays/s" << std::endl;
+  }
+  out << "  " << std::left << std::setw(10) << "total" << std::right << std::setw(14) << stats.rays()
+      << " rays " << std::setw(10) << stats.rate(stats.rays()) * 1.0e-6 << " Mrays/s" << std::endl;
+
+  unsigned long long paths = 0;
+  for (int i = 0; i < 4; ++i)
+  {
+    paths += stats.m_counters[RAY_COUNTER_END_MISS + i];
+  }
+  out << "Path terminations (" << paths << " paths):" << std::endl;
+  for (int i = 0; i < 4; ++i)
+  {
+    const unsigned long long count = stats.m_counters[RAY_COUNTER_END_MISS + i];
+    out << "  " << std::left << std::setw(10) << endNames[i] << std::right << std::setw(14) << count
+        << std::setw(8) << percent(count, paths) << " %" << std::endl;
+  }
+
+  out << "Closest hits per program:" << std::endl;
+  for (int i = 0; i < RAY_STATS_MAX_PROGRAMS; ++i)
+  {
+    const unsigned long long count = stats.m_counters[RAY_COUNTER_PROGRAM_HITS + i];
+    if (count)
+    {
+      const std::string name = rayStatsProgramName(i) ? std::string(rayStatsProgramName(i)) : "program " + std::to_string(i);
+      out << "  " << std::left << std::setw(10) << name << std::right << std::setw(14) << count << std::endl;
+    }
+  }
+
+  out << "Path length histogram (segments):" << std::endl;
+  for (int i = 0; i < RAY_STATS_MAX_PATH_LENGTH; ++i)
+  {
+    const unsigned long long count = stats.m_counters[RAY_COUNTER_PATH_LENGTH + i];
+    if (count)
+    {
+      out << "  " << std::setw(3) << (i + 1) << ((i + 1 == RAY_STATS_MAX_PATH_LENGTH) ? "+" : " ") << std::setw(20) << count
+          << std::setw(8) << percent(count, paths) << " %" << std::endl;
+    }
+  }
+
+  out.flags(flags);
+  out.precision(precision);
+}
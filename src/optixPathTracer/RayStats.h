@@ -0,0 +1,32 @@
+#pragma once
+
+#ifndef RAY_STATS_HOST_H
+#define RAY_STATS_HOST_H
+
+#include "ray_stats.h"
+
+#include <ostream>
+
+// Totals of the ray statistics counters (ray_stats.h) of a session, see SessionSettings::m_rayStats.
+// m_seconds is the launch time of the counted frames, including the counting itself, so the rates are
+// lower than those of a render without statistics.
+struct RayStats
+{
+  RayStats();
+
+  void add(const RayStats& other);
+
+  unsigned long long rays() const; // Primary, bounce and shadow rays.
+  double rate(unsigned long long count) const; // Per second, 0 without time.
+
+  unsigned long long m_counters[RAY_COUNTER_COUNT]; // Indexed by RayCounter.
+  double             m_seconds;
+};
+
+// Name of a BRDF programId, nullptr for unknown ones.
+const char* rayStatsProgramName(int programId);
+
+// Ray counts and rays/s per category, path terminations, hits per program and the path length histogram.
+void printRayStats(std::ostream& out, const RayStats& stats);
+
+#endif // RAY_STATS_HOST_H
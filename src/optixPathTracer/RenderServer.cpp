@@ -0,0 +1,150 @@
+#include "RenderServer.h"
+
+#include <cstdlib>
+
+
+RenderJob::RenderJob()
+: m_width(0)
+, m_height(0)
+, m_samples(256)
+, m_camera(false)
+{
+  for (int i = 0; i < 3; ++i)
+  {
+    m_eye[i]    = 0.0f;
+    m_lookat[i] = 0.0f;
+    m_up[i]     = (i == 1) ? 1.0f : 0.0f;
+  }
+}
+
+std::vector<std::string> splitRequest(const std::string& line)
+{
+  std::vector<std::string> fields;
+  size_t begin = 0;
+  for (;;)
+  {
+    const size_t end = line.find('\t', begin);
+    const std::string field = line.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+    // A trailing '\r' of clients which send CRLF line endings.
+    if (!field.empty() && field != "\r")
+    {
+      fields.push_back(field[field.size() - 1] == '\r' ? field.substr(0, field.size() - 1) : field);
+    }
+    if (end == std::string::npos)
+    {
+      return fields;
+    }
+    begin = end + 1;
+  }
+}
+
+static bool parseUnsigned(const std::string& value, unsigned int& result)
+{
+  char* end = nullptr;
+  const long n = strtol(value.c_str(), &end, 10);
+  if (value.empty() || *end != '\0' || n <= 0 || n > 65536)
+  {
+    return false;
+  }
+  result = static_cast<unsigned int>(n);
+  return true;
+}
+
+static bool parseFloat3(const std::string& value, float* result)
+{
+  const char* p = value.c_str();
+  for (int i = 0; i < 3; ++i)
+  {
+    char* end = nullptr;
+    result[i] = static_cast<float>(strtod(p, &end));
+    if (end == p || *end != (i < 2 ? ',' : '\0'))
+    {
+      return false;
+    }
+    p = end + 1;
+  }
+  return true;
+}
+
+bool parseRenderJob(const std::vector<std::string>& fields, RenderJob& job, std::string& error)
+{
+  int camera = 0; // Bits of eye, lookat and up.
+  for (size_t i = 0; i < fields.size(); ++i)
+  {
+    const size_t equals = fields[i].find('=');
+    if (equals == std::string::npos)
+    {
+      error = "expected key=value instead of '" + fields[i] + "'";
+      return false;
+    }
+    const std::string key   = fields[i].substr(0, equals);
+    const std::string value = fields[i].substr(equals + 1);
+
+    bool valid = true;
+    if (key == "scene")
+    {
+      job.m_scene = value;
+    }
+    else if (key == "output")
+    {
+      job.m_output = value;
+    }
+    else if (key == "width")
+    {
+      valid = parseUnsigned(value, job.m_width);
+    }
+    else if (key == "height")
+    {
+      valid = parseUnsigned(value, job.m_height);
+    }
+    else if (key == "spp")
+    {
+      valid = parseUnsigned(value, job.m_samples);
+    }
+    else if (key == "eye" || key == "lookat" || key == "up")
+    {
+      const int bit = (key == "eye") ? 1 : (key == "lookat") ? 2 : 4;
+      valid = parseFloat3(value, (bit == 1) ? job.m_eye : (bit == 2) ? job.m_lookat : job.m_up);
+      camera |= bit;
+    }
+    else if (key == "tonemap")
+    {
+      valid = sutil::toneMapOperatorFromName(value, job.m_toneMap.op);
+    }
+    else if (key == "exposure")
+    {
+      char* end = nullptr;
+      job.m_toneMap.exposure = static_cast<float>(strtod(value.c_str(), &end));
+      valid = !value.empty() && *end == '\0';
+    }
+    else
+    {
+      error = "unknown field '" + key + "'";
+      return false;
+    }
+
+    if (!valid)
+    {
+      error = "invalid field '" + fields[i] + "'";
+      return false;
+    }
+  }
+
+  if (job.m_scene.empty() || job.m_output.empty())
+  {
+    error = "scene and output are required";
+    return false;
+  }
+  if (camera != 0 && camera != 7)
+  {
+    error = "eye, lookat and up must be given together";
+    return false;
+  }
+  if ((job.m_width == 0) != (job.m_height == 0))
+  {
+    error = "width and height must be given together";
+    return false;
+  }
+  job.m_camera = job.m_camera || (camera == 7);
+  return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#ifndef RENDER_SERVER_H
+#define RENDER_SERVER_H
+
+#include <ToneMap.h>
+
+#include <string>
+#include <vector>
+
+// Requests of the render server (optixPathTracer --server <socket>).
+// One request per line, the fields are separated by tabs so that paths may contain spaces:
+//   render  scene=<file>  output=<file>  [width=<n>]  [height=<n>]  [spp=<n>]
+//           [eye=<x,y,z>  lookat=<x,y,z>  up=<x,y,z>]  [tonemap=<operator>]  [exposure=<stops>]
+//   stats
+//   quit
+// Every request gets one reply line starting with "ok" or "error". Paths are used as given, relative
+// paths are relative to the working directory of the server.
+
+struct RenderJob
+{
+  RenderJob();
+
+  std::string             m_scene;
+  std::string             m_output;
+  unsigned int            m_width;   // 0: resolution of the scene file.
+  unsigned int            m_height;
+  unsigned int            m_samples; // Frames of one sample per pixel.
+  bool                    m_camera;  // m_eye, m_lookat and m_up are given, otherwise the default view of the scene is used.
+  float                   m_eye[3];
+  float                   m_lookat[3];
+  float                   m_up[3];
+  sutil::ToneMapSettings  m_toneMap;
+};
+
+std::vector<std::string> splitRequest(const std::string& line);
+
+// Parses the fields after "render". Fields which are not given keep their value in job.
+bool parseRenderJob(const std::vector<std::string>& fields, RenderJob& job, std::string& error);
+
+#endif // RENDER_SERVER_H
@@ -0,0 +1,944 @@
+#include "Renderer.h"
+
+#include <HDRLoader.h>
+#include <OptiXMesh.h>
+#include <Profiler.h>
+#include <sutil.h>
+
+#include <IL/il.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <mutex>
+
+static const int NUMBER_OF_BRDF_INDICES  = 3;
+static const int NUMBER_OF_LIGHT_INDICES = 2;
+
+// The PTX files are named after the executable which used to build them.
+static const char* const PTX_PREFIX = "optixPathTracer";
+
+
+SessionSettings::SessionSettings()
+: m_width(0)
+, m_height(0)
+, m_accumulation(ACCUMULATION_FLOAT)
+, m_textureCompression(BLOCK_FORMAT_NONE)
+, m_readableAccumulation(false)
+, m_glInterop(false)
+, m_maxDepth(3)
+, m_reprojection(false)
+, m_aovs(0)
+, m_tileSize(0)
+, m_samplesPerLaunch(1)
+, m_rayStats(false)
+{
+}
+
+
+std::string PtxCache::path(const std::string& cudaFile) const
+{
+  return m_ptxDir + "/" + PTX_PREFIX + "_generated_" + cudaFile + ".ptx";
+}
+
+const std::string& PtxCache::get(const std::string& cudaFile)
+{
+  static const std::string empty;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::map<std::string, std::string>::const_iterator it = m_ptx.find(cudaFile);
+  if (it != m_ptx.end())
+  {
+    return it->second;
+  }
+  std::ifstream file(path(cudaFile).c_str(), std::ios::binary);
+  if (!file)
+  {
+    return empty;
+  }
+  std::ostringstream text;
+  text << file.rdbuf();
+  return m_ptx[cudaFile] = text.str();
+}
+
+
+Renderer::Renderer(unsigned int numThreads, const std::string& ptxDir, const std::string& dataDir)
+: m_ptxDir(ptxDir.empty() ? std::string(sutil::samplesPTXDir()) : ptxDir)
+, m_dataDir(dataDir.empty() ? std::string(sutil::samplesDir()) + "/data" : dataDir)
+, m_ptx(std::make_shared<PtxCache>(m_ptxDir))
+, m_pool(numThreads)
+{
+  // DevIL is initialized once per process, Picture::load() serializes its use.
+  static std::once_flag ilInitialized;
+  std::call_once(ilInitialized, []() { ilInit(); });
+}
+
+std::unique_ptr<Session> Renderer::createSession(const std::string& sceneFilename, const SessionSettings& settings) const
+{
+  sutil::ProfileScope profile("createSession", sceneFilename);
+  std::unique_ptr<Scene> scene = LoadScene(sceneFilename.c_str());
+  if (!scene)
+  {
+    std::cerr << "ERROR: Cannot load scene " << sceneFilename << std::endl;
+    return nullptr;
+  }
+  std::unique_ptr<Session> session(new Session(*this, std::move(scene), settings));
+  session->initialize();
+  return session;
+}
+
+std::future<void> Renderer::submit(const std::function<void()>& task)
+{
+  return m_pool.submit(task);
+}
+
+unsigned int Renderer::numThreads() const
+{
+  return m_pool.size();
+}
+
+
+Session::Session(const Renderer& renderer, std::unique_ptr<Scene> scene, const SessionSettings& settings)
+: m_ptx(renderer.ptxCache())
+, m_dataDir(renderer.dataDir())
+, m_settings(settings)
+, m_scene(std::move(scene))
+, m_assetBytes(0)
+, m_frame(0)
+, m_samplesPerLaunch(std::max(1u, settings.m_samplesPerLaunch))
+, m_launchSamples(1)
+, m_tileWidth(0)
+, m_tileHeight(0)
+, m_tileX(0)
+, m_tileY(0)
+, m_regionX(0)
+, m_regionY(0)
+, m_regionWidth(0)
+, m_regionHeight(0)
+, m_launchWidth(0)
+, m_launchHeight(0)
+, m_previewScale(1)
+, m_aovs(settings.m_accumulation == ACCUMULATION_FLOAT ? settings.m_aovs : 0)
+, m_reprojection(settings.m_reprojection && settings.m_accumulation == ACCUMULATION_FLOAT)
+, m_reprojectPending(false)
+, m_historyValid(false)
+, m_reprojectedPixels(0)
+, m_reprojectedSamples(0)
+, m_rayStats(settings.m_rayStats && settings.m_accumulation == ACCUMULATION_FLOAT)
+{
+}
+
+Session::~Session()
+{
+  // The handles only reference the context's objects, destroying the context releases them all.
+  m_camera.reset();
+  m_programs.clear();
+  if (m_context)
+  {
+    m_context->destroy();
+  }
+}
+
+void Session::initialize()
+{
+  if (!m_settings.m_width || !m_settings.m_height)
+  {
+    m_settings.m_width  = m_scene->properties.width;
+    m_settings.m_height = m_scene->properties.height;
+  }
+  m_tileWidth  = m_settings.m_tileSize;
+  m_tileHeight = m_settings.m_tileSize;
+  createContext(m_settings.m_width, m_settings.m_height);
+
+  loadTextures();
+
+  m_bufferLightParameters = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_USER);
+  m_bufferLightParameters->setElementSize(sizeof(LightParameter));
+  m_bufferLightParameters->setSize(m_scene->lights.size());
+  updateLightParameters();
+  m_context["sysLightParameters"]->setBuffer(m_bufferLightParameters);
+
+  m_bufferMaterialParameters = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_USER);
+  m_bufferMaterialParameters->setElementSize(sizeof(MaterialParameter));
+  m_bufferMaterialParameters->setSize(m_scene->materials.size());
+  updateMaterialParameters();
+  m_context["sysMaterialParameters"]->setBuffer(m_bufferMaterialParameters);
+
+  m_context["sysNumberOfLights"]->setInt(static_cast<int>(m_scene->lights.size()));
+  createGeometry();
+
+  {
+    sutil::ProfileScope profile("validate");
+    m_context->validate();
+  }
+
+  setDefaultCamera();
+  updateLaunch();
+
+  if (sutil::profilingEnabled())
+  {
+    // OptiX compiles the kernel and builds the acceleration structures at the first launch. An empty launch
+    // separates that from the time of the first frame.
+    sutil::ProfileScope profile("compile and build acceleration");
+    m_context->launch(0, 0, 0);
+  }
+}
+
+// The PTX of a program is only compiled once per context, the files are only read once per process.
+optix::Program Session::getProgram(const std::string& cudaFile, const std::string& name)
+{
+  const std::string key = cudaFile + ":" + name;
+  std::map<std::string, optix::Program>::const_iterator it = m_programs.find(key);
+  if (it != m_programs.end())
+  {
+    return it->second;
+  }
+  sutil::ProfileScope profile("load PTX", key);
+  const std::string& ptx = m_ptx->get(cudaFile);
+  // A missing file is left to OptiX, which throws the usual exception with the path.
+  optix::Program program = ptx.empty() ? m_context->createProgramFromPTXFile(m_ptx->path(cudaFile), name)
+                                       : m_context->createProgramFromPTXString(ptx, name);
+  m_programs[key] = program;
+  return program;
+}
+
+size_t Session::getBufferBytes() const
+{
+  size_t bytes = 0;
+  for (unsigned int i = 0; i < m_context->getVariableCount(); ++i)
+  {
+    optix::Variable variable = m_context->getVariable(i);
+    if (variable->getType() != RT_OBJECTTYPE_BUFFER)
+    {
+      continue;
+    }
+    optix::Buffer buffer = variable->getBuffer();
+    RTsize width = 0;
+    RTsize height = 1;
+    if (buffer->getDimensionality() == 2)
+    {
+      buffer->getSize(width, height);
+    }
+    else
+    {
+      buffer->getSize(width);
+    }
+    bytes += size_t(width) * height * buffer->getElementSize();
+  }
+  return bytes;
+}
+
+void Session::createContext(unsigned int width, unsigned int height)
+{
+  m_context = optix::Context::create();
+  m_context->setRayTypeCount(2);
+  m_context->setEntryPointCount(2); // Path tracing, tonemapping.
+
+  // Note: this sample does not need a big stack size even with high ray depths, 
+  // because rays are not shot recursively.
+  m_context->setStackSize(800);
+
+  // Note: high max depth for reflection and refraction through glass
+  m_context["max_depth"]->setInt(m_settings.m_maxDepth);
+  m_context["cutoff_color"]->setFloat(0.0f, 0.0f, 0.0f);
+  m_context["frame"]->setUint(0u);
+  m_context["samples_per_launch"]->setUint(1u);
+  m_context["scene_epsilon"]->setFloat(1.e-3f);
+  m_context["image_size"]->setUint(width, height);
+  m_context["tile_origin"]->setUint(0u, 0u);
+  m_context["launch_offset"]->setUint(0u, 0u);
+  m_context["launch_limit"]->setUint(width, height);
+  m_context["preview_scale"]->setUint(1u);
+
+  // The buffers of a tiled session only hold one tile.
+  const unsigned int bufferWidth  = isTiled() ? std::min(m_tileWidth,  width)  : width;
+  const unsigned int bufferHeight = isTiled() ? std::min(m_tileHeight, height) : height;
+  optix::Buffer buffer = sutil::createOutputBuffer(m_context, RT_FORMAT_UNSIGNED_BYTE4, bufferWidth, bufferHeight, m_settings.m_glInterop);
+  m_context["output_buffer"]->set(buffer);
+
+  // Accumulation buffer. It stays on the device unless the host has to read it for batch output.
+  // Only the buffer of the selected format exists, the programs of the other format are not used.
+  const AccumulationFormat format = m_settings.m_accumulation;
+  optix::Buffer accumBuffer = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | (m_settings.m_readableAccumulation ? 0 : RT_BUFFER_GPU_LOCAL),
+                                                      accumulationBufferFormat(format), bufferWidth, bufferHeight);
+  m_context[accumulationBufferName(format)]->set(accumBuffer);
+
+  // Reprojection buffers. Without reprojection the float program still references them, they stay 1x1.
+  const unsigned int historyWidth  = m_reprojection ? bufferWidth  : 1;
+  const unsigned int historyHeight = m_reprojection ? bufferHeight : 1;
+  m_context["hit_buffer"]->set(m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT4, historyWidth, historyHeight));
+  m_context["prev_hit_buffer"]->set(m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_FLOAT4, historyWidth, historyHeight));
+  // Swapped with the accumulation buffer, so it has to be just as readable.
+  m_context["prev_accum_buffer"]->set(m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | (m_settings.m_readableAccumulation ? 0 : RT_BUFFER_GPU_LOCAL),
+                                                              RT_FORMAT_FLOAT4, historyWidth, historyHeight));
+  m_context["reproject_counts"]->set(m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_UNSIGNED_INT, 2));
+  m_context["store_hits"]->setInt(0);
+  m_context["reproject"]->setInt(0);
+  m_context["reproject_max_samples"]->setFloat(64.0f);
+
+  // AOV buffers, 1x1 like the reprojection buffers when the AOV is not rendered.
+  const unsigned int aovType = RT_BUFFER_INPUT_OUTPUT | (m_settings.m_readableAccumulation ? 0 : RT_BUFFER_GPU_LOCAL);
+  for (unsigned int index = 0; index < AOV_COUNT; ++index)
+  {
+    if (aovBufferName(index))
+    {
+      const bool rendered = (m_aovs & (1u << index)) != 0;
+      m_context[aovBufferName(index)]->set(m_context->createBuffer(aovType, RT_FORMAT_FLOAT4, rendered ? bufferWidth : 1, rendered ? bufferHeight : 1));
+    }
+  }
+  m_context["aov_mask"]->setUint(m_aovs & AOV_DEVICE_MASK);
+  const bool cost = (m_aovs & AOV_COST) != 0;
+  m_context["intersection_count_buffer"]->set(m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL, RT_FORMAT_UNSIGNED_INT,
+                                                                      cost ? bufferWidth : 1, cost ? bufferHeight : 1));
+
+  // Ray statistics stripes, 1 counter when nothing is counted.
+  optix::Buffer rayStats = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_UNSIGNED_INT, m_rayStats ? RAY_STATS_STRIPES * RAY_COUNTER_COUNT : 1);
+  memset(rayStats->map(0, RT_BUFFER_MAP_WRITE_DISCARD), 0, (m_rayStats ? RAY_STATS_STRIPES * RAY_COUNTER_COUNT : 1) * sizeof(unsigned int));
+  rayStats->unmap();
+  m_context["ray_stats_buffer"]->set(rayStats);
+
+  // Ray generation program. The hit captures, the AOV writes and the ray statistics are specialized into programs
+  // of their own, which match the closest hit programs of closestHitProgram().
+  const bool deviceAovs = (m_aovs & AOV_DEVICE_MASK) != 0;
+  const char* rayGeneration = deviceAovs     ? (m_rayStats ? "pinhole_camera_aov_stats" : "pinhole_camera_aov")
+                            : m_reprojection ? (m_rayStats ? "pinhole_camera_capture_stats" : "pinhole_camera_capture")
+                                             : (m_rayStats ? "pinhole_camera_stats" : accumulationRayGenerationProgram(format));
+  m_context->setRayGenerationProgram(0, getProgram("path_trace_camera.cu", rayGeneration));
+
+  // Exception programs, they map launch indices to pixels like the ray generation program of their entry point.
+  m_context->setExceptionProgram(0, getProgram("path_trace_camera.cu", "exception"));
+  m_context->setExceptionProgram(1, getProgram("path_trace_camera.cu", "exception_tonemap"));
+  m_context["bad_color"]->setFloat(1.0f, 0.0f, 1.0f);
+
+  // Display conversion of the accumulation buffer
+  m_context->setRayGenerationProgram(1, getProgram("tonemap.cu", accumulationToneMapProgram(format)));
+  setToneMapSettings(sutil::ToneMapSettings());
+
+  // Miss program
+  m_context->setMissProgram(0, getProgram("background.cu", "miss"));
+  const std::string textureFilename = m_dataDir + "/CedarCity.hdr";
+  m_context["envmap"]->setTextureSampler(loadHDRTexture(m_context, textureFilename, optix::make_float3(1.0f), true)); // RGBA16F halves the resident size.
+
+  // Bindless callable programs of the BRDFs and light types, selected by index on the device.
+  const char* const brdfFiles[NUMBER_OF_BRDF_INDICES] = { "disney.cu", "glass.cu", "lambert.cu" };
+  const char* const brdfFunctions[3] = { "Sample", "Eval", "Pdf" };
+  const char* const brdfBuffers[3]   = { "sysBRDFSample", "sysBRDFEval", "sysBRDFPdf" };
+  for (int f = 0; f < 3; ++f)
+  {
+    optix::Buffer ids = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_PROGRAM_ID, NUMBER_OF_BRDF_INDICES);
+    int* id = static_cast<int*>(ids->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+    for (int i = 0; i < NUMBER_OF_BRDF_INDICES; ++i)
+    {
+      id[i] = getProgram(brdfFiles[i], brdfFunctions[f])->getId();
+    }
+    ids->unmap();
+    m_context[brdfBuffers[f]]->setBuffer(ids);
+  }
+
+  // Light sampling functions.
+  const char* const lightFunctions[NUMBER_OF_LIGHT_INDICES] = { "sphere_sample", "quad_sample" };
+  optix::Buffer lightSample = m_context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_PROGRAM_ID, NUMBER_OF_LIGHT_INDICES);
+  int* id = static_cast<int*>(lightSample->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+  for (int i = 0; i < NUMBER_OF_LIGHT_INDICES; ++i)
+  {
+    id[i] = getProgram("light_sample.cu", lightFunctions[i])->getId();
+  }
+  lightSample->unmap();
+  m_context["sysLightSample"]->setBuffer(lightSample);
+}
+
+optix::Material Session::createMaterial(const MaterialParameter& mat, int index)
+{
+  optix::Material material = m_context->createMaterial();
+  material->setClosestHitProgram(0, getProgram("hit_program.cu", closestHitProgram()));
+  material->setAnyHitProgram(1, getProgram("hit_program.cu", "any_hit"));
+
+  material["materialId"]->setInt(index);
+  material["programId"]->setInt(mat.brdf);
+
+  return material;
+}
+
+optix::Material Session::createLightMaterial(const LightParameter& mat, int index)
+{
+  optix::Material material = m_context->createMaterial();
+  material->setClosestHitProgram(0, getProgram("light_hit_program.cu", closestHitProgram()));
+
+  material["lightMaterialId"]->setInt(index);
+
+  return material;
+}
+
+std::string Session::closestHitProgram() const
+{
+  // The first hits of the AOVs and reprojection are recorded by the *_capture variants. The shadow ray and material
+  // counts of the ray statistics and of the cost AOV by the *_stats variants. Plain sessions trace the plain payload.
+  const bool capture = (m_aovs & AOV_DEVICE_MASK) != 0 || m_reprojection;
+  const bool stats   = m_rayStats || (m_aovs & AOV_COST) != 0;
+  return std::string("closest_hit") + (capture ? "_capture" : "") + (stats ? "_stats" : "");
+}
+
+std::string Session::intersectionProgram(const std::string& name) const
+{
+  // The cost AOV counts the intersection tests in variants of the programs, see intersection_count.h.
+  return (m_aovs & AOV_COST) ? name + "_cost" : name;
+}
+
+optix::GeometryInstance Session::createSphere(optix::Material material, const optix::float3& center, float radius)
+{
+  optix::Geometry sphere = m_context->createGeometry();
+  sphere->setPrimitiveCount(1u);
+  sphere->setBoundingBoxProgram(getProgram("sphere_intersect.cu", "bounds"));
+  sphere->setIntersectionProgram(getProgram("sphere_intersect.cu", intersectionProgram("sphere_intersect_robust")));
+
+  sphere["center"]->setFloat(center);
+  sphere["radius"]->setFloat(radius);
+
+  return m_context->createGeometryInstance(sphere, &material, &material + 1);
+}
+
+optix::GeometryInstance Session::createQuad(optix::Material material, optix::float3 v1, optix::float3 v2,
+                                            const optix::float3& anchor, const optix::float3& n)
+{
+  optix::Geometry quad = m_context->createGeometry();
+  quad->setPrimitiveCount(1u);
+  quad->setBoundingBoxProgram(getProgram("quad_intersect.cu", "bounds"));
+  quad->setIntersectionProgram(getProgram("quad_intersect.cu", intersectionProgram("intersect")));
+
+  const optix::float3 normal = optix::normalize(optix::cross(v1, v2));
+  const optix::float4 plane  = optix::make_float4(normal, optix::dot(normal, anchor));
+  v1 *= 1.0f / optix::dot(v1, v1);
+  v2 *= 1.0f / optix::dot(v2, v2);
+  quad["v1"]->setFloat(v1);
+  quad["v2"]->setFloat(v2);
+  quad["anchor"]->setFloat(anchor);
+  quad["plane"]->setFloat(plane);
+
+  return m_context->createGeometryInstance(quad, &material, &material + 1);
+}
+
+// A Group with two GeometryGroup children: the meshes and the light geometry.
+void Session::createGeometry()
+{
+  m_topGroup = m_context->createGroup();
+  m_topGroup->setAcceleration(m_context->createAcceleration("Trbvh"));
+
+  size_t geometryBytes = 0;
+  int numTriangles = 0;
+  {
+    optix::GeometryGroup geometryGroup = m_context->createGeometryGroup();
+    geometryGroup->setAcceleration(m_context->createAcceleration("Trbvh"));
+    m_topGroup->addChild(geometryGroup);
+
+    for (size_t i = 0; i < m_scene->mesh_names.size(); ++i)
+    {
+      OptiXMesh mesh;
+      mesh.context = m_context;
+
+      // override defaults
+      mesh.intersection = getProgram("triangle_mesh.cu", intersectionProgram("mesh_intersect_refine"));
+      mesh.bounds       = getProgram("triangle_mesh.cu", "mesh_bounds");
+      mesh.material     = createMaterial(m_scene->materials[i], static_cast<int>(i));
+
+      {
+        sutil::ProfileScope profile("loadMesh", m_scene->mesh_names[i]);
+        loadMesh(m_scene->mesh_names[i], mesh, m_scene->transforms[i]);
+      }
+      geometryGroup->addChild(mesh.geom_instance);
+
+      m_bounds.include(mesh.bbox_min, mesh.bbox_max);
+
+      // Vertex, index and material buffers of the mesh.
+      optix::Geometry geometry = mesh.geom_instance->getGeometry();
+      for (unsigned int k = 0; k < geometry->getVariableCount(); ++k)
+      {
+        optix::Variable variable = geometry->getVariable(k);
+        if (variable->getType() == RT_OBJECTTYPE_BUFFER)
+        {
+          optix::Buffer buffer = variable->getBuffer();
+          RTsize size = 0;
+          buffer->getSize(size);
+          geometryBytes += size_t(size) * buffer->getElementSize();
+        }
+      }
+
+      std::cerr << m_scene->mesh_names[i] << ": " << mesh.num_triangles << std::endl;
+      numTriangles += mesh.num_triangles;
+    }
+    std::cerr << "Total triangle count: " << numTriangles << std::endl;
+  }
+
+  // Lights
+  {
+    optix::GeometryGroup geometryGroup = m_context->createGeometryGroup();
+    geometryGroup->setAcceleration(m_context->createAcceleration("NoAccel"));
+    m_topGroup->addChild(geometryGroup);
+
+    for (size_t i = 0; i < m_scene->lights.size(); ++i)
+    {
+      const LightParameter& light = m_scene->lights[i];
+      optix::GeometryInstance instance;
+      if (light.lightType == QUAD)
+      {
+        instance = createQuad(createLightMaterial(light, static_cast<int>(i)), light.u, light.v, light.position, light.normal);
+      }
+      else if (light.lightType == SPHERE)
+      {
+        instance = createSphere(createLightMaterial(light, static_cast<int>(i)), light.position, light.radius);
+      }
+      geometryGroup->addChild(instance);
+    }
+  }
+
+  m_context["top_object"]->set(m_topGroup);
+  m_assetBytes += geometryBytes;
+}
+
+void Session::loadTextures()
+{
+  size_t textureBytes = 0;
+  for (std::map<int, std::string>::const_iterator it = m_scene->texture_map.begin(); it != m_scene->texture_map.end(); ++it)
+  {
+    Texture tex;
+    Picture picture;
+    const std::string textureFilename = m_dataDir + "/" + it->second;
+    std::cout << textureFilename << std::endl;
+    {
+      sutil::ProfileScope profile("texture decode", textureFilename);
+      picture.load(textureFilename);
+    }
+    sutil::ProfileScope profile("texture convert and upload", textureFilename);
+    CompressionReport report;
+    // Albedo textures hold sRGB data. The sampler or the download converts them to linear once.
+    if (m_settings.m_textureCompression != BLOCK_FORMAT_NONE &&
+        tex.createSamplerCompressed(m_context, &picture, m_settings.m_textureCompression, textureFilename, true, &report))
+    {
+      std::cerr << "  " << report.m_uncompressedBytes / 1024 << " KB -> " << report.m_compressedBytes / 1024
+                << " KB, PSNR " << report.m_psnr << " dB" << (report.m_fromCache ? " (cached)" : "") << std::endl;
+    }
+    else
+    {
+      tex.createSampler(m_context, &picture, true);
+    }
+    textureBytes += tex.getDeviceSize();
+    m_scene->textures.push_back(tex);
+  }
+  if (!m_scene->texture_map.empty())
+  {
+    std::cerr << "Texture memory: " << textureBytes / 1024 << " KB" << std::endl;
+  }
+  m_assetBytes += textureBytes;
+
+  // Set textures to albedo ID of materials
+  for (size_t i = 0; i < m_scene->materials.size(); ++i)
+  {
+    if (m_scene->materials[i].albedoID != RT_TEXTURE_ID_NULL)
+    {
+      m_scene->materials[i].albedoID = m_scene->textures[m_scene->materials[i].albedoID - 1].getId();
+    }
+  }
+}
+
+void Session::updateMaterialParameters()
+{
+  MaterialParameter* dst = static_cast<MaterialParameter*>(m_bufferMaterialParameters->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+  for (size_t i = 0; i < m_scene->materials.size(); ++i, ++dst)
+  {
+    const MaterialParameter& mat = m_scene->materials[i];
+
+    dst->color          = mat.color;
+    dst->emission       = mat.emission;
+    dst->metallic       = mat.metallic;
+    dst->subsurface     = mat.subsurface;
+    dst->specular       = mat.specular;
+    dst->specularTint   = mat.specularTint;
+    dst->roughness      = mat.roughness;
+    dst->anisotropic    = mat.anisotropic;
+    dst->sheen          = mat.sheen;
+    dst->sheenTint      = mat.sheenTint;
+    dst->clearcoat      = mat.clearcoat;
+    dst->clearcoatGloss = mat.clearcoatGloss;
+    dst->brdf           = mat.brdf;
+    dst->albedoID       = mat.albedoID;
+  }
+  m_bufferMaterialParameters->unmap();
+}
+
+void Session::updateLightParameters()
+{
+  LightParameter* dst = static_cast<LightParameter*>(m_bufferLightParameters->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
+  for (size_t i = 0; i < m_scene->lights.size(); ++i, ++dst)
+  {
+    const LightParameter& light = m_scene->lights[i];
+
+    dst->position  = light.position;
+    dst->emission  = light.emission;
+    dst->radius    = light.radius;
+    dst->area      = light.area;
+    dst->u         = light.u;
+    dst->v         = light.v;
+    dst->normal    = light.normal;
+    dst->lightType = light.lightType;
+  }
+  m_bufferLightParameters->unmap();
+}
+
+void Session::setCamera(const optix::float3& eye, const optix::float3& lookat, const optix::float3& up)
+{
+  const unsigned int width  = m_camera ? m_camera->width()  : m_settings.m_width;
+  const unsigned int height = m_camera ? m_camera->height() : m_settings.m_height;
+  m_camera.reset(new sutil::Camera(width, height, &eye.x, &lookat.x, &up.x,
+                                   m_context["eye"], m_context["U"], m_context["V"], m_context["W"]));
+  resetAccumulation();
+}
+
+void Session::setDefaultCamera()
+{
+  optix::float3 eye;
+  optix::float3 lookat;
+  optix::float3 up;
+  getDefaultCamera(eye, lookat, up);
+  setCamera(eye, lookat, up);
+}
+
+void Session::getDefaultCamera(optix::float3& eye, optix::float3& lookat, optix::float3& up) const
+{
+  eye    = optix::make_float3(0.0f, 1.5f * m_bounds.extent(1), -1.5f * m_bounds.extent(2));
+  lookat = m_bounds.center();
+  up     = optix::make_float3(0.0f, 1.0f, 0.0f);
+}
+
+bool Session::resize(unsigned int width, unsigned int height)
+{
+  if (!m_camera->resize(width, height))
+  {
+    return false;
+  }
+  m_context["image_size"]->setUint(width, height);
+  resizeBuffers();
+  updateLaunch();
+  resetAccumulation();
+  return true;
+}
+
+void Session::resizeBuffers()
+{
+  // A tile never needs more than the image.
+  const unsigned int width  = isTiled() ? std::min(m_tileWidth,  getWidth())  : getWidth();
+  const unsigned int height = isTiled() ? std::min(m_tileHeight, getHeight()) : getHeight();
+  RTsize bufferWidth;
+  RTsize bufferHeight;
+  getAccumulationBuffer()->getSize(bufferWidth, bufferHeight);
+  if (bufferWidth == width && bufferHeight == height)
+  {
+    return;
+  }
+  // Also reallocates the GL pixel buffer behind an interop output buffer.
+  sutil::resizeBuffer(getOutputBuffer(), width, height);
+  sutil::resizeBuffer(getAccumulationBuffer(), width, height);
+  if (m_reprojection)
+  {
+    sutil::resizeBuffer(m_context["hit_buffer"]->getBuffer(), width, height);
+    sutil::resizeBuffer(m_context["prev_hit_buffer"]->getBuffer(), width, height);
+    sutil::resizeBuffer(m_context["prev_accum_buffer"]->getBuffer(), width, height);
+    m_historyValid = false;
+  }
+  for (unsigned int index = 0; index < AOV_COUNT; ++index)
+  {
+    if ((m_aovs & (1u << index)) && aovBufferName(index))
+    {
+      sutil::resizeBuffer(m_context[aovBufferName(index)]->getBuffer(), width, height);
+    }
+  }
+  if (m_aovs & AOV_COST)
+  {
+    sutil::resizeBuffer(m_context["intersection_count_buffer"]->getBuffer(), width, height);
+  }
+}
+
+void Session::setTileSize(unsigned int tileWidth, unsigned int tileHeight)
+{
+  const bool tiled = tileWidth && tileHeight;
+  m_tileWidth  = tiled ? tileWidth  : 0;
+  m_tileHeight = tiled ? tileHeight : 0;
+  resizeBuffers();
+  setTile(0, 0);
+}
+
+void Session::setTile(unsigned int x, unsigned int y)
+{
+  m_tileX = x;
+  m_tileY = y;
+  m_context["tile_origin"]->setUint(x, y);
+  updateLaunch();
+  resetAccumulation();
+}
+
+unsigned int Session::getTileWidth() const
+{
+  return isTiled() ? std::min(m_tileWidth, getWidth() - std::min(m_tileX, getWidth())) : getWidth();
+}
+
+unsigned int Session::getTileHeight() const
+{
+  return isTiled() ? std::min(m_tileHeight, getHeight() - std::min(m_tileY, getHeight())) : getHeight();
+}
+
+void Session::setRegion(unsigned int x, unsigned int y, unsigned int width, unsigned int height)
+{
+  const bool region = width && height;
+  m_regionX      = region ? x : 0;
+  m_regionY      = region ? y : 0;
+  m_regionWidth  = region ? width  : 0;
+  m_regionHeight = region ? height : 0;
+  updateLaunch();
+  resetAccumulation();
+}
+
+void Session::clearRegion()
+{
+  setRegion(0, 0, 0, 0);
+}
+
+void Session::updateLaunch()
+{
+  // Image pixels of the buffers, intersected with the region.
+  unsigned int x0 = m_tileX;
+  unsigned int y0 = m_tileY;
+  unsigned int x1 = m_tileX + getTileWidth();
+  unsigned int y1 = m_tileY + getTileHeight();
+  if (hasRegion())
+  {
+    x0 = std::max(x0, m_regionX);
+    y0 = std::max(y0, m_regionY);
+    x1 = std::min(x1, m_regionX + m_regionWidth);
+    y1 = std::min(y1, m_regionY + m_regionHeight);
+  }
+  if (x1 <= x0 || y1 <= y0)
+  {
+    m_launchWidth  = 0;
+    m_launchHeight = 0;
+    return;
+  }
+  m_launchWidth  = x1 - x0;
+  m_launchHeight = y1 - y0;
+  m_context["launch_offset"]->setUint(x0 - m_tileX, y0 - m_tileY);
+  m_context["launch_limit"]->setUint(x1 - m_tileX, y1 - m_tileY);
+}
+
+void Session::setPreviewScale(unsigned int scale)
+{
+  scale = std::max(1u, scale);
+  if (scale == m_previewScale)
+  {
+    return;
+  }
+  m_previewScale = scale;
+  m_context["preview_scale"]->setUint(scale);
+  resetAccumulation();
+}
+
+void Session::setMaxDepth(int maxDepth)
+{
+  m_settings.m_maxDepth = maxDepth;
+  m_context["max_depth"]->setInt(maxDepth);
+  resetAccumulation();
+}
+
+void Session::setToneMapSettings(const sutil::ToneMapSettings& settings)
+{
+  m_context["tonemap_operator"]->setInt(settings.op);
+  m_context["exposure_scale"]->setFloat(exp2f(settings.exposure));
+  m_context["dither"]->setInt(settings.dither ? 1 : 0);
+}
+
+bool Session::beginAccumulation()
+{
+  // The hits of a full frame at full resolution describe every pixel, anything else leaves no history.
+  const bool storeHits = m_reprojection && !isTiled() && !hasRegion() && m_previewScale == 1;
+  const bool reproject = storeHits && m_historyValid && m_reprojectPending;
+  m_reprojectPending = false;
+  m_historyValid     = storeHits;
+  m_context["store_hits"]->setInt(storeHits ? 1 : 0);
+  m_context["reproject"]->setInt(reproject ? 1 : 0);
+  if (!storeHits)
+  {
+    return false;
+  }
+
+  if (reproject)
+  {
+    // The last accumulation becomes the history, its buffers take the new one. Nothing is copied.
+    const char* const names[2][2] = { { "accum_buffer", "prev_accum_buffer" }, { "hit_buffer", "prev_hit_buffer" } };
+    for (int i = 0; i < 2; ++i)
+    {
+      optix::Buffer current  = m_context[names[i][0]]->getBuffer();
+      optix::Buffer previous = m_context[names[i][1]]->getBuffer();
+      m_context[names[i][0]]->set(previous);
+      m_context[names[i][1]]->set(current);
+    }
+    m_context["prev_eye"]->setFloat(m_historyCamera[0]);
+    m_context["prev_U"]->setFloat(m_historyCamera[1]);
+    m_context["prev_V"]->setFloat(m_historyCamera[2]);
+    m_context["prev_W"]->setFloat(m_historyCamera[3]);
+
+    optix::Buffer counts = m_context["reproject_counts"]->getBuffer();
+    memset(counts->map(0, RT_BUFFER_MAP_WRITE_DISCARD), 0, 2 * sizeof(unsigned int));
+    counts->unmap();
+  }
+
+  // The sutil::Camera writes these variables, they are the camera of the new accumulation.
+  const char* const camera[4] = { "eye", "U", "V", "W" };
+  for (int i = 0; i < 4; ++i)
+  {
+    m_historyCamera[i] = m_context[camera[i]]->getFloat3();
+  }
+  return reproject;
+}
+
+void Session::render(unsigned int samples)
+{
+  for (unsigned int i = 0; i < samples; )
+  {
+    const unsigned int launchSamples = std::min(m_samplesPerLaunch, samples - i);
+    const bool reproject = (m_frame == 0) && beginAccumulation();
+    m_context["frame"]->setUint(m_frame);
+    if (launchSamples != m_launchSamples)
+    {
+      m_context["samples_per_launch"]->setUint(launchSamples);
+      m_launchSamples = launchSamples;
+    }
+    m_frame += launchSamples;
+    i       += launchSamples;
+    if (m_launchWidth && m_launchHeight)
+    {
+      sutil::ProfileScope profile("launch");
+      const double launchStart = m_rayStats ? sutil::currentTime() : 0.0;
+      m_context->launch(0, (m_launchWidth + m_previewScale - 1) / m_previewScale, (m_launchHeight + m_previewScale - 1) / m_previewScale);
+      if (m_rayStats)
+      {
+        addRayStats(sutil::currentTime() - launchStart);
+      }
+    }
+    if (reproject)
+    {
+      optix::Buffer counts = m_context["reproject_counts"]->getBuffer();
+      const unsigned int* count = static_cast<const unsigned int*>(counts->map(0, RT_BUFFER_MAP_READ));
+      m_reprojectedPixels  = count[0];
+      m_reprojectedSamples = count[1];
+      counts->unmap();
+    }
+  }
+}
+
+void Session::addRayStats(double seconds)
+{
+  optix::Buffer buffer = m_context["ray_stats_buffer"]->getBuffer();
+  unsigned int* stripes = static_cast<unsigned int*>(buffer->map(0, RT_BUFFER_MAP_READ_WRITE));
+  for (unsigned int stripe = 0; stripe < RAY_STATS_STRIPES; ++stripe)
+  {
+    for (int i = 0; i < RAY_COUNTER_COUNT; ++i)
+    {
+      m_rayStatTotals.m_counters[i] += stripes[stripe * RAY_COUNTER_COUNT + i];
+    }
+  }
+  // Zeroed after every launch, so the 32 bit counters only have to hold one launch.
+  memset(stripes, 0, RAY_STATS_STRIPES * RAY_COUNTER_COUNT * sizeof(unsigned int));
+  buffer->unmap();
+  m_rayStatTotals.m_seconds += seconds;
+}
+
+void Session::clearAccumulation()
+{
+  optix::Buffer buffer = getAccumulationBuffer();
+  RTsize width;
+  RTsize height;
+  buffer->getSize(width, height);
+  memset(buffer->map(0, RT_BUFFER_MAP_WRITE_DISCARD), 0, width * height * accumulationBytesPerPixel(m_settings.m_accumulation));
+  buffer->unmap();
+  for (unsigned int index = 0; index < AOV_COUNT; ++index)
+  {
+    if ((m_aovs & (1u << index)) && aovBufferName(index))
+    {
+      optix::Buffer aov = m_context[aovBufferName(index)]->getBuffer();
+      memset(aov->map(0, RT_BUFFER_MAP_WRITE_DISCARD), 0, width * height * 4 * sizeof(float));
+      aov->unmap();
+    }
+  }
+}
+
+void Session::toneMap()
+{
+  if (m_launchWidth && m_launchHeight)
+  {
+    sutil::ProfileScope profile("tonemap launch");
+    m_context->launch(1, m_launchWidth, m_launchHeight);
+  }
+}
+
+bool Session::readMean(std::vector<float>& rgba) const
+{
+  sutil::ProfileScope profile("read accumulation");
+  optix::Buffer buffer = getAccumulationBuffer();
+  if (!resolveAccumulation(buffer, rgba))
+  {
+    return false;
+  }
+  RTsize bufferWidth;
+  RTsize bufferHeight;
+  buffer->getSize(bufferWidth, bufferHeight);
+  cropToTile(rgba, bufferWidth);
+  return true;
+}
+
+bool Session::readAov(unsigned int index, std::vector<float>& values) const
+{
+  if (index >= AOV_COUNT || !(m_aovs & (1u << index)) || !m_settings.m_readableAccumulation)
+  {
+    std::cerr << "ERROR: readAov() needs a session with the readable AOV " << aovName(index) << std::endl;
+    return false;
+  }
+  optix::Context context = m_context;
+  optix::Buffer buffer = aovBufferName(index) ? context[aovBufferName(index)]->getBuffer() : getAccumulationBuffer();
+  RTsize bufferWidth;
+  RTsize bufferHeight;
+  buffer->getSize(bufferWidth, bufferHeight);
+  resolveAov(index, static_cast<const float*>(buffer->map(0, RT_BUFFER_MAP_READ)), size_t(bufferWidth) * bufferHeight, values);
+  buffer->unmap();
+  cropToTile(values, bufferWidth);
+  return true;
+}
+
+bool Session::readFeatures(std::vector<float>& albedo, std::vector<float>& normal) const
+{
+  return readAov(AOV_INDEX_ALBEDO, albedo) && readAov(AOV_INDEX_NORMAL, normal);
+}
+
+void Session::cropToTile(std::vector<float>& rgba, size_t bufferWidth) const
+{
+  // Tiles at the right and top border only cover part of the buffer.
+  const size_t width  = getTileWidth();
+  const size_t height = getTileHeight();
+  if (width != bufferWidth)
+  {
+    for (size_t y = 1; y < height; ++y)
+    {
+      memmove(&rgba[y * width * 4], &rgba[y * bufferWidth * 4], width * 4 * sizeof(float));
+    }
+  }
+  rgba.resize(width * height * 4);
+}
+
+optix::Buffer Session::getOutputBuffer() const
+{
+  optix::Context context = m_context;
+  return context["output_buffer"]->getBuffer();
+}
+
+optix::Buffer Session::getAccumulationBuffer() const
+{
+  optix::Context context = m_context;
+  return context[accumulationBufferName(m_settings.m_accumulation)]->getBuffer();
+}
@@ -0,0 +1,287 @@
+#pragma once
+
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <optixu/optixpp_namespace.h>
+#include <optixu/optixu_aabb_namespace.h>
+#include <optixu/optixu_math_namespace.h>
+
+#include <Camera.h>
+#include <ToneMap.h>
+#include <Parallel.h>
+
+#include "Accumulation.h"
+#include "Aov.h"
+#include "BlockCompression.h"
+#include "RayStats.h"
+#include "sceneLoader.h"
+
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// The path tracer as a library.
+// A Renderer holds what all sessions of a process share: the worker threads, the location of the data
+// files and the PTX of the programs, which is read once. A Session owns one OptiX context with one loaded
+// scene, its camera and its accumulation. Everything a session creates is released by its destructor.
+//
+// A session must only be used by one thread at a time. Different sessions share nothing on the device
+// and can render concurrently, e.g. as tasks submitted to the renderer's thread pool.
+
+class Session;
+
+struct SessionSettings
+{
+  SessionSettings();
+
+  unsigned int       m_width;                // 0: resolution of the scene file.
+  unsigned int       m_height;
+  AccumulationFormat m_accumulation;
+  BlockFormat        m_textureCompression;   // Albedo textures, BLOCK_FORMAT_NONE keeps them uncompressed.
+  bool               m_readableAccumulation; // The host reads the accumulation (batch output). Otherwise it stays on the device.
+  bool               m_glInterop;            // Display output buffer backed by a GL pixel buffer. Needs a current GL context.
+  int                m_maxDepth;
+  bool               m_reprojection;         // Float accumulation: keep samples across camera moves, see Session::reprojectAccumulation().
+  unsigned int       m_aovs;                 // Float accumulation: AovFlag bits of the AOVs to render, see Session::readAov().
+  unsigned int       m_tileSize;             // 0: untiled. Otherwise the buffers are created for one tile, see Session::setTileSize().
+  unsigned int       m_samplesPerLaunch;     // See Session::setSamplesPerLaunch().
+  bool               m_rayStats;             // Float accumulation: count rays and paths, see Session::getRayStats().
+};
+
+// PTX files of the CUDA sources, read on first use and kept for all later sessions. OptiX programs belong to
+// one context, so every session still creates its own from the shared text. Thread-safe.
+class PtxCache
+{
+public:
+  explicit PtxCache(const std::string& ptxDir) : m_ptxDir(ptxDir) {}
+
+  std::string path(const std::string& cudaFile) const;
+  // The PTX of cudaFile, empty when the file cannot be read. The reference stays valid.
+  const std::string& get(const std::string& cudaFile);
+
+private:
+  std::string                        m_ptxDir;
+  std::mutex                         m_mutex;
+  std::map<std::string, std::string> m_ptx; // By CUDA file name, files which cannot be read are not kept.
+};
+
+class Renderer
+{
+public:
+  // numThreads == 0 uses sutil::numWorkerThreads(). The PTX and data directories default to the sample paths.
+  explicit Renderer(unsigned int numThreads = 0,
+                    const std::string& ptxDir  = std::string(),
+                    const std::string& dataDir = std::string());
+
+  // Loads the scene file and sets up a context for it. Returns nullptr when the scene cannot be read.
+  // OptiX errors are thrown as optix::Exception.
+  std::unique_ptr<Session> createSession(const std::string& sceneFilename, const SessionSettings& settings = SessionSettings()) const;
+
+  // Runs task on one of the renderer's threads.
+  std::future<void> submit(const std::function<void()>& task);
+
+  unsigned int numThreads() const;
+
+  const std::string& ptxDir() const  { return m_ptxDir; }
+  const std::string& dataDir() const { return m_dataDir; }
+  const std::shared_ptr<PtxCache>& ptxCache() const { return m_ptx; }
+
+private:
+  Renderer(const Renderer&);
+  Renderer& operator=(const Renderer&);
+
+  std::string               m_ptxDir;
+  std::string               m_dataDir;
+  std::shared_ptr<PtxCache> m_ptx; // Shared with the sessions, which may outlive the renderer.
+  sutil::ThreadPool         m_pool;
+};
+
+class Session
+{
+public:
+  ~Session(); // Destroys the context and everything on it.
+
+  const Scene&  getScene() const      { return *m_scene; }
+  optix::Aabb   getBounds() const     { return m_bounds; }
+  unsigned int  getWidth() const      { return m_camera->width(); }
+  unsigned int  getHeight() const     { return m_camera->height(); }
+  size_t        getAssetBytes() const { return m_assetBytes; } // Texture and geometry buffers.
+  size_t        getBufferBytes() const; // Buffers of the context: output, accumulation, AOVs, reprojection and parameters.
+
+  // The camera writes to the context directly. Call resetAccumulation() after moving it.
+  sutil::Camera& getCamera() { return *m_camera; }
+  void setCamera(const optix::float3& eye, const optix::float3& lookat, const optix::float3& up);
+  void setDefaultCamera(); // Looks at the center of the scene from the front and above.
+  void getDefaultCamera(optix::float3& eye, optix::float3& lookat, optix::float3& up) const;
+
+  // Resizes the output and accumulation buffers. Returns true and restarts the accumulation when the size changed.
+  bool resize(unsigned int width, unsigned int height);
+
+  // Tiled rendering for images whose buffers would not fit: the output and accumulation buffers hold one
+  // tile, the camera still covers the full image. A tile samples exactly like the same pixels of an
+  // untiled render. Size 0 renders untiled. Both restart the accumulation.
+  void setTileSize(unsigned int tileWidth, unsigned int tileHeight);
+  void setTile(unsigned int x, unsigned int y); // Lower left image pixel, rows count from the bottom like the buffers.
+  bool isTiled() const { return m_tileWidth != 0; }
+
+  // Image pixels held by the buffers: the current tile clipped at the image border, or the full image when untiled.
+  unsigned int getTileWidth() const;
+  unsigned int getTileHeight() const;
+
+  // Render region in image pixels, lower left corner with rows counted from the bottom. Only the pixels inside
+  // are launched and accumulated, the other pixels of the buffers keep their contents. The region is clipped to
+  // the image (and tile), an empty one launches nothing. Both restart the accumulation.
+  void setRegion(unsigned int x, unsigned int y, unsigned int width, unsigned int height);
+  void clearRegion(); // Renders the full image (or tile) again.
+  bool hasRegion() const { return m_regionWidth != 0; }
+  void getRegion(unsigned int& x, unsigned int& y, unsigned int& width, unsigned int& height) const
+  {
+    x = m_regionX; y = m_regionY; width = m_regionWidth; height = m_regionHeight;
+  }
+
+  // Launch size: the tile or the image, intersected with the region.
+  unsigned int getLaunchWidth() const  { return m_launchWidth; }
+  unsigned int getLaunchHeight() const { return m_launchHeight; }
+
+  // Reduced resolution for interactive previews: render() traces one path per scale x scale block of pixels
+  // and writes it to the whole block, so the launches shrink by scale^2 and toneMap() upsamples for display.
+  // Scale 1 is full resolution. A change restarts the accumulation.
+  void setPreviewScale(unsigned int scale);
+  unsigned int getPreviewScale() const { return m_previewScale; }
+
+  void setMaxDepth(int maxDepth);                            // Restarts the accumulation.
+  void setToneMapSettings(const sutil::ToneMapSettings& settings); // Used by toneMap(), the accumulation stays.
+
+  // Renders samples frames (one sample per pixel each), continuing the accumulation. The frames are split into
+  // launches of up to getSamplesPerLaunch() frames, which sum their samples on the device and write the buffers
+  // once. Every sample keeps the seed of its frame, so the split does not change the samples.
+  void render(unsigned int samples = 1);
+
+  // Amortizes the launch and variable update overhead of small images, 1 launches every frame on its own.
+  // A launch of many samples runs longer before the display or a checkpoint can see it.
+  void setSamplesPerLaunch(unsigned int samples) { m_samplesPerLaunch = std::max(1u, samples); }
+  unsigned int getSamplesPerLaunch() const { return m_samplesPerLaunch; }
+
+  // The next frame starts a new accumulation.
+  void resetAccumulation() { m_frame = 0; m_reprojectPending = false; }
+
+  // Temporal reprojection, for camera moves with SessionSettings::m_reprojection. The next frame starts a new
+  // accumulation, but every pixel whose first hit was visible to the previous camera keeps the samples
+  // accumulated there, at most 64. Only disoccluded pixels and those with another depth or normal start again.
+  // Tiles, regions and preview scales fall back to resetAccumulation().
+  void reprojectAccumulation() { m_frame = 0; m_reprojectPending = true; }
+  bool hasReprojection() const { return m_reprojection; }
+
+  // Result of the last reprojected frame: pixels which kept samples and the number of samples they kept.
+  unsigned int       getReprojectedPixels() const  { return m_reprojectedPixels; }
+  unsigned long long getReprojectedSamples() const { return m_reprojectedSamples; }
+
+  // Frame index of the next sample. Frame 0 initializes the accumulation, later frames add to it.
+  // Setting a start frame > 0 on an empty accumulation requires clearAccumulation().
+  unsigned int getFrame() const { return m_frame; }
+  void setFrame(unsigned int frame) { m_frame = frame; }
+  void clearAccumulation(); // Zeroes the buffer and the feature buffers; needs a readable accumulation.
+
+  // Converts the accumulation into the 8-bit output buffer on the device, for display.
+  void toneMap();
+
+  // Mean radiance of the tile (or image) as RGBA floats in buffer row order. Needs a readable accumulation.
+  bool readMean(std::vector<float>& rgba) const;
+
+  // AOVs of the same pixels, see resolveAov(). Needs the AOV in SessionSettings::m_aovs and a readable accumulation.
+  // Without AOVs the launches run a ray generation program which does not contain the AOV code.
+  unsigned int getAovs() const { return m_aovs; }
+  bool readAov(unsigned int index, std::vector<float>& values) const; // index: AovIndex.
+
+  // The denoiser features: the AOV_ALBEDO and AOV_NORMAL values.
+  bool hasFeatures() const { return (m_aovs & (AOV_ALBEDO | AOV_NORMAL)) == (AOV_ALBEDO | AOV_NORMAL); }
+  bool readFeatures(std::vector<float>& albedo, std::vector<float>& normal) const;
+
+  // Ray and path counters of the launches since the last reset, with SessionSettings::m_rayStats. Like the AOVs
+  // they are compiled into ray generation programs of their own. Every launch reads the counters back, which
+  // synchronizes with the device, so the statistics are a diagnostic mode and not free.
+  bool hasRayStats() const { return m_rayStats; }
+  const RayStats& getRayStats() const { return m_rayStatTotals; }
+  void resetRayStats() { m_rayStatTotals = RayStats(); }
+
+  AccumulationFormat getAccumulationFormat() const { return m_settings.m_accumulation; }
+  optix::Buffer getOutputBuffer() const;
+  optix::Buffer getAccumulationBuffer() const;
+  optix::Context getContext() const { return m_context; }
+
+private:
+  friend class Renderer;
+
+  Session(const Renderer& renderer, std::unique_ptr<Scene> scene, const SessionSettings& settings);
+  void initialize(); // Separate from the constructor, so the destructor cleans up after exceptions.
+  Session(const Session&);
+  Session& operator=(const Session&);
+
+  optix::Program getProgram(const std::string& cudaFile, const std::string& name);
+
+  void createContext(unsigned int width, unsigned int height);
+  void resizeBuffers(); // To the image or tile size.
+  void cropToTile(std::vector<float>& rgba, size_t bufferWidth) const; // Buffer rows of 4 floats to the tile's pixels.
+  void updateLaunch();  // Launch rectangle from the tile and the region.
+  bool beginAccumulation(); // Before frame 0, returns true when the frame reprojects.
+  void addRayStats(double seconds); // Adds the counters of the last launch to the totals and zeroes them.
+  std::string closestHitProgram() const;
+  std::string intersectionProgram(const std::string& name) const;
+  optix::Material createMaterial(const MaterialParameter& mat, int index);
+  optix::Material createLightMaterial(const LightParameter& mat, int index);
+  optix::GeometryInstance createSphere(optix::Material material, const optix::float3& center, float radius);
+  optix::GeometryInstance createQuad(optix::Material material, optix::float3 v1, optix::float3 v2,
+                                     const optix::float3& anchor, const optix::float3& n);
+  void createGeometry();
+  void loadTextures();
+  void updateMaterialParameters();
+  void updateLightParameters();
+
+private:
+  std::shared_ptr<PtxCache>              m_ptx;
+  std::string                            m_dataDir;
+  SessionSettings                        m_settings;
+  std::unique_ptr<Scene>                 m_scene;
+
+  optix::Context                         m_context;
+  std::map<std::string, optix::Program>  m_programs; // Key "<cuda file>:<program>", shared by all materials and geometry.
+  optix::Buffer                          m_bufferMaterialParameters;
+  optix::Buffer                          m_bufferLightParameters;
+  optix::Group                           m_topGroup;
+  optix::Aabb                            m_bounds;
+  size_t                                 m_assetBytes;
+
+  std::unique_ptr<sutil::Camera>         m_camera;
+  unsigned int                           m_frame;
+  unsigned int                           m_samplesPerLaunch;
+  unsigned int                           m_launchSamples; // Value of the samples_per_launch variable.
+  unsigned int                           m_tileWidth;  // 0: untiled.
+  unsigned int                           m_tileHeight;
+  unsigned int                           m_tileX;
+  unsigned int                           m_tileY;
+  unsigned int                           m_regionX;
+  unsigned int                           m_regionY;
+  unsigned int                           m_regionWidth; // 0: no region.
+  unsigned int                           m_regionHeight;
+  unsigned int                           m_launchWidth;
+  unsigned int                           m_launchHeight;
+  unsigned int                           m_previewScale;
+
+  unsigned int                           m_aovs;
+  bool                                   m_reprojection;
+  bool                                   m_reprojectPending;
+  bool                                   m_historyValid;      // The hit buffer belongs to the current accumulation.
+  optix::float3                          m_historyCamera[4]; // eye, U, V, W of the current accumulation.
+  unsigned int                           m_reprojectedPixels;
+  unsigned long long                     m_reprojectedSamples;
+  bool                                   m_rayStats;
+  RayStats                               m_rayStatTotals;
+};
+
+#endif // RENDERER_H
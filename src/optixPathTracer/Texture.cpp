@@ -34,6 +34,8 @@
 #include <optixu/optixpp_namespace.h>
 #include <optixu/optixu_math_namespace.h>
 
+#include <sutil/ColorSpace.h>
+
 #include <algorithm>
 #include <cstring>
 #include <iostream>
@@ -170,6 +172,7 @@ bool Texture::createSampler(optix::Context context,
 
       // sRGB to linear conversions only apply to fetches form 8-bit unsigned integer data because the texture hardware does it only for that. 
       // The CUDA manual doesn't mention this. See OpenGL specs for EXT_texture_sRGB_decode. 
+      // Other types are linearized once during the download below.
       if (useSrgb && image->m_type == IL_UNSIGNED_BYTE)
       {
         if (m_readMode == RT_TEXTURE_READ_ELEMENT_TYPE)
@@ -253,6 +256,10 @@ bool Texture::createSampler(optix::Context context,
         {
           void *dst = m_buffer->map(indexFace, RT_BUFFER_MAP_WRITE_DISCARD);
           convert(dst, image->m_pixels, image->m_width * image->m_height * image->m_depth, hostEncoding);
+          if (useSrgb && image->m_type != IL_UNSIGNED_BYTE)
+          {
+            linearizeSrgb(dst, image->m_width * image->m_height * image->m_depth);
+          }
           m_buffer->unmap(indexFace);
         }
       }
@@ -278,6 +285,10 @@ bool Texture::createSampler(optix::Context context,
             dst += indexImage * image->m_width * image->m_height * getElementSize();
 
             convert(dst, image->m_pixels, image->m_width * image->m_height, hostEncoding); // 2D!
+            if (useSrgb && image->m_type != IL_UNSIGNED_BYTE)
+            {
+              linearizeSrgb(dst, image->m_width * image->m_height);
+            }
             m_buffer->unmap(indexFace);
           }
         }
@@ -293,6 +304,177 @@ bool Texture::createSampler(optix::Context context,
 }
 
 
+bool Texture::convertToRGBA8(const Picture* picture, std::vector<unsigned char>& rgba)
+{
+  const Image* source = (picture != nullptr) ? picture->getImageFace(0, 0) : nullptr;
+
+  if (source == nullptr || source->m_depth != 1 || picture->isCubemap())
+  {
+    return false;
+  }
+
+  const unsigned int hostEncoding = determineHostEncoding(source->m_format, source->m_type);
+  if (!determineDeviceEncoding(source->m_format, IL_UNSIGNED_BYTE)) // This sets m_encoding, m_readMode, and m_format.
+  {
+    return false;
+  }
+
+  rgba.resize(size_t(source->m_width) * source->m_height * 4);
+  convert(rgba.data(), source->m_pixels, size_t(source->m_width) * source->m_height, hostEncoding);
+  return true;
+}
+
+bool Texture::compress(const Picture* picture,
+                       BlockFormat format,
+                       const std::string& sourceFilename,
+                       CompressedImage& image,
+                       CompressionReport* report) // = nullptr
+{
+  const Image* source = (picture != nullptr) ? picture->getImageFace(0, 0) : nullptr;
+  if (source == nullptr || source->m_depth != 1 || picture->isCubemap())
+  {
+    std::cerr << "ERROR: compress() needs a 2D picture: " << sourceFilename << std::endl;
+    return false;
+  }
+
+  const unsigned int width  = source->m_width;
+  const unsigned int height = source->m_height;
+
+  // The cache is keyed by the requested format and stores the PSNR, a hit needs neither the RGBA8 texels nor a decode.
+  const std::string cacheFilename = compressedCacheFilename(sourceFilename, format);
+
+  double psnr = 0.0;
+  if (loadCompressedImage(cacheFilename, sourceFilename, format, image, &psnr) && image.m_width == width && image.m_height == height)
+  {
+    if (report != nullptr)
+    {
+      report->m_uncompressedBytes = size_t(width) * height * 4;
+      report->m_compressedBytes   = image.m_blocks.size();
+      report->m_psnr              = psnr;
+      report->m_seconds           = 0.0;
+      report->m_fromCache         = true;
+    }
+    return true;
+  }
+
+  // The encoders work on RGBA8 texels, which is what the uncompressed path creates for unsigned byte data.
+  std::vector<unsigned char> rgba;
+  if (!convertToRGBA8(picture, rgba))
+  {
+    std::cerr << "ERROR: compress() could not convert to RGBA8: " << sourceFilename << std::endl;
+    return false;
+  }
+
+  // BC1 has no usable alpha, keep cutouts intact with BC7.
+  BlockFormat encodedFormat = format;
+  if (format == BLOCK_FORMAT_BC1)
+  {
+    for (size_t i = 0; i < size_t(width) * height; ++i)
+    {
+      if (rgba[i * 4 + 3] != 255)
+      {
+        encodedFormat = BLOCK_FORMAT_BC7;
+        break;
+      }
+    }
+  }
+
+  // The PSNR is always measured, it goes into the cache file.
+  CompressionReport encodeReport;
+  if (!compressImage(rgba.data(), width, height, encodedFormat, image, &encodeReport))
+  {
+    std::cerr << "ERROR: compress() failed to encode " << sourceFilename << std::endl;
+    return false;
+  }
+  if (report != nullptr)
+  {
+    *report = encodeReport;
+  }
+
+  if (!saveCompressedImage(cacheFilename, sourceFilename, image, encodeReport.m_psnr))
+  {
+    std::cerr << "WARNING: compress() could not write cache file " << cacheFilename << std::endl;
+  }
+  return true;
+}
+
+bool Texture::createSamplerCompressed(optix::Context context,
+                                      const Picture* picture,
+                                      BlockFormat format,
+                                      const std::string& sourceFilename,
+                                      bool useSrgb,               // = false
+                                      CompressionReport* report) // = nullptr
+{
+  CompressedImage image;
+
+  if (!compress(picture, format, sourceFilename, image, report))
+  {
+    return false;
+  }
+
+  m_width  = image.m_width;
+  m_height = image.m_height;
+  m_depth  = 1;
+
+  try
+  {
+    m_sampler = context->createTextureSampler();
+
+    // DAR FIXME Add user control over the wrap modes.
+    m_sampler->setWrapMode(0, RT_WRAP_REPEAT);
+    m_sampler->setWrapMode(1, RT_WRAP_REPEAT);
+    m_sampler->setWrapMode(2, RT_WRAP_REPEAT);
+    m_sampler->setFilteringModes(RT_FILTER_LINEAR, RT_FILTER_LINEAR, RT_FILTER_NONE);
+
+    m_indexMode = RT_TEXTURE_INDEX_NORMALIZED_COORDINATES;
+    m_sampler->setIndexingMode(m_indexMode);
+
+    // The texture units decode sRGB for block compressed formats as well.
+    m_readMode = (useSrgb) ? RT_TEXTURE_READ_NORMALIZED_FLOAT_SRGB : RT_TEXTURE_READ_NORMALIZED_FLOAT;
+
+#if OPTIX_VERSION >= 60000
+    switch (image.m_format)
+    {
+      case BLOCK_FORMAT_BC1:
+        m_format = RT_FORMAT_BC1;
+        break;
+      case BLOCK_FORMAT_BC4:
+        m_format = RT_FORMAT_BC4;
+        break;
+      default:
+        m_format = RT_FORMAT_BC7;
+        break;
+    }
+
+    // Buffers with block compressed formats are sized in blocks. One element is one 4x4 block.
+    m_buffer = context->createBuffer(RT_BUFFER_INPUT, m_format, image.m_blocksX, image.m_blocksY);
+
+    void* dst = m_buffer->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
+    memcpy(dst, image.m_blocks.data(), image.m_blocks.size());
+    m_buffer->unmap(0);
+#else
+    // Block compressed buffer formats need OptiX 6.0.0. Decode on the host instead.
+    // That still skips the encoding work on the next run, but the device holds RGBA8 data.
+    m_format = RT_FORMAT_UNSIGNED_BYTE4;
+    m_buffer = context->createBuffer(RT_BUFFER_INPUT, m_format, m_width, m_height);
+
+    void* dst = m_buffer->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
+    decompressImage(image, static_cast<unsigned char*>(dst));
+    m_buffer->unmap(0);
+#endif
+
+    m_sampler->setReadMode(m_readMode);
+    m_sampler->setMaxAnisotropy(1.0f);
+    m_sampler->setBuffer(m_buffer);
+  }
+  catch(optix::Exception& e)
+  {
+    std::cerr << e.getErrorString() << std::endl;
+    return false;
+  }
+  return true;
+}
+
 // Use with standard texture sampler declarations.
 optix::TextureSampler Texture::getSampler() const
 {
@@ -539,6 +721,13 @@ size_t Texture::getElementSize() const
     return sizeof(unsigned int) * 3;
   case RT_FORMAT_UNSIGNED_INT4:
     return sizeof(unsigned int) * 4;
+#if OPTIX_VERSION >= 60000
+  case RT_FORMAT_BC1:
+  case RT_FORMAT_BC4:
+    return 8;  // Per 4x4 block.
+  case RT_FORMAT_BC7:
+    return 16; // Per 4x4 block.
+#endif
   case RT_FORMAT_UNKNOWN:
   case RT_FORMAT_USER:
   default:
@@ -547,6 +736,56 @@ size_t Texture::getElementSize() const
   }
 }
 
+size_t Texture::getDeviceSize() const
+{
+  if (!m_buffer)
+  {
+    return 0;
+  }
+
+  RTsize width  = 1;
+  RTsize height = 1;
+  RTsize depth  = 1;
+  switch (m_buffer->getDimensionality())
+  {
+    case 1:
+      m_buffer->getSize(width);
+      break;
+    case 2:
+      m_buffer->getSize(width, height);
+      break;
+    default:
+      m_buffer->getSize(width, height, depth);
+      break;
+  }
+  return size_t(width * height * depth) * m_buffer->getElementSize();
+}
+
+void Texture::destroy()
+{
+  if (m_sampler)
+  {
+    m_sampler->destroy();
+    m_sampler = nullptr;
+  }
+  if (m_buffer)
+  {
+    m_buffer->destroy();
+    m_buffer = nullptr;
+  }
+  if (m_bufferCDF_U)
+  {
+    m_bufferCDF_U->destroy();
+    m_bufferCDF_U = nullptr;
+  }
+  if (m_bufferCDF_V)
+  {
+    m_bufferCDF_V->destroy();
+    m_bufferCDF_V = nullptr;
+  }
+}
+
+
 
 template<typename T> 
 T getAlphaOne()
@@ -927,6 +1166,42 @@ void Texture::convert(void *dst, const void *src, size_t elements, unsigned int
   }
 }
 
+// Apply the sRGB decoding to converted texels of types the texture hardware can't decode.
+// All device encodings have four channels, see determineDeviceEncoding().
+void Texture::linearizeSrgb(void* dst, size_t elements) const
+{
+  switch ((m_encoding >> ENC_TYPE_SHIFT) & ENC_MASK)
+  {
+    case (ENC_TYPE_UNSIGNED_SHORT >> ENC_TYPE_SHIFT):
+    {
+      unsigned short* texels = static_cast<unsigned short*>(dst);
+      for (size_t i = 0; i < elements * 4; ++i)
+      {
+        if ((i & 3) != 3)
+        {
+          texels[i] = static_cast<unsigned short>(sutil::srgbToLinear(float(texels[i]) / 65535.0f) * 65535.0f + 0.5f);
+        }
+      }
+      break;
+    }
+    case (ENC_TYPE_FLOAT >> ENC_TYPE_SHIFT):
+    {
+      float* texels = static_cast<float*>(dst);
+      for (size_t i = 0; i < elements * 4; ++i)
+      {
+        if ((i & 3) != 3)
+        {
+          texels[i] = sutil::srgbToLinear(texels[i]);
+        }
+      }
+      break;
+    }
+    default:
+      std::cerr << "WARNING: linearizeSrgb() unsupported texel type, data stays sRGB encoded." << std::endl;
+      break;
+  }
+}
+
 // The following functions are used to build the data needed for an importance sampled spherical HDR environment map. 
 // DAR FIXME Put this into a separate class derived from Texture.
 
@@ -35,6 +35,7 @@
 #include <optix.h>
 #include <optixu/optixpp_namespace.h>
 
+#include "BlockCompression.h"
 #include "Picture.h"
 
 #include <string>
@@ -120,15 +121,34 @@ public:
 
   bool createSampler(optix::Context context,
                      const Picture* picture,
-                     bool useSrgb         = false,  // Affects the read mode. Only applied to unsigned byte formats!
+                     bool useSrgb         = false,  // Affects the read mode of unsigned byte formats. Unsigned short and float texels are linearized on the host.
                      bool useMipmaps      = false,  // Affects the download of mipmaps. Default is to not download mipmaps.
                      bool useUnnormalized = false); // Affects the texture indexing. Default is normalized 2D coordinates.
 
+  // Expand LOD 0 of face 0 of a 2D picture to tightly packed RGBA8 texels. Returns false for 3D and cubemap pictures.
+  bool convertToRGBA8(const Picture* picture, std::vector<unsigned char>& rgba);
+
+  // Block compressed 2D textures. Only LOD 0 of face 0 is used.
+  // The encoded blocks are cached next to sourceFilename and reused while the source file is unchanged.
+  // BC1 requests switch to BC7 for pictures with non-opaque alpha.
+  bool compress(const Picture* picture,
+                BlockFormat format,
+                const std::string& sourceFilename,
+                CompressedImage& image,
+                CompressionReport* report = nullptr);
+  bool createSamplerCompressed(optix::Context context,
+                               const Picture* picture,
+                               BlockFormat format,
+                               const std::string& sourceFilename,
+                               bool useSrgb = false, // The blocks keep sRGB data, the sampler decodes it.
+                               CompressionReport* report = nullptr);
+
   void setWrapMode(RTwrapmode s, RTwrapmode t, RTwrapmode r);
 
   unsigned int determineHostEncoding(int format, int type) const;
   bool determineDeviceEncoding(int format, int type);
   void convert( void *dst, const void *src, size_t elements, unsigned int hostEncoding ) const;
+  void linearizeSrgb(void* dst, size_t elements) const; // In place on converted texels. Alpha stays unchanged.
 
   optix::TextureSampler getSampler() const;
   int getId() const; // Bindless texture ID.
@@ -136,6 +156,10 @@ public:
   unsigned int getWidth() const;
   unsigned int getHeight() const;
   size_t getElementSize() const;
+  size_t getDeviceSize() const; // Bytes of texel data in the buffer behind the sampler, LOD 0 only.
+
+  // Destroys the sampler and buffers. Copies share these objects, so only the last user may call this.
+  void destroy();
 
   // Special functions for spherical environment textures.
   void createEnvironment();                       // Creates a small white dummy environment.
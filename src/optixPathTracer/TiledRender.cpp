@@ -0,0 +1,232 @@
+#include "TiledRender.h"
+
+#include "Accumulation.h"
+#include "Renderer.h"
+
+#include <ImageWriter.h>
+#include <Profiler.h>
+#include <sutil.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+
+TiledRenderSettings::TiledRenderSettings()
+: m_tileSize(512)
+, m_passes(1)
+, m_frames(256)
+, m_png16(false)
+{
+}
+
+TiledRenderStats::TiledRenderStats()
+: m_seconds(0.0)
+, m_renderSeconds(0.0)
+, m_writeSeconds(0.0)
+, m_tileBytes(0)
+, m_stripBytes(0)
+, m_outputBytes(0)
+{
+}
+
+static bool seekFile(FILE* file, unsigned long long offset)
+{
+#if defined(_WIN32)
+  return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+  return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+// Accumulations of all tiles between round-robin passes, one fixed size record per tile.
+class TileScratchFile
+{
+public:
+  TileScratchFile()
+  : m_file(nullptr)
+  , m_tileBytes(0)
+  {
+  }
+
+  ~TileScratchFile()
+  {
+    if (m_file)
+    {
+      fclose(m_file);
+      remove(m_filename.c_str());
+    }
+  }
+
+  bool open(const std::string& filename, size_t tileBytes)
+  {
+    m_filename  = filename;
+    m_tileBytes = tileBytes;
+    m_file = fopen(filename.c_str(), "w+b");
+    if (!m_file)
+    {
+      std::cerr << "ERROR: renderTiled() cannot create " << filename << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  bool save(unsigned int tile, optix::Buffer buffer)
+  {
+    const bool written = seekFile(m_file, static_cast<unsigned long long>(tile) * m_tileBytes) &&
+                         fwrite(buffer->map(0, RT_BUFFER_MAP_READ), 1, m_tileBytes, m_file) == m_tileBytes;
+    buffer->unmap();
+    if (!written)
+    {
+      std::cerr << "ERROR: renderTiled() cannot write " << m_filename << std::endl;
+    }
+    return written;
+  }
+
+  bool load(unsigned int tile, optix::Buffer buffer)
+  {
+    fflush(m_file); // Switching from writing to reading.
+    const bool read = seekFile(m_file, static_cast<unsigned long long>(tile) * m_tileBytes) &&
+                      fread(buffer->map(0, RT_BUFFER_MAP_WRITE_DISCARD), 1, m_tileBytes, m_file) == m_tileBytes;
+    buffer->unmap();
+    if (!read)
+    {
+      std::cerr << "ERROR: renderTiled() cannot read " << m_filename << std::endl;
+    }
+    return read;
+  }
+
+private:
+  TileScratchFile(const TileScratchFile&);
+  TileScratchFile& operator=(const TileScratchFile&);
+
+  std::string m_filename;
+  FILE*       m_file;
+  size_t      m_tileBytes;
+};
+
+bool renderTiled(Session& session, const std::string& filename, const TiledRenderSettings& settings, TiledRenderStats& stats)
+{
+  const double startTime = sutil::currentTime();
+
+  const unsigned int width    = session.getWidth();
+  const unsigned int height   = session.getHeight();
+  const unsigned int tileSize = std::max(1u, settings.m_tileSize);
+  const unsigned int tilesX   = (width  + tileSize - 1) / tileSize;
+  const unsigned int tilesY   = (height + tileSize - 1) / tileSize;
+  const unsigned int frames   = std::max(1u, settings.m_frames);
+  const unsigned int passes   = std::max(1u, std::min(settings.m_passes, frames));
+
+  session.clearRegion();
+  session.setTileSize(tileSize, tileSize);
+
+  const size_t tilePixels = size_t(std::min(tileSize, width)) * std::min(tileSize, height);
+  const size_t tileAccumulationBytes = tilePixels * accumulationBytesPerPixel(session.getAccumulationFormat());
+  stats.m_tileBytes = tilePixels * 4 + tileAccumulationBytes;
+
+  TileScratchFile scratch;
+  if (1 < passes && !scratch.open(filename + ".tiles", tileAccumulationBytes))
+  {
+    return false;
+  }
+
+  std::vector<float>         strip;
+  std::vector<float>         mean;
+  std::vector<unsigned char> bgra;
+
+  for (unsigned int pass = 0; pass < passes; ++pass)
+  {
+    const unsigned int frameBegin = static_cast<unsigned int>(static_cast<unsigned long long>(frames) * pass / passes);
+    const unsigned int frameEnd   = static_cast<unsigned int>(static_cast<unsigned long long>(frames) * (pass + 1) / passes);
+
+    // Intermediate passes replace the previous image only once they are complete.
+    const std::string passFilename = (1 < passes) ? filename + ".tmp" : filename;
+    sutil::StreamingImageWriter writer;
+    if (!writer.open(passFilename, width, height, settings.m_png16))
+    {
+      return false;
+    }
+
+    // The file is written top down, the buffers count rows from the bottom.
+    for (unsigned int row = tilesY; row-- > 0; )
+    {
+      const unsigned int y0          = row * tileSize;
+      const unsigned int stripHeight = std::min(tileSize, height - y0);
+      strip.resize(size_t(width) * stripHeight * 4);
+
+      const double renderStart = sutil::currentTime();
+      for (unsigned int column = 0; column < tilesX; ++column)
+      {
+        const unsigned int x0   = column * tileSize;
+        const unsigned int tile = row * tilesX + column;
+        session.setTile(x0, y0);
+        if (0 < frameBegin)
+        {
+          if (!scratch.load(tile, session.getAccumulationBuffer()))
+          {
+            return false;
+          }
+          session.setFrame(frameBegin);
+        }
+        session.render(frameEnd - frameBegin);
+        if (pass + 1 < passes && !scratch.save(tile, session.getAccumulationBuffer()))
+        {
+          return false;
+        }
+
+        if (!session.readMean(mean))
+        {
+          return false;
+        }
+        const unsigned int tileWidth = session.getTileWidth();
+        for (unsigned int y = 0; y < stripHeight; ++y)
+        {
+          memcpy(&strip[(size_t(y) * width + x0) * 4], &mean[size_t(y) * tileWidth * 4], tileWidth * 4 * sizeof(float));
+        }
+      }
+      const double writeStart = sutil::currentTime();
+      stats.m_renderSeconds += writeStart - renderStart;
+
+      sutil::ProfileScope profile("write strip", passFilename);
+      bool written;
+      if (writer.takesFloat())
+      {
+        written = writer.writeLines(strip.data(), stripHeight, 4, true);
+      }
+      else
+      {
+        // The dither pattern lines up with an untiled render when the tile size is a multiple of 64.
+        bgra.resize(size_t(width) * stripHeight * 4);
+        sutil::toneMap(strip.data(), width, stripHeight, 4, settings.m_toneMap, bgra.data());
+        written = writer.writeLines(bgra.data(), stripHeight, true);
+      }
+      stats.m_writeSeconds += sutil::currentTime() - writeStart;
+      if (!written)
+      {
+        return false;
+      }
+      stats.m_stripBytes = std::max(stats.m_stripBytes, strip.capacity() * sizeof(float) + bgra.capacity() + mean.capacity() * sizeof(float));
+    }
+    if (!writer.close())
+    {
+      return false;
+    }
+    stats.m_outputBytes = writer.bytesWritten();
+
+    if (1 < passes)
+    {
+      remove(filename.c_str()); // rename() does not replace files on Windows.
+      if (rename(passFilename.c_str(), filename.c_str()) != 0)
+      {
+        std::cerr << "ERROR: renderTiled() cannot rename " << passFilename << " to " << filename << std::endl;
+        return false;
+      }
+      std::cerr << "Pass " << pass + 1 << " of " << passes << ": " << frameEnd << " samples per pixel in " << filename << std::endl;
+    }
+  }
+
+  stats.m_seconds = sutil::currentTime() - startTime;
+  return true;
+}
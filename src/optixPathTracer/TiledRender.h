@@ -0,0 +1,49 @@
+#pragma once
+
+#ifndef TILED_RENDER_H
+#define TILED_RENDER_H
+
+#include <ToneMap.h>
+
+#include <string>
+
+// Batch rendering of images too large for full-frame buffers.
+// The session renders one tile at a time into tile-sized buffers. A row of tiles is collected in a
+// host strip and streamed to the output file, which is written top down, so neither the device nor
+// the host ever holds more than one tile row of the image.
+//
+// With one pass every tile is accumulated to the full sample count before the next one starts.
+// With more passes the samples are split into round-robin passes over all tiles: the accumulations
+// of the tiles are kept in a scratch file (<output>.tiles) between passes and the complete image is
+// rewritten after each pass, so a coarse version of the whole image is available early.
+
+class Session;
+
+struct TiledRenderSettings
+{
+  TiledRenderSettings();
+
+  unsigned int           m_tileSize; // Square tiles, in pixels.
+  unsigned int           m_passes;
+  unsigned int           m_frames;   // Samples per pixel.
+  bool                   m_png16;    // .png files with 16 bits per channel from the accumulation.
+  sutil::ToneMapSettings m_toneMap;  // 8-bit output.
+};
+
+struct TiledRenderStats
+{
+  TiledRenderStats();
+
+  double             m_seconds;
+  double             m_renderSeconds; // Launches and accumulation readback.
+  double             m_writeSeconds;  // Tonemapping and encoding of the strips.
+  size_t             m_tileBytes;     // Output and accumulation buffers of one tile on the device.
+  size_t             m_stripBytes;    // Host memory of one tile row.
+  unsigned long long m_outputBytes;
+};
+
+// Renders the full image of the session's camera, a render region is cleared. The session stays tiled afterwards.
+// Returns false with a message on std::cerr when a file cannot be written.
+bool renderTiled(Session& session, const std::string& filename, const TiledRenderSettings& settings, TiledRenderStats& stats);
+
+#endif // TILED_RENDER_H
@@ -0,0 +1,146 @@
+#include "TiledTexture.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+
+// File layout: TiledTextureHeader, then the tiles of all mipmap levels, finest level first,
+// each level in row-major tile order. Every tile has tileSize * tileSize RGBA8 texels,
+// the texels outside of the level at the right and bottom border are zero.
+struct TiledTextureHeader
+{
+  char         m_magic[4];
+  unsigned int m_version;
+  unsigned int m_width;
+  unsigned int m_height;
+  unsigned int m_tileSize;
+  unsigned int m_numLevels;
+};
+
+static const unsigned int tiledTextureVersion = 1;
+
+static unsigned int numberOfLevels(unsigned int width, unsigned int height)
+{
+  unsigned int levels = 1;
+  while (1 < width || 1 < height)
+  {
+    width  = std::max(1u, width  >> 1);
+    height = std::max(1u, height >> 1);
+    ++levels;
+  }
+  return levels;
+}
+
+// 2x2 box filter. Odd sizes repeat the last row or column.
+static void downsample(const std::vector<unsigned char>& src, unsigned int width, unsigned int height,
+                       std::vector<unsigned char>& dst, unsigned int dstWidth, unsigned int dstHeight)
+{
+  dst.resize(size_t(dstWidth) * dstHeight * 4);
+
+  for (unsigned int y = 0; y < dstHeight; ++y)
+  {
+    const unsigned int y0 = std::min(y * 2,     height - 1);
+    const unsigned int y1 = std::min(y * 2 + 1, height - 1);
+    for (unsigned int x = 0; x < dstWidth; ++x)
+    {
+      const unsigned int x0 = std::min(x * 2,     width - 1);
+      const unsigned int x1 = std::min(x * 2 + 1, width - 1);
+
+      const unsigned char* a = &src[(size_t(y0) * width + x0) * 4];
+      const unsigned char* b = &src[(size_t(y0) * width + x1) * 4];
+      const unsigned char* c = &src[(size_t(y1) * width + x0) * 4];
+      const unsigned char* d = &src[(size_t(y1) * width + x1) * 4];
+
+      unsigned char* p = &dst[(size_t(y) * dstWidth + x) * 4];
+      for (unsigned int i = 0; i < 4; ++i)
+      {
+        p[i] = static_cast<unsigned char>((a[i] + b[i] + c[i] + d[i] + 2) >> 2);
+      }
+    }
+  }
+}
+
+bool writeTiledTexture(const std::string& filename, const unsigned char* rgba, unsigned int width, unsigned int height, unsigned int tileSize)
+{
+  if (rgba == nullptr || width == 0 || height == 0 || tileSize == 0)
+  {
+    std::cerr << "ERROR: writeTiledTexture() invalid arguments for " << filename << std::endl;
+    return false;
+  }
+
+  const std::string tempFilename = filename + ".tmp";
+
+  FILE* file = fopen(tempFilename.c_str(), "wb");
+  if (!file)
+  {
+    std::cerr << "ERROR: writeTiledTexture() cannot open " << tempFilename << std::endl;
+    return false;
+  }
+
+  TiledTextureHeader header;
+  memcpy(header.m_magic, "TTEX", 4);
+  header.m_version   = tiledTextureVersion;
+  header.m_width     = width;
+  header.m_height    = height;
+  header.m_tileSize  = tileSize;
+  header.m_numLevels = numberOfLevels(width, height);
+
+  bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+
+  // Only the current and the next level are held in memory.
+  std::vector<unsigned char> level(rgba, rgba + size_t(width) * height * 4);
+  std::vector<unsigned char> next;
+  std::vector<unsigned char> tile(size_t(tileSize) * tileSize * 4);
+
+  for (unsigned int l = 0; l < header.m_numLevels && success; ++l)
+  {
+    const unsigned int tilesX = (width  + tileSize - 1) / tileSize;
+    const unsigned int tilesY = (height + tileSize - 1) / tileSize;
+
+    for (unsigned int ty = 0; ty < tilesY && success; ++ty)
+    {
+      for (unsigned int tx = 0; tx < tilesX && success; ++tx)
+      {
+        std::fill(tile.begin(), tile.end(), static_cast<unsigned char>(0));
+
+        const unsigned int x0 = tx * tileSize;
+        const unsigned int y0 = ty * tileSize;
+        const unsigned int w  = std::min(tileSize, width  - x0);
+        const unsigned int h  = std::min(tileSize, height - y0);
+        for (unsigned int y = 0; y < h; ++y)
+        {
+          memcpy(&tile[size_t(y) * tileSize * 4], &level[(size_t(y0 + y) * width + x0) * 4], size_t(w) * 4);
+        }
+        success = fwrite(tile.data(), 1, tile.size(), file) == tile.size();
+      }
+    }
+
+    const unsigned int nextWidth  = std::max(1u, width  >> 1);
+    const unsigned int nextHeight = std::max(1u, height >> 1);
+    if (l + 1 < header.m_numLevels)
+    {
+      downsample(level, width, height, next, nextWidth, nextHeight);
+      level.swap(next);
+    }
+    width  = nextWidth;
+    height = nextHeight;
+  }
+
+  success = (fclose(file) == 0) && success;
+
+  if (success)
+  {
+    remove(filename.c_str()); // rename() does not replace existing files on Windows.
+    success = rename(tempFilename.c_str(), filename.c_str()) == 0;
+  }
+  if (!success)
+  {
+    std::cerr << "ERROR: writeTiledTexture() failed to write " << filename << std::endl;
+    remove(tempFilename.c_str());
+  }
+  return success;
+}
+
@@ -0,0 +1,16 @@
+#pragma once
+
+#ifndef TILED_TEXTURE_H
+#define TILED_TEXTURE_H
+
+#include <string>
+
+// Tiled texture files, an offline conversion.
+// A tiled texture file stores RGBA8 texels of a full mipmap chain in fixed size square tiles, for
+// out-of-core texture readers which page tiles in on demand. Rendering does not read them: OptiX samples
+// the whole textures from device memory. --tile-textures writes the files of a scene.
+
+// Write a tiled texture file with a box filtered mipmap chain. rgba holds width * height RGBA8 texels.
+bool writeTiledTexture(const std::string& filename, const unsigned char* rgba, unsigned int width, unsigned int height, unsigned int tileSize);
+
+#endif // TILED_TEXTURE_H
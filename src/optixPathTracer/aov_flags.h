@@ -0,0 +1,40 @@
+#pragma once
+
+#ifndef AOV_FLAGS_H
+#define AOV_FLAGS_H
+
+// Arbitrary output variables. Shared by the host and the ray generation program.
+// Every AOV except the samples has its own float4 buffer on the device, which only has the image size when
+// the AOV is requested; the samples are the w component of the float accumulation.
+enum AovIndex
+{
+  AOV_INDEX_DEPTH,    // Camera space depth of the first hit: sum over the hits in x, hits in y.
+  AOV_INDEX_NORMAL,   // First hit shading normal facing the camera, sum in xyz. Misses face the ray.
+  AOV_INDEX_ALBEDO,   // First hit base color, sum in xyz. Lights are white, misses black.
+  AOV_INDEX_MATERIAL, // Material index at the pixel center in x, -1 for lights, -2 for misses.
+  AOV_INDEX_DIRECT,   // Emission seen directly plus light reflected once, sum in xyz.
+  AOV_INDEX_INDIRECT, // The rest of the radiance, sum in xyz.
+  AOV_INDEX_VARIANCE, // Luminance of the samples: sum in x, sum of squares in y. Resolves to the variance of the pixel mean.
+  AOV_INDEX_COST,     // Rays in x, intersection tests in y, clock64() cycles of the paths in z, sums. Resolves to means per sample.
+  AOV_INDEX_SAMPLES,  // Samples per pixel of the accumulation.
+  AOV_COUNT
+};
+
+// One bit per AOV, for masks. The summed AOVs hold the sample count in w.
+enum AovFlag
+{
+  AOV_DEPTH    = 1 << AOV_INDEX_DEPTH,
+  AOV_NORMAL   = 1 << AOV_INDEX_NORMAL,
+  AOV_ALBEDO   = 1 << AOV_INDEX_ALBEDO,
+  AOV_MATERIAL = 1 << AOV_INDEX_MATERIAL,
+  AOV_DIRECT   = 1 << AOV_INDEX_DIRECT,
+  AOV_INDIRECT = 1 << AOV_INDEX_INDIRECT,
+  AOV_VARIANCE = 1 << AOV_INDEX_VARIANCE,
+  AOV_COST     = 1 << AOV_INDEX_COST,
+  AOV_SAMPLES  = 1 << AOV_INDEX_SAMPLES
+};
+
+// AOVs with a device buffer.
+#define AOV_DEVICE_MASK ( AOV_DEPTH | AOV_NORMAL | AOV_ALBEDO | AOV_MATERIAL | AOV_DIRECT | AOV_INDIRECT | AOV_VARIANCE | AOV_COST )
+
+#endif // AOV_FLAGS_H
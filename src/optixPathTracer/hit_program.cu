@@ -48,6 +48,7 @@ rtDeclareVariable( float3, texcoord, attribute texcoord, );
 rtDeclareVariable(Ray, ray, rtCurrentRay, );
 rtDeclareVariable(float, t_hit, rtIntersectionDistance, );
 rtDeclareVariable(PerRayData_radiance, prd, rtPayload, );
+rtDeclareVariable(PerRayData_radiance_hit, prd_hit, rtPayload, ); // Of the *_capture and *_stats programs.
 rtDeclareVariable(PerRayData_shadow, prd_shadow, rtPayload, );
 rtDeclareVariable(rtObject, top_object, , );
 rtDeclareVariable(float, scene_epsilon, , );
@@ -65,7 +66,43 @@ rtDeclareVariable(int, sysNumberOfLights, , );
 
 rtBuffer<LightParameter> sysLightParameters;
 
-RT_FUNCTION float3 DirectLight(MaterialParameter &mat, State &state)
+// Hit records of the *_capture (CAPTURE) and *_stats (STATS) programs. The plain payload has no room for them,
+// its overloads do nothing.
+template<bool CAPTURE, bool STATS>
+RT_FUNCTION void recordHit(PerRayData_radiance_hit &prd, const float3 &normal, const float3 &albedo, const float3 &emitted)
+{
+	if (CAPTURE)
+	{
+		prd.hitDistance = t_hit;
+		prd.hitNormal = normal;
+		prd.hitAlbedo = albedo;
+		prd.emitted = emitted;
+	}
+	if (CAPTURE || STATS)
+		prd.hitMaterial = materialId;
+	if (STATS)
+		prd.hitProgram = programId;
+}
+
+template<bool CAPTURE, bool STATS>
+RT_FUNCTION void recordHit(PerRayData_radiance &prd, const float3 &normal, const float3 &albedo, const float3 &emitted)
+{
+}
+
+template<bool STATS>
+RT_FUNCTION void countShadowRay(PerRayData_radiance_hit &prd)
+{
+	if (STATS)
+		prd.shadowRays++;
+}
+
+template<bool STATS>
+RT_FUNCTION void countShadowRay(PerRayData_radiance &prd)
+{
+}
+
+template<bool STATS, typename Payload>
+RT_FUNCTION float3 DirectLight(MaterialParameter &mat, State &state, Payload &prd)
 {
 	float3 L = make_float3(0.0f);
 
@@ -89,6 +126,7 @@ RT_FUNCTION float3 DirectLight(MaterialParameter &mat, State &state)
 
 	PerRayData_shadow prd_shadow;
 	prd_shadow.inShadow = false;
+	countShadowRay<STATS>(prd);
 	optix::Ray shadowRay = optix::make_Ray(surfacePos, lightDir, 1, scene_epsilon, lightDist - scene_epsilon);
 	rtTrace(top_object, shadowRay, prd_shadow);
 
@@ -108,7 +146,8 @@ RT_FUNCTION float3 DirectLight(MaterialParameter &mat, State &state)
 	return L;
 }
 
-RT_PROGRAM void closest_hit()
+template<bool CAPTURE, bool STATS, typename Payload>
+RT_FUNCTION void shade(Payload &prd)
 {
 	const float3 world_shading_normal = normalize(rtTransformNormal(RT_OBJECT_TO_WORLD, shading_normal));
 	const float3 world_geometric_normal = normalize( rtTransformNormal( RT_OBJECT_TO_WORLD, geometric_normal ) );
@@ -118,8 +157,8 @@ RT_PROGRAM void closest_hit()
 
 	if (mat.albedoID != RT_TEXTURE_ID_NULL)
 	{
-		const float3 texColor = make_float3(optix::rtTex2D<float4>(mat.albedoID, texcoord.x, texcoord.y));
-		mat.color = make_float3(powf(texColor.x, 2.2f), powf(texColor.y, 2.2f), powf(texColor.z, 2.2f));
+		// Albedo textures are linearized at load time (sRGB read mode or on the host), see Texture::createSampler().
+		mat.color = make_float3(optix::rtTex2D<float4>(mat.albedoID, texcoord.x, texcoord.y));
 	}
 
 	State state;
@@ -129,14 +168,16 @@ RT_PROGRAM void closest_hit()
 	state.ffnormal = ffnormal;
 	prd.wo = -ray.direction;
 
-	prd.radiance += mat.emission * prd.throughput;
+	const float3 emitted = mat.emission * prd.throughput;
+	prd.radiance += emitted;
+	recordHit<CAPTURE, STATS>(prd, ffnormal, mat.color, emitted);
 
 	//TODO: Clean up handling of specular bounces
 	prd.specularBounce = mat.brdf == GLASS? true : false;
 
 	// Direct light Sampling
 	if (!prd.specularBounce && prd.depth < max_depth)
-		prd.radiance += DirectLight(mat, state);
+		prd.radiance += DirectLight<STATS>(mat, state, prd);
 
 	// BRDF Sampling
 	sysBRDFSample[programId](mat, state, prd);
@@ -149,6 +190,28 @@ RT_PROGRAM void closest_hit()
 		prd.done = true;
 }
 
+// The plain program runs in launches without AOVs, reprojection and ray statistics. The others are selected by
+// Session::closestHitProgram() together with a ray generation program which traces PerRayData_radiance_hit.
+RT_PROGRAM void closest_hit()
+{
+	shade<false, false>(prd);
+}
+
+RT_PROGRAM void closest_hit_capture()
+{
+	shade<true, false>(prd_hit);
+}
+
+RT_PROGRAM void closest_hit_stats()
+{
+	shade<false, true>(prd_hit);
+}
+
+RT_PROGRAM void closest_hit_capture_stats()
+{
+	shade<true, true>(prd_hit);
+}
+
 RT_PROGRAM void any_hit()
 {
 	prd_shadow.inShadow = true;
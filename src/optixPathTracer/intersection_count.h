@@ -0,0 +1,20 @@
+#pragma once
+
+#ifndef INTERSECTION_COUNT_H
+#define INTERSECTION_COUNT_H
+
+#include <optix_world.h>
+
+// Cost AOV: intersection tests per launch index, the part of the traversal work the programs can observe.
+// Only the *_cost intersection programs count, the host selects them for sessions with AOV_COST.
+// All rays of a launch index are traced by its own thread, so the counter needs no atomics.
+
+rtDeclareVariable(optix::uint2, launch_index, rtLaunchIndex, );
+rtBuffer<unsigned int, 2>       intersection_count_buffer;
+
+static __device__ __inline__ void count_intersection()
+{
+  intersection_count_buffer[launch_index]++;
+}
+
+#endif // INTERSECTION_COUNT_H
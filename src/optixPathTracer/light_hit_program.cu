@@ -46,6 +46,7 @@ rtDeclareVariable(float3, back_hit_point, attribute back_hit_point, );
 rtDeclareVariable(Ray, ray, rtCurrentRay, );
 rtDeclareVariable(float, hit_dist, rtIntersectionDistance, );
 rtDeclareVariable(PerRayData_radiance, prd, rtPayload, );
+rtDeclareVariable(PerRayData_radiance_hit, prd_hit, rtPayload, ); // Of the *_capture and *_stats programs.
 rtDeclareVariable(PerRayData_shadow, prd_shadow, rtPayload, );
 rtDeclareVariable(rtObject, top_object, , );
 rtDeclareVariable(float, scene_epsilon, , );
@@ -53,7 +54,28 @@ rtDeclareVariable(float, scene_epsilon, , );
 rtBuffer<LightParameter> sysLightParameters;
 rtDeclareVariable(int, lightMaterialId, , );
 
-RT_PROGRAM void closest_hit()
+// Hit records of the *_capture (CAPTURE) and *_stats (STATS) programs, see hit_program.cu.
+template<bool CAPTURE, bool STATS>
+RT_FUNCTION void recordHit(PerRayData_radiance_hit &prd, const float3 &normal, const float3 &emitted)
+{
+	if (CAPTURE)
+	{
+		prd.hitDistance = hit_dist;
+		prd.hitNormal = normal;
+		prd.hitAlbedo = make_float3(1.0f);
+		prd.emitted = emitted;
+	}
+	if (CAPTURE || STATS)
+		prd.hitMaterial = -1;
+}
+
+template<bool CAPTURE, bool STATS>
+RT_FUNCTION void recordHit(PerRayData_radiance &prd, const float3 &normal, const float3 &emitted)
+{
+}
+
+template<bool CAPTURE, bool STATS, typename Payload>
+RT_FUNCTION void shade(Payload &prd)
 {
 	const float3 world_shading_normal = normalize(rtTransformNormal(RT_OBJECT_TO_WORLD, shading_normal));
 	const float3 world_geometric_normal = normalize( rtTransformNormal( RT_OBJECT_TO_WORLD, geometric_normal ) );
@@ -62,16 +84,40 @@ RT_PROGRAM void closest_hit()
 	LightParameter light = sysLightParameters[lightMaterialId];
 	float cosTheta = dot(-ray.direction, light.normal);
 
+	float3 emitted = make_float3(0.0f);
 	if ((light.lightType == QUAD && cosTheta > 0.0f) || light.lightType == SPHERE)
 	{
 		if(prd.depth == 0 || prd.specularBounce)
-			prd.radiance += light.emission * prd.throughput;
+			emitted = light.emission * prd.throughput;
 		else
 		{
 			float lightPdf = (hit_dist * hit_dist) / (light.area * clamp(cosTheta, 1.e-3f, 1.0f));
-			prd.radiance += powerHeuristic(prd.pdf, lightPdf) * prd.throughput * light.emission;
+			emitted = powerHeuristic(prd.pdf, lightPdf) * prd.throughput * light.emission;
 		}
+		prd.radiance += emitted;
 	}
+	recordHit<CAPTURE, STATS>(prd, ffnormal, emitted);
 
 	prd.done = true;
-}
\ No newline at end of file
+}
+
+// Variants like those of hit_program.cu.
+RT_PROGRAM void closest_hit()
+{
+	shade<false, false>(prd);
+}
+
+RT_PROGRAM void closest_hit_capture()
+{
+	shade<true, false>(prd_hit);
+}
+
+RT_PROGRAM void closest_hit_stats()
+{
+	shade<false, true>(prd_hit);
+}
+
+RT_PROGRAM void closest_hit_capture_stats()
+{
+	shade<true, true>(prd_hit);
+}
@@ -42,52 +42,47 @@
 #include <GLFW/glfw3.h>
 
 #include <optixu/optixpp_namespace.h>
-#include <optixu/optixu_aabb_namespace.h>
 #include <optixu/optixu_math_stream_namespace.h>
 
 #include <sutil.h>
-#include "commonStructs.h"
+#include "Renderer.h"
 #include "sceneLoader.h"
-#include "light_parameters.h"
-#include "properties.h"
+#include "BlockCompression.h"
+#include "TiledTexture.h"
+#include "Accumulation.h"
+#include "AdaptiveRender.h"
+#include "Aov.h"
+#include "Checkpoint.h"
+#include "CostHeatmap.h"
+#include "LruCache.h"
+#include "RenderServer.h"
+#include "TiledRender.h"
 #include <IL/il.h>
 #include <Camera.h>
-#include <OptiXMesh.h>
+#include <Denoise.h>
+#include <FrameWriter.h>
+#include <ImageWriter.h>
+#include <LocalSocket.h>
+#include <PartialImage.h>
+#include <Profiler.h>
+#include <ToneMap.h>
 
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_glfw.h>
 
+#include <algorithm>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <stdint.h>
 
 using namespace optix;
 
 const char* const SAMPLE_NAME = "optixPathTracer";
 
-const int NUMBER_OF_BRDF_INDICES = 3;
-const int NUMBER_OF_LIGHT_INDICES = 2;
-optix::Buffer m_bufferBRDFSample;
-optix::Buffer m_bufferBRDFEval;
-optix::Buffer m_bufferBRDFPdf;
-
-optix::Buffer m_bufferLightSample;
-optix::Buffer m_bufferMaterialParameters;
-optix::Buffer m_bufferLightParameters;
-
-double elapsedTime = 0;
-double lastTime = 0;
-
-//------------------------------------------------------------------------------
-//
-// Globals
-//
-//------------------------------------------------------------------------------
-Properties properties;
-Context      context = 0;
-Scene* scene;
-
 
 //------------------------------------------------------------------------------
 //
@@ -95,296 +90,105 @@ Scene* scene;
 //
 //------------------------------------------------------------------------------
 
-static std::string ptxPath( const std::string& cuda_file )
+// These files are written from the linear accumulation buffer instead of the 8-bit display buffer.
+static bool isFloatImageFile( const std::string& filename, bool png16 )
 {
-    return
-        std::string(sutil::samplesPTXDir()) +
-        "/" + std::string(SAMPLE_NAME) + "_generated_" +
-        cuda_file +
-        ".ptx";
+    const std::string suffix = filename.length() > 4 ? filename.substr( filename.length() - 4 ) : std::string();
+    return suffix == ".exr" || suffix == ".pfm" || ( png16 && suffix == ".png" );
 }
 
-optix::GeometryInstance createSphere(optix::Context context,
-	optix::Material material,
-	float3 center,
-	float radius)
+// Moves the rows of the rectangle (x, y, w, h) of an image with 4 floats per pixel to the front, in place.
+static void cropPixels( std::vector<float>& pixels, unsigned int width, unsigned int x, unsigned int y, unsigned int w, unsigned int h )
 {
-	optix::Geometry sphere = context->createGeometry();
-	sphere->setPrimitiveCount(1u);
-	const std::string ptx_path = ptxPath("sphere_intersect.cu");
-	sphere->setBoundingBoxProgram(context->createProgramFromPTXFile(ptx_path, "bounds"));
-	sphere->setIntersectionProgram(context->createProgramFromPTXFile(ptx_path, "sphere_intersect_robust"));
-
-	sphere["center"]->setFloat(center);
-	sphere["radius"]->setFloat(radius);
-
-	optix::GeometryInstance instance = context->createGeometryInstance(sphere, &material, &material + 1);
-	return instance;
+    for ( unsigned int row = 0; row < h; ++row )
+        memmove( &pixels[size_t( row ) * w * 4], &pixels[( size_t( y + row ) * width + x ) * 4], w * 4 * sizeof( float ) );
+    pixels.resize( size_t( w ) * h * 4 );
 }
 
-optix::GeometryInstance createQuad(optix::Context context,
-	optix::Material material,
-	float3 v1, float3 v2, float3 anchor, float3 n)
+// Sets the render region from a rectangle with rows counted from the top, like the window and the image files.
+// The rectangle is clipped to the image. Returns false when it lies outside.
+static bool setTopDownRegion( Session& session, unsigned int x, unsigned int y, unsigned int w, unsigned int h )
 {
-	optix::Geometry quad = context->createGeometry();
-	quad->setPrimitiveCount(1u);
-	const std::string ptx_path = ptxPath("quad_intersect.cu");
-	quad->setBoundingBoxProgram(context->createProgramFromPTXFile(ptx_path, "bounds"));
-	quad->setIntersectionProgram(context->createProgramFromPTXFile(ptx_path, "intersect"));
-
-	float3 normal = normalize(cross(v1, v2));
-	float4 plane = make_float4(normal, dot(normal, anchor));
-	v1 *= 1.0f / dot(v1, v1);
-	v2 *= 1.0f / dot(v2, v2);
-	quad["v1"]->setFloat(v1);
-	quad["v2"]->setFloat(v2);
-	quad["anchor"]->setFloat(anchor);
-	quad["plane"]->setFloat(plane);
-
-	optix::GeometryInstance instance = context->createGeometryInstance(quad, &material, &material + 1);
-	return instance;
+    const unsigned int width  = session.getWidth();
+    const unsigned int height = session.getHeight();
+    if ( x >= width || y >= height || !w || !h )
+        return false;
+    w = std::min( w, width - x );
+    h = std::min( h, height - y );
+    session.setRegion( x, height - y - h, w, h );
+    return true;
 }
 
-
-static Buffer getOutputBuffer()
+static void printCompressionReport( const std::string& filename, const CompressedImage& image, const CompressionReport& report )
 {
-    return context[ "output_buffer" ]->getBuffer();
+    std::cerr << "  " << blockFormatName( image.m_format ) << " " << image.m_width << "x" << image.m_height << ": "
+              << report.m_uncompressedBytes / 1024 << " KB -> " << report.m_compressedBytes / 1024 << " KB ("
+              << double( report.m_uncompressedBytes ) / double( report.m_compressedBytes ) << "x), PSNR "
+              << report.m_psnr << " dB, ";
+    if( report.m_fromCache )
+        std::cerr << "cached";
+    else
+        std::cerr << report.m_seconds << " s";
+    std::cerr << "  " << filename << std::endl;
 }
 
-void destroyContext()
+// Encode all textures of the scene into their block compression cache files without rendering.
+static void compressSceneTextures( const Scene& scene, BlockFormat format )
 {
-    if( context )
+    size_t uncompressed = 0;
+    size_t compressed   = 0;
+    for (int i = 0; i < scene.texture_map.size(); i++)
     {
-        context->destroy();
-        context = 0;
-    }
-}
-
-
-void createContext( bool use_pbo )
-{
-    // Set up context
-    context = Context::create();
-    context->setRayTypeCount( 2 );
-    context->setEntryPointCount( 1 );
-
-    // Note: this sample does not need a big stack size even with high ray depths, 
-    // because rays are not shot recursively.
-    context->setStackSize( 800 );
-
-    // Note: high max depth for reflection and refraction through glass
-    context["max_depth"]->setInt( 3 );
-    context["cutoff_color"]->setFloat( 0.0f, 0.0f, 0.0f );
-    context["frame"]->setUint( 0u );
-    context["scene_epsilon"]->setFloat( 1.e-3f );
-
-    Buffer buffer = sutil::createOutputBuffer( context, RT_FORMAT_UNSIGNED_BYTE4, scene->properties.width, scene->properties.height, use_pbo );
-    context["output_buffer"]->set( buffer );
-
-    // Accumulation buffer
-    Buffer accum_buffer = context->createBuffer( RT_BUFFER_INPUT_OUTPUT | RT_BUFFER_GPU_LOCAL,
-            RT_FORMAT_FLOAT4, scene->properties.width, scene->properties.height);
-    context["accum_buffer"]->set( accum_buffer );
-
-    // Ray generation program
-    std::string ptx_path( ptxPath( "path_trace_camera.cu" ) );
-    Program ray_gen_program = context->createProgramFromPTXFile( ptx_path, "pinhole_camera" );
-    context->setRayGenerationProgram( 0, ray_gen_program );
-
-    // Exception program
-    Program exception_program = context->createProgramFromPTXFile( ptx_path, "exception" );
-    context->setExceptionProgram( 0, exception_program );
-    context["bad_color"]->setFloat( 1.0f, 0.0f, 1.0f );
-
-    // Miss program
-    ptx_path = ptxPath( "background.cu" );
-    context->setMissProgram( 0, context->createProgramFromPTXFile( ptx_path, "miss" ) );
-	const std::string texture_filename = std::string(sutil::samplesDir()) + "/data/CedarCity.hdr";
-	context["envmap"]->setTextureSampler(sutil::loadTexture(context, texture_filename, optix::make_float3(1.0f)));
-
-	Program prg;
-	// BRDF sampling functions.
-	m_bufferBRDFSample = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_PROGRAM_ID, NUMBER_OF_BRDF_INDICES);
-	int* brdfSample = (int*) m_bufferBRDFSample->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
-	prg = context->createProgramFromPTXFile(ptxPath("disney.cu"), "Sample");
-	brdfSample[0] = prg->getId();
-	prg = context->createProgramFromPTXFile(ptxPath("glass.cu"), "Sample");
-	brdfSample[1] = prg->getId();
-	prg = context->createProgramFromPTXFile(ptxPath("lambert.cu"), "Sample");
-	brdfSample[2] = prg->getId();
-	m_bufferBRDFSample->unmap();
-	context["sysBRDFSample"]->setBuffer(m_bufferBRDFSample);
-	
-	// BRDF Eval functions.
-	m_bufferBRDFEval = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_PROGRAM_ID, NUMBER_OF_BRDF_INDICES);
-	int* brdfEval = (int*) m_bufferBRDFEval->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
-	prg = context->createProgramFromPTXFile(ptxPath("disney.cu"), "Eval");
-	brdfEval[0] = prg->getId();
-	prg = context->createProgramFromPTXFile(ptxPath("glass.cu"), "Eval");
-	brdfEval[1] = prg->getId();
-	prg = context->createProgramFromPTXFile(ptxPath("lambert.cu"), "Eval");
-	brdfEval[2] = prg->getId();
-	m_bufferBRDFEval->unmap();
-	context["sysBRDFEval"]->setBuffer(m_bufferBRDFEval);
-	
-	// BRDF Pdf functions.
-	m_bufferBRDFPdf = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_PROGRAM_ID, NUMBER_OF_BRDF_INDICES);
-	int* brdfPdf = (int*) m_bufferBRDFPdf->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
-	prg = context->createProgramFromPTXFile(ptxPath("disney.cu"), "Pdf");
-	brdfPdf[0] = prg->getId();
-	prg = context->createProgramFromPTXFile(ptxPath("glass.cu"), "Pdf");
-	brdfPdf[1] = prg->getId();
-	prg = context->createProgramFromPTXFile(ptxPath("lambert.cu"), "Pdf");
-	brdfPdf[2] = prg->getId();
-	m_bufferBRDFPdf->unmap();
-	context["sysBRDFPdf"]->setBuffer(m_bufferBRDFPdf);
-
-	// Light sampling functions.
-	m_bufferLightSample = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_PROGRAM_ID, NUMBER_OF_LIGHT_INDICES);
-	int* lightsample = (int*)m_bufferLightSample->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
-	prg = context->createProgramFromPTXFile(ptxPath("light_sample.cu"), "sphere_sample");
-	lightsample[0] = prg->getId();
-	prg = context->createProgramFromPTXFile(ptxPath("light_sample.cu"), "quad_sample");
-	lightsample[1] = prg->getId();
-	m_bufferLightSample->unmap();
-	context["sysLightSample"]->setBuffer(m_bufferLightSample);
-}
-
-Material createMaterial(const MaterialParameter &mat, int index)
-{
-	const std::string ptx_path = ptxPath( "hit_program.cu" );
-	Program ch_program = context->createProgramFromPTXFile( ptx_path, "closest_hit" );
-	Program ah_program = context->createProgramFromPTXFile(ptx_path, "any_hit");
-	
-	Material material = context->createMaterial();
-	material->setClosestHitProgram( 0, ch_program );
-	material->setAnyHitProgram(1, ah_program);
-	
-	material["materialId"]->setInt(index);
-	material["programId"]->setInt(mat.brdf);
-
-	return material;
-}
-
-Material createLightMaterial(const LightParameter &mat, int index)
-{
-	const std::string ptx_path = ptxPath("light_hit_program.cu");
-	Program ch_program = context->createProgramFromPTXFile(ptx_path, "closest_hit");
-
-	Material material = context->createMaterial();
-	material->setClosestHitProgram(0, ch_program);
-
-	material["lightMaterialId"]->setInt(index);
+        const std::string textureFilename = std::string(sutil::samplesDir()) + "/data/" + scene.texture_map.at(i);
 
-	return material;
-}
-
-void updateMaterialParameters(const std::vector<MaterialParameter> &materials)
-{
-	MaterialParameter* dst = static_cast<MaterialParameter*>(m_bufferMaterialParameters->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
-	for (size_t i = 0; i < materials.size(); ++i, ++dst) {
-		MaterialParameter mat = materials[i];
-		
-		dst->color = mat.color;
-		dst->emission = mat.emission;
-		dst->metallic = mat.metallic;
-		dst->subsurface = mat.subsurface;
-		dst->specular = mat.specular;
-		dst->specularTint = mat.specularTint;
-		dst->roughness = mat.roughness;
-		dst->anisotropic = mat.anisotropic;
-		dst->sheen = mat.sheen;
-		dst->sheenTint = mat.sheenTint;
-		dst->clearcoat = mat.clearcoat;
-		dst->clearcoatGloss = mat.clearcoatGloss;
-		dst->brdf = mat.brdf;
-		dst->albedoID = mat.albedoID;
-	}
-	m_bufferMaterialParameters->unmap();
-}
+        Picture picture;
+        if ( !picture.load( textureFilename ) )
+            continue;
 
-void updateLightParameters(const std::vector<LightParameter> &lightParameters)
-{
-	LightParameter* dst = static_cast<LightParameter*>(m_bufferLightParameters->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
-	for (size_t i = 0; i < lightParameters.size(); ++i, ++dst) {
-		LightParameter mat = lightParameters[i];
-
-		dst->position = mat.position;
-		dst->emission = mat.emission;
-		dst->radius = mat.radius;
-		dst->area = mat.area;
-		dst->u = mat.u;
-		dst->v = mat.v;
-		dst->normal = mat.normal;
-		dst->lightType = mat.lightType;
-	}
-	m_bufferLightParameters->unmap();
+        Texture tex;
+        CompressedImage image;
+        CompressionReport report;
+        if ( tex.compress( &picture, format, textureFilename, image, &report ) )
+        {
+            printCompressionReport( textureFilename, image, report );
+            uncompressed += report.m_uncompressedBytes;
+            compressed   += report.m_compressedBytes;
+        }
+    }
+    if ( compressed )
+    {
+        std::cerr << "Total: " << uncompressed / 1024 << " KB -> " << compressed / 1024 << " KB ("
+                  << double( uncompressed ) / double( compressed ) << "x)" << std::endl;
+    }
 }
 
-optix::Aabb createGeometry(
-        // output: this is a Group with two GeometryGroup children, for toggling visibility later
-        optix::Group& top_group
-        )
+// Standalone tool: convert all textures of the scene into tiled files next to their sources without rendering.
+// Only one source picture is resident at a time. Renders do not read the tiled files.
+static void tileSceneTextures( const Scene& scene, unsigned int tileSize )
 {
-
-    const std::string ptx_path = ptxPath( "triangle_mesh.cu" );
-
-    top_group = context->createGroup();
-    top_group->setAcceleration( context->createAcceleration( "Trbvh" ) );
-
-    int num_triangles = 0;
-	size_t i,j;
-    optix::Aabb aabb;
+    for (int i = 0; i < scene.texture_map.size(); i++)
     {
-        GeometryGroup geometry_group = context->createGeometryGroup();
-        geometry_group->setAcceleration( context->createAcceleration( "Trbvh" ) );
-        top_group->addChild( geometry_group );
-		
-        for (i = 0,j=0; i < scene->mesh_names.size(); ++i,++j) {
-            OptiXMesh mesh;
-            mesh.context = context;
-            
-            // override defaults
-            mesh.intersection = context->createProgramFromPTXFile( ptx_path, "mesh_intersect_refine" );
-            mesh.bounds = context->createProgramFromPTXFile( ptx_path, "mesh_bounds" );
-            mesh.material = createMaterial(scene->materials[i], i);
-
-            loadMesh( scene->mesh_names[i], mesh, scene->transforms[i] ); 
-            geometry_group->addChild( mesh.geom_instance );
-
-            aabb.include( mesh.bbox_min, mesh.bbox_max );
-
-            std::cerr << scene->mesh_names[i] << ": " << mesh.num_triangles << std::endl;
-            num_triangles += mesh.num_triangles;
-        }
-        std::cerr << "Total triangle count: " << num_triangles << std::endl;
-    }
-	//Lights
-	{
-		GeometryGroup geometry_group = context->createGeometryGroup();
-		geometry_group->setAcceleration(context->createAcceleration("NoAccel"));
-		top_group->addChild(geometry_group);
-		
-		for (i = 0; i < scene->lights.size(); ++i)
-		{
-			GeometryInstance instance;
-			if (scene->lights[i].lightType == QUAD)
-				instance = createQuad(context, createLightMaterial(scene->lights[i], i), scene->lights[i].u, scene->lights[i].v, scene->lights[i].position, scene->lights[i].normal);
-			else if (scene->lights[i].lightType == SPHERE)
-				instance = createSphere(context, createLightMaterial(scene->lights[i], i), scene->lights[i].position, scene->lights[i].radius);
-			geometry_group->addChild(instance);
-		}
-		//GeometryInstance instance = createSphere(context, createMaterial(materials[j], j), optix::make_float3(150, 80, 120), 80);
-		//geometry_group->addChild(instance);
-	}
-
-	
+        const std::string textureFilename = std::string(sutil::samplesDir()) + "/data/" + scene.texture_map.at(i);
+        const std::string tiledFilename   = textureFilename + ".tiles";
 
-    context[ "top_object" ]->set( top_group ); 
+        std::vector<unsigned char> rgba;
+        unsigned int width  = 0;
+        unsigned int height = 0;
+        {
+            Picture picture;
+            Texture tex;
+            if ( !picture.load( textureFilename ) || !tex.convertToRGBA8( &picture, rgba ) )
+                continue;
+            width  = picture.getImageFace( 0, 0 )->m_width;
+            height = picture.getImageFace( 0, 0 )->m_height;
+        }
 
-    return aabb;
+        if ( writeTiledTexture( tiledFilename, rgba.data(), width, height, tileSize ) )
+            std::cerr << "  " << width << "x" << height << " -> " << tiledFilename << std::endl;
+    }
 }
 
+
 //------------------------------------------------------------------------------
 //
 //  GLFW callbacks
@@ -393,8 +197,7 @@ optix::Aabb createGeometry(
 
 struct CallbackData
 {
-    sutil::Camera& camera;
-    unsigned int& accumulation_frame;
+    Session& session;
 };
 
 void keyCallback( GLFWwindow* window, int key, int scancode, int action, int mods )
@@ -403,30 +206,40 @@ void keyCallback( GLFWwindow* window, int key, int scancode, int action, int mod
 
     if( action == GLFW_PRESS )
     {
+        CallbackData* cb = static_cast<CallbackData*>( glfwGetWindowUserPointer( window ) );
         switch( key )
         {
             case GLFW_KEY_Q:
             case GLFW_KEY_ESCAPE:
-                if( context )
-                    context->destroy();
-                if( window )
-                    glfwDestroyWindow( window );
-                glfwTerminate();
-                exit(EXIT_SUCCESS);
+                // glfwRun() returns and the session is destroyed before the window.
+                glfwSetWindowShouldClose( window, GLFW_TRUE );
+                handled = true;
+                break;
 
             case( GLFW_KEY_S ):
             {
+                if( !cb )
+                    break;
                 const std::string outputImage = std::string(SAMPLE_NAME) + ".png";
                 std::cerr << "Saving current frame to '" << outputImage << "'\n";
-                sutil::writeBufferToFile( outputImage.c_str(), getOutputBuffer() );
+                sutil::writeBufferToFile( outputImage.c_str(), cb->session.getOutputBuffer() );
                 handled = true;
                 break;
             }
             case( GLFW_KEY_F ):
             {
-               CallbackData* cb = static_cast<CallbackData*>( glfwGetWindowUserPointer( window ) );
-               cb->camera.reset_lookat();
-               cb->accumulation_frame = 0;
+               if( !cb )
+                   break;
+               cb->session.getCamera().reset_lookat();
+               cb->session.reprojectAccumulation();
+               handled = true;
+               break;
+            }
+            case( GLFW_KEY_R ):
+            {
+               if( !cb )
+                   break;
+               cb->session.clearRegion();
                handled = true;
                break;
             }
@@ -447,12 +260,9 @@ void windowSizeCallback( GLFWwindow* window, int w, int h )
     const unsigned height = (unsigned)h;
 
     CallbackData* cb = static_cast<CallbackData*>( glfwGetWindowUserPointer( window ) );
-    if ( cb->camera.resize( width, height ) ) {
-        cb->accumulation_frame = 0;
-    }
-
-    sutil::resizeBuffer( getOutputBuffer(), width, height );
-    sutil::resizeBuffer( context[ "accum_buffer" ]->getBuffer(), width, height );
+    if ( !cb )
+        return;
+    cb->session.resize( width, height );
 
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
@@ -463,10 +273,30 @@ void windowSizeCallback( GLFWwindow* window, int w, int h )
 
 //------------------------------------------------------------------------------
 //
-// GLFW setup and run 
+// GLFW setup and run
 //
 //------------------------------------------------------------------------------
 
+// Outline of the render region over the image, in the [0,1] projection set up by glfwRun().
+static void displayRegionGL( const Session& session )
+{
+    unsigned int x, y, w, h;
+    session.getRegion( x, y, w, h );
+    const float x0 = float( x ) / session.getWidth();
+    const float y0 = float( y ) / session.getHeight();
+    const float x1 = float( x + w ) / session.getWidth();
+    const float y1 = float( y + h ) / session.getHeight();
+
+    glColor3f( 1.0f, 0.8f, 0.0f );
+    glBegin( GL_LINE_LOOP );
+    glVertex2f( x0, y0 );
+    glVertex2f( x1, y0 );
+    glVertex2f( x1, y1 );
+    glVertex2f( x0, y1 );
+    glEnd();
+    glColor3f( 1.0f, 1.0f, 1.0f );
+}
+
 GLFWwindow* glfwInitialize( )
 {
     GLFWwindow* window = sutil::initGLFW();
@@ -474,51 +304,102 @@ GLFWwindow* glfwInitialize( )
     // Note: this overrides imgui key callback with our own.  We'll chain this.
     glfwSetKeyCallback( window, keyCallback );
 
-    glfwSetWindowSize( window, (int)scene->properties.width, (int)scene->properties.height);
     glfwSetWindowSizeCallback( window, windowSizeCallback );
 
     return window;
 }
 
 
-void glfwRun( GLFWwindow* window, sutil::Camera& camera, const optix::Group top_group )
+// Preview scale for the next moving frame. Halving the scale quadruples the launch size, the margins keep
+// the scale from alternating between two sizes.
+static unsigned int adaptPreviewScale( unsigned int scale, double frame_time, double target_frame_time )
+{
+    const unsigned int max_scale = 8;
+    if ( frame_time > target_frame_time && scale < max_scale )
+        return scale * 2;
+    if ( frame_time * 4.0 < target_frame_time * 0.75 && 1 < scale )
+        return scale / 2;
+    return scale;
+}
+
+// target_frame_time > 0: while the camera or the settings change, frames render at the preview scale which
+// meets the target. Once nothing changed for a moment the accumulation restarts at full resolution.
+// Sessions with reprojection keep full resolution, camera moves reuse the accumulated samples instead.
+// Sessions with readable features can show the accumulation denoised on the host, denoise sets the initial state.
+void glfwRun( GLFWwindow* window, Session& session, sutil::ToneMapSettings& tonemap_settings, double target_frame_time, bool denoise )
 {
+    // Expose user data for access in GLFW callback functions when the window is resized, etc.
+    // This avoids having to make it global.
+    CallbackData cb = { session };
+    glfwSetWindowUserPointer( window, &cb );
+    glfwSetWindowSize( window, (int)session.getWidth(), (int)session.getHeight() );
+
     // Initialize GL state
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
     glOrtho(0, 1, 0, 1, -1, 1 );
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
-    glViewport(0, 0, scene->properties.width, scene->properties.height);
+    glViewport(0, 0, session.getWidth(), session.getHeight());
 
     unsigned int frame_count = 0;
-    unsigned int accumulation_frame = 0;
-    float transmittance_log_scale = 0.0f;
     int max_depth = 3;
-	lastTime = sutil::currentTime();
-
-    // Expose user data for access in GLFW callback functions when the window is resized, etc.
-    // This avoids having to make it global.
-    CallbackData cb = { camera, accumulation_frame };
-    glfwSetWindowUserPointer( window, &cb );
+    bool region_drag = false;
+    double drag_x = 0.0;
+    double drag_y = 0.0;
+    unsigned int drag_region[4] = { 0, 0, 0, 0 };
+    const double settle_time = 0.25;
+    unsigned int preview_scale = 2;
+    double last_change = 0.0;
+    double frame_time = 0.0;
+    double denoise_time = 0.0;
+    double elapsed_time = 0.0;
+    double last_time = sutil::currentTime();
+    std::vector<float> mean;
+    std::vector<float> albedo;
+    std::vector<float> normal;
+    std::vector<unsigned char> pixels;
+    RayStats ray_rates; // Counters of the last half second of launches.
 
     while( !glfwWindowShouldClose( window ) )
     {
 
-        glfwPollEvents();                                                        
+        glfwPollEvents();
 
         ImGui_ImplGlfw_NewFrame();
 
         ImGuiIO& io = ImGui::GetIO();
-        
+
         // Let imgui process the mouse first
         if (!io.WantCaptureMouse) {
 
             double x, y;
             glfwGetCursorPos( window, &x, &y );
 
-            if ( camera.process_mouse( (float)x, (float)y, ImGui::IsMouseDown(0), ImGui::IsMouseDown(1), ImGui::IsMouseDown(2) ) ) {
-                accumulation_frame = 0;
+            // Shift and left drag selects the render region instead of rotating the camera.
+            const bool shift = glfwGetKey( window, GLFW_KEY_LEFT_SHIFT ) == GLFW_PRESS || glfwGetKey( window, GLFW_KEY_RIGHT_SHIFT ) == GLFW_PRESS;
+            if ( ImGui::IsMouseDown(0) && ( region_drag || shift ) ) {
+                if ( !region_drag ) {
+                    region_drag = true;
+                    drag_x = x;
+                    drag_y = y;
+                    std::fill( drag_region, drag_region + 4, 0u );
+                }
+                const unsigned int x0 = static_cast<unsigned int>( std::max( 0.0, std::min( drag_x, x ) ) );
+                const unsigned int y0 = static_cast<unsigned int>( std::max( 0.0, std::min( drag_y, y ) ) );
+                const unsigned int rect[4] = { x0, y0,
+                                               static_cast<unsigned int>( std::max( 0.0, std::max( drag_x, x ) ) ) + 1 - x0,
+                                               static_cast<unsigned int>( std::max( 0.0, std::max( drag_y, y ) ) ) + 1 - y0 };
+                // Only a changed region restarts the accumulation.
+                if ( !std::equal( rect, rect + 4, drag_region ) ) {
+                    std::copy( rect, rect + 4, drag_region );
+                    setTopDownRegion( session, rect[0], rect[1], rect[2], rect[3] );
+                }
+            } else {
+                region_drag = false;
+                if ( session.getCamera().process_mouse( (float)x, (float)y, ImGui::IsMouseDown(0), ImGui::IsMouseDown(1), ImGui::IsMouseDown(2) ) ) {
+                    session.reprojectAccumulation();
+                }
             }
         }
 
@@ -527,12 +408,12 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, const optix::Group top_
         ImGui::PushStyleVar(ImGuiStyleVar_Alpha,          0.6f        );
         ImGui::PushStyleVar(ImGuiStyleVar_WindowRounding, 2.0f        );
 
-		
+
         sutil::displayFps( frame_count++ );
-		sutil::displaySpp( accumulation_frame );
+		sutil::displaySpp( session.getFrame() );
 
         {
-            static const ImGuiWindowFlags window_flags = 
+            static const ImGuiWindowFlags window_flags =
                     ImGuiWindowFlags_NoTitleBar |
                     ImGuiWindowFlags_AlwaysAutoResize |
                     ImGuiWindowFlags_NoMove |
@@ -542,36 +423,270 @@ void glfwRun( GLFWwindow* window, sutil::Camera& camera, const optix::Group top_
             ImGui::Begin("controls", 0, window_flags );
             if ( ImGui::CollapsingHeader( "Controls", ImGuiTreeNodeFlags_DefaultOpen ) ) {
                 if (ImGui::SliderInt( "max depth", &max_depth, 1, 10 )) {
-                    context["max_depth"]->setInt( max_depth );
-                    accumulation_frame = 0;
+                    session.setMaxDepth( max_depth );
                 }
+                int tonemap_operator = tonemap_settings.op;
+                if (ImGui::Combo( "tonemap", &tonemap_operator, "linear\0reinhard\0aces\0filmic\0" )) {
+                    tonemap_settings.op = static_cast<sutil::ToneMapOperator>( tonemap_operator );
+                    session.setToneMapSettings( tonemap_settings );
+                }
+                if (ImGui::SliderFloat( "exposure", &tonemap_settings.exposure, -8.0f, 8.0f )) {
+                    session.setToneMapSettings( tonemap_settings );
+                }
+                if (ImGui::Checkbox( "dither", &tonemap_settings.dither )) {
+                    session.setToneMapSettings( tonemap_settings );
+                }
+                if ( session.hasFeatures() ) {
+                    ImGui::Checkbox( "denoise", &denoise );
+                    if ( denoise )
+                        ImGui::Text( "denoise %.1f ms", denoise_time * 1000.0 );
+                }
+                const unsigned int scale = session.getPreviewScale();
+                ImGui::Text( "resolution 1/%u, %.1f ms", scale * scale, frame_time * 1000.0 );
+                if ( session.hasReprojection() ) {
+                    const double pixels = double( session.getWidth() ) * session.getHeight();
+                    ImGui::Text( "reprojection kept %.1f spp, %.0f%% of pixels", session.getReprojectedSamples() / pixels,
+                                 100.0 * session.getReprojectedPixels() / pixels );
+                }
+            }
+            if ( sutil::profilingEnabled() && ImGui::CollapsingHeader( "Profile", ImGuiTreeNodeFlags_DefaultOpen ) ) {
+                const std::vector<sutil::ProfileStat> stats = sutil::profileStats();
+                for ( size_t i = 0; i < stats.size(); ++i ) {
+                    const sutil::ProfileStat& stat = stats[i];
+                    ImGui::Text( "%-30s %9.2f ms last %9.2f ms mean %8llu x", stat.name.c_str(), stat.lastSeconds * 1000.0,
+                                 stat.totalSeconds * 1000.0 / stat.count, stat.count );
+                }
+            }
+            if ( session.hasRayStats() && ImGui::CollapsingHeader( "Rays", ImGuiTreeNodeFlags_DefaultOpen ) ) {
+                const char* const names[3] = { "primary", "bounce", "shadow" };
+                for ( int i = 0; i < 3; ++i )
+                    ImGui::Text( "%-8s %8.1f Mrays/s", names[i], ray_rates.rate( ray_rates.m_counters[RAY_COUNTER_PRIMARY + i] ) * 1e-6 );
+                ImGui::Text( "%-8s %8.1f Mrays/s", "total", ray_rates.rate( ray_rates.rays() ) * 1e-6 );
             }
             ImGui::End();
         }
 
-		elapsedTime += sutil::currentTime() - lastTime;
-		if (accumulation_frame == 0)
-			elapsedTime = 0;
-		sutil::displayElapsedTime(elapsedTime);
-		lastTime = sutil::currentTime();
+		elapsed_time += sutil::currentTime() - last_time;
+		if (session.getFrame() == 0)
+			elapsed_time = 0;
+		sutil::displayElapsedTime(elapsed_time);
+		last_time = sutil::currentTime();
 
         // imgui pops
         ImGui::PopStyleVar( 3 );
 
+        // Every frame after the first one of an accumulation adds to it, frame 0 means something changed.
+        const double frame_start = sutil::currentTime();
+        const bool changed = session.getFrame() == 0;
+        if ( changed )
+            last_change = frame_start;
+        const bool moving = target_frame_time > 0.0 && !session.hasReprojection() && frame_start - last_change < settle_time;
+        if ( moving && changed )
+            session.setPreviewScale( preview_scale );
+        else if ( !moving )
+            session.setPreviewScale( 1 );
+
         // Render main window
-        context["frame"]->setUint( accumulation_frame++ );
-        context->launch( 0, camera.width(), camera.height() );
-        sutil::displayBufferGL( getOutputBuffer() );
+        session.render( 1 );
+        if ( session.hasRayStats() && session.getRayStats().m_seconds >= 0.5 ) {
+            ray_rates = session.getRayStats();
+            session.resetRayStats();
+        }
+        if ( denoise && session.hasFeatures() ) {
+            // The denoiser runs on the host at full resolution, the preview scale does not make it faster.
+            const double denoise_start = sutil::currentTime();
+            if ( session.readMean( mean ) && session.readFeatures( albedo, normal ) ) {
+                sutil::denoise( mean.data(), albedo.data(), normal.data(), session.getWidth(), session.getHeight(), sutil::DenoiseSettings(), mean.data() );
+                pixels.resize( mean.size() );
+                sutil::toneMap( mean.data(), session.getWidth(), session.getHeight(), 4, tonemap_settings, pixels.data() );
+                sutil::displayImageGL( pixels.data(), session.getWidth(), session.getHeight() );
+            }
+            denoise_time = sutil::currentTime() - denoise_start;
+        } else {
+            session.toneMap();
+            sutil::displayBufferGL( session.getOutputBuffer() );
+            denoise_time = 0.0;
+        }
+        if ( session.hasRegion() )
+            displayRegionGL( session );
+
+        frame_time = sutil::currentTime() - frame_start;
+        if ( moving && changed )
+            preview_scale = adaptPreviewScale( preview_scale, frame_time - denoise_time, target_frame_time );
 
         // Render gui over it
         ImGui::Render();
 
         glfwSwapBuffers( window );
     }
-    
-    destroyContext();
-    glfwDestroyWindow( window );
-    glfwTerminate();
+
+    glfwSetWindowUserPointer( window, 0 );
+}
+
+
+//------------------------------------------------------------------------------
+//
+//  Render server
+//
+//------------------------------------------------------------------------------
+
+struct ServerStats
+{
+    unsigned int jobs;
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int evictions;
+};
+
+// Reply lines must not contain line breaks, OptiX error strings may.
+static std::string singleLine( std::string text )
+{
+    std::replace( text.begin(), text.end(), '\n', ' ' );
+    std::replace( text.begin(), text.end(), '\r', ' ' );
+    return text;
+}
+
+// Renders one job and returns the reply line. Setup covers scene loading (or the cache hit), buffer
+// resizing and camera; render covers the launches; write covers reading back, converting and saving
+// the image.
+static std::string renderJob( const Renderer& renderer, const RenderJob& job, LruCache<std::shared_ptr<Session> >& cache,
+                              const SessionSettings& settings, ServerStats& stats )
+{
+    const double setup_start = sutil::currentTime();
+
+    std::shared_ptr<Session> session;
+    std::shared_ptr<Session>* cached = cache.find( job.m_scene );
+    const bool hit = ( cached != nullptr );
+    if ( hit ) {
+        ++stats.hits;
+        session = *cached;
+    } else {
+        ++stats.misses;
+        session = renderer.createSession( job.m_scene, settings );
+        if ( !session )
+            return "error cannot load scene " + job.m_scene;
+    }
+
+    const Scene& scene = session->getScene();
+    const unsigned int width  = job.m_width  ? job.m_width  : scene.properties.width;
+    const unsigned int height = job.m_height ? job.m_height : scene.properties.height;
+    session->resize( width, height );
+
+    // A session holds its assets and the buffers of the last job's resolution. Evicted sessions destroy
+    // their contexts when the last reference goes.
+    const size_t bytes = session->getAssetBytes() + session->getBufferBytes();
+    const std::vector<std::shared_ptr<Session> > evicted = hit ? cache.setBytes( job.m_scene, bytes )
+                                                               : cache.insert( job.m_scene, session, bytes );
+    for ( size_t i = 0; i < evicted.size(); ++i ) {
+        std::cerr << "Evicting scene with " << ( evicted[i]->getAssetBytes() + evicted[i]->getBufferBytes() ) / 1024 << " KB" << std::endl;
+        ++stats.evictions;
+    }
+
+    // Without a camera in the job, the same view as the interactive viewer.
+    if ( job.m_camera ) {
+        session->setCamera( optix::make_float3( job.m_eye[0], job.m_eye[1], job.m_eye[2] ),
+                            optix::make_float3( job.m_lookat[0], job.m_lookat[1], job.m_lookat[2] ),
+                            optix::make_float3( job.m_up[0], job.m_up[1], job.m_up[2] ) );
+    } else {
+        session->setDefaultCamera();
+    }
+    session->resetAccumulation();
+
+    const double render_start = sutil::currentTime();
+    session->render( job.m_samples );
+
+    const double write_start = sutil::currentTime();
+    std::vector<float> mean;
+    if ( !session->readMean( mean ) )
+        return "error cannot read the accumulation";
+    if ( isFloatImageFile( job.m_output, false ) ) {
+        if ( !sutil::writeFloatImageToFile( job.m_output.c_str(), mean.data(), width, height, 4 ) )
+            return "error cannot write " + job.m_output;
+    } else {
+        std::vector<unsigned char> pixels( mean.size() );
+        sutil::toneMap( mean.data(), width, height, 4, job.m_toneMap, pixels.data() );
+        sutil::writeImageToFile( job.m_output.c_str(), pixels.data(), width, height, RT_FORMAT_UNSIGNED_BYTE4 );
+    }
+    const double end = sutil::currentTime();
+
+    ++stats.jobs;
+    std::ostringstream reply;
+    reply << "ok setup=" << render_start - setup_start << " render=" << write_start - render_start
+          << " write=" << end - write_start << " cache=" << ( hit ? "hit" : "miss" );
+    std::cerr << "Job " << stats.jobs << ": " << job.m_scene << " (" << ( hit ? "cached" : "loaded" ) << "), "
+              << width << "x" << height << ", " << job.m_samples << " spp -> " << job.m_output << ": setup "
+              << render_start - setup_start << " s, render " << write_start - render_start << " s, write "
+              << end - write_start << " s" << std::endl;
+    return reply.str();
+}
+
+// Serves requests (see RenderServer.h) on socket_path until a quit request. Connections are handled
+// one after the other, each may send any number of requests. Every scene keeps its own session, and
+// the least recently used sessions are destroyed when their textures, geometry and buffers exceed
+// cache_bytes. The sessions share the PTX read by the renderer.
+static int runServer( const Renderer& renderer, const std::string& socket_path, size_t cache_bytes,
+                      const SessionSettings& settings, const sutil::ToneMapSettings& tonemap_settings )
+{
+    const int server = sutil::listenLocalSocket( socket_path );
+    if ( server < 0 )
+        return 1;
+    std::cerr << "Listening on " << socket_path << ", scene cache " << cache_bytes / ( 1024 * 1024 ) << " MB" << std::endl;
+
+    LruCache<std::shared_ptr<Session> > cache( cache_bytes );
+    ServerStats stats = { 0, 0, 0, 0 };
+    bool quit = false;
+    while ( !quit ) {
+        const int client = sutil::acceptLocalSocket( server );
+        if ( client < 0 ) {
+            std::cerr << "ERROR: Cannot accept connections on " << socket_path << std::endl;
+            break;
+        }
+
+        std::string line;
+        while ( !quit && sutil::readLocalSocketLine( client, line ) ) {
+            const std::vector<std::string> fields = splitRequest( line );
+            if ( fields.empty() )
+                continue;
+
+            std::string reply;
+            if ( fields[0] == "render" ) {
+                RenderJob job;
+                job.m_toneMap = tonemap_settings;
+                std::string error;
+                if ( !parseRenderJob( std::vector<std::string>( fields.begin() + 1, fields.end() ), job, error ) ) {
+                    reply = "error " + error;
+                } else {
+                    try {
+                        reply = renderJob( renderer, job, cache, settings, stats );
+                    } catch ( const Exception& e ) {
+                        reply = "error " + singleLine( e.getErrorString() );
+                    } catch ( const std::exception& e ) {
+                        reply = "error " + singleLine( e.what() );
+                    }
+                }
+            } else if ( fields[0] == "stats" ) {
+                std::ostringstream out;
+                out << "ok jobs=" << stats.jobs << " hits=" << stats.hits << " misses=" << stats.misses
+                    << " evictions=" << stats.evictions << " scenes=" << cache.size()
+                    << " cache_mb=" << double( cache.bytes() ) / ( 1024 * 1024 ) << " budget_mb=" << cache.budget() / ( 1024 * 1024 );
+                reply = out.str();
+            } else if ( fields[0] == "quit" ) {
+                reply = "ok";
+                quit = true;
+            } else {
+                reply = "error unknown request '" + fields[0] + "'";
+            }
+            if ( reply.compare( 0, 5, "error" ) == 0 )
+                std::cerr << reply << std::endl;
+            sutil::writeLocalSocketLine( client, reply );
+        }
+        sutil::closeLocalSocket( client );
+    }
+
+    sutil::closeLocalSocket( server );
+    remove( socket_path.c_str() );
+    cache.clear();
+    return quit ? 0 : 1;
 }
 
 
@@ -588,12 +703,83 @@ void printUsageAndExit( const std::string& argv0 )
         "App Options:\n"
         "  -h | --help                  Print this usage message and exit.\n"
         "  -f | --file <output_file>    Save image to file and exit.\n"
+        "                               .exr (half, ZIP) and .pfm files hold the linear accumulation.\n"
+        "  --png16                      Save .png files with 16 bits per channel from the accumulation.\n"
+        "  --sequence <count>           With --file, render a turntable of <count> frames around the scene.\n"
+        "                               Frames are named after <output_file> (e.g. out_0000.png or out_%03d.png)\n"
+        "                               and written by background threads while the next frame renders.\n"
+        "  --accumulation <format>      float (default): sample sums and counts, 16 bytes per pixel.\n"
+        "                               rgb9e5: compact preview mean, 4 bytes per pixel, about 1% error.\n"
+        "  --tonemap <operator>         Display transform: linear, reinhard (default), aces or filmic.\n"
+        "  --exposure <stops>           Exposure applied before the tonemap operator (default 0).\n"
+        "  --no-dither                  Quantize 8-bit output without dithering.\n"
+        "  --resolution <w> <h>         Render at <w> x <h> instead of the resolution of the scene file.\n"
+        "  --region <x> <y> <w> <h>     Only render the <w> x <h> pixels with the upper left corner at <x>, <y>.\n"
+        "                               The rest of the image stays black (or unchanged in the window).\n"
+        "                               In the window, drag with shift and the left mouse button to select a region.\n"
+        "  --crop                       With --region and --file, save only the region.\n"
+        "  --tile <size>                With --file, render in tiles of <size> x <size> pixels and stream the image\n"
+        "                               to the file a row of tiles at a time. Memory is bounded by the tile size.\n"
+        "  --tile-passes <n>            With --tile, split the samples into <n> round-robin passes over all tiles\n"
+        "                               instead of finishing one tile after the other. The image is rewritten\n"
+        "                               after each pass, tile accumulations are kept in <output_file>.tiles.\n"
+        "  --spp <n>                    With --file, render <n> samples per pixel instead of 256.\n"
+        "  --sample-range <first> <n>   With --file, render only frames [first, first + n) of the 256 and write a\n"
+        "                               mergeable partial (sample sums and counts) to <output_file>.\n"
+        "                               Combine partials with optixMergePartials.\n"
+        "  --checkpoint-interval <s>    With --file, save the accumulation to <output_file>.ckpt every <s> seconds.\n"
+        "  --resume                     With --file, continue from <output_file>.ckpt when it matches the scene,\n"
+        "                               camera and settings. Checkpoints every 60 seconds unless set otherwise.\n"
+        "                               Checkpoints hold only the image, not with --aov, --denoise or --heatmap.\n"
+        "  --server <socket>            Run as a render server on a local socket without a window. Scenes stay\n"
+        "                               loaded between jobs. Send jobs with optixRenderClient.\n"
+        "  --server-cache <MB>          Texture, geometry and buffer memory of the scenes kept by --server\n"
+        "                               (default 2048). The least recently used scenes are unloaded first.\n"
+        "  --target-frame-time <ms>     While the camera moves, render at 1/4, 1/16 or 1/64 resolution as needed to\n"
+        "                               stay within <ms> per frame (default 33). 0 always renders full resolution.\n"
+        "  --reproject                  Keep the accumulated samples of surfaces which stay visible when the camera\n"
+        "                               moves, in the window and between the images of a --sequence. Only\n"
+        "                               disoccluded pixels start again. Needs float accumulation, replaces the\n"
+        "                               reduced resolution preview.\n"
+        "  --aov <list>                 With --file *.exr, add layers to the image: a comma separated list of depth (Z),\n"
+        "                               normal, albedo, material (index at the pixel center, -1 lights, -2 background),\n"
+        "                               direct, indirect, variance (of the mean luminance), cost (rays, intersection\n"
+        "                               tests and device cycles per sample), samples (per pixel) or all.\n"
+        "                               Needs float accumulation, without --sample-range and --tile.\n"
+        "  --time-budget <s>            With --file, render as many samples as fit into <s> seconds instead of 256,\n"
+        "                               predicted from the time per sample so far. Writes <output_file>.json with\n"
+        "                               the samples per pixel, the times and the estimated error.\n"
+        "  --target-rmse <e>            With --file, render until the estimated RMSE of the linear luminance falls\n"
+        "                               to <e>, from the variance of the samples. Also writes <output_file>.json.\n"
+        "                               Combined with --time-budget, whichever comes first. Needs float accumulation.\n"
+        "  --samples-per-launch <n>     With --file or --server, trace up to <n> samples per pixel in one launch\n"
+        "                               (default 1). Amortizes the launch overhead of small images, every sample\n"
+        "                               keeps its seed. Checkpoints are only written between launches.\n"
+        "  --denoise                    Denoise the image on the host with an edge-aware filter guided by the albedo\n"
+        "                               and normal of the first hits. In the window, the denoiser can be switched\n"
+        "                               off and on. Needs float accumulation, without --sample-range and --tile.\n"
+        "  --profile <trace.json>       Time the loading, the launches and the image output and write them as a\n"
+        "                               Chrome trace (chrome://tracing) at exit, with a summary on stderr.\n"
+        "                               The window shows the times as they are measured.\n"
+        "  --heatmap <name>             With --file, write where the render spends its time: <name>.png shows the\n"
+        "                               device cycles per sample in false colour, <name>.pfm holds the rays,\n"
+        "                               intersection tests and cycles per sample. Needs float accumulation, a single\n"
+        "                               image, without --sample-range and --tile.\n"
+        "  --ray-stats                  Count primary, bounce and shadow rays, path terminations, path lengths and\n"
+        "                               hits per BRDF program, printed with the rays/s after a --file render and\n"
+        "                               shown in the window. Slows the launches down. Needs float accumulation.\n"
         "  -n | --nopbo                 Disable GL interop for display buffer.\n"
 		"  -s | --scene                 Provide a scene file for rendering.\n"
+        "  --texture-compression <fmt>  Block compress albedo textures at load: none (default), bc1 or bc7.\n"
+        "                               bc1 falls back to bc7 for textures with alpha.\n"
+        "  --compress-textures          Encode the scene's textures into the compression cache and exit.\n"
+        "  --tile-textures <size>       Write the scene's textures as tiled mipmapped files (<texture>.tiles) and exit.\n"
+        "                               A standalone conversion, renders still load the source textures.\n"
         "App Keystrokes:\n"
         "  q  Quit\n"
         "  s  Save image to '" << SAMPLE_NAME << ".png'\n"
         "  f  Re-center camera\n"
+        "  r  Render the full image again after selecting a region\n"
         "\n"
         << std::endl;
 
@@ -601,11 +787,57 @@ void printUsageAndExit( const std::string& argv0 )
 }
 
 
+// Writes the trace and the summary of --profile however main returns.
+struct ProfileReport
+{
+    ~ProfileReport()
+    {
+        if ( m_traceFile.empty() )
+            return;
+        sutil::printProfileSummary( std::cerr );
+        if ( sutil::writeChromeTrace( m_traceFile ) )
+            std::cerr << "Wrote the profile to " << m_traceFile << std::endl;
+    }
+
+    std::string m_traceFile;
+};
+
+
 int main( int argc, char** argv )
 {
     bool use_pbo  = true;
     std::string scene_file;
 	std::string out_file;
+    BlockFormat texture_compression = BLOCK_FORMAT_NONE;
+    AccumulationFormat accumulation_format = ACCUMULATION_FLOAT;
+    sutil::ToneMapSettings tonemap_settings;
+    bool compress_textures_only = false;
+    bool png16 = false;
+    unsigned int tile_size = 0;
+    unsigned int sequence_length = 1;
+    double checkpoint_interval = 0.0;
+    unsigned int frame_begin = 0;
+    unsigned int frame_end = 256;
+    unsigned int spp = 0; // 0: frame_end.
+    bool partial_output = false;
+    bool resume = false;
+    std::string server_socket;
+    size_t server_cache = 2048;
+    unsigned int resolution_width = 0;
+    unsigned int resolution_height = 0;
+    unsigned int region[4] = { 0, 0, 0, 0 }; // x, y from the top, width, height
+    bool crop = false;
+    unsigned int render_tile_size = 0;
+    unsigned int render_tile_passes = 1;
+    double target_frame_time = 33.0;
+    bool reprojection = false;
+    bool denoise = false;
+    unsigned int aov_mask = 0;
+    unsigned int samples_per_launch = 1;
+    bool ray_stats = false;
+    std::string heatmap_file;
+    AdaptiveRenderSettings adaptive_settings;
+    ProfileReport profile_report;
     for( int i=1; i<argc; ++i )
     {
         const std::string arg( argv[i] );
@@ -636,6 +868,296 @@ int main( int argc, char** argv )
         {
             use_pbo = false;
         }
+        else if( arg == "--png16" )
+        {
+            png16 = true;
+        }
+        else if( arg == "--sample-range" )
+        {
+            if( i + 2 >= argc )
+            {
+                std::cerr << "Option '" << arg << "' requires two additional arguments.\n";
+                printUsageAndExit( argv[0] );
+            }
+            const int first = atoi( argv[++i] );
+            const int count = atoi( argv[++i] );
+            if( first < 0 || count <= 0 )
+            {
+                std::cerr << "Option '" << arg << "' requires a first frame >= 0 and a positive count.\n";
+                printUsageAndExit( argv[0] );
+            }
+            frame_begin = first;
+            frame_end = first + count;
+            partial_output = true;
+        }
+        else if( arg == "--spp" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            const int samples = atoi( argv[++i] );
+            if( samples <= 0 )
+            {
+                std::cerr << "Option '" << arg << "' requires a positive value.\n";
+                printUsageAndExit( argv[0] );
+            }
+            spp = static_cast<unsigned int>( samples );
+        }
+        else if( arg == "--resolution" )
+        {
+            if( i + 2 >= argc )
+            {
+                std::cerr << "Option '" << arg << "' requires two additional arguments.\n";
+                printUsageAndExit( argv[0] );
+            }
+            const int w = atoi( argv[++i] );
+            const int h = atoi( argv[++i] );
+            if( w <= 0 || h <= 0 )
+            {
+                std::cerr << "Option '" << arg << "' requires a positive width and height.\n";
+                printUsageAndExit( argv[0] );
+            }
+            resolution_width = w;
+            resolution_height = h;
+        }
+        else if( arg == "--region" )
+        {
+            if( i + 4 >= argc )
+            {
+                std::cerr << "Option '" << arg << "' requires four additional arguments.\n";
+                printUsageAndExit( argv[0] );
+            }
+            const int x = atoi( argv[++i] );
+            const int y = atoi( argv[++i] );
+            const int w = atoi( argv[++i] );
+            const int h = atoi( argv[++i] );
+            if( x < 0 || y < 0 || w <= 0 || h <= 0 )
+            {
+                std::cerr << "Option '" << arg << "' requires a corner >= 0 and a positive width and height.\n";
+                printUsageAndExit( argv[0] );
+            }
+            region[0] = x;
+            region[1] = y;
+            region[2] = w;
+            region[3] = h;
+        }
+        else if( arg == "--target-frame-time" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            target_frame_time = atof( argv[++i] );
+            if( target_frame_time < 0.0 )
+            {
+                std::cerr << "Option '" << arg << "' requires a value >= 0.\n";
+                printUsageAndExit( argv[0] );
+            }
+        }
+        else if( arg == "--profile" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            profile_report.m_traceFile = argv[++i];
+            sutil::setProfilingEnabled( true );
+        }
+        else if( arg == "--heatmap" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            heatmap_file = argv[++i];
+        }
+        else if( arg == "--ray-stats" )
+        {
+            ray_stats = true;
+        }
+        else if( arg == "--reproject" )
+        {
+            reprojection = true;
+        }
+        else if( arg == "--aov" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            if( !aovsFromNames( argv[++i], aov_mask ) )
+            {
+                std::cerr << "Option '" << arg << "' requires a list of AOV names.\n";
+                printUsageAndExit( argv[0] );
+            }
+        }
+        else if( arg == "--time-budget" || arg == "--target-rmse" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            const double value = atof( argv[++i] );
+            if( value <= 0.0 )
+            {
+                std::cerr << "Option '" << arg << "' requires a positive value.\n";
+                printUsageAndExit( argv[0] );
+            }
+            ( arg == "--time-budget" ? adaptive_settings.m_timeBudget : adaptive_settings.m_targetRmse ) = value;
+        }
+        else if( arg == "--samples-per-launch" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            const int samples = atoi( argv[++i] );
+            if( samples <= 0 )
+            {
+                std::cerr << "Option '" << arg << "' requires a positive value.\n";
+                printUsageAndExit( argv[0] );
+            }
+            samples_per_launch = static_cast<unsigned int>( samples );
+        }
+        else if( arg == "--denoise" )
+        {
+            denoise = true;
+        }
+        else if( arg == "--crop" )
+        {
+            crop = true;
+        }
+        else if( arg == "--checkpoint-interval" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            checkpoint_interval = atof( argv[++i] );
+            if( checkpoint_interval <= 0.0 )
+            {
+                std::cerr << "Option '" << arg << "' requires a positive value.\n";
+                printUsageAndExit( argv[0] );
+            }
+        }
+        else if( arg == "--resume" )
+        {
+            resume = true;
+        }
+        else if( arg == "--accumulation" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            if( !accumulationFormatFromName( argv[++i], accumulation_format ) )
+            {
+                std::cerr << "Unknown accumulation format '" << argv[i] << "'\n";
+                printUsageAndExit( argv[0] );
+            }
+        }
+        else if( arg == "--tonemap" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            if( !sutil::toneMapOperatorFromName( argv[++i], tonemap_settings.op ) )
+            {
+                std::cerr << "Unknown tonemap operator '" << argv[i] << "'\n";
+                printUsageAndExit( argv[0] );
+            }
+        }
+        else if( arg == "--exposure" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            tonemap_settings.exposure = static_cast<float>( atof( argv[++i] ) );
+        }
+        else if( arg == "--no-dither" )
+        {
+            tonemap_settings.dither = false;
+        }
+        else if( arg == "--texture-compression" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            const std::string format = argv[++i];
+            texture_compression = blockFormatFromName( format );
+            if( texture_compression == BLOCK_FORMAT_BC4 || ( texture_compression == BLOCK_FORMAT_NONE && format != "none" ) )
+            {
+                std::cerr << "Unsupported texture compression '" << format << "'\n";
+                printUsageAndExit( argv[0] );
+            }
+        }
+        else if( arg == "--compress-textures" )
+        {
+            compress_textures_only = true;
+        }
+        else if( arg == "--server" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            server_socket = argv[++i];
+        }
+        else if( arg == "--tile-textures" || arg == "--server-cache" ||
+                 arg == "--tile" || arg == "--tile-passes" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            const int value = atoi( argv[++i] );
+            if( value <= 0 )
+            {
+                std::cerr << "Option '" << arg << "' requires a positive value.\n";
+                printUsageAndExit( argv[0] );
+            }
+            if( arg == "--tile-textures" )
+                tile_size = value;
+            else if( arg == "--server-cache" )
+                server_cache = value;
+            else if( arg == "--tile" )
+                render_tile_size = value;
+            else
+                render_tile_passes = value;
+        }
+        else if( arg == "--sequence" )
+        {
+            if( i == argc-1 )
+            {
+                std::cerr << "Option '" << arg << "' requires additional argument.\n";
+                printUsageAndExit( argv[0] );
+            }
+            const int value = atoi( argv[++i] );
+            if( value <= 0 )
+            {
+                std::cerr << "Option '" << arg << "' requires a positive value.\n";
+                printUsageAndExit( argv[0] );
+            }
+            sequence_length = value;
+        }
         else if( arg[0] == '-' )
         {
             std::cerr << "Unknown option '" << arg << "'\n";
@@ -643,105 +1165,464 @@ int main( int argc, char** argv )
         }
     }
 
+    if( spp )
+    {
+        if( partial_output )
+        {
+            std::cerr << "Options '--spp' and '--sample-range' exclude each other.\n";
+            printUsageAndExit( argv[0] );
+        }
+        frame_end = spp;
+    }
+
+    if( partial_output && ( out_file.empty() || sequence_length != 1 || accumulation_format != ACCUMULATION_FLOAT ) )
+    {
+        std::cerr << "Option '--sample-range' needs --file, a single image and float accumulation.\n";
+        printUsageAndExit( argv[0] );
+    }
+
+    if( render_tile_size && ( out_file.empty() || sequence_length != 1 || partial_output || resume || checkpoint_interval > 0.0 ) )
+    {
+        std::cerr << "Option '--tile' needs --file and a single image, without --sample-range and checkpoints.\n";
+        printUsageAndExit( argv[0] );
+    }
+
+    if( region[2] && render_tile_size )
+    {
+        std::cerr << "Option '--region' cannot be combined with --tile.\n";
+        printUsageAndExit( argv[0] );
+    }
+
+    if( crop && ( !region[2] || out_file.empty() || partial_output ) )
+    {
+        std::cerr << "Option '--crop' needs --region and --file, without --sample-range.\n";
+        printUsageAndExit( argv[0] );
+    }
+
+    if( reprojection && ( accumulation_format != ACCUMULATION_FLOAT || partial_output || resume || checkpoint_interval > 0.0 || render_tile_size ) )
+    {
+        std::cerr << "Option '--reproject' needs float accumulation, without --sample-range, checkpoints and --tile.\n";
+        printUsageAndExit( argv[0] );
+    }
+
+    // Checkpoints hold only the accumulation, the AOV, feature and cost buffers of a resumed render would be missing.
+    if( denoise && ( accumulation_format != ACCUMULATION_FLOAT || partial_output || render_tile_size || !server_socket.empty() ||
+                     resume || checkpoint_interval > 0.0 ) )
+    {
+        std::cerr << "Option '--denoise' needs float accumulation, without --sample-range, --tile, --server and checkpoints.\n";
+        printUsageAndExit( argv[0] );
+    }
+
+    if( aov_mask && ( out_file.length() < 4 || out_file.substr( out_file.length() - 4 ) != ".exr" || accumulation_format != ACCUMULATION_FLOAT ||
+                      partial_output || render_tile_size || resume || checkpoint_interval > 0.0 ) )
+    {
+        std::cerr << "Option '--aov' needs --file with an .exr image and float accumulation, without --sample-range, --tile and\n"
+                     "checkpoints.\n";
+        printUsageAndExit( argv[0] );
+    }
+
+    if( !heatmap_file.empty() && ( out_file.empty() || sequence_length != 1 || accumulation_format != ACCUMULATION_FLOAT ||
+                                   partial_output || render_tile_size || resume || checkpoint_interval > 0.0 ) )
+    {
+        std::cerr << "Option '--heatmap' needs --file, a single image and float accumulation, without --sample-range, --tile and\n"
+                     "checkpoints.\n";
+        printUsageAndExit( argv[0] );
+    }
+
+    const bool adaptive = adaptive_settings.m_timeBudget > 0.0 || adaptive_settings.m_targetRmse > 0.0;
+    if( adaptive && ( out_file.empty() || sequence_length != 1 || accumulation_format != ACCUMULATION_FLOAT || partial_output ||
+                      render_tile_size || resume || checkpoint_interval > 0.0 ) )
+    {
+        std::cerr << "Options '--time-budget' and '--target-rmse' need --file, a single image and float accumulation, without\n"
+                     "--sample-range, --tile and checkpoints.\n";
+        printUsageAndExit( argv[0] );
+    }
+
+    if( ray_stats && ( accumulation_format != ACCUMULATION_FLOAT || !server_socket.empty() ) )
+    {
+        std::cerr << "Option '--ray-stats' needs float accumulation and does not apply to --server.\n";
+        printUsageAndExit( argv[0] );
+    }
+
+    if( render_tile_passes != 1 && !render_tile_size )
+    {
+        std::cerr << "Option '--tile-passes' needs --tile.\n";
+        printUsageAndExit( argv[0] );
+    }
+
+    if( !server_socket.empty() && !out_file.empty() )
+    {
+        std::cerr << "Option '--server' takes the output files from the jobs, not from --file.\n";
+        printUsageAndExit( argv[0] );
+    }
+
     try
     {
+		Renderer renderer;
+
+		SessionSettings settings;
+		settings.m_width              = resolution_width;
+		settings.m_height             = resolution_height;
+		settings.m_accumulation       = accumulation_format;
+		settings.m_textureCompression = texture_compression;
+		settings.m_reprojection       = reprojection;
+		settings.m_aovs               = aov_mask | ( denoise ? AOV_ALBEDO | AOV_NORMAL : 0 ) | ( adaptive ? AOV_VARIANCE : 0 ) |
+		                                ( heatmap_file.empty() ? 0 : AOV_COST );
+		settings.m_samplesPerLaunch   = samples_per_launch;
+		settings.m_rayStats           = ray_stats;
+
+		if (!server_socket.empty())
+		{
+			settings.m_readableAccumulation = true; // Every job reads the accumulation back.
+			return runServer(renderer, server_socket, server_cache * 1024 * 1024, settings, tonemap_settings);
+		}
+
 		if (scene_file.empty())
 		{
 			// Default scene
 			scene_file = sutil::samplesDir() + std::string("/data/cornell.scene");
-			scene = LoadScene(scene_file.c_str());
 		}
-		else
+
+		if (compress_textures_only || tile_size)
 		{
-			scene = LoadScene(scene_file.c_str());
+			std::unique_ptr<Scene> scene = LoadScene(scene_file.c_str());
+			if (!scene)
+				return 1;
+			if (compress_textures_only)
+				compressSceneTextures(*scene, texture_compression != BLOCK_FORMAT_NONE ? texture_compression : BLOCK_FORMAT_BC1);
+			else
+				tileSceneTextures(*scene, tile_size);
+			return 0;
 		}
 
-		GLFWwindow* window = glfwInitialize();
-
-		GLenum err = glewInit();
-        
-		if (err != GLEW_OK)
+		if ( out_file.empty() )
 		{
-			std::cerr << "GLEW init failed: " << glewGetErrorString( err ) << std::endl;
-			exit(EXIT_FAILURE);
-		}
+			GLFWwindow* window = glfwInitialize();
 
-		ilInit();
+			GLenum err = glewInit();
 
-		createContext(use_pbo);
+			if (err != GLEW_OK)
+			{
+				std::cerr << "GLEW init failed: " << glewGetErrorString( err ) << std::endl;
+				exit(EXIT_FAILURE);
+			}
 
-		// Load textures
-		for (int i = 0; i < scene->texture_map.size(); i++)
-		{
-			Texture tex;
-			Picture* picture = new Picture;
-			std::string textureFilename = std::string(sutil::samplesDir()) + "/data/" + scene->texture_map[i];
-			std::cout << textureFilename << std::endl;
-			picture->load(textureFilename);
-			tex.createSampler(context, picture);
-			scene->textures.push_back(tex);
-			delete picture;
+			settings.m_glInterop = use_pbo;
+			settings.m_readableAccumulation = denoise; // The denoiser reads the accumulation and the features every frame.
+			std::unique_ptr<Session> session = renderer.createSession(scene_file, settings);
+			if (!session)
+				return 1;
+			session->setToneMapSettings(tonemap_settings);
+			if (region[2] && !setTopDownRegion(*session, region[0], region[1], region[2], region[3]))
+			{
+				std::cerr << "ERROR: --region lies outside of the " << session->getWidth() << "x" << session->getHeight() << " image." << std::endl;
+				return 1;
+			}
+
+			glfwRun( window, *session, tonemap_settings, target_frame_time * 0.001, denoise );
+
+			// The output buffer may be a GL buffer, the context goes before the window.
+			session.reset();
+			glfwDestroyWindow( window );
+			glfwTerminate();
+			return 0;
 		}
 
-		// Set textures to albedo ID of materials
-		for (int i = 0; i < scene->materials.size(); i++)
+		// Batch output is converted on the host from the accumulation, no window is needed.
+		settings.m_readableAccumulation = true;
+
+		if (render_tile_size)
 		{
-			if(scene->materials[i].albedoID != RT_TEXTURE_ID_NULL)
+			settings.m_tileSize = render_tile_size; // The full size buffers are never allocated.
+			std::unique_ptr<Session> session = renderer.createSession(scene_file, settings);
+			if (!session)
+				return 1;
+
+			TiledRenderSettings tiled;
+			tiled.m_tileSize = render_tile_size;
+			tiled.m_passes   = render_tile_passes;
+			tiled.m_frames   = frame_end;
+			tiled.m_png16    = png16;
+			tiled.m_toneMap  = tonemap_settings;
+			TiledRenderStats stats;
+			if (!renderTiled(*session, out_file, tiled, stats))
+				return 1;
+
+			const double megapixels = double(session->getWidth()) * session->getHeight() * 1e-6;
+			std::cerr << "Wrote " << session->getWidth() << "x" << session->getHeight() << " in tiles of " << render_tile_size
+			          << " to " << out_file << " in " << stats.m_seconds << " s (render " << stats.m_renderSeconds
+			          << " s, write " << stats.m_writeSeconds << " s), " << megapixels / stats.m_seconds << " Mpixel/s" << std::endl;
+			std::cerr << "Device buffers " << stats.m_tileBytes / ( 1024.0 * 1024.0 ) << " MB per tile, host strip "
+			          << stats.m_stripBytes / ( 1024.0 * 1024.0 ) << " MB, peak resident " << sutil::peakMemoryUsage() / ( 1024.0 * 1024.0 )
+			          << " MB, file " << stats.m_outputBytes / ( 1024.0 * 1024.0 ) << " MB" << std::endl;
+			if (session->hasRayStats())
+				printRayStats(std::cerr, session->getRayStats());
+			return 0;
+		}
+		std::unique_ptr<Session> session = renderer.createSession(scene_file, settings);
+		if (!session)
+			return 1;
+		const unsigned int width  = session->getWidth();
+		const unsigned int height = session->getHeight();
+
+		// The pixels outside of a region keep the cleared accumulation and come out black.
+		unsigned int region_x = 0;
+		unsigned int region_y = 0;
+		unsigned int region_width = width;
+		unsigned int region_height = height;
+		if (region[2])
+		{
+			if (!setTopDownRegion(*session, region[0], region[1], region[2], region[3]))
 			{
-				scene->materials[i].albedoID = scene->textures[scene->materials[i].albedoID-1].getId();
+				std::cerr << "ERROR: --region lies outside of the " << width << "x" << height << " image." << std::endl;
+				return 1;
 			}
+			session->getRegion(region_x, region_y, region_width, region_height);
+			session->clearAccumulation();
 		}
-		
-		m_bufferLightParameters = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_USER);
-		m_bufferLightParameters->setElementSize(sizeof(LightParameter));
-		m_bufferLightParameters->setSize(scene->lights.size());
-		updateLightParameters(scene->lights);
-		context["sysLightParameters"]->setBuffer(m_bufferLightParameters);
-		
-		m_bufferMaterialParameters = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_USER);
-		m_bufferMaterialParameters->setElementSize(sizeof(MaterialParameter));
-		m_bufferMaterialParameters->setSize(scene->materials.size());
-		updateMaterialParameters(scene->materials);
-		context["sysMaterialParameters"]->setBuffer(m_bufferMaterialParameters);
-
-		context["sysNumberOfLights"]->setInt(scene->lights.size());
-        optix::Group top_group;
-		const optix::Aabb aabb = createGeometry(top_group);
-
-        context->validate();
-
-        const optix::float3 camera_eye( optix::make_float3( 0.0f, 1.5f*aabb.extent( 1 ), -1.5f*aabb.extent( 2 ) ) );
-		const optix::float3 camera_lookat(aabb.center());
-
-		//const optix::float3 camera_eye(optix::make_float3(278, 273, -800));
-		//const optix::float3 camera_lookat(optix::make_float3(278, 273, -799));
-		//const optix::float3 camera_eye(optix::make_float3(0,1,4.9));
-		//const optix::float3 camera_lookat(optix::make_float3(0,1,3));
-		
-        const optix::float3 camera_up( optix::make_float3( 0.0f, 1.0f, 0.0f ) );
-        sutil::Camera camera( scene->properties.width, scene->properties.height, 
-                &camera_eye.x, &camera_lookat.x, &camera_up.x,
-                context["eye"], context["U"], context["V"], context["W"] );
-
-        if ( out_file.empty() )
-        {
-            glfwRun( window, camera, top_group );
-        }
-        else
-        {
-            // Accumulate frames for anti-aliasing
-            const unsigned int numframes = 256;
-            std::cerr << "Accumulating " << numframes << " frames ..." << std::endl;
-            for ( unsigned int frame = 0; frame < numframes; ++frame ) {
-                context["frame"]->setUint( frame );
-                context->launch( 0, scene->properties.width, scene->properties.height );
-            }
-            sutil::writeBufferToFile( out_file.c_str(), getOutputBuffer() );
-            std::cerr << "Wrote " << out_file << std::endl;
-            destroyContext();
+		const unsigned int image_width  = crop ? region_width : width;
+		const unsigned int image_height = crop ? region_height : height;
+
+        {
+            // Accumulate frames [frame_begin, frame_end) for anti-aliasing
+            const bool float_image = isFloatImageFile( out_file, png16 );
+            double render_time = 0.0;
+            double rendered_samples = 0.0;
+            AdaptiveRenderStats adaptive_stats;
+            const double start_time = sutil::currentTime();
+
+            // Everything which changes the samples goes into the scene hash. Partials only merge with equal hashes.
+            unsigned long long scene_hash = checkpointHashSeed;
+            if ( !hashFile( scene_file, scene_hash ) )
+                scene_hash = hashBytes( scene_file.data(), scene_file.size() );
+            optix::float3 camera_eye;
+            optix::float3 camera_lookat;
+            optix::float3 camera_up;
+            session->getDefaultCamera( camera_eye, camera_lookat, camera_up );
+            const float camera_setup[9] = { camera_eye.x, camera_eye.y, camera_eye.z, camera_lookat.x, camera_lookat.y, camera_lookat.z,
+                                            camera_up.x, camera_up.y, camera_up.z };
+            const int hash_settings[3] = { settings.m_maxDepth, static_cast<int>( texture_compression ),
+                                           static_cast<int>( sequence_length ) };
+            scene_hash = hashBytes( camera_setup, sizeof( camera_setup ), scene_hash );
+            scene_hash = hashBytes( hash_settings, sizeof( hash_settings ), scene_hash );
+            if ( session->hasRegion() ) {
+                const unsigned int hash_region[4] = { region_x, region_y, region_width, region_height };
+                scene_hash = hashBytes( hash_region, sizeof( hash_region ), scene_hash );
+            }
+
+            // A checkpoint also belongs to one frame range.
+            CheckpointState checkpoint;
+            checkpoint.m_width  = width;
+            checkpoint.m_height = height;
+            checkpoint.m_format = accumulation_format;
+            const unsigned int frame_range[3] = { frame_begin, frame_end, 1 /* checkpoint layout */ };
+            checkpoint.m_hash = hashBytes( frame_range, sizeof( frame_range ), scene_hash );
+
+            const std::string checkpoint_file = out_file + ".ckpt";
+            const size_t accum_bytes = size_t( width ) * height * accumulationBytesPerPixel( accumulation_format );
+            unsigned int first_image = 0;
+            unsigned int first_frame = frame_begin;
+            if ( resume ) {
+                std::vector<unsigned char> data;
+                if ( loadCheckpoint( checkpoint_file, checkpoint, data ) && data.size() == accum_bytes ) {
+                    first_image = checkpoint.m_image;
+                    first_frame = checkpoint.m_frame;
+                    Buffer accum_buffer = session->getAccumulationBuffer();
+                    memcpy( accum_buffer->map( 0, RT_BUFFER_MAP_WRITE_DISCARD ), data.data(), data.size() );
+                    accum_buffer->unmap();
+                    std::cerr << "Resuming image " << first_image << " at frame " << first_frame << " from " << checkpoint_file << std::endl;
+                } else {
+                    std::cerr << "No usable checkpoint " << checkpoint_file << ", starting from the beginning." << std::endl;
+                }
+                if ( checkpoint_interval <= 0.0 )
+                    checkpoint_interval = 60.0;
+            }
+
+            // Checkpoint files are written in the background, the render thread only reads back the buffer.
+            std::unique_ptr<CheckpointWriter> checkpoints;
+            if ( checkpoint_interval > 0.0 )
+                checkpoints.reset( new CheckpointWriter( checkpoint_file ) );
+            unsigned int checkpoint_count = 0;
+            double checkpoint_time = 0.0;
+            double last_checkpoint = sutil::currentTime();
+
+            // Images are encoded in the background while the next one renders.
+            sutil::FrameWriter writer;
+            std::vector<float> mean;
+            std::vector<float> albedo;
+            std::vector<float> normal;
+            std::vector<unsigned char> pixels;
+            double denoise_time = 0.0;
+            std::vector<float> aovs[AOV_COUNT];
+            double aov_time = 0.0;
+            std::vector<float> cost;
+            CostHeatmapStats heatmap_stats;
+            unsigned int failed = 0;
+            for ( unsigned int image = 0; image < sequence_length; ++image ) {
+                const std::string filename = sequence_length > 1 ? sutil::FrameWriter::sequenceFilename( out_file, image ) : out_file;
+                // Images before a resumed one are skipped, but the camera takes the same steps to land on the same position.
+                if ( image > 0 )
+                    session->getCamera().orbit( 2.0f * M_PIf / sequence_length );
+                if ( image < first_image )
+                    continue;
+                // Reprojection carries the samples of the previous image over, the frames add to them.
+                if ( image > first_image )
+                    session->reprojectAccumulation();
+
+                // A resumed render skips the images before the checkpointed one, so a checkpoint may only be taken
+                // once the writer has saved them. Those of an earlier run were saved before its checkpoints.
+                bool previous_images_written = ( image == first_image );
+
+                const unsigned int start_frame = ( image == first_image ) ? first_frame : frame_begin;
+                if ( start_frame == frame_begin && frame_begin > 0 ) {
+                    // Frame 0 initializes the accumulation on the device, a later first frame adds to it.
+                    session->clearAccumulation();
+                }
+
+                const double render_start = sutil::currentTime();
+                unsigned int rendered_frames = frame_end - start_frame;
+                if ( adaptive ) {
+                    std::cerr << "Accumulating for " << filename << " until the time budget or the target RMSE is reached ..." << std::endl;
+                    if ( !renderAdaptive( *session, adaptive_settings, adaptive_stats ) )
+                        return 1;
+                    rendered_frames = adaptive_stats.m_frames;
+                } else {
+                    std::cerr << "Accumulating " << frame_end - start_frame << " frames for " << filename << " ..." << std::endl;
+                    session->setFrame( start_frame );
+                    for ( unsigned int frame = start_frame; frame < frame_end; ) {
+                        // One launch at a time, so the checkpoints can still be taken between them.
+                        const unsigned int samples = std::min( samples_per_launch, frame_end - frame );
+                        session->render( samples );
+                        frame += samples;
+
+                        if ( checkpoints && frame < frame_end && sutil::currentTime() - last_checkpoint >= checkpoint_interval ) {
+                            const double checkpoint_start = sutil::currentTime();
+                            if ( !previous_images_written ) {
+                                failed += writer.flush();
+                                previous_images_written = ( failed == 0 );
+                            }
+                            if ( !previous_images_written ) {
+                                // The checkpoint would skip a missing image, keep the previous one.
+                                last_checkpoint = sutil::currentTime();
+                                checkpoint_time += last_checkpoint - checkpoint_start;
+                                continue;
+                            }
+                            checkpoint.m_image = image;
+                            checkpoint.m_frame = frame;
+                            Buffer accum_buffer = session->getAccumulationBuffer();
+                            checkpoints->write( checkpoint, accum_buffer->map( 0, RT_BUFFER_MAP_READ ), accum_bytes );
+                            accum_buffer->unmap();
+                            ++checkpoint_count;
+                            last_checkpoint = sutil::currentTime();
+                            checkpoint_time += last_checkpoint - checkpoint_start;
+                        }
+                    }
+                }
+                render_time += sutil::currentTime() - render_start;
+                rendered_samples += double( session->getLaunchWidth() ) * session->getLaunchHeight() * rendered_frames;
+                if ( session->hasReprojection() && image > first_image ) {
+                    const double pixels = double( width ) * height;
+                    std::cerr << "Reprojection kept " << session->getReprojectedSamples() / pixels << " samples per pixel, "
+                              << 100.0 * session->getReprojectedPixels() / pixels << "% of the pixels" << std::endl;
+                }
+
+                if ( partial_output ) {
+                    sutil::PartialImageInfo info;
+                    info.width       = width;
+                    info.height      = height;
+                    info.frame_begin = frame_begin;
+                    info.frame_end   = frame_end;
+                    info.scene_hash  = scene_hash;
+                    Buffer accum_buffer = session->getAccumulationBuffer();
+                    const bool written = sutil::writePartialImage( filename, info, static_cast<const float*>( accum_buffer->map( 0, RT_BUFFER_MAP_READ ) ) );
+                    accum_buffer->unmap();
+                    if ( !written )
+                        return 1;
+                    continue;
+                }
+
+                // Only the final accumulation is tonemapped, the per-sample launches never touch the output buffer.
+                if ( !session->readMean( mean ) )
+                    return 1;
+                if ( denoise ) {
+                    // The whole image is denoised, so the filter sees the neighbours of a cropped region.
+                    const double denoise_start = sutil::currentTime();
+                    if ( !session->readFeatures( albedo, normal ) )
+                        return 1;
+                    sutil::denoise( mean.data(), albedo.data(), normal.data(), width, height, sutil::DenoiseSettings(), mean.data() );
+                    denoise_time += sutil::currentTime() - denoise_start;
+                }
+                if ( crop )
+                    cropPixels( mean, width, region_x, region_y, region_width, region_height );
+                if ( !heatmap_file.empty() ) {
+                    if ( !session->readAov( AOV_INDEX_COST, cost ) )
+                        return 1;
+                    if ( crop )
+                        cropPixels( cost, width, region_x, region_y, region_width, region_height );
+                    if ( !writeCostHeatmap( heatmap_file, cost, image_width, image_height, heatmap_stats ) )
+                        return 1;
+                }
+                if ( aov_mask ) {
+                    // The layers go into one file, written here instead of in the background.
+                    const double aov_start = sutil::currentTime();
+                    for ( unsigned int index = 0; index < AOV_COUNT; ++index ) {
+                        if ( !( aov_mask & ( 1u << index ) ) )
+                            continue;
+                        if ( !session->readAov( index, aovs[index] ) )
+                            return 1;
+                        if ( crop )
+                            cropPixels( aovs[index], width, region_x, region_y, region_width, region_height );
+                    }
+                    if ( !writeAovImage( filename, mean, aovs, aov_mask, image_width, image_height ) )
+                        return 1;
+                    aov_time += sutil::currentTime() - aov_start;
+                } else if ( float_image ) {
+                    writer.write( filename, mean.data(), image_width, image_height, RT_FORMAT_FLOAT4 );
+                } else {
+                    pixels.resize( mean.size() );
+                    sutil::toneMap( mean.data(), image_width, image_height, 4, tonemap_settings, pixels.data() );
+                    writer.write( filename, pixels.data(), image_width, image_height, RT_FORMAT_UNSIGNED_BYTE4 );
+                }
+            }
+            failed += writer.flush();
+            const double total_time = sutil::currentTime() - start_time;
+
+            std::cerr << "Wrote " << sequence_length - first_image - failed << " of " << sequence_length - first_image << " images in " << total_time << " s"
+                      << " (render " << render_time << " s, encode " << writer.encodeSeconds() << " s"
+                      << ", blocked on output " << writer.blockedSeconds() << " s)" << std::endl;
+            std::cerr << rendered_samples / std::max( render_time, 1e-9 ) * 1e-6 << " Msamples/s with " << samples_per_launch
+                      << " samples per launch" << std::endl;
+            std::cerr << "Peak resident " << sutil::peakMemoryUsage() / ( 1024.0 * 1024.0 ) << " MB" << std::endl;
+            if ( session->hasRayStats() )
+                printRayStats( std::cerr, session->getRayStats() );
+            if ( adaptive ) {
+                std::cerr << "Stopped at " << adaptive_stats.m_frames << " samples per pixel (" << adaptive_stats.m_stopReason << "), estimated RMSE "
+                          << adaptive_stats.m_rmse << ", " << adaptive_stats.m_estimates << " estimates in " << adaptive_stats.m_estimateSeconds << " s" << std::endl;
+                if ( !writeRenderReport( out_file + ".json", out_file, image_width, image_height, adaptive_settings, adaptive_stats, total_time ) )
+                    return 1;
+            }
+            if ( denoise )
+                std::cerr << "Denoised in " << denoise_time << " s" << std::endl;
+            if ( aov_mask )
+                std::cerr << "Read back and wrote the AOV layers in " << aov_time << " s" << std::endl;
+            if ( !heatmap_file.empty() ) {
+                std::cerr << "Wrote the cost heatmap " << heatmap_file << ".png and " << heatmap_file << ".pfm: per sample "
+                          << heatmap_stats.m_meanRays << " rays, " << heatmap_stats.m_meanIntersections << " intersection tests, "
+                          << heatmap_stats.m_meanCycles << " cycles on average, " << heatmap_stats.m_maxCycles << " cycles at most, "
+                          << "colour scale up to " << heatmap_stats.m_scale << " cycles (99th percentile)" << std::endl;
+            }
+            if ( checkpoints ) {
+                std::cerr << checkpoint_count << " checkpoints, " << checkpoint_time << " s on the render thread ("
+                          << 100.0 * checkpoint_time / std::max( render_time, 1e-9 ) << "% of render time), "
+                          << checkpoints->writeSeconds() << " s writing in the background" << std::endl;
+                // The images are complete, a later --resume must not skip them.
+                if ( !failed )
+                    checkpoints->remove();
+            }
+            if ( failed )
+                return 1;
         }
         return 0;
     }
-    SUTIL_CATCH( context->get() )
+    SUTIL_CATCH( 0 )
 }
-
@@ -28,10 +28,13 @@
 
 #include <optix.h>
 #include <optixu/optixu_math_namespace.h>
+#include "aov_flags.h"
 #include "helpers.h"
 #include "prd.h"
 #include "rt_function.h"
 #include "random.h"
+#include "ray_stats.h"
+#include "rgb9e5.h"
 
 using namespace optix;
 
@@ -45,46 +48,154 @@ rtDeclareVariable(float,         scene_epsilon, , );
 rtDeclareVariable(float3,        cutoff_color, , );
 rtDeclareVariable(int,           max_depth, , );
 rtBuffer<uchar4, 2>              output_buffer;
-rtBuffer<float4, 2>              accum_buffer;
+rtBuffer<float4, 2>              accum_buffer;         // Sum of the samples in xyz, sample count in w.
+rtBuffer<unsigned int, 2>        accum_preview_buffer; // Running mean in RGB9E5.
 rtDeclareVariable(rtObject,      top_object, , );
 rtDeclareVariable(unsigned int,  frame, , );
+rtDeclareVariable(unsigned int,  samples_per_launch, , ); // Samples [frame, frame + samples_per_launch) in one launch, at least 1.
 rtDeclareVariable(uint2,         launch_index, rtLaunchIndex, );
+rtDeclareVariable(uint2,         launch_dim, rtLaunchDim, );
+rtDeclareVariable(uint2,         tile_origin, , );     // Tiled renders launch one tile, the buffers hold the tile.
+rtDeclareVariable(uint2,         launch_offset, , );   // Render region: buffer element of launch index (0,0).
+rtDeclareVariable(uint2,         launch_limit, , );    // End of the region in buffer elements.
+rtDeclareVariable(unsigned int,  preview_scale, , );   // Interactive preview: one path per preview_scale^2 block of pixels.
+rtDeclareVariable(uint2,         image_size, , );      // Full image, the camera and the random seeds refer to it.
 
-__device__ inline float4 ToneMap(const float4& c, float limit)
+// Temporal reprojection, float accumulation only. Frame 0 stores the first hit of every pixel center. With
+// reproject set, it also carries the accumulation of the previous camera over to the pixels which still see
+// the same surface. The previous buffers are the ones of the last accumulation, swapped by the host.
+rtBuffer<float4, 2>              hit_buffer;           // World position in xyz, hit_normal_bits() in w. Misses: ray direction, w = 0.
+rtBuffer<float4, 2>              prev_hit_buffer;
+rtBuffer<float4, 2>              prev_accum_buffer;
+rtBuffer<unsigned int, 1>        reproject_counts;     // Pixels with history and the retained samples of the last reprojection.
+rtDeclareVariable(int,           store_hits, , );
+rtDeclareVariable(int,           reproject, , );
+rtDeclareVariable(float,         reproject_max_samples, , ); // Older samples are down-weighted, lighting changes with the view.
+rtDeclareVariable(float3,        prev_eye, , );
+rtDeclareVariable(float3,        prev_U, , );
+rtDeclareVariable(float3,        prev_V, , );
+rtDeclareVariable(float3,        prev_W, , );
+
+// Arbitrary output variables, float accumulation only, see aov_flags.h. Only pinhole_camera_aov writes them,
+// the buffers of the AOVs which are not in aov_mask are 1x1.
+rtBuffer<float4, 2>              depth_buffer;
+rtBuffer<float4, 2>              normal_buffer;
+rtBuffer<float4, 2>              albedo_buffer;
+rtBuffer<float4, 2>              material_buffer;
+rtBuffer<float4, 2>              direct_buffer;
+rtBuffer<float4, 2>              indirect_buffer;
+rtBuffer<float4, 2>              variance_buffer;
+rtBuffer<float4, 2>              cost_buffer;
+rtBuffer<unsigned int, 2>        intersection_count_buffer; // Of the launch index, counted by the *_cost intersection programs.
+rtDeclareVariable(unsigned int,  aov_mask, , );
+
+// Ray statistics, see ray_stats.h. Only the *_stats programs count, otherwise the buffer is 1x1.
+rtBuffer<unsigned int, 1>        ray_stats_buffer;     // RAY_STATS_STRIPES copies of RAY_COUNTER_COUNT counters.
+
+struct RayCounts
 {
-	float luminance = 0.3f*c.x + 0.6f*c.y + 0.1f*c.z;
+  unsigned int count[RAY_COUNTER_COUNT];
+};
 
-	float4 col = c * 1.0f / (1.0f + luminance / limit);
-	return make_float4(col.x, col.y, col.z, 1.0f);
-}
+// What a path saw at its first hit.
+struct FirstHit
+{
+  float4 hit;      // Like hit_buffer.
+  float  depth;    // Camera space, 0 for a miss.
+  float3 normal;
+  float3 albedo;
+  int    material;
+  float3 direct;   // Radiance up to the first bounce.
+  unsigned int rays; // Radiance and shadow rays of the whole path.
+};
 
-__device__ inline float4 LinearToSrgb(const float4& c)
+// Octahedral normal with 15 bits per coordinate. Bit 31 marks a hit, so a miss is 0.
+__device__ inline unsigned int hit_normal_bits( float3 n )
 {
-	const float kInvGamma = 1.0f / 2.2f;
-	return make_float4(powf(c.x, kInvGamma), powf(c.y, kInvGamma), powf(c.z, kInvGamma), c.w);
+  n /= fabsf( n.x ) + fabsf( n.y ) + fabsf( n.z );
+  float2 e = make_float2( n.x, n.y );
+  if( n.z < 0.0f )
+    e = make_float2( ( 1.0f - fabsf( n.y ) ) * copysignf( 1.0f, n.x ), ( 1.0f - fabsf( n.x ) ) * copysignf( 1.0f, n.y ) );
+  const unsigned int x = static_cast<unsigned int>( ( e.x * 0.5f + 0.5f ) * 32767.0f + 0.5f );
+  const unsigned int y = static_cast<unsigned int>( ( e.y * 0.5f + 0.5f ) * 32767.0f + 0.5f );
+  return 0x80000000u | ( y << 15 ) | x;
 }
 
+__device__ inline float3 hit_normal( const unsigned int bits )
+{
+  const float2 e = make_float2( ( bits & 0x7fff ) / 32767.0f, ( ( bits >> 15 ) & 0x7fff ) / 32767.0f ) * 2.0f - 1.0f;
+  float3 n = make_float3( e.x, e.y, 1.0f - fabsf( e.x ) - fabsf( e.y ) );
+  if( n.z < 0.0f )
+    n = make_float3( ( 1.0f - fabsf( e.y ) ) * copysignf( 1.0f, e.x ), ( 1.0f - fabsf( e.x ) ) * copysignf( 1.0f, e.y ), n.z );
+  return normalize( n );
+}
 
-RT_PROGRAM void pinhole_camera()
+// Accumulation of the previous camera at the surface of hit, zero when it was not visible there.
+__device__ inline float4 reprojected_history( const float4 hit )
 {
+  const unsigned int bits = __float_as_uint( hit.w );
 
-  size_t2 screen = output_buffer.size();
-  unsigned int seed = tea<16>(screen.x*launch_index.y+launch_index.x, frame);
+  // The pixel of the previous camera which looked at the hit. Misses are points at infinity.
+  const float3 position  = make_float3( hit );
+  const float3 direction = bits ? position - prev_eye : position;
+  const float  w = dot( direction, prev_W ) / dot( prev_W, prev_W );
+  if( w <= 0.0f )
+    return make_float4( 0.0f );
+  const float2 d = make_float2( dot( direction, prev_U ) / dot( prev_U, prev_U ), dot( direction, prev_V ) / dot( prev_V, prev_V ) ) / w;
+  const float2 p = ( d + 1.0f ) * 0.5f * make_float2( image_size ) + 0.5f;
+  if( p.x < 0.0f || p.y < 0.0f || p.x >= image_size.x || p.y >= image_size.y )
+    return make_float4( 0.0f );
+  const uint2 index = make_uint2( static_cast<unsigned int>( p.x ), static_cast<unsigned int>( p.y ) );
+
+  // Disocclusions: the previous pixel saw another surface, at another depth or with another orientation.
+  const float4 prev_hit = prev_hit_buffer[index];
+  const unsigned int prev_bits = __float_as_uint( prev_hit.w );
+  if( ( bits != 0 ) != ( prev_bits != 0 ) )
+    return make_float4( 0.0f );
+  if( bits ) {
+    if( length( make_float3( prev_hit ) - position ) > 0.01f * length( position - eye ) )
+      return make_float4( 0.0f );
+    if( dot( hit_normal( prev_bits ), hit_normal( bits ) ) < 0.9f )
+      return make_float4( 0.0f );
+  }
+
+  float4 history = prev_accum_buffer[index];
+  if( history.w > reproject_max_samples )
+    history *= reproject_max_samples / history.w;
+  return history;
+}
+
+// One path through the image pixel for the sample of sample_frame. seed is advanced.
+// CAPTURE and STATS trace PerRayData_radiance_hit for the *_capture and *_stats closest hit programs, otherwise
+// the plain payload is traced. With AOVS (which needs CAPTURE) first receives the first hit, with CAPTURE alone
+// only first.hit and only if capture_hit is set. With STATS the rays and the end of the path are added to counts.
+template<bool CAPTURE, bool AOVS, bool STATS>
+__device__ inline float3 trace_path( const uint2 pixel, const unsigned int sample_frame, unsigned int& seed, const bool capture_hit, FirstHit& first, RayCounts& counts )
+{
+  const bool capture = CAPTURE && ( AOVS || capture_hit );
 
   // Subpixel jitter: send the ray through a different position inside the pixel each time,
   // to provide antialiasing.
-  float2 subpixel_jitter = frame == 0 ? make_float2( 0.0f ) : make_float2(rnd( seed ) - 0.5f, rnd( seed ) - 0.5f);
+  float2 subpixel_jitter = sample_frame == 0 ? make_float2( 0.0f ) : make_float2(rnd( seed ) - 0.5f, rnd( seed ) - 0.5f);
 
-  float2 d = (make_float2(launch_index) + subpixel_jitter) / make_float2(screen) * 2.f - 1.f;
+  float2 d = (make_float2(pixel) + subpixel_jitter) / make_float2(image_size) * 2.f - 1.f;
   float3 ray_origin = eye;
   float3 ray_direction = normalize(d.x*U + d.y*V + W);
 
-  PerRayData_radiance prd;
+  // The hit fields of the plain variant are never touched, they are not part of its payload.
+  PerRayData_radiance_hit prd;
   prd.depth = 0;
   prd.seed = seed;
   prd.done = false;
   prd.pdf = 0.0f;
   prd.specularBounce = false;
+  if ( capture ) {
+      prd.hitDistance = 0.0f;
+      prd.hitAlbedo = make_float3( 0.0f );
+      prd.hitMaterial = -2;
+  }
+  if ( AOVS || STATS )
+      prd.shadowRays = 0;
 
   // These represent the current shading state and will be set by the closest-hit or miss program
 
@@ -106,7 +217,41 @@ RT_PROGRAM void pinhole_camera()
   for(;;) {
       optix::Ray ray(ray_origin, ray_direction, /*ray type*/ 0, scene_epsilon );
 	  prd.wo = -ray.direction;
-      rtTrace(top_object, ray, prd);
+      if ( AOVS )
+          prd.emitted = make_float3( 0.0f );
+      if ( STATS ) {
+          // Misses leave them alone, so they describe this ray only.
+          prd.hitMaterial = -2;
+          prd.hitProgram = -1;
+      }
+      if ( CAPTURE || STATS )
+          rtTrace(top_object, ray, prd);
+      else
+          rtTrace(top_object, ray, static_cast<PerRayData_radiance&>( prd ));
+
+      if ( STATS ) {
+          counts.count[prd.depth == 0 ? RAY_COUNTER_PRIMARY : RAY_COUNTER_BOUNCE]++;
+          if ( prd.hitProgram >= 0 && prd.hitProgram < RAY_STATS_MAX_PROGRAMS )
+              counts.count[RAY_COUNTER_PROGRAM_HITS + prd.hitProgram]++;
+      }
+
+      if ( capture && prd.depth == 0 ) {
+          const bool hit = prd.hitDistance > 0.0f;
+          first.hit = hit ? make_float4( ray.origin + ray.direction * prd.hitDistance, __uint_as_float( hit_normal_bits( prd.hitNormal ) ) )
+                          : make_float4( ray.direction, 0.0f );
+      }
+      if ( AOVS && prd.depth == 0 ) {
+          const bool hit = prd.hitDistance > 0.0f;
+          first.depth = hit ? prd.hitDistance * dot( ray.direction, normalize( W ) ) : 0.0f;
+          first.normal = hit ? prd.hitNormal : -ray.direction;
+          first.albedo = prd.hitAlbedo;
+          first.material = prd.hitMaterial;
+          // Emission at the first hit and the light sampled there.
+          first.direct = prd.radiance;
+      } else if ( AOVS && prd.depth == 1 ) {
+          // Lights hit by the first bounce, the other half of the multiple importance sampled direct light.
+          first.direct += prd.emitted;
+      }
 
       if ( prd.done || prd.depth >= max_depth)
           break;
@@ -118,27 +263,251 @@ RT_PROGRAM void pinhole_camera()
       ray_direction = prd.bsdfDir;
   }
 
+  if ( AOVS )
+      first.rays = prd.depth + 1 + prd.shadowRays;
+  if ( STATS ) {
+      // Only misses, light hits and BRDF samples with pdf <= 0 set done.
+      const int end = !prd.done ? RAY_COUNTER_END_MAX_DEPTH
+                    : prd.hitMaterial == -2 ? RAY_COUNTER_END_MISS
+                    : prd.hitMaterial == -1 ? RAY_COUNTER_END_LIGHT : RAY_COUNTER_END_PDF;
+      counts.count[end]++;
+      counts.count[RAY_COUNTER_PATH_LENGTH + min( prd.depth, RAY_STATS_MAX_PATH_LENGTH - 1 )]++;
+      counts.count[RAY_COUNTER_SHADOW] += prd.shadowRays;
+  }
+
   result = prd.radiance;
+  seed = prd.seed;
+  return result;
+}
+
+// Display conversion happens in the tonemap entry point (tonemap.cu), only for frames which are shown.
+
+// First buffer element of the block of the launch index and the end of the block. Blocks are single pixels
+// unless a preview scale is set.
+__device__ inline void preview_block( uint2& begin, uint2& end )
+{
+  begin = launch_offset + make_uint2( launch_index.x * preview_scale, launch_index.y * preview_scale );
+  end   = make_uint2( min( begin.x + preview_scale, launch_limit.x ), min( begin.y + preview_scale, launch_limit.y ) );
+}
+
+// An AOV sum with the samples of the launch added, frame 0 starts a new sum.
+__device__ inline float4 add_sample( const float4 sum, const float4 value )
+{
+  return ( frame > 0 ) ? sum + value : value;
+}
+
+// Seed of the sample of sample_frame in the image pixel. Every sample is seeded like a launch of its own,
+// so the result does not depend on how the samples are split into launches.
+__device__ inline unsigned int sample_seed( const uint2 pixel, const unsigned int sample_frame )
+{
+  return tea<16>(image_size.x*pixel.y+pixel.x, sample_frame);
+}
 
-  float4 acc_val = accum_buffer[launch_index];
-  if( frame > 0 ) {
-    acc_val = lerp( acc_val, make_float4( result, 0.f ), 1.0f / static_cast<float>( frame+1 ) );
-  } else {
-    acc_val = make_float4( result, 0.f );
+// Adds the counts of a launch index to its stripe of the ray statistics.
+__device__ inline void add_ray_counts( const RayCounts& counts )
+{
+  const unsigned int stripe = ( launch_index.y * launch_dim.x + launch_index.x ) % RAY_STATS_STRIPES;
+  for( int i = 0; i < RAY_COUNTER_COUNT; ++i ) {
+    if( counts.count[i] )
+      atomicAdd( &ray_stats_buffer[stripe * RAY_COUNTER_COUNT + i], counts.count[i] );
   }
+}
 
-  float4 val = LinearToSrgb(ToneMap(acc_val, 1.5));
-  //float4 val = LinearToSrgb(acc_val);
+// The float accumulation. The hit captures of the AOVs and reprojection, the AOV writes and the ray statistics
+// are compiled into separate programs, which the host pairs with the matching closest hit programs
+// (Session::closestHitProgram()). Without them the plain payload is traced and nothing is recorded.
+template<bool CAPTURE, bool AOVS, bool STATS>
+__device__ inline void accumulate_pixel()
+{
+  // Seeded by the image pixel, a tile or region samples exactly like the same pixels of a full render.
+  uint2 index;
+  uint2 end;
+  preview_block( index, end );
+  const uint2 pixel = make_uint2( ( index.x + end.x ) / 2, ( index.y + end.y ) / 2 ) + tile_origin;
 
-  output_buffer[launch_index] = make_color(make_float3(val));
-  accum_buffer[launch_index] = acc_val;
+  // Sums instead of a running mean, so partial renders can be merged by adding them
+  // and pixels can carry different sample counts. The samples of the launch are summed in registers,
+  // the buffers are read and written once per launch.
+  float3 radiance = make_float3( 0.0f );
+  float4 depth    = make_float4( 0.0f );
+  float3 normal   = make_float3( 0.0f );
+  float3 albedo   = make_float3( 0.0f );
+  float3 direct   = make_float3( 0.0f );
+  float4 variance = make_float4( 0.0f );
+  float4 cost     = make_float4( 0.0f );
+  float4 first_hit;
+  int    first_material;
+  RayCounts counts;
+  if( STATS ) {
+    for( int i = 0; i < RAY_COUNTER_COUNT; ++i )
+      counts.count[i] = 0;
+  }
+  // The cost counts the cycles of the paths only, not the sums and buffer writes around them.
+  const bool measure_cost = AOVS && ( aov_mask & AOV_COST );
+  if( measure_cost )
+    intersection_count_buffer[launch_index] = 0;
+  for( unsigned int s = 0; s < samples_per_launch; ++s ) {
+    unsigned int seed = sample_seed( pixel, frame + s );
+    FirstHit first;
+    const long long start = measure_cost ? clock64() : 0;
+    const bool capture_hit = frame == 0 && s == 0 && store_hits;
+    const float3 value = trace_path<CAPTURE, AOVS, STATS>( pixel, frame + s, seed, capture_hit, first, counts );
+    if( measure_cost )
+      cost += make_float4( static_cast<float>( first.rays ), 0.0f, static_cast<float>( clock64() - start ), 1.0f );
+    radiance += value;
+    if( CAPTURE && s == 0 ) {
+      first_hit = first.hit;
+      if( AOVS )
+        first_material = first.material;
+    }
+    if( AOVS ) {
+      depth  += make_float4( first.depth, first.depth > 0.0f ? 1.0f : 0.0f, 0.0f, 1.0f );
+      normal += first.normal;
+      albedo += first.albedo;
+      direct += first.direct;
+      const float y = dot( value, make_float3( 0.2126f, 0.7152f, 0.0722f ) );
+      variance += make_float4( y, y * y, 0.0f, 1.0f );
+    }
+  }
+  const float samples = static_cast<float>( samples_per_launch );
+  const float4 sample = make_float4( radiance, samples );
+  if( STATS )
+    add_ray_counts( counts );
+  if( measure_cost )
+    cost.y = static_cast<float>( intersection_count_buffer[launch_index] );
+
+  // Frame 0 samples the pixel center, its first hit stands for the pixel. Reprojection runs without
+  // tiles, regions and preview blocks, so index is the image pixel.
+  float4 history = make_float4( 0.0f );
+  if( CAPTURE && frame == 0 && store_hits ) {
+    if( reproject ) {
+      history = reprojected_history( first_hit );
+      if( history.w > 0.0f ) {
+        atomicAdd( &reproject_counts[0], 1u );
+        atomicAdd( &reproject_counts[1], static_cast<unsigned int>( history.w + 0.5f ) );
+      }
+    }
+    hit_buffer[index] = first_hit;
+  }
+
+  for( unsigned int y = index.y; y < end.y; ++y ) {
+    for( unsigned int x = index.x; x < end.x; ++x ) {
+      const uint2 i = make_uint2( x, y );
+      accum_buffer[i] = ( frame > 0 ) ? accum_buffer[i] + sample : history + sample;
+      if( AOVS ) {
+        if( aov_mask & AOV_DEPTH )
+          depth_buffer[i] = add_sample( depth_buffer[i], depth );
+        if( aov_mask & AOV_NORMAL )
+          normal_buffer[i] = add_sample( normal_buffer[i], make_float4( normal, samples ) );
+        if( aov_mask & AOV_ALBEDO )
+          albedo_buffer[i] = add_sample( albedo_buffer[i], make_float4( albedo, samples ) );
+        // Indices do not average. The first sample of the pixel, at its center unless the accumulation was cleared.
+        if( ( aov_mask & AOV_MATERIAL ) && ( frame == 0 || material_buffer[i].w == 0.0f ) )
+          material_buffer[i] = make_float4( static_cast<float>( first_material ), 0.0f, 0.0f, 1.0f );
+        if( aov_mask & AOV_DIRECT )
+          direct_buffer[i] = add_sample( direct_buffer[i], make_float4( direct, samples ) );
+        if( aov_mask & AOV_INDIRECT )
+          indirect_buffer[i] = add_sample( indirect_buffer[i], make_float4( radiance - direct, samples ) );
+        if( aov_mask & AOV_VARIANCE )
+          variance_buffer[i] = add_sample( variance_buffer[i], variance );
+        if( measure_cost )
+          cost_buffer[i] = add_sample( cost_buffer[i], cost );
+      }
+    }
+  }
 }
 
-RT_PROGRAM void exception()
+RT_PROGRAM void pinhole_camera()
+{
+  accumulate_pixel<false, false, false>();
+}
+
+// Temporal reprojection, the first hits of frame 0.
+RT_PROGRAM void pinhole_camera_capture()
+{
+  accumulate_pixel<true, false, false>();
+}
+
+RT_PROGRAM void pinhole_camera_aov()
+{
+  accumulate_pixel<true, true, false>();
+}
+
+RT_PROGRAM void pinhole_camera_stats()
+{
+  accumulate_pixel<false, false, true>();
+}
+
+RT_PROGRAM void pinhole_camera_capture_stats()
+{
+  accumulate_pixel<true, false, true>();
+}
+
+RT_PROGRAM void pinhole_camera_aov_stats()
+{
+  accumulate_pixel<true, true, true>();
+}
+
+RT_PROGRAM void pinhole_camera_preview()
+{
+  uint2 index;
+  uint2 end;
+  preview_block( index, end );
+  const uint2 pixel = make_uint2( ( index.x + end.x ) / 2, ( index.y + end.y ) / 2 ) + tile_origin;
+
+  // The mean of the samples of the launch goes into the running mean with their combined weight.
+  float3 sample = make_float3( 0.0f );
+  unsigned int seed;
+  RayCounts counts;
+  for( unsigned int s = 0; s < samples_per_launch; ++s ) {
+    seed = sample_seed( pixel, frame + s );
+    FirstHit first;
+    sample += trace_path<false, false, false>( pixel, frame + s, seed, false, first, counts );
+  }
+  sample /= static_cast<float>( samples_per_launch );
+  const float rounding = rnd( seed );
+  for( unsigned int y = index.y; y < end.y; ++y ) {
+    for( unsigned int x = index.x; x < end.x; ++x ) {
+      const uint2 i = make_uint2( x, y );
+      float3 result = sample;
+      if( frame > 0 ) {
+        float3 mean;
+        decodeRGB9E5( accum_preview_buffer[i], mean.x, mean.y, mean.z );
+        result = lerp( mean, result, static_cast<float>( samples_per_launch ) / static_cast<float>( frame + samples_per_launch ) );
+      }
+      // Stochastic rounding, otherwise updates below the 9-bit precision are lost after a few hundred frames.
+      accum_preview_buffer[i] = encodeRGB9E5( result.x, result.y, result.z, rounding );
+    }
+  }
+}
+
+// Marks the buffer elements from begin to end of a launch index which caught an exception. The output buffer
+// holds only the tile in tiled renders, the block is clipped to it.
+__device__ inline void mark_exception( const uint2 begin, const uint2 end )
 {
   const unsigned int code = rtGetExceptionCode();
   rtPrintf( "Caught exception 0x%X at launch index (%d,%d)\n", code, launch_index.x, launch_index.y );
-  output_buffer[launch_index] = make_color( bad_color );
+  const size_t2 size = output_buffer.size();
+  for( unsigned int y = begin.y; y < min( end.y, static_cast<unsigned int>( size.y ) ); ++y ) {
+    for( unsigned int x = begin.x; x < min( end.x, static_cast<unsigned int>( size.x ) ); ++x )
+      output_buffer[make_uint2( x, y )] = make_color( bad_color );
+  }
+}
+
+// Camera entry point, a launch index covers a preview block.
+RT_PROGRAM void exception()
+{
+  uint2 index;
+  uint2 end;
+  preview_block( index, end );
+  mark_exception( index, end );
+}
+
+// Tone mapping entry point, one launch index per pixel of the region whatever the preview scale.
+RT_PROGRAM void exception_tonemap()
+{
+  const uint2 index = launch_index + launch_offset;
+  mark_exception( index, index + make_uint2( 1u, 1u ) );
 }
 
 
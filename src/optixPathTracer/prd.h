@@ -47,6 +47,24 @@ struct PerRayData_radiance
   float pdf;
 };
 
+// Payload of the launches which record hits: the AOVs, temporal reprojection and the ray statistics.
+// Only the *_capture and *_stats closest hit programs fill the extra fields, the others and the miss program
+// see the leading PerRayData_radiance. Launches without any of them trace the plain payload.
+struct PerRayData_radiance_hit : PerRayData_radiance
+{
+  // Surface of the last hit, written by the *_capture programs.
+  float hitDistance; // 0 for a miss.
+  float3 hitNormal;  // Shading normal facing the ray.
+  float3 hitAlbedo;  // Base color of the material, 1 for lights.
+  float3 emitted;    // Radiance the last hit added by its own emission, for the direct light AOV.
+
+  int hitMaterial;   // Material index, -1 for lights. Written by the *_capture and *_stats programs.
+
+  // Written by the *_stats programs.
+  int hitProgram;    // programId of the last hit's material.
+  unsigned int shadowRays; // Traced by the path so far.
+};
+
 struct PerRayData_shadow
 {
   bool inShadow;
@@ -28,6 +28,7 @@
 
 #include <optix_world.h>
 #include "intersection_refinement.h"
+#include "intersection_count.h"
 
 using namespace optix;
 
@@ -45,7 +46,7 @@ rtDeclareVariable(float4, geometry_color, attribute geometry_color, );
 
 rtDeclareVariable(optix::Ray, ray, rtCurrentRay, );
 
-RT_PROGRAM void intersect(int primIdx)
+static __device__ void intersect_quad()
 {
 	float3 n = make_float3(plane);
 	float dt = dot(ray.direction, n);
@@ -73,6 +74,17 @@ RT_PROGRAM void intersect(int primIdx)
 	}
 }
 
+RT_PROGRAM void intersect(int primIdx)
+{
+	intersect_quad();
+}
+
+RT_PROGRAM void intersect_cost(int primIdx)
+{
+	count_intersection();
+	intersect_quad();
+}
+
 RT_PROGRAM void bounds(int, float result[6])
 {
 	// v1 and v2 are scaled by 1./length^2.  Rescale back to normal for the bounds computation.
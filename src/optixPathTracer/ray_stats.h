@@ -0,0 +1,28 @@
+#pragma once
+
+#ifndef RAY_STATS_H
+#define RAY_STATS_H
+
+// Path and ray statistics counters, float accumulation only. Shared by the host and the ray generation program.
+// Every launch index counts its paths in local memory and adds the counts once per launch to one of
+// RAY_STATS_STRIPES copies of the counters, so few threads contend for the same atomics. The host sums the copies.
+
+#define RAY_STATS_STRIPES         64
+#define RAY_STATS_MAX_PROGRAMS    4  // BRDF programs, indexed by the programId of the materials.
+#define RAY_STATS_MAX_PATH_LENGTH 16 // Segments per path, longer paths share the last bin.
+
+enum RayCounter
+{
+  RAY_COUNTER_PRIMARY,
+  RAY_COUNTER_BOUNCE,
+  RAY_COUNTER_SHADOW,
+  RAY_COUNTER_END_MISS,       // Path terminations by reason.
+  RAY_COUNTER_END_LIGHT,
+  RAY_COUNTER_END_PDF,        // The BRDF sample had pdf <= 0.
+  RAY_COUNTER_END_MAX_DEPTH,
+  RAY_COUNTER_PROGRAM_HITS,   // Closest hits per programId, RAY_STATS_MAX_PROGRAMS counters.
+  RAY_COUNTER_PATH_LENGTH = RAY_COUNTER_PROGRAM_HITS + RAY_STATS_MAX_PROGRAMS, // Paths of 1 .. RAY_STATS_MAX_PATH_LENGTH segments.
+  RAY_COUNTER_COUNT = RAY_COUNTER_PATH_LENGTH + RAY_STATS_MAX_PATH_LENGTH
+};
+
+#endif // RAY_STATS_H
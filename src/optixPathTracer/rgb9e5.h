@@ -0,0 +1,58 @@
+#pragma once
+
+#ifndef RGB9E5_H
+#define RGB9E5_H
+
+#include <math.h>
+
+// Shared exponent RGB9E5 (EXT_texture_shared_exponent): three 9-bit mantissas and one 5-bit exponent in 32 bits.
+// Used for the compact preview accumulation, on the device and on the host.
+
+#ifdef __CUDACC__
+#define RGB9E5_FUNCTION __forceinline__ __host__ __device__
+#else
+#define RGB9E5_FUNCTION inline
+#endif
+
+#define RGB9E5_MANTISSA_BITS 9
+#define RGB9E5_EXPONENT_BIAS 15
+#define RGB9E5_MAX_VALUE     65408.0f // (511 / 512) * 2^16
+
+// offset is added before truncating the mantissas. 0.5 rounds to nearest.
+// A uniform random offset in [0, 1) rounds stochastically, which keeps a running mean unbiased
+// when the per-sample update is smaller than the mantissa precision.
+RGB9E5_FUNCTION unsigned int encodeRGB9E5(float r, float g, float b, float offset)
+{
+  // fmaxf() drops NaN.
+  r = fminf(fmaxf(r, 0.0f), RGB9E5_MAX_VALUE);
+  g = fminf(fmaxf(g, 0.0f), RGB9E5_MAX_VALUE);
+  b = fminf(fmaxf(b, 0.0f), RGB9E5_MAX_VALUE);
+
+  const float maxc = fmaxf(r, fmaxf(g, b));
+  int e;
+  frexpf(maxc, &e); // maxc = f * 2^e with f in [0.5, 1), so floor(log2(maxc)) == e - 1.
+  int exponent = (e < -RGB9E5_EXPONENT_BIAS ? -RGB9E5_EXPONENT_BIAS : e) + RGB9E5_EXPONENT_BIAS;
+
+  float scale = ldexpf(1.0f, RGB9E5_MANTISSA_BITS + RGB9E5_EXPONENT_BIAS - exponent);
+  if (floorf(maxc * scale + 0.5f) >= float(1 << RGB9E5_MANTISSA_BITS))
+  {
+    ++exponent;
+    scale *= 0.5f;
+  }
+
+  const unsigned int limit = (1u << RGB9E5_MANTISSA_BITS) - 1u;
+  const unsigned int rm = (unsigned int) floorf(r * scale + offset);
+  const unsigned int gm = (unsigned int) floorf(g * scale + offset);
+  const unsigned int bm = (unsigned int) floorf(b * scale + offset);
+  return (rm < limit ? rm : limit) | ((gm < limit ? gm : limit) << 9) | ((bm < limit ? bm : limit) << 18) | ((unsigned int) exponent << 27);
+}
+
+RGB9E5_FUNCTION void decodeRGB9E5(unsigned int v, float& r, float& g, float& b)
+{
+  const float scale = ldexpf(1.0f, int(v >> 27) - RGB9E5_EXPONENT_BIAS - RGB9E5_MANTISSA_BITS);
+  r = float(v & 0x1ff) * scale;
+  g = float((v >> 9) & 0x1ff) * scale;
+  b = float((v >> 18) & 0x1ff) * scale;
+}
+
+#endif // RGB9E5_H
@@ -18,20 +18,24 @@ freely, subject to the following restrictions:
 
 #include"sceneLoader.h"
 
+#include <Profiler.h>
+
 static const int kMaxLineLength = 2048;
 
-Scene* LoadScene(const char* filename)
+std::unique_ptr<Scene> LoadScene(const char* filename)
 {
-	Scene *scene = new Scene;
+	sutil::ProfileScope profile("LoadScene", filename);
 	int tex_id = 0;
 	FILE* file = fopen(filename, "r");
 
 	if (!file)
 	{
-		printf("Couldn't open %s for reading.", filename);
-		return NULL;
+		printf("Couldn't open %s for reading.\n", filename);
+		return nullptr;
 	}
 
+	std::unique_ptr<Scene> scene(new Scene);
+
 	std::map<std::string, MaterialParameter> materials_map;
 	std::map<std::string, int> texture_ids;
 
@@ -204,5 +208,6 @@ Scene* LoadScene(const char* filename)
 			}
 		}
 	}
+	fclose(file);
 	return scene;
 }
\ No newline at end of file
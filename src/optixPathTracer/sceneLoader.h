@@ -21,6 +21,7 @@ freely, subject to the following restrictions:
 #include <stdio.h>
 
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <optixu/optixpp_namespace.h>
@@ -53,4 +54,5 @@ struct Scene
 	Properties properties;
 };
 
-Scene* LoadScene(const char* filename);
\ No newline at end of file
+// Returns nullptr when the file cannot be read.
+std::unique_ptr<Scene> LoadScene(const char* filename);
\ No newline at end of file
@@ -27,6 +27,7 @@
  */
 
 #include <optix_world.h>
+#include "intersection_count.h"
 
 using namespace optix;
 
@@ -111,6 +112,13 @@ RT_PROGRAM void sphere_intersect_robust(int primIdx)
 }
 
 
+RT_PROGRAM void sphere_intersect_robust_cost(int primIdx)
+{
+  count_intersection();
+  intersect_sphere<true>();
+}
+
+
 RT_PROGRAM void bounds (int, float result[6])
 {
   const float3 cen = center;
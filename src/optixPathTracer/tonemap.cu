@@ -0,0 +1,140 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <optix.h>
+#include <optixu/optixu_math_namespace.h>
+#include "helpers.h"
+#include "rgb9e5.h"
+
+using namespace optix;
+
+// Display conversion of the accumulation buffer. This is a separate entry point so it runs
+// once per displayed frame instead of once per sample. The operators and the dither pattern
+// match the host implementation in sutil/ToneMap.cpp, tonemap_operator is a sutil::ToneMapOperator.
+
+rtBuffer<uchar4, 2>              output_buffer;
+rtBuffer<float4, 2>              accum_buffer;         // Sum of the samples in xyz, sample count in w.
+rtBuffer<unsigned int, 2>        accum_preview_buffer; // Running mean in RGB9E5.
+rtDeclareVariable(int,           tonemap_operator, , );
+rtDeclareVariable(float,         exposure_scale, , );
+rtDeclareVariable(int,           dither, , );
+rtDeclareVariable(uint2,         launch_index, rtLaunchIndex, );
+rtDeclareVariable(uint2,         launch_offset, , ); // Render region, see path_trace_camera.cu.
+
+__device__ inline float3 Reinhard(const float3& c)
+{
+	const float luminance = 0.3f*c.x + 0.6f*c.y + 0.1f*c.z;
+	return c * (1.0f / (1.0f + luminance / 1.5f));
+}
+
+__device__ inline float Aces(float x)
+{
+	x *= 0.6f;
+	return x * (2.51f * x + 0.03f) / (x * (2.43f * x + 0.59f) + 0.14f);
+}
+
+__device__ inline float Hable(float x)
+{
+	const float A = 0.15f, B = 0.50f, C = 0.10f, D = 0.20f, E = 0.02f, F = 0.30f;
+	return (x * (A * x + C * B) + D * E) / (x * (A * x + B) + D * F) - E / F;
+}
+
+__device__ inline float Filmic(float x)
+{
+	return Hable(2.0f * x) / Hable(11.2f);
+}
+
+// sRGB encoding without powf. Three square roots approximate x^(1/2.4) (max. error < 0.001, one 8-bit code).
+__device__ inline float LinearToSrgb(float x)
+{
+	if (!(x > 0.0031308f))
+		return x > 0.0f ? 12.92f * x : 0.0f;
+	const float s1 = sqrtf(x);
+	const float s2 = sqrtf(s1);
+	const float s3 = sqrtf(s2);
+	return 0.662002687f * s1 + 0.684122060f * s2 - 0.323583601f * s3 - 0.0225411470f * x;
+}
+
+// Triangular noise in [-0.5, 1.5) codes, repeating every 64 pixels.
+__device__ inline float DitherOffset(unsigned int x, unsigned int y)
+{
+	unsigned int h = (x & 63u) * 73856093u ^ (y & 63u) * 19349663u;
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+	return (h & 0xffff) / 65536.0f + (h >> 16) / 65536.0f - 0.5f;
+}
+
+__device__ inline unsigned char Quantize(float x, float offset)
+{
+	const float s = __saturatef(x);
+	return static_cast<unsigned char>(fminf(fmaxf(s * 255.99f + (s > 0.0f ? offset : 0.0f), 0.0f), 255.0f));
+}
+
+__device__ inline void Display(const uint2 index, float3 c)
+{
+	c *= exposure_scale;
+
+	switch (tonemap_operator)
+	{
+	case 1:
+		c = Reinhard(c);
+		break;
+	case 2:
+		c = make_float3(Aces(c.x), Aces(c.y), Aces(c.z));
+		break;
+	case 3:
+		c = make_float3(Filmic(c.x), Filmic(c.y), Filmic(c.z));
+		break;
+	default:
+		break;
+	}
+
+	const float offset = dither ? DitherOffset(index.x, index.y) : 0.0f;
+	output_buffer[index] = make_uchar4(Quantize(LinearToSrgb(c.z), offset),
+	                                   Quantize(LinearToSrgb(c.y), offset),
+	                                   Quantize(LinearToSrgb(c.x), offset),
+	                                   255u);
+}
+
+RT_PROGRAM void tonemap()
+{
+	const uint2 index = launch_index + launch_offset;
+	const float4 acc = accum_buffer[index];
+	Display(index, 0.0f < acc.w ? make_float3(acc) / acc.w : make_float3(0.0f));
+}
+
+RT_PROGRAM void tonemap_preview()
+{
+	const uint2 index = launch_index + launch_offset;
+	float3 mean;
+	decodeRGB9E5(accum_preview_buffer[index], mean.x, mean.y, mean.z);
+	Display(index, mean);
+}
@@ -31,6 +31,7 @@
 #include <optixu/optixu_matrix_namespace.h>
 #include <optixu/optixu_aabb_namespace.h>
 #include "intersection_refinement.h"
+#include "intersection_count.h"
 
 using namespace optix;
 
@@ -118,6 +119,13 @@ RT_PROGRAM void mesh_intersect_refine( int primIdx )
 }
 
 
+RT_PROGRAM void mesh_intersect_refine_cost( int primIdx )
+{
+    count_intersection();
+    meshIntersect<true>( primIdx );
+}
+
+
 RT_PROGRAM void mesh_bounds (int primIdx, float result[6])
 {
   const int3 v_idx = index_buffer[primIdx];
@@ -0,0 +1,119 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//-----------------------------------------------------------------------------
+//
+// optixRenderClient: Send a request to a render server (optixPathTracer --server).
+//
+//-----------------------------------------------------------------------------
+
+#include <sutil.h>
+#include <LocalSocket.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#if defined(_WIN32)
+#include <direct.h>
+#define getcwd _getcwd
+#else
+#include <unistd.h>
+#endif
+
+
+void printUsageAndExit( const std::string& argv0 )
+{
+    std::cerr << "\nUsage: " << argv0 << " <socket> <request> [<key>=<value> ...]\n";
+    std::cerr <<
+        "Sends one request to the render server listening on <socket> and prints the reply.\n"
+        "Requests:\n"
+        "  render scene=<file> output=<file> [width=<n> height=<n>] [spp=<n>]\n"
+        "         [eye=<x,y,z> lookat=<x,y,z> up=<x,y,z>] [tonemap=<operator>] [exposure=<stops>]\n"
+        "  stats  Jobs, scene cache hits and misses, cached scenes and their memory.\n"
+        "  quit   Shut the server down.\n"
+        "Relative scene and output paths are made absolute. Exits with 0 when the reply is ok.\n"
+        << std::endl;
+
+    exit(1);
+}
+
+
+// The server resolves paths in its own working directory.
+static std::string absolutePath( const std::string& path )
+{
+    if( path.empty() || path[0] == '/' || ( path.size() > 1 && path[1] == ':' ) )
+        return path;
+    char cwd[4096];
+    if( !getcwd( cwd, sizeof( cwd ) ) )
+        return path;
+    return std::string( cwd ) + "/" + path;
+}
+
+
+int main( int argc, char** argv )
+{
+    if( argc < 3 )
+        printUsageAndExit( argv[0] );
+
+    // Fields are separated by tabs, so arguments may contain spaces.
+    std::string request = argv[2];
+    for( int i = 3; i < argc; ++i )
+    {
+        std::string field = argv[i];
+        if( field.compare( 0, 6, "scene=" ) == 0 || field.compare( 0, 7, "output=" ) == 0 )
+        {
+            const size_t equals = field.find( '=' );
+            field = field.substr( 0, equals + 1 ) + absolutePath( field.substr( equals + 1 ) );
+        }
+        if( field.find_first_of( "\t\n" ) != std::string::npos )
+        {
+            std::cerr << "Argument '" << argv[i] << "' must not contain tabs or newlines.\n";
+            return 1;
+        }
+        request += '\t' + field;
+    }
+
+    const int connection = sutil::connectLocalSocket( argv[1] );
+    if( connection < 0 )
+        return 1;
+
+    const double start = sutil::currentTime();
+    std::string reply;
+    const bool ok = sutil::writeLocalSocketLine( connection, request ) && sutil::readLocalSocketLine( connection, reply );
+    const double seconds = sutil::currentTime() - start;
+    sutil::closeLocalSocket( connection );
+    if( !ok )
+    {
+        std::cerr << "ERROR: No reply from " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::cout << reply << " total=" << seconds << std::endl;
+    return reply.compare( 0, 2, "ok" ) == 0 ? 0 : 1;
+}
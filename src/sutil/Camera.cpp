@@ -84,6 +84,13 @@ void sutil::Camera::reset_lookat()
     apply();
 }
 
+void sutil::Camera::orbit( float radians )
+{
+    const Matrix4x4 rotation = Matrix4x4::rotate( radians, m_camera_up );
+    m_camera_eye = m_camera_lookat + make_float3( rotation*make_float4( m_camera_eye - m_camera_lookat, 0.0f ) );
+    apply();
+}
+
 bool sutil::Camera::process_mouse( float x, float y, bool left_button_down, bool right_button_down, bool middle_button_down )
 {
     static sutil::Arcball arcball;
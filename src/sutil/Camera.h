@@ -65,6 +65,9 @@ class Camera
 
     SUTILAPI void reset_lookat();
 
+    // Rotate the eye around the lookat point about the up vector, e.g. for turntable sequences.
+    SUTILAPI void orbit( float radians );
+
     SUTILAPI bool process_mouse( float x, float y, bool left_button_down, bool right_button_down, bool middle_button_down );
 
     SUTILAPI bool resize( unsigned int w, unsigned int h) {
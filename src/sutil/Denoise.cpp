@@ -0,0 +1,374 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sutil/Denoise.h>
+#include <sutil/Parallel.h>
+#include <sutil/Profiler.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#  define SUTIL_DENOISE_SSE2 1
+#  include <emmintrin.h>
+#endif
+
+namespace
+{
+
+// B3 spline, the a-trous kernel is the outer product with itself.
+const float KERNEL[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+
+// Albedo below this is not divided out (black surfaces and misses).
+const float MIN_ALBEDO = 1.0e-3f;
+
+// Keeps the luminance weight finite where the variance is zero.
+const float MIN_SIGMA = 1.0e-4f;
+
+// Demodulated color, luminance and variance of one a-trous iteration.
+struct Planes
+{
+    void resize( size_t count )
+    {
+        r.resize( count );
+        g.resize( count );
+        b.resize( count );
+        l.resize( count );
+        var.resize( count );
+    }
+
+    std::vector<float> r, g, b, l, var;
+};
+
+// One a-trous iteration from src to dst.
+struct Pass
+{
+    const Planes* src;
+    Planes*       dst;
+    const float*  nx;
+    const float*  ny;
+    const float*  nz;
+    unsigned int  width;
+    unsigned int  height;
+    unsigned int  step;
+    float         colorSigma;
+    unsigned int  squarings; // The normal weight is dot^(2^squarings).
+};
+
+inline float luminance( float r, float g, float b )
+{
+    return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+}
+
+// exp(x) for x <= 0 with a relative error below 1e-6. The SSE2 version does the same operations,
+// so pixels at the image border, which the scalar code filters, match their neighbours.
+inline float fastExp( float x )
+{
+    const float t = std::max( x, -87.0f ) * 1.44269504f;
+    const float i = floorf( t );
+    const float f = t - i;
+    const float p = 1.0f + f * ( 0.693147182f + f * ( 0.240226507f + f * ( 0.0555041086f + f * ( 0.00961812911f + f * 0.00133335581f ) ) ) );
+    union { unsigned int u; float f; } scale;
+    scale.u = static_cast<unsigned int>( static_cast<int>( i ) + 127 ) << 23;
+    return p * scale.f;
+}
+
+void filterPixel( const Pass& pass, unsigned int x, unsigned int y )
+{
+    const Planes& s = *pass.src;
+    const size_t  i = size_t( y ) * pass.width + x;
+
+    const float lp       = s.l[i];
+    const float invSigma = 1.0f / ( pass.colorSigma * sqrtf( std::max( s.var[i], 0.0f ) ) + MIN_SIGMA );
+
+    float sumW = 0.0f, sumR = 0.0f, sumG = 0.0f, sumB = 0.0f, sumVar = 0.0f;
+    for( int dy = -2; dy <= 2; ++dy )
+    {
+        const int yy = static_cast<int>( y ) + dy * static_cast<int>( pass.step );
+        if( yy < 0 || yy >= static_cast<int>( pass.height ) )
+            continue;
+        for( int dx = -2; dx <= 2; ++dx )
+        {
+            const int xx = static_cast<int>( x ) + dx * static_cast<int>( pass.step );
+            if( xx < 0 || xx >= static_cast<int>( pass.width ) )
+                continue;
+            const size_t j = size_t( yy ) * pass.width + xx;
+
+            float wn = std::max( pass.nx[i] * pass.nx[j] + pass.ny[i] * pass.ny[j] + pass.nz[i] * pass.nz[j], 0.0f );
+            for( unsigned int k = 0; k < pass.squarings; ++k )
+                wn *= wn;
+            const float wl = fastExp( -fabsf( lp - s.l[j] ) * invSigma );
+            const float w  = KERNEL[dx + 2] * KERNEL[dy + 2] * wn * wl;
+
+            sumW   += w;
+            sumR   += w * s.r[j];
+            sumG   += w * s.g[j];
+            sumB   += w * s.b[j];
+            sumVar += w * w * s.var[j];
+        }
+    }
+
+    // The center tap has weight > 0, unless the normal is degenerate.
+    Planes& d = *pass.dst;
+    if( sumW > 0.0f )
+    {
+        const float inv = 1.0f / sumW;
+        d.r[i]   = sumR * inv;
+        d.g[i]   = sumG * inv;
+        d.b[i]   = sumB * inv;
+        d.var[i] = sumVar * inv * inv;
+    }
+    else
+    {
+        d.r[i]   = s.r[i];
+        d.g[i]   = s.g[i];
+        d.b[i]   = s.b[i];
+        d.var[i] = s.var[i];
+    }
+    d.l[i] = luminance( d.r[i], d.g[i], d.b[i] );
+}
+
+#ifdef SUTIL_DENOISE_SSE2
+
+inline __m128 fastExp4( __m128 x )
+{
+    const __m128  t = _mm_mul_ps( _mm_max_ps( x, _mm_set1_ps( -87.0f ) ), _mm_set1_ps( 1.44269504f ) );
+    // floor(): truncation rounds negative values up, correct those by one.
+    __m128i       i = _mm_cvttps_epi32( t );
+    i = _mm_add_epi32( i, _mm_castps_si128( _mm_cmpgt_ps( _mm_cvtepi32_ps( i ), t ) ) );
+    const __m128  f = _mm_sub_ps( t, _mm_cvtepi32_ps( i ) );
+    __m128 p = _mm_add_ps( _mm_set1_ps( 0.00961812911f ), _mm_mul_ps( f, _mm_set1_ps( 0.00133335581f ) ) );
+    p = _mm_add_ps( _mm_set1_ps( 0.0555041086f ), _mm_mul_ps( f, p ) );
+    p = _mm_add_ps( _mm_set1_ps( 0.240226507f ), _mm_mul_ps( f, p ) );
+    p = _mm_add_ps( _mm_set1_ps( 0.693147182f ), _mm_mul_ps( f, p ) );
+    p = _mm_add_ps( _mm_set1_ps( 1.0f ), _mm_mul_ps( f, p ) );
+    const __m128i scale = _mm_slli_epi32( _mm_add_epi32( i, _mm_set1_epi32( 127 ) ), 23 );
+    return _mm_mul_ps( p, _mm_castsi128_ps( scale ) );
+}
+
+inline __m128 abs4( __m128 x )
+{
+    return _mm_and_ps( x, _mm_castsi128_ps( _mm_set1_epi32( 0x7fffffff ) ) );
+}
+
+// Four pixels at a time over [begin, end) of row y, where all taps are inside the row. Returns the first pixel not done.
+unsigned int filterRow4( const Pass& pass, unsigned int y, unsigned int begin, unsigned int end )
+{
+    const Planes& s = *pass.src;
+    Planes&       d = *pass.dst;
+    const __m128  sigma = _mm_set1_ps( pass.colorSigma );
+
+    unsigned int x = begin;
+    for( ; x + 4 <= end; x += 4 )
+    {
+        const size_t i = size_t( y ) * pass.width + x;
+
+        const __m128 lp       = _mm_loadu_ps( &s.l[i] );
+        const __m128 nxp      = _mm_loadu_ps( pass.nx + i );
+        const __m128 nyp      = _mm_loadu_ps( pass.ny + i );
+        const __m128 nzp      = _mm_loadu_ps( pass.nz + i );
+        const __m128 invSigma = _mm_div_ps( _mm_set1_ps( 1.0f ),
+                                            _mm_add_ps( _mm_mul_ps( sigma, _mm_sqrt_ps( _mm_max_ps( _mm_loadu_ps( &s.var[i] ), _mm_setzero_ps() ) ) ),
+                                                        _mm_set1_ps( MIN_SIGMA ) ) );
+
+        __m128 sumW   = _mm_setzero_ps();
+        __m128 sumR   = _mm_setzero_ps();
+        __m128 sumG   = _mm_setzero_ps();
+        __m128 sumB   = _mm_setzero_ps();
+        __m128 sumVar = _mm_setzero_ps();
+        for( int dy = -2; dy <= 2; ++dy )
+        {
+            const int yy = static_cast<int>( y ) + dy * static_cast<int>( pass.step );
+            if( yy < 0 || yy >= static_cast<int>( pass.height ) )
+                continue;
+            for( int dx = -2; dx <= 2; ++dx )
+            {
+                const size_t j = size_t( yy ) * pass.width + x + dx * static_cast<int>( pass.step );
+
+                __m128 wn = _mm_add_ps( _mm_add_ps( _mm_mul_ps( nxp, _mm_loadu_ps( pass.nx + j ) ), _mm_mul_ps( nyp, _mm_loadu_ps( pass.ny + j ) ) ),
+                                        _mm_mul_ps( nzp, _mm_loadu_ps( pass.nz + j ) ) );
+                wn = _mm_max_ps( wn, _mm_setzero_ps() );
+                for( unsigned int k = 0; k < pass.squarings; ++k )
+                    wn = _mm_mul_ps( wn, wn );
+                const __m128 wl = fastExp4( _mm_mul_ps( _mm_sub_ps( _mm_setzero_ps(), abs4( _mm_sub_ps( lp, _mm_loadu_ps( &s.l[j] ) ) ) ), invSigma ) );
+                const __m128 w  = _mm_mul_ps( _mm_set1_ps( KERNEL[dx + 2] * KERNEL[dy + 2] ), _mm_mul_ps( wn, wl ) );
+
+                sumW   = _mm_add_ps( sumW, w );
+                sumR   = _mm_add_ps( sumR, _mm_mul_ps( w, _mm_loadu_ps( &s.r[j] ) ) );
+                sumG   = _mm_add_ps( sumG, _mm_mul_ps( w, _mm_loadu_ps( &s.g[j] ) ) );
+                sumB   = _mm_add_ps( sumB, _mm_mul_ps( w, _mm_loadu_ps( &s.b[j] ) ) );
+                sumVar = _mm_add_ps( sumVar, _mm_mul_ps( _mm_mul_ps( w, w ), _mm_loadu_ps( &s.var[j] ) ) );
+            }
+        }
+
+        // Like the scalar code, a pixel without weight keeps its value.
+        const __m128 valid = _mm_cmpgt_ps( sumW, _mm_setzero_ps() );
+        const __m128 inv   = _mm_and_ps( valid, _mm_div_ps( _mm_set1_ps( 1.0f ), _mm_max_ps( sumW, _mm_set1_ps( 1.0e-30f ) ) ) );
+        const __m128 keep  = _mm_andnot_ps( valid, _mm_set1_ps( 1.0f ) );
+        const __m128 r     = _mm_add_ps( _mm_mul_ps( sumR, inv ), _mm_mul_ps( keep, _mm_loadu_ps( &s.r[i] ) ) );
+        const __m128 g     = _mm_add_ps( _mm_mul_ps( sumG, inv ), _mm_mul_ps( keep, _mm_loadu_ps( &s.g[i] ) ) );
+        const __m128 b     = _mm_add_ps( _mm_mul_ps( sumB, inv ), _mm_mul_ps( keep, _mm_loadu_ps( &s.b[i] ) ) );
+        const __m128 var   = _mm_add_ps( _mm_mul_ps( sumVar, _mm_mul_ps( inv, inv ) ), _mm_mul_ps( keep, _mm_loadu_ps( &s.var[i] ) ) );
+        _mm_storeu_ps( &d.r[i], r );
+        _mm_storeu_ps( &d.g[i], g );
+        _mm_storeu_ps( &d.b[i], b );
+        _mm_storeu_ps( &d.var[i], var );
+        _mm_storeu_ps( &d.l[i], _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( 0.2126f ), r ), _mm_mul_ps( _mm_set1_ps( 0.7152f ), g ) ),
+                                            _mm_mul_ps( _mm_set1_ps( 0.0722f ), b ) ) );
+    }
+    return x;
+}
+
+#endif // SUTIL_DENOISE_SSE2
+
+void filterRows( const Pass& pass, size_t begin, size_t end )
+{
+    // Pixels closer to the left and right border than the kernel reach are filtered one at a time.
+    const unsigned int reach = 2 * pass.step;
+    const unsigned int inner = pass.width > 2 * reach ? pass.width - reach : reach;
+    for( size_t y = begin; y < end; ++y )
+    {
+        const unsigned int row = static_cast<unsigned int>( y );
+        unsigned int x = 0;
+        for( ; x < std::min( reach, pass.width ); ++x )
+            filterPixel( pass, x, row );
+#ifdef SUTIL_DENOISE_SSE2
+        if( x < inner )
+            x = filterRow4( pass, row, x, inner );
+#endif
+        for( ; x < pass.width; ++x )
+            filterPixel( pass, x, row );
+    }
+}
+
+} // end anonymous namespace
+
+
+sutil::DenoiseSettings::DenoiseSettings()
+    : iterations( 5 ),
+      colorSigma( 4.0f ),
+      normalExponent( 128 )
+{
+}
+
+
+void sutil::denoise( const float* rgba, const float* albedo, const float* normal, unsigned int width, unsigned int height,
+                     const DenoiseSettings& settings, float* out )
+{
+    ProfileScope profile( "denoise" );
+    const size_t count = size_t( width ) * height;
+    if( count == 0 )
+        return;
+
+    // Structure of arrays, so four neighbouring pixels are one SSE2 load.
+    Planes planes[2];
+    planes[0].resize( count );
+    planes[1].resize( count );
+    std::vector<float> demodulation( count * 3 );
+    std::vector<float> nx( count ), ny( count ), nz( count );
+
+    Planes& src = planes[0];
+    parallelFor( height, [&]( size_t begin, size_t end )
+    {
+        for( size_t i = begin * width; i < end * width; ++i )
+        {
+            for( int c = 0; c < 3; ++c )
+                demodulation[i * 3 + c] = albedo[i * 4 + c] > MIN_ALBEDO ? albedo[i * 4 + c] : 1.0f;
+            src.r[i] = rgba[i * 4 + 0] / demodulation[i * 3 + 0];
+            src.g[i] = rgba[i * 4 + 1] / demodulation[i * 3 + 1];
+            src.b[i] = rgba[i * 4 + 2] / demodulation[i * 3 + 2];
+            src.l[i] = luminance( src.r[i], src.g[i], src.b[i] );
+            nx[i] = normal[i * 4 + 0];
+            ny[i] = normal[i * 4 + 1];
+            nz[i] = normal[i * 4 + 2];
+        }
+    }, 16 );
+
+    // Without per-sample moments the variance is estimated over the 3x3 neighbourhood, like SVGF
+    // does for pixels with a short history.
+    parallelFor( height, [&]( size_t begin, size_t end )
+    {
+        for( size_t y = begin; y < end; ++y )
+        {
+            const size_t y0 = y > 0 ? y - 1 : 0;
+            const size_t y1 = std::min<size_t>( y + 2, height );
+            for( size_t x = 0; x < width; ++x )
+            {
+                const size_t x0 = x > 0 ? x - 1 : 0;
+                const size_t x1 = std::min<size_t>( x + 2, width );
+                float sum = 0.0f, sumSquares = 0.0f;
+                for( size_t yy = y0; yy < y1; ++yy )
+                    for( size_t xx = x0; xx < x1; ++xx )
+                    {
+                        const float l = src.l[yy * width + xx];
+                        sum        += l;
+                        sumSquares += l * l;
+                    }
+                const float n    = static_cast<float>( ( y1 - y0 ) * ( x1 - x0 ) );
+                const float mean = sum / n;
+                src.var[y * width + x] = std::max( sumSquares / n - mean * mean, 0.0f );
+            }
+        }
+    }, 16 );
+
+    unsigned int squarings = 0;
+    while( ( 1u << squarings ) < settings.normalExponent && squarings < 31 )
+        ++squarings;
+
+    unsigned int current = 0;
+    for( unsigned int iteration = 0; iteration < settings.iterations; ++iteration )
+    {
+        Pass pass;
+        pass.src        = &planes[current];
+        pass.dst        = &planes[current ^ 1];
+        pass.nx         = nx.data();
+        pass.ny         = ny.data();
+        pass.nz         = nz.data();
+        pass.width      = width;
+        pass.height     = height;
+        pass.step       = 1u << std::min( iteration, 30u );
+        pass.colorSigma = settings.colorSigma;
+        pass.squarings  = squarings;
+        parallelFor( height, [&]( size_t begin, size_t end ) { filterRows( pass, begin, end ); }, 4 );
+        current ^= 1;
+    }
+
+    // The albedo goes back onto the filtered irradiance.
+    const Planes& result = planes[current];
+    parallelFor( height, [&]( size_t begin, size_t end )
+    {
+        for( size_t i = begin * width; i < end * width; ++i )
+        {
+            out[i * 4 + 0] = result.r[i] * demodulation[i * 3 + 0];
+            out[i * 4 + 1] = result.g[i] * demodulation[i * 3 + 1];
+            out[i * 4 + 2] = result.b[i] * demodulation[i * 3 + 2];
+            out[i * 4 + 3] = 1.0f;
+        }
+    }, 16 );
+}
@@ -0,0 +1,57 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <sutilapi.h>
+
+namespace sutil
+{
+
+// Edge-aware denoiser for path traced images on the host, after the SVGF spatial filter
+// (Schied et al. 2017) without its temporal part. The color is divided by the first hit
+// albedo, so textures are not blurred, and the remaining irradiance is filtered by a
+// number of a-trous iterations of a 5x5 B3 spline kernel with growing gaps (1, 2, 4, ...).
+// Neighbours only contribute when their normal and their luminance are close; the
+// luminance tolerance follows the local variance, which is filtered along with the color.
+struct DenoiseSettings
+{
+    SUTILAPI DenoiseSettings();
+
+    unsigned int iterations;     // A-trous passes, the filter radius is 2^(iterations+1) - 2 pixels. Default 5.
+    float        colorSigma;     // Luminance tolerance in standard deviations. Default 4.
+    unsigned int normalExponent; // Normal weight max(0, dot)^exponent, rounded up to a power of two. Default 128.
+};
+
+// Denoise RGBA float pixels with their mean first hit albedo (RGBA) and normal (XYZW, unit length),
+// all in the same row order. out receives RGBA with alpha 1 and may be the same array as rgba.
+// Uses SSE2 four pixels at a time where available and runs over rows in parallel.
+SUTILAPI void denoise( const float* rgba, const float* albedo, const float* normal, unsigned int width, unsigned int height,
+                       const DenoiseSettings& settings, float* out );
+
+} // end namespace sutil
@@ -0,0 +1,252 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sutil/FrameWriter.h>
+#include <sutil/ImageWriter.h>
+#include <sutil/Parallel.h>
+#include <sutil/sutil.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+using namespace optix;
+
+namespace
+{
+
+size_t bytesPerPixel( RTformat format )
+{
+    switch( format )
+    {
+        case RT_FORMAT_UNSIGNED_BYTE4: return 4;
+        case RT_FORMAT_FLOAT:          return 4;
+        case RT_FORMAT_FLOAT3:         return 12;
+        case RT_FORMAT_FLOAT4:         return 16;
+        default:
+            throw Exception( "FrameWriter: unsupported buffer format" );
+    }
+}
+
+double secondsSince( const std::chrono::steady_clock::time_point& start )
+{
+    return std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+}
+
+} // end anonymous namespace
+
+
+sutil::FrameWriter::FrameWriter( unsigned int num_threads, unsigned int capacity )
+    : m_busy( 0 ),
+      m_failed( 0 ),
+      m_quit( false ),
+      m_blocked( 0.0 ),
+      m_encode( 0.0 )
+{
+    if( num_threads == 0 )
+        num_threads = numWorkerThreads();
+    capacity = std::max( capacity, num_threads + 1 ); // One frame can be staged while all threads encode.
+
+    for( unsigned int i = 0; i < capacity; ++i )
+    {
+        m_frames.push_back( new Frame() );
+        m_free.push_back( m_frames.back() );
+    }
+    for( unsigned int i = 0; i < num_threads; ++i )
+        m_threads.push_back( std::thread( &FrameWriter::worker, this ) );
+}
+
+
+sutil::FrameWriter::~FrameWriter()
+{
+    flush();
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_quit = true;
+    }
+    m_work.notify_all();
+    for( size_t i = 0; i < m_threads.size(); ++i )
+        m_threads[i].join();
+    for( size_t i = 0; i < m_frames.size(); ++i )
+        delete m_frames[i];
+}
+
+
+sutil::FrameWriter::Frame* sutil::FrameWriter::acquire()
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock( m_mutex );
+    m_done.wait( lock, [this]() { return !m_free.empty(); } );
+    Frame* frame = m_free.back();
+    m_free.pop_back();
+    m_blocked += secondsSince( start );
+    return frame;
+}
+
+
+void sutil::FrameWriter::write( const std::string& filename, Buffer buffer )
+{
+    RTsize width, height;
+    buffer->getSize( width, height );
+
+    const void* data = buffer->map( 0, RT_BUFFER_MAP_READ );
+    try
+    {
+        write( filename, data, static_cast<unsigned int>( width ), static_cast<unsigned int>( height ), buffer->getFormat() );
+    }
+    catch( ... )
+    {
+        buffer->unmap();
+        throw;
+    }
+    buffer->unmap();
+}
+
+
+void sutil::FrameWriter::write( const std::string& filename, const void* data, unsigned int width, unsigned int height, RTformat format )
+{
+    const size_t size = bytesPerPixel( format ) * width * height;
+
+    Frame* frame = acquire();
+
+    // Copying into the staging buffer is the only work left on the caller's thread.
+    frame->filename = filename;
+    frame->width    = width;
+    frame->height   = height;
+    frame->format   = format;
+    frame->data.resize( size );
+    memcpy( frame->data.data(), data, size );
+
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_queue.push_back( frame );
+    }
+    m_work.notify_one();
+}
+
+
+unsigned int sutil::FrameWriter::flush()
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    m_done.wait( lock, [this]() { return m_queue.empty() && m_busy == 0; } );
+    const unsigned int failed = m_failed;
+    m_failed = 0;
+    return failed;
+}
+
+
+void sutil::FrameWriter::worker()
+{
+    for( ;; )
+    {
+        Frame* frame;
+        {
+            std::unique_lock<std::mutex> lock( m_mutex );
+            m_work.wait( lock, [this]() { return m_quit || !m_queue.empty(); } );
+            if( m_queue.empty() )
+                return; // m_quit
+            frame = m_queue.front();
+            m_queue.pop_front();
+            ++m_busy;
+        }
+
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        bool success = false;
+        try
+        {
+            if( frame->format == RT_FORMAT_FLOAT3 || frame->format == RT_FORMAT_FLOAT4 )
+            {
+                success = writeFloatImageToFile( frame->filename.c_str(), reinterpret_cast<const float*>( frame->data.data() ),
+                                                 frame->width, frame->height, frame->format == RT_FORMAT_FLOAT3 ? 3 : 4 );
+            }
+            else
+            {
+                writeImageToFile( frame->filename.c_str(), frame->data.data(), frame->width, frame->height, frame->format );
+                success = true;
+            }
+        }
+        catch( const Exception& e )
+        {
+            std::cerr << "ERROR: FrameWriter: " << e.getErrorString() << std::endl;
+        }
+        const double seconds = secondsSince( start );
+
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            if( !success )
+                ++m_failed;
+            m_encode += seconds;
+            --m_busy;
+            m_free.push_back( frame );
+        }
+        m_done.notify_all();
+    }
+}
+
+
+double sutil::FrameWriter::blockedSeconds() const
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    return m_blocked;
+}
+
+
+double sutil::FrameWriter::encodeSeconds() const
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    return m_encode;
+}
+
+
+std::string sutil::FrameWriter::sequenceFilename( const std::string& pattern, unsigned int index )
+{
+    char number[32];
+
+    const size_t percent = pattern.find( '%' );
+    if( percent != std::string::npos )
+    {
+        // Only a flag/width specification followed by 'd' or 'u' is accepted.
+        const size_t conversion = pattern.find_first_not_of( "0123456789", percent + 1 );
+        if( conversion != std::string::npos && ( pattern[conversion] == 'd' || pattern[conversion] == 'u' ) )
+        {
+            const std::string spec = pattern.substr( percent, conversion - percent ) + "u";
+            snprintf( number, sizeof( number ), spec.c_str(), index );
+            return pattern.substr( 0, percent ) + number + pattern.substr( conversion + 1 );
+        }
+    }
+
+    snprintf( number, sizeof( number ), "_%04u", index );
+    const size_t dot   = pattern.rfind( '.' );
+    const size_t slash = pattern.find_last_of( "/\\" );
+    if( dot == std::string::npos || ( slash != std::string::npos && dot < slash ) )
+        return pattern + number;
+    return pattern.substr( 0, dot ) + number + pattern.substr( dot );
+}
@@ -0,0 +1,102 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <optixu/optixpp_namespace.h>
+#include <sutilapi.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sutil
+{
+
+// Asynchronous image output. write() copies a frame into a staging buffer and
+// returns, encoder threads write the files in the background. At most 'capacity'
+// frames are staged at a time, write() blocks until a staging buffer is free
+// (backpressure), which bounds the memory held by a fast renderer.
+//
+// Float buffers (FLOAT3, FLOAT4) are written with writeFloatImageToFile(),
+// everything else with writeImageToFile().
+class FrameWriter
+{
+public:
+    // num_threads == 0 uses numWorkerThreads(). capacity is raised to at least num_threads + 1.
+    SUTILAPI FrameWriter( unsigned int num_threads = 0, unsigned int capacity = 0 );
+    SUTILAPI ~FrameWriter(); // Flushes.
+
+    SUTILAPI void write( const std::string& filename, optix::Buffer buffer );
+    SUTILAPI void write( const std::string& filename, const void* data, unsigned int width, unsigned int height, RTformat format );
+
+    // Waits until all staged frames are written. Returns the number of frames which failed since the last flush().
+    SUTILAPI unsigned int flush();
+
+    SUTILAPI double blockedSeconds() const; // Total time write() waited for a free staging buffer.
+    SUTILAPI double encodeSeconds() const;  // Total time spent encoding and writing files, summed over all threads.
+
+    // Frame 'index' of a sequence. A printf style integer conversion in pattern (e.g. "frame_%04d.png")
+    // is replaced by index, otherwise "_%04d" is inserted before the extension.
+    SUTILAPI static std::string sequenceFilename( const std::string& pattern, unsigned int index );
+
+private:
+    struct Frame
+    {
+        std::string                filename;
+        unsigned int               width;
+        unsigned int               height;
+        RTformat                   format;
+        std::vector<unsigned char> data;
+    };
+
+    FrameWriter( const FrameWriter& );
+    FrameWriter& operator=( const FrameWriter& );
+
+    Frame* acquire();
+    void   worker();
+
+    std::vector<std::thread>  m_threads;
+    std::vector<Frame*>       m_frames;  // All staging buffers, owned.
+    std::vector<Frame*>       m_free;
+    std::deque<Frame*>        m_queue;
+    unsigned int              m_busy;    // Frames being encoded.
+    unsigned int              m_failed;
+    bool                      m_quit;
+    double                    m_blocked;
+    double                    m_encode;
+
+    mutable std::mutex        m_mutex;
+    std::condition_variable   m_work;    // Signals queued frames and m_quit.
+    std::condition_variable   m_done;    // Signals released staging buffers.
+};
+
+} // end namespace sutil
@@ -27,30 +27,30 @@
  */
 
 #include "HDRLoader.h"
+#include "HalfFloat.h"
+#include "Parallel.h"
 
 #include <math.h>
-#include <fstream>
 #include <iostream>
 #include <string>
 #include <cstdlib>
-
-//-----------------------------------------------------------------------------
-//  
-//  HDRLoader class definition
-//
-//-----------------------------------------------------------------------------
-
-void HDRLoader::getLine( std::ifstream& file_in, std::string& s )
-{
-  for (;;) {
-    if ( !std::getline( file_in, s ) )
-      return;
-    if(s.empty()) return;
-    std::string::size_type index = s.find_first_not_of( "\n\r\t " );
-    if ( index != std::string::npos && s[index] != '#' )
-      break;
-  }
-}
+#include <cstdio>
+#include <cstring>
+
+#if defined(_WIN32)
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
 
 namespace {
 
@@ -79,118 +79,263 @@ namespace {
       FV[1] = (RV.g + 0.5f)*s;
       FV[2] = (RV.b + 0.5f)*s;
     }
+    FV[3] = 1.0f;
   }
 
-
-  void ReadScanlineNoRLE(std::ifstream &inf, RGBe *RGBEline, const size_t wid)
+  inline bool IsRLEScanline(const unsigned char* p, const unsigned char* end, const size_t wid)
   {
-    inf.read(reinterpret_cast<char *>(RGBEline), wid * sizeof(RGBe));
-    if(inf.eof()) throw HDRError("Premature file end in ReadScanlineNoRLE");
+    const size_t MinLen = 8, MaxLen = 0x7fff;
+    if(wid<MinLen || wid>MaxLen) return false;
+    if(end - p < 4) throw HDRError("Premature file end in scanline header");
+    return p[0] == 2 && p[1] == 2 && !(p[2]&0x80); // Otherwise an old-format scanline.
   }
 
-  void ReadScanline(std::ifstream &inf, RGBe *RGBEline, const size_t wid)
+  // Returns the size of the scanline starting at p without decoding it.
+  size_t SkipScanline(const unsigned char* p, const unsigned char* end, const size_t wid)
   {
-    const size_t MinLen = 8, MaxLen = 0x7fff;
-    if(wid<MinLen || wid>MaxLen) return ReadScanlineNoRLE(inf, RGBEline, wid);
-    char c0, c1, c2, c3;
-    inf.get(c0);
-    inf.get(c1);
-    inf.get(c2);
-    inf.get(c3);
-    if(inf.eof()) throw HDRError("Premature file end in ReadScanline 1");
-    if(c0 != 2 || c1 != 2 || (c2&0x80)) {
-      inf.putback(c3);
-      inf.putback(c2);
-      inf.putback(c1);
-      inf.putback(c0);
-      return ReadScanlineNoRLE(inf, RGBEline, wid); // Found an old-format scanline
+    if(!IsRLEScanline(p, end, wid)) {
+      if(size_t(end - p) < wid * sizeof(RGBe)) throw HDRError("Premature file end in raw scanline");
+      return wid * sizeof(RGBe);
     }
 
-    if(size_t(size_t(c2)<<8 | size_t(c3)) != wid) throw HDRError("Scanline width inconsistent");
+    if((size_t(p[2])<<8 | size_t(p[3])) != wid) throw HDRError("Scanline width inconsistent");
 
-    // This scanline is RLE.
+    const unsigned char* q = p + 4;
     for(unsigned int ch=0; ch<4; ch++) {
-      for(unsigned int x=0; x<wid; ) {
-        unsigned char code;
-        inf.get(reinterpret_cast<char &>(code));
-        if(inf.eof()) throw HDRError("Premature file end in ReadScanline 2");
+      for(size_t x=0; x<wid; ) {
+        if(q >= end) throw HDRError("Premature file end in RLE scanline");
+        const unsigned char code = *q++;
+        size_t count;
         if(code > 0x80) { // RLE span
-          char pix;
-          inf.get(pix);
-          if(inf.eof()) throw HDRError("Premature file end in ReadScanline 3");
+          count = code & 0x7f;
+          q += 1;
+        } else { // Arbitrary span
+          count = code;
+          q += count;
+        }
+        if(count == 0 || x + count > wid) throw HDRError("Invalid run length in RLE scanline");
+        if(q > end) throw HDRError("Premature file end in RLE scanline");
+        x += count;
+      }
+    }
+    return size_t(q - p);
+  }
+
+  // The scanline has been validated by SkipScanline() already.
+  void DecodeScanline(const unsigned char* p, const unsigned char* end, RGBe *RGBEline, const size_t wid)
+  {
+    if(!IsRLEScanline(p, end, wid)) {
+      memcpy(RGBEline, p, wid * sizeof(RGBe));
+      return;
+    }
+
+    const unsigned char* q = p + 4;
+    for(unsigned int ch=0; ch<4; ch++) {
+      for(size_t x=0; x<wid; ) {
+        unsigned char code = *q++;
+        if(code > 0x80) { // RLE span
+          const unsigned char pix = *q++;
           code = code & 0x7f;
           while(code--)
             RGBEline[x++].v[ch] = pix;
         } else { // Arbitrary span
-          while(code--) {
-            inf.get(reinterpret_cast<char &>(RGBEline[x++].v[ch]));
-            if(inf.eof()) throw HDRError("Premature file end in ReadScanline 4");
-          }
+          while(code--)
+            RGBEline[x++].v[ch] = *q++;
         }
       }
     }
   }
+
+  // Reads one header line starting at pos. Returns false at the end of the data.
+  bool HeaderLine(const unsigned char* data, size_t size, size_t& pos, std::string& s)
+  {
+    if(pos >= size) return false;
+    const size_t begin = pos;
+    while(pos < size && data[pos] != '\n') ++pos;
+    s.assign(reinterpret_cast<const char*>(data) + begin, pos - begin);
+    if(!s.empty() && s[s.size()-1] == '\r') s.erase(s.size()-1);
+    if(pos < size) ++pos; // Skip the newline.
+    return true;
+  }
 };
 
-HDRLoader::HDRLoader( const std::string& filename )
-: m_nx( 0u ), m_ny( 0u ), m_raster( 0 )
+//-----------------------------------------------------------------------------
+//  
+//  HDRFile class definition
+//
+//-----------------------------------------------------------------------------
+
+HDRFile::HDRFile( const std::string& filename )
+: m_nx( 0u ), m_ny( 0u ), m_exposure( 1.0f ), m_data( 0 ), m_size( 0 )
+#if defined(_WIN32)
+, m_file( INVALID_HANDLE_VALUE ), m_mapping( 0 )
+#endif
 {
   if ( filename.empty() ) return;
 
-  // Open file
   try {
-    std::ifstream inf(filename.c_str(), std::ios::binary);
-
-    if(!inf.is_open()) throw HDRError("Couldn't open file " + filename);
-
-    std::string magic, comment;
-    float exposure = 1.0f;
-
-    std::getline(inf, magic);
-    if(magic != "#?RADIANCE") throw HDRError("File isn't Radiance.");
+#if defined(_WIN32)
+    m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(m_file == INVALID_HANDLE_VALUE) throw HDRError("Couldn't open file " + filename);
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(m_file, &size) || size.QuadPart == 0) throw HDRError("Couldn't get the size of " + filename);
+    m_size = size_t(size.QuadPart);
+    m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(!m_mapping) throw HDRError("Couldn't map file " + filename);
+    m_data = static_cast<const unsigned char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if(!m_data) throw HDRError("Couldn't map file " + filename);
+#else
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0) throw HDRError("Couldn't open file " + filename);
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size == 0) {
+      close(fd);
+      throw HDRError("Couldn't get the size of " + filename);
+    }
+    m_size = size_t(info.st_size);
+    void* data = mmap(0, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file referenced.
+    if(data == MAP_FAILED) throw HDRError("Couldn't map file " + filename);
+    m_data = static_cast<const unsigned char*>(data);
+    madvise(data, m_size, MADV_WILLNEED);
+#endif
+
+    size_t pos = 0;
+    std::string line;
+
+    if(!HeaderLine(m_data, m_size, pos, line) || line != "#?RADIANCE") throw HDRError("File isn't Radiance.");
     for (;;) {
-      getLine(inf, comment);
-
-      // VS2010 doesn't let you look at the 0th element of a 0 length string, so this was tripping
-      // debug asserts
-      if (comment.empty()) break;
-      if(comment[0] == '#') continue;
+      if(!HeaderLine(m_data, m_size, pos, line)) throw HDRError("Premature file end in header");
+      if(line.empty()) break;
+      if(line[0] == '#') continue;
 
-      if(comment.find("FORMAT") != std::string::npos) {
-        if(comment != "FORMAT=32-bit_rle_rgbe") throw HDRError("Can only handle RGBe, not XYZe.");
+      if(line.find("FORMAT") != std::string::npos) {
+        if(line != "FORMAT=32-bit_rle_rgbe") throw HDRError("Can only handle RGBe, not XYZe.");
         continue;
       }
 
-      size_t ofs = comment.find("EXPOSURE=");
+      size_t ofs = line.find("EXPOSURE=");
       if(ofs != std::string::npos) {
-        exposure = (float)atof(comment.c_str()+ofs+9);
+        m_exposure = (float)atof(line.c_str()+ofs+9);
       }
     }
-    
-    std::string major, minor;
-    inf >> minor >> m_ny >> major >> m_nx;
-    if(minor != "-Y" || major != "+X") throw "Can only handle -Y +X ordering";
-    if(m_nx <= 0 || m_ny <= 0) throw "Invalid image dimensions";
-    getLine(inf, comment); // Read the last newline of the header
-
-    RGBe *RGBERaster = new RGBe[m_nx * m_ny];
 
+    if(!HeaderLine(m_data, m_size, pos, line)) throw HDRError("Premature file end in header");
+    char minor[8], major[8];
+    int ny = 0, nx = 0;
+    if(sscanf(line.c_str(), "%7s %d %7s %d", minor, &ny, major, &nx) != 4) throw HDRError("Invalid resolution string");
+    if(std::string(minor) != "-Y" || std::string(major) != "+X") throw HDRError("Can only handle -Y +X ordering");
+    if(nx <= 0 || ny <= 0) throw HDRError("Invalid image dimensions");
+    m_nx = unsigned(nx);
+    m_ny = unsigned(ny);
+
+    // Scanlines have variable length with RLE. Walking the run lengths is cheap compared to decoding.
+    m_scanlines.resize(m_ny + 1);
+    const unsigned char* end = m_data + m_size;
     for(unsigned int y=0; y<m_ny; y++) {
-      ReadScanline(inf, RGBERaster + m_nx*y, m_nx);
+      m_scanlines[y] = pos;
+      pos += SkipScanline(m_data + pos, end, m_nx);
     }
+    m_scanlines[m_ny] = pos;
+  } catch ( const HDRError& err  ) {
+    std::cerr << "HDRFile( '" << filename << "' ) failed to load file: " << err.Er << '\n';
+    unmap();
+    m_nx = m_ny = 0;
+    m_scanlines.clear();
+  }
+}
 
-    m_raster = new float[m_nx * m_ny * 4];
 
-    float inv_img_exposure = 1.0f / exposure;
-    for(unsigned int i=0; i<m_nx*m_ny; i++) {
-      RGBEtoFloats(RGBERaster[i], m_raster + i*4, inv_img_exposure);
+HDRFile::~HDRFile()
+{
+  unmap();
+}
+
+
+void HDRFile::unmap()
+{
+#if defined(_WIN32)
+  if(m_data) UnmapViewOfFile(m_data);
+  if(m_mapping) CloseHandle(m_mapping);
+  if(m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+  m_mapping = 0;
+  m_file = INVALID_HANDLE_VALUE;
+#else
+  if(m_data) munmap(const_cast<unsigned char*>(m_data), m_size);
+#endif
+  m_data = 0;
+  m_size = 0;
+}
+
+
+bool HDRFile::failed()const
+{
+  return m_data == 0;
+}
+
+
+unsigned int HDRFile::width()const
+{
+  return m_nx;
+}
+
+
+unsigned int HDRFile::height()const
+{
+  return m_ny;
+}
+
+
+bool HDRFile::decode( void* dst, bool use_half, bool flip_y )const
+{
+  if(failed() || !dst) return false;
+
+  const float inv_img_exposure = 1.0f / m_exposure;
+  const unsigned char* end = m_data + m_size;
+
+  sutil::parallelFor( m_ny, [&]( size_t begin, size_t finish )
+  {
+    std::vector<RGBe> line(m_nx);
+    for(size_t y=begin; y<finish; y++) {
+      DecodeScanline(m_data + m_scanlines[y], end, line.data(), m_nx);
+
+      const size_t row = flip_y ? m_ny - 1 - y : y;
+      if(use_half) {
+        unsigned short* out = static_cast<unsigned short*>(dst) + row * m_nx * 4;
+        float texel[4];
+        for(unsigned int x=0; x<m_nx; x++) {
+          RGBEtoFloats(line[x], texel, inv_img_exposure);
+          for(unsigned int c=0; c<4; c++)
+            out[x*4 + c] = sutil::floatToHalf(texel[c]);
+        }
+      } else {
+        float* out = static_cast<float*>(dst) + row * m_nx * 4;
+        for(unsigned int x=0; x<m_nx; x++)
+          RGBEtoFloats(line[x], out + x*4, inv_img_exposure);
+      }
     }
-    delete[] RGBERaster;
-  } catch ( const HDRError& err  ) {
-    std::cerr << "HDRLoader( '" << filename << "' ) failed to load file: " << err.Er << '\n';
-    delete [] m_raster;
-    m_raster = 0;
-  }
+  }, 16 );
+
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+//  
+//  HDRLoader class definition
+//
+//-----------------------------------------------------------------------------
+
+HDRLoader::HDRLoader( const std::string& filename )
+: m_nx( 0u ), m_ny( 0u ), m_raster( 0 )
+{
+  HDRFile file( filename );
+  if ( file.failed() ) return;
+
+  m_nx = file.width();
+  m_ny = file.height();
+  m_raster = new float[size_t(m_nx) * m_ny * 4];
+  file.decode( m_raster, false, false );
 }
 
 
@@ -232,7 +377,8 @@ float* HDRLoader::raster()const
 
 optix::TextureSampler loadHDRTexture( optix::Context context,
                                       const std::string& filename,
-                                      const optix::float3& default_color )
+                                      const optix::float3& default_color,
+                                      bool use_half )
 {
   // Create tex sampler and populate with default values
   optix::TextureSampler sampler = context->createTextureSampler();
@@ -246,7 +392,7 @@ optix::TextureSampler loadHDRTexture( optix::Context context,
   sampler->setArraySize( 1u );
 
   // Read in HDR, set texture buffer to empty buffer if fails
-  HDRLoader hdr( filename );
+  HDRFile hdr( filename );
   if ( hdr.failed() ) {
 
     // Create buffer with single texel set to default_color
@@ -270,23 +416,9 @@ optix::TextureSampler loadHDRTexture( optix::Context context,
   const unsigned int nx = hdr.width();
   const unsigned int ny = hdr.height();
 
-  // Create buffer and populate with HDR data
-  optix::Buffer buffer = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_FLOAT4, nx, ny );
-  float* buffer_data = static_cast<float*>( buffer->map() );
-
-  for ( unsigned int i = 0; i < nx; ++i ) {
-    for ( unsigned int j = 0; j < ny; ++j ) {
-
-      unsigned int hdr_index = ( (ny-j-1)*nx + i )*4;
-      unsigned int buf_index = ( (j     )*nx + i )*4;
-
-      buffer_data[ buf_index + 0 ] = hdr.raster()[ hdr_index + 0 ];
-      buffer_data[ buf_index + 1 ] = hdr.raster()[ hdr_index + 1 ];
-      buffer_data[ buf_index + 2 ] = hdr.raster()[ hdr_index + 2 ];
-      buffer_data[ buf_index + 3 ] = hdr.raster()[ hdr_index + 3 ];
-    }
-  }
-
+  // Create buffer and decode the HDR data directly into it, flipped to bottom-up rows.
+  optix::Buffer buffer = context->createBuffer( RT_BUFFER_INPUT, use_half ? RT_FORMAT_HALF4 : RT_FORMAT_FLOAT4, nx, ny );
+  hdr.decode( buffer->map(), use_half, true );
   buffer->unmap();
 
   sampler->setBuffer( 0u, 0u, buffer );
@@ -294,4 +426,3 @@ optix::TextureSampler loadHDRTexture( optix::Context context,
 
   return sampler;
 }
-
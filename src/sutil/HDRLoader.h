@@ -31,7 +31,7 @@
 #include <optixu/optixpp_namespace.h>
 #include <sutil.h>
 #include <string>
-#include <iosfwd>
+#include <vector>
 
 //-----------------------------------------------------------------------------
 //
@@ -42,9 +42,11 @@
 // Creates a TextureSampler object for the given HDR file.  If filename is 
 // empty or HDRLoader fails, a 1x1 texture is created with the provided default
 // texture color.
+// use_half stores the texels as RGBA16F (RT_FORMAT_HALF4) instead of RGBA32F.
 SUTILAPI optix::TextureSampler loadHDRTexture( optix::Context context,
                                                const std::string& hdr_filename,
-                                               const optix::float3& default_color );
+                                               const optix::float3& default_color,
+                                               bool use_half = false );
 
 
 //-----------------------------------------------------------------------------
@@ -69,6 +71,47 @@ private:
   unsigned int   m_ny;
   float*         m_raster;
 
-  static void getLine( std::ifstream& file_in, std::string& s );
+};
+
+
+//-----------------------------------------------------------------------------
+//
+// HDRFile class declaration
+//
+//-----------------------------------------------------------------------------
+
+// Memory mapped Radiance HDR file. The constructor parses the header and
+// finds the start of every scanline without decoding it. decode() then
+// expands all scanlines in parallel straight into the destination, so no
+// intermediate RGBe or float raster is needed.
+class HDRFile
+{
+public:
+  SUTILAPI HDRFile( const std::string& filename );
+  SUTILAPI ~HDRFile();
+
+  SUTILAPI bool           failed()const;
+  SUTILAPI unsigned int   width()const;
+  SUTILAPI unsigned int   height()const;
+
+  // dst receives width() * height() RGBA texels, as float or as half (unsigned short) when use_half is set.
+  // flip_y stores the top scanline of the file in the last row, the order OptiX textures expect.
+  SUTILAPI bool           decode( void* dst, bool use_half, bool flip_y )const;
+
+private:
+  HDRFile( const HDRFile& );
+  HDRFile& operator=( const HDRFile& );
+
+  void unmap();
 
+  unsigned int          m_nx;
+  unsigned int          m_ny;
+  float                 m_exposure;
+  const unsigned char*  m_data;
+  size_t                m_size;
+  std::vector<size_t>   m_scanlines; // Offset of each scanline, plus the end of the last one.
+#if defined(_WIN32)
+  void*                 m_file;
+  void*                 m_mapping;
+#endif
 };
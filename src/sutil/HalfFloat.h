@@ -0,0 +1,103 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstring>
+
+// IEEE 754 binary16 conversions for host side storage of RGBA16F data (RT_FORMAT_HALF*).
+
+namespace sutil
+{
+
+// Round to nearest even. Values beyond the half range become infinity, NaN stays NaN.
+inline unsigned short floatToHalf( float f )
+{
+    unsigned int u;
+    memcpy( &u, &f, sizeof( u ) );
+
+    const unsigned int sign = ( u >> 16 ) & 0x8000u;
+    const unsigned int absu = u & 0x7FFFFFFFu;
+
+    if( absu >= 0x7F800000u ) // Inf or NaN
+        return static_cast<unsigned short>( sign | 0x7C00u | ( absu > 0x7F800000u ? 0x200u : 0u ) );
+    if( absu >= 0x477FF000u ) // Rounds to above 65504
+        return static_cast<unsigned short>( sign | 0x7C00u );
+    if( absu < 0x38800000u ) // Denormal or zero in half
+    {
+        if( absu < 0x33000000u ) // Less than half the smallest denormal
+            return static_cast<unsigned short>( sign );
+        const unsigned int mantissa = ( absu & 0x007FFFFFu ) | 0x00800000u;
+        const unsigned int shift    = 126u - ( absu >> 23 );        // 14 to 24
+        unsigned int       h        = mantissa >> shift;
+        const unsigned int rest     = mantissa & ( ( 1u << shift ) - 1u );
+        const unsigned int halfway  = 1u << ( shift - 1u );
+        if( rest > halfway || ( rest == halfway && ( h & 1u ) ) )
+            ++h;
+        return static_cast<unsigned short>( sign | h );
+    }
+
+    // Normal: rebias the exponent and round the 13 dropped mantissa bits.
+    unsigned int h = ( absu - 0x38000000u ) >> 13;
+    const unsigned int rest = absu & 0x1FFFu;
+    if( rest > 0x1000u || ( rest == 0x1000u && ( h & 1u ) ) )
+        ++h; // A carry into the exponent is the correct rounding.
+    return static_cast<unsigned short>( sign | h );
+}
+
+inline float halfToFloat( unsigned short h )
+{
+    const unsigned int sign     = ( h & 0x8000u ) << 16;
+    const unsigned int exponent = ( h >> 10 ) & 0x1Fu;
+    unsigned int       mantissa = h & 0x3FFu;
+    unsigned int       u;
+
+    if( exponent == 0x1Fu )
+        u = sign | 0x7F800000u | ( mantissa << 13 );
+    else if( exponent != 0 )
+        u = sign | ( ( exponent + 112u ) << 23 ) | ( mantissa << 13 );
+    else if( mantissa == 0 )
+        u = sign;
+    else
+    {
+        // Denormal half, normalize.
+        unsigned int e = 113u;
+        while( !( mantissa & 0x400u ) )
+        {
+            mantissa <<= 1;
+            --e;
+        }
+        u = sign | ( e << 23 ) | ( ( mantissa & 0x3FFu ) << 13 );
+    }
+
+    float f;
+    memcpy( &f, &u, sizeof( f ) );
+    return f;
+}
+
+} // end namespace sutil
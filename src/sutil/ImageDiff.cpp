@@ -0,0 +1,694 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sutil/ImageDiff.h>
+#include <sutil/ColorSpace.h>
+#include <sutil/Parallel.h>
+#include <sutil/Profiler.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#  define SUTIL_IMAGEDIFF_SSE2 1
+#  include <emmintrin.h>
+#endif
+
+namespace
+{
+
+const size_t kRowGrain = 8;
+const float  kPi       = 3.14159265358979f;
+
+// SSIM constants for a dynamic range of 1.
+const float kSsimC1 = 0.01f * 0.01f;
+const float kSsimC2 = 0.03f * 0.03f;
+
+// LDR-FLIP constants.
+const float kFlipQc           = 0.7f;   // Exponent of the colour difference, the one of the feature difference is 0.5.
+const float kFlipPc           = 0.4f;   // Fraction of the maximal colour difference ...
+const float kFlipPt           = 0.95f;  // ... which is mapped to this error.
+const float kFlipFeatureWidth = 0.082f; // Degrees.
+
+// White point of linear sRGB (D65) in XYZ.
+const float kWhiteX = 0.9504559f;
+const float kWhiteY = 1.0f;
+const float kWhiteZ = 1.0890578f;
+
+
+float sum( const std::vector<float>& values )
+{
+    float s = 0.0f;
+    for( size_t i = 0; i < values.size(); ++i )
+        s += values[i];
+    return s;
+}
+
+// Gaussian of the given sigma, normalised.
+std::vector<float> gaussianKernel( int radius, float sigma )
+{
+    std::vector<float> kernel( 2 * radius + 1 );
+    for( int i = -radius; i <= radius; ++i )
+        kernel[i + radius] = expf( -float( i * i ) / ( 2.0f * sigma * sigma ) );
+    const float s = sum( kernel );
+    for( size_t i = 0; i < kernel.size(); ++i )
+        kernel[i] /= s;
+    return kernel;
+}
+
+// 1 for symmetric kernels (Gaussians), -1 for antisymmetric ones (first derivatives), 0 otherwise.
+float kernelSymmetry( const std::vector<float>& kernel )
+{
+    bool symmetric = true, antisymmetric = true;
+    for( size_t i = 0; i < kernel.size(); ++i )
+    {
+        symmetric     = symmetric && kernel[i] == kernel[kernel.size() - 1 - i];
+        antisymmetric = antisymmetric && kernel[i] == -kernel[kernel.size() - 1 - i];
+    }
+    return symmetric ? 1.0f : antisymmetric ? -1.0f : 0.0f;
+}
+
+// out[x] = sum of kernel[k] * taps[k][x] over the taps. Mirrored taps of (anti)symmetric kernels are combined
+// before the multiplication, which halves the work of the usual kernels. The loops vectorize.
+void weightTaps( const float* const* taps, const std::vector<float>& kernel, float symmetry, unsigned int width, float* out )
+{
+    const size_t n = kernel.size();
+    if( symmetry == 0.0f )
+    {
+        std::fill( out, out + width, 0.0f );
+        for( size_t k = 0; k < n; ++k )
+        {
+            const float  weight = kernel[k];
+            const float* in     = taps[k];
+            for( unsigned int x = 0; x < width; ++x )
+                out[x] += weight * in[x];
+        }
+        return;
+    }
+
+    const size_t r      = n / 2;
+    const float  centre = kernel[r];
+    const float* middle = taps[r];
+    for( unsigned int x = 0; x < width; ++x )
+        out[x] = centre * middle[x];
+    for( size_t j = 1; j <= r; ++j )
+    {
+        const float  weight = kernel[r + j];
+        const float* a      = taps[r + j];
+        const float* b      = taps[r - j];
+        for( unsigned int x = 0; x < width; ++x )
+            out[x] += weight * ( a[x] + symmetry * b[x] );
+    }
+}
+
+// Separable convolution of one plane into another. Both kernels have an odd number of taps centred on the pixel,
+// pixels outside the image repeat the border. Each chunk of rows keeps the horizontally filtered rows under the
+// vertical kernel in a ring buffer, so no intermediate plane is written.
+void convolve( const float* src, float* dst, unsigned int width, unsigned int height, const std::vector<float>& kx,
+               const std::vector<float>& ky )
+{
+    const int   rx = static_cast<int>( kx.size() / 2 );
+    const int   ry = static_cast<int>( ky.size() / 2 );
+    const float sx = kernelSymmetry( kx );
+    const float sy = kernelSymmetry( ky );
+    const int   h  = static_cast<int>( height );
+
+    sutil::parallelFor( height, [&]( size_t begin, size_t end ) {
+        std::vector<float>        padded( width + 2 * rx );
+        std::vector<float>        ring( ky.size() * width );
+        std::vector<const float*> taps( std::max( kx.size(), ky.size() ) );
+
+        // Row r is kept in slot r % ky.size(), which holds the rows under the kernel apart.
+        int next = std::max( static_cast<int>( begin ) - ry, 0 ); // Next row to filter horizontally.
+        for( int y = static_cast<int>( begin ); y < static_cast<int>( end ); ++y )
+        {
+            for( const int last = std::min( y + ry, h - 1 ); next <= last; ++next )
+            {
+                const float* row = src + size_t( next ) * width;
+                std::fill( padded.begin(), padded.begin() + rx, row[0] );
+                std::copy( row, row + width, padded.begin() + rx );
+                std::fill( padded.begin() + rx + width, padded.end(), row[width - 1] );
+                for( size_t k = 0; k < kx.size(); ++k )
+                    taps[k] = &padded[k];
+                weightTaps( taps.data(), kx, sx, width, &ring[( next % ky.size() ) * width] );
+            }
+            for( int k = -ry; k <= ry; ++k )
+                taps[k + ry] = &ring[( std::min( std::max( y + k, 0 ), h - 1 ) % ky.size() ) * width];
+            weightTaps( taps.data(), ky, sy, width, dst + size_t( y ) * width );
+        }
+    }, 32 );
+}
+
+// Filters a plane through a scratch plane, which receives the old values.
+void convolveInPlace( std::vector<float>& plane, std::vector<float>& scratch, unsigned int width, unsigned int height,
+                      const std::vector<float>& kx, const std::vector<float>& ky )
+{
+    scratch.resize( plane.size() );
+    convolve( plane.data(), scratch.data(), width, height, kx, ky );
+    plane.swap( scratch );
+}
+
+// Sum of the per row values in row order.
+double rowSum( const std::vector<double>& rows )
+{
+    double s = 0.0;
+    for( size_t i = 0; i < rows.size(); ++i )
+        s += rows[i];
+    return s;
+}
+
+// Decodes sRGB values in [0, 1] by linear interpolation in a table, within 1e-7 of srgbToLinear() but without a
+// pow() per value.
+class SrgbDecoder
+{
+public:
+    SrgbDecoder() : m_table( kIntervals + 2 )
+    {
+        for( unsigned int i = 0; i <= kIntervals; ++i )
+            m_table[i] = sutil::srgbToLinear( float( i ) / kIntervals );
+        m_table[kIntervals + 1] = m_table[kIntervals];
+    }
+
+    float operator()( float c ) const
+    {
+        const float        s = std::min( std::max( c, 0.0f ), 1.0f ) * kIntervals;
+        const unsigned int i = static_cast<unsigned int>( s );
+        return m_table[i] + ( s - i ) * ( m_table[i + 1] - m_table[i] );
+    }
+
+private:
+    static const unsigned int kIntervals = 4096;
+    std::vector<float>        m_table;
+};
+
+// Clamped and sRGB encoded copy of a linear image.
+void encodeSrgb( const std::vector<float>& linear, std::vector<float>& encoded )
+{
+    encoded.resize( linear.size() );
+    sutil::parallelFor( linear.size(), [&]( size_t begin, size_t end ) {
+        for( size_t i = begin; i < end; ++i )
+            encoded[i] = sutil::linearToSrgb( std::min( std::max( linear[i], 0.0f ), 1.0f ) );
+    }, 1 << 16 );
+}
+
+
+//------------------------------------------------------------------------------
+//
+//  Pixel differences
+//
+//------------------------------------------------------------------------------
+
+struct RowDiff
+{
+    double abs_sum;
+    double squared_sum;
+    float  max_abs;
+    double max_relative;
+    size_t differing;
+};
+
+// Absolute differences of n values into out. Returns the sums of one row, accumulated in float within the row.
+RowDiff diffRow( const float* a, const float* b, size_t n, float* out )
+{
+    float  abs_sum = 0.0f, squared_sum = 0.0f, max_abs = 0.0f;
+    size_t i       = 0;
+#if SUTIL_IMAGEDIFF_SSE2
+    const __m128 sign    = _mm_set1_ps( -0.0f );
+    __m128       vabs    = _mm_setzero_ps();
+    __m128       vsquare = _mm_setzero_ps();
+    __m128       vmax    = _mm_setzero_ps();
+    for( ; i + 4 <= n; i += 4 )
+    {
+        const __m128 d  = _mm_sub_ps( _mm_loadu_ps( b + i ), _mm_loadu_ps( a + i ) );
+        const __m128 ad = _mm_andnot_ps( sign, d );
+        vabs    = _mm_add_ps( vabs, ad );
+        vsquare = _mm_add_ps( vsquare, _mm_mul_ps( d, d ) );
+        vmax    = _mm_max_ps( vmax, ad );
+        _mm_storeu_ps( out + i, ad );
+    }
+    float lanes[4];
+    _mm_storeu_ps( lanes, vabs );
+    abs_sum = ( lanes[0] + lanes[1] ) + ( lanes[2] + lanes[3] );
+    _mm_storeu_ps( lanes, vsquare );
+    squared_sum = ( lanes[0] + lanes[1] ) + ( lanes[2] + lanes[3] );
+    _mm_storeu_ps( lanes, vmax );
+    max_abs = std::max( std::max( lanes[0], lanes[1] ), std::max( lanes[2], lanes[3] ) );
+#endif
+    for( ; i < n; ++i )
+    {
+        const float d  = b[i] - a[i];
+        const float ad = fabsf( d );
+        abs_sum += ad;
+        squared_sum += d * d;
+        max_abs = std::max( max_abs, ad );
+        out[i]  = ad;
+    }
+
+    RowDiff row;
+    row.abs_sum     = abs_sum;
+    row.squared_sum = squared_sum;
+    row.max_abs      = max_abs;
+    row.max_relative = 0.0;
+    row.differing    = 0;
+    return row;
+}
+
+
+//------------------------------------------------------------------------------
+//
+//  SSIM
+//
+//------------------------------------------------------------------------------
+
+void luma( const std::vector<float>& rgb, std::vector<float>& y )
+{
+    y.resize( rgb.size() / 3 );
+    sutil::parallelFor( y.size(), [&]( size_t begin, size_t end ) {
+        for( size_t i = begin; i < end; ++i )
+            y[i] = 0.2126f * rgb[3 * i] + 0.7152f * rgb[3 * i + 1] + 0.0722f * rgb[3 * i + 2];
+    }, 1 << 16 );
+}
+
+double meanSsim( const std::vector<float>& reference, const std::vector<float>& test, unsigned int width, unsigned int height )
+{
+    std::vector<float> x, y;
+    luma( reference, x );
+    luma( test, y );
+
+    const size_t       count = x.size();
+    std::vector<float> xx( count ), yy( count ), xy( count );
+    sutil::parallelFor( count, [&]( size_t begin, size_t end ) {
+        for( size_t i = begin; i < end; ++i )
+        {
+            xx[i] = x[i] * x[i];
+            yy[i] = y[i] * y[i];
+            xy[i] = x[i] * y[i];
+        }
+    }, 1 << 16 );
+
+    // Local means and second moments, filtered in place of their inputs.
+    const std::vector<float> window = gaussianKernel( 5, 1.5f );
+    std::vector<float>       scratch;
+    convolveInPlace( x, scratch, width, height, window, window );
+    convolveInPlace( y, scratch, width, height, window, window );
+    convolveInPlace( xx, scratch, width, height, window, window );
+    convolveInPlace( yy, scratch, width, height, window, window );
+    convolveInPlace( xy, scratch, width, height, window, window );
+
+    std::vector<double> rows( height );
+    sutil::parallelFor( height, [&]( size_t begin, size_t end ) {
+        for( size_t r = begin; r < end; ++r )
+        {
+            double s = 0.0;
+            for( size_t i = r * width; i < ( r + 1 ) * width; ++i )
+            {
+                const float mx  = x[i];
+                const float my  = y[i];
+                const float vx  = xx[i] - mx * mx;
+                const float vy  = yy[i] - my * my;
+                const float cxy = xy[i] - mx * my;
+                s += ( ( 2.0f * mx * my + kSsimC1 ) * ( 2.0f * cxy + kSsimC2 ) ) /
+                     ( ( mx * mx + my * my + kSsimC1 ) * ( vx + vy + kSsimC2 ) );
+            }
+            rows[r] = s;
+        }
+    }, kRowGrain );
+    return rowSum( rows ) / count;
+}
+
+
+//------------------------------------------------------------------------------
+//
+//  FLIP
+//
+//------------------------------------------------------------------------------
+
+inline void linearRgbToXyz( const float* rgb, float& X, float& Y, float& Z )
+{
+    X = 0.4124564f * rgb[0] + 0.3575761f * rgb[1] + 0.1804375f * rgb[2];
+    Y = 0.2126729f * rgb[0] + 0.7151522f * rgb[1] + 0.0721750f * rgb[2];
+    Z = 0.0193339f * rgb[0] + 0.1191920f * rgb[1] + 0.9503041f * rgb[2];
+}
+
+inline void xyzToLinearRgb( float X, float Y, float Z, float* rgb )
+{
+    rgb[0] = 3.2404542f * X - 1.5371385f * Y - 0.4985314f * Z;
+    rgb[1] = -0.9692660f * X + 1.8760108f * Y + 0.0415560f * Z;
+    rgb[2] = 0.0556434f * X - 0.2040259f * Y + 1.0572252f * Z;
+}
+
+// Cube root of a positive normal float: an estimate from the exponent bits, refined by three Newton steps to
+// float precision. Much cheaper than cbrtf(), which dominates the colour conversion otherwise.
+inline float cubeRoot( float t )
+{
+    unsigned int bits;
+    memcpy( &bits, &t, sizeof( bits ) );
+    bits = bits / 3 + 0x2A514067u;
+    float y;
+    memcpy( &y, &bits, sizeof( y ) );
+    for( int i = 0; i < 3; ++i )
+        y = ( 2.0f * y + t / ( y * y ) ) * ( 1.0f / 3.0f );
+    return y;
+}
+
+inline float labF( float t )
+{
+    const float delta = 6.0f / 29.0f;
+    return t > delta * delta * delta ? cubeRoot( t ) : t / ( 3.0f * delta * delta ) + 4.0f / 29.0f;
+}
+
+// L*a*b* of a linear RGB colour, with a* and b* scaled by L* / 100 (Hunt effect: colours look less saturated
+// when they are darker).
+inline void huntLab( const float* rgb, float* lab )
+{
+    float X, Y, Z;
+    linearRgbToXyz( rgb, X, Y, Z );
+    const float fx = labF( X / kWhiteX );
+    const float fy = labF( Y / kWhiteY );
+    const float fz = labF( Z / kWhiteZ );
+    lab[0] = 116.0f * fy - 16.0f;
+    lab[1] = 0.01f * lab[0] * 500.0f * ( fx - fy );
+    lab[2] = 0.01f * lab[0] * 200.0f * ( fy - fz );
+}
+
+inline float hyab( const float* a, const float* b )
+{
+    const float da = a[1] - b[1];
+    const float db = a[2] - b[2];
+    return fabsf( a[0] - b[0] ) + sqrtf( da * da + db * db );
+}
+
+// One Gaussian of the contrast sensitivity function, a * sqrt(pi / b) * exp(-pi^2 * r^2 / b) with r in degrees.
+struct CsfGaussian
+{
+    float a;
+    float b;
+};
+
+// The 1D factor of the Gaussian (normalised) and the weight of the full 2D kernel.
+std::vector<float> csfKernel( const CsfGaussian& g, int radius, float pixels_per_degree, float& weight )
+{
+    std::vector<float> kernel( 2 * radius + 1 );
+    for( int i = -radius; i <= radius; ++i )
+    {
+        const float r = i / pixels_per_degree;
+        kernel[i + radius] = expf( -kPi * kPi * r * r / g.b );
+    }
+    const float s = sum( kernel );
+    weight        = g.a * sqrtf( kPi / g.b ) * s * s;
+    for( size_t i = 0; i < kernel.size(); ++i )
+        kernel[i] /= s;
+    return kernel;
+}
+
+// Derivative of a Gaussian across x (edges: first, points: second) and the Gaussian along y, with the positive and
+// the negative weights of the 2D kernel each summing to one.
+void featureKernels( float pixels_per_degree, bool points, std::vector<float>& derivative, std::vector<float>& gaussian )
+{
+    const float sd     = 0.5f * kFlipFeatureWidth * pixels_per_degree;
+    const int   radius = static_cast<int>( ceilf( 3.0f * sd ) );
+    gaussian           = gaussianKernel( radius, sd );
+    derivative.resize( gaussian.size() );
+    float positive = 0.0f, negative = 0.0f;
+    for( int i = -radius; i <= radius; ++i )
+    {
+        const float g = gaussian[i + radius];
+        const float d = points ? ( i * i / ( sd * sd ) - 1.0f ) * g : -i * g;
+        derivative[i + radius] = d;
+        ( d > 0.0f ? positive : negative ) += fabsf( d );
+    }
+    for( size_t i = 0; i < derivative.size(); ++i )
+        derivative[i] /= derivative[i] > 0.0f ? positive : negative;
+}
+
+// What LDR-FLIP compares of one image: the Hunt adjusted L*a*b* of the filtered image (interleaved) and the
+// magnitudes of the edge and point features of the luminance.
+struct FlipImage
+{
+    std::vector<float> lab;
+    std::vector<float> edges;
+    std::vector<float> points;
+};
+
+void prepareFlip( const std::vector<float>& display, unsigned int width, unsigned int height, float pixels_per_degree, FlipImage& image )
+{
+    sutil::ProfileScope profile( "flip image" );
+    const size_t        count = size_t( width ) * height;
+
+    // Opponent space YCxCz, one plane per channel, and the normalised luminance for the features.
+    const SrgbDecoder  decode;
+    std::vector<float> y( count ), cx( count ), cz( count ), luminance( count );
+    sutil::parallelFor( count, [&]( size_t begin, size_t end ) {
+        for( size_t i = begin; i < end; ++i )
+        {
+            const float rgb[3] = { decode( display[3 * i] ), decode( display[3 * i + 1] ), decode( display[3 * i + 2] ) };
+            float X, Y, Z;
+            linearRgbToXyz( rgb, X, Y, Z );
+            X /= kWhiteX;
+            Y /= kWhiteY;
+            Z /= kWhiteZ;
+            luminance[i] = Y;
+            y[i]         = 116.0f * Y - 16.0f;
+            cx[i]        = 500.0f * ( X - Y );
+            cz[i]        = 200.0f * ( Y - Z );
+        }
+    }, 1 << 14 );
+
+    // Contrast sensitivity of the achromatic, red-green and blue-yellow channels.
+    const CsfGaussian achromatic = { 1.0f, 0.0047f };
+    const CsfGaussian red_green  = { 1.0f, 0.0053f };
+    const CsfGaussian blue_yellow[2] = { { 34.1f, 0.04f }, { 13.5f, 0.025f } };
+    const int         radius = static_cast<int>( ceilf( 3.0f * sqrtf( 0.04f / ( 2.0f * kPi * kPi ) ) * pixels_per_degree ) );
+
+    float              weight, weight2;
+    std::vector<float> scratch;
+    std::vector<float> kernel = csfKernel( achromatic, radius, pixels_per_degree, weight );
+    convolveInPlace( y, scratch, width, height, kernel, kernel );
+    kernel = csfKernel( red_green, radius, pixels_per_degree, weight );
+    convolveInPlace( cx, scratch, width, height, kernel, kernel );
+
+    std::vector<float> cz2( count );
+    kernel = csfKernel( blue_yellow[1], radius, pixels_per_degree, weight2 );
+    convolve( cz.data(), cz2.data(), width, height, kernel, kernel );
+    kernel = csfKernel( blue_yellow[0], radius, pixels_per_degree, weight );
+    convolveInPlace( cz, scratch, width, height, kernel, kernel );
+
+    const float w1 = weight / ( weight + weight2 );
+    const float w2 = weight2 / ( weight + weight2 );
+    image.lab.resize( 3 * count );
+    sutil::parallelFor( count, [&]( size_t begin, size_t end ) {
+        for( size_t i = begin; i < end; ++i )
+        {
+            const float Y = ( y[i] + 16.0f ) / 116.0f;
+            const float X = cx[i] / 500.0f + Y;
+            const float Z = Y - ( w1 * cz[i] + w2 * cz2[i] ) / 200.0f;
+            float rgb[3];
+            xyzToLinearRgb( X * kWhiteX, Y * kWhiteY, Z * kWhiteZ, rgb );
+            for( int c = 0; c < 3; ++c )
+                rgb[c] = std::min( std::max( rgb[c], 0.0f ), 1.0f );
+            huntLab( rgb, &image.lab[3 * i] );
+        }
+    }, 1 << 14 );
+
+    // Features of the unfiltered luminance, the planes of the colour pipeline are reused.
+    std::vector<float> derivative, gaussian;
+    std::vector<float>* magnitudes[2] = { &image.edges, &image.points };
+    for( int feature = 0; feature < 2; ++feature )
+    {
+        featureKernels( pixels_per_degree, feature == 1, derivative, gaussian );
+        convolve( luminance.data(), y.data(), width, height, derivative, gaussian );
+        convolve( luminance.data(), cx.data(), width, height, gaussian, derivative );
+        std::vector<float>& magnitude = *magnitudes[feature];
+        magnitude.resize( count );
+        sutil::parallelFor( count, [&]( size_t begin, size_t end ) {
+            for( size_t i = begin; i < end; ++i )
+                magnitude[i] = sqrtf( y[i] * y[i] + cx[i] * cx[i] );
+        }, 1 << 16 );
+    }
+}
+
+// FLIP error per pixel. Returns the sum of the errors.
+double flipError( const FlipImage& reference, const FlipImage& test, unsigned int width, unsigned int height,
+                  std::vector<float>& error, float& max_error )
+{
+    // Colour differences are normalised by the largest one, between green and blue.
+    const float green[3] = { 0.0f, 1.0f, 0.0f };
+    const float blue[3]  = { 0.0f, 0.0f, 1.0f };
+    float       green_lab[3], blue_lab[3];
+    huntLab( green, green_lab );
+    huntLab( blue, blue_lab );
+    const float cmax   = powf( hyab( green_lab, blue_lab ), kFlipQc );
+    const float pccmax = kFlipPc * cmax;
+
+    error.resize( size_t( width ) * height );
+    std::vector<double> rows( height );
+    std::vector<float>  row_max( height );
+    sutil::parallelFor( height, [&]( size_t begin, size_t end ) {
+        for( size_t r = begin; r < end; ++r )
+        {
+            double s = 0.0;
+            float  m = 0.0f;
+            for( size_t i = r * width; i < ( r + 1 ) * width; ++i )
+            {
+                const float p      = powf( hyab( &reference.lab[3 * i], &test.lab[3 * i] ), kFlipQc );
+                const float colour = p < pccmax ? kFlipPt / pccmax * p : kFlipPt + ( p - pccmax ) / ( cmax - pccmax ) * ( 1.0f - kFlipPt );
+                const float feature = std::max( fabsf( reference.edges[i] - test.edges[i] ), fabsf( reference.points[i] - test.points[i] ) );
+                const float f       = sqrtf( feature / sqrtf( 2.0f ) );
+                error[i] = powf( colour, 1.0f - f );
+                s += error[i];
+                m = std::max( m, error[i] );
+            }
+            rows[r]    = s;
+            row_max[r] = m;
+        }
+    }, kRowGrain );
+    max_error = *std::max_element( row_max.begin(), row_max.end() );
+    return rowSum( rows );
+}
+
+} // end anonymous namespace
+
+
+sutil::ImageDiffSettings::ImageDiffSettings()
+    : pixels_per_degree( 67.0f )
+    , pixel_threshold( 0.0f )
+{
+}
+
+
+sutil::ImageDiffStats::ImageDiffStats()
+    : max_abs( 0.0 )
+    , max_relative( 0.0 )
+    , mean_abs( 0.0 )
+    , rmse( 0.0 )
+    , psnr( std::numeric_limits<double>::infinity() )
+    , ssim( 1.0 )
+    , flip_mean( 0.0 )
+    , flip_max( 0.0 )
+    , differing_pixels( 0 )
+{
+}
+
+
+bool sutil::compareImages( const FloatImage& reference, const FloatImage& test, const ImageDiffSettings& settings,
+                           ImageDiffStats& stats, std::vector<float>* diff, std::vector<float>* flip )
+{
+    if( reference.width != test.width || reference.height != test.height || reference.pixels.empty() ||
+        reference.pixels.size() != test.pixels.size() )
+    {
+        std::cerr << "ERROR: compareImages() image sizes differ: " << reference.width << "x" << reference.height << " and "
+                  << test.width << "x" << test.height << std::endl;
+        return false;
+    }
+
+    const unsigned int width  = reference.width;
+    const unsigned int height = reference.height;
+    stats = ImageDiffStats();
+
+    // Display images, sRGB encoded. They are also compared pixel by pixel unless both images are linear.
+    std::vector<float> reference_encoded, test_encoded;
+    if( reference.linear )
+        encodeSrgb( reference.pixels, reference_encoded );
+    if( test.linear )
+        encodeSrgb( test.pixels, test_encoded );
+    const std::vector<float>& reference_display = reference.linear ? reference_encoded : reference.pixels;
+    const std::vector<float>& test_display      = test.linear ? test_encoded : test.pixels;
+    const bool                linear            = reference.linear && test.linear;
+    const float*              a                 = linear ? reference.pixels.data() : reference_display.data();
+    const float*              b                 = linear ? test.pixels.data() : test_display.data();
+
+    {
+        ProfileScope profile( "pixel differences" );
+        const size_t         row_values = size_t( width ) * 3;
+        std::vector<RowDiff> rows( height );
+        if( diff )
+            diff->resize( row_values * height );
+        parallelFor( height, [&]( size_t begin, size_t end ) {
+            std::vector<float> abs_row( row_values );
+            for( size_t y = begin; y < end; ++y )
+            {
+                const float* reference_row = a + y * row_values;
+                rows[y] = diffRow( reference_row, b + y * row_values, row_values, abs_row.data() );
+                for( size_t x = 0; x < row_values; x += 3 )
+                {
+                    if( std::max( std::max( abs_row[x], abs_row[x + 1] ), abs_row[x + 2] ) > settings.pixel_threshold )
+                        ++rows[y].differing;
+                }
+                if( rows[y].max_abs > 0.0f )
+                {
+                    for( size_t x = 0; x < row_values; ++x )
+                    {
+                        if( abs_row[x] > 0.0f )
+                            rows[y].max_relative = std::max( rows[y].max_relative, reference_row[x] != 0.0f
+                                ? double( abs_row[x] ) / fabs( double( reference_row[x] ) ) : std::numeric_limits<double>::infinity() );
+                    }
+                }
+                if( diff )
+                    std::copy( abs_row.begin(), abs_row.end(), diff->begin() + y * row_values );
+            }
+        }, kRowGrain );
+
+        double abs_sum = 0.0, squared_sum = 0.0;
+        for( unsigned int y = 0; y < height; ++y )
+        {
+            abs_sum += rows[y].abs_sum;
+            squared_sum += rows[y].squared_sum;
+            stats.max_abs = std::max( stats.max_abs, double( rows[y].max_abs ) );
+            stats.max_relative = std::max( stats.max_relative, rows[y].max_relative );
+            stats.differing_pixels += rows[y].differing;
+        }
+        const double values = double( row_values ) * height;
+        stats.mean_abs      = abs_sum / values;
+        stats.rmse          = sqrt( squared_sum / values );
+        if( squared_sum > 0.0 )
+            stats.psnr = -10.0 * log10( squared_sum / values );
+    }
+
+    {
+        ProfileScope profile( "ssim" );
+        stats.ssim = meanSsim( reference_display, test_display, width, height );
+    }
+
+    {
+        ProfileScope profile( "flip" );
+        FlipImage flip_reference, flip_test;
+        prepareFlip( reference_display, width, height, settings.pixels_per_degree, flip_reference );
+        prepareFlip( test_display, width, height, settings.pixels_per_degree, flip_test );
+
+        std::vector<float> error;
+        std::vector<float>& flip_error = flip ? *flip : error;
+        float               flip_max   = 0.0f;
+        stats.flip_mean = flipError( flip_reference, flip_test, width, height, flip_error, flip_max ) / ( double( width ) * height );
+        stats.flip_max  = flip_max;
+    }
+    return true;
+}
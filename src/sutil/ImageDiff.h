@@ -0,0 +1,83 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <sutil/ImageReader.h>
+#include <sutilapi.h>
+
+#include <cstddef>
+#include <vector>
+
+// Metrics for comparing renders against gold images.
+//
+// The pixel differences (absolute difference, RMSE, PSNR, differing pixels) are taken in linear values when both
+// images are linear, otherwise in sRGB encoding with the linear image clamped to [0, 1] and encoded. SSIM and FLIP
+// always look at the display images, sRGB encoded and clamped.
+//
+// SSIM is the mean SSIM of Wang et al. 2004 over the Rec. 709 luma, with an 11x11 Gaussian window of sigma 1.5.
+// FLIP follows LDR-FLIP of Andersson et al. 2020: colour differences (HyAB in Hunt adjusted L*a*b*) of images
+// filtered with the contrast sensitivity of the eye at the given viewing distance, raised where edges or points
+// differ. Per pixel it is 0 for equal pixels and close to 1 for the worst differences. Unlike the reference
+// implementation the filters clamp at the image borders instead of mirroring.
+//
+// All passes are split over rows with parallelFor. Per row sums are added in row order, so the results do not
+// depend on the number of threads.
+
+namespace sutil
+{
+
+struct ImageDiffSettings
+{
+    SUTILAPI ImageDiffSettings();
+
+    float pixels_per_degree; // FLIP viewing conditions. The default 67 is a 0.7 m wide 4K monitor seen from 0.7 m.
+    float pixel_threshold;   // A pixel differs when one of its channels differs by more.
+};
+
+struct ImageDiffStats
+{
+    SUTILAPI ImageDiffStats();
+
+    double max_abs;
+    double max_relative;      // Largest |test - reference| / |reference| of a channel, infinite where only the reference is 0.
+    double mean_abs;          // Over all channels.
+    double rmse;
+    double psnr;              // dB for a peak value of 1, infinite for equal images.
+    double ssim;              // 1 for equal images.
+    double flip_mean;
+    double flip_max;
+    size_t differing_pixels;
+};
+
+// The images must have the same size. diff receives |test - reference| per channel in the space of the pixel
+// differences and flip the FLIP error per pixel, both top-down, unless they are null.
+SUTILAPI bool compareImages( const FloatImage& reference, const FloatImage& test, const ImageDiffSettings& settings,
+                             ImageDiffStats& stats, std::vector<float>* diff = 0, std::vector<float>* flip = 0 );
+
+} // end namespace sutil
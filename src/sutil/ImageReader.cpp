@@ -0,0 +1,916 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sutil/ImageReader.h>
+#include <sutil/HalfFloat.h>
+#include <sutil/Parallel.h>
+#include <sutil/Profiler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Like the writers, the readers assume a little endian host.
+
+namespace
+{
+
+bool fail( const char* function, const char* filename, const char* message )
+{
+    std::cerr << "ERROR: " << function << "() '" << filename << "': " << message << std::endl;
+    return false;
+}
+
+bool readFile( const char* function, const char* filename, std::vector<unsigned char>& data )
+{
+    FILE* file = fopen( filename, "rb" );
+    if( !file )
+        return fail( function, filename, "cannot open file" );
+
+    data.clear();
+    unsigned char chunk[1 << 16];
+    size_t        count;
+    while( ( count = fread( chunk, 1, sizeof( chunk ), file ) ) > 0 )
+        data.insert( data.end(), chunk, chunk + count );
+    const bool success = !ferror( file );
+    fclose( file );
+    return success || fail( function, filename, "read error" );
+}
+
+template <typename T>
+inline T get( const unsigned char* data )
+{
+    T value;
+    memcpy( &value, data, sizeof( T ) );
+    return value;
+}
+
+inline unsigned int getBigEndian( const unsigned char* data )
+{
+    return ( static_cast<unsigned int>( data[0] ) << 24 ) | ( static_cast<unsigned int>( data[1] ) << 16 ) |
+           ( static_cast<unsigned int>( data[2] ) << 8 ) | data[3];
+}
+
+
+//------------------------------------------------------------------------------
+//
+//  zlib decoder
+//
+//------------------------------------------------------------------------------
+
+// Canonical Huffman code, decoded with one table lookup on the next 'bits' input bits.
+struct HuffmanTable
+{
+    unsigned int                bits;    // Longest code length.
+    std::vector<unsigned short> entries; // symbol << 4 | code length, 0 for bit patterns without a code.
+
+    bool build( const unsigned char* lengths, unsigned int count );
+};
+
+bool HuffmanTable::build( const unsigned char* lengths, unsigned int count )
+{
+    unsigned int length_count[16] = { 0 };
+    for( unsigned int i = 0; i < count; ++i )
+        ++length_count[lengths[i]];
+    length_count[0] = 0;
+
+    bits = 1;
+    int left = 1;
+    for( unsigned int len = 1; len < 16; ++len )
+    {
+        left = 2 * left - static_cast<int>( length_count[len] );
+        if( left < 0 )
+            return false; // Over-subscribed. Incomplete codes are allowed, e.g. a single distance code.
+        if( length_count[len] )
+            bits = len;
+    }
+
+    unsigned int next_code[16];
+    unsigned int code = 0;
+    for( unsigned int len = 1; len < 16; ++len )
+    {
+        code           = ( code + length_count[len - 1] ) << 1;
+        next_code[len] = code;
+    }
+
+    entries.assign( size_t( 1 ) << bits, 0 );
+    for( unsigned int symbol = 0; symbol < count; ++symbol )
+    {
+        const unsigned int len = lengths[symbol];
+        if( !len )
+            continue;
+        // Huffman codes are packed starting with their most significant bit, the table is indexed LSB first.
+        unsigned int c        = next_code[len]++;
+        unsigned int reversed = 0;
+        for( unsigned int i = 0; i < len; ++i, c >>= 1 )
+            reversed = ( reversed << 1 ) | ( c & 1u );
+        for( size_t i = reversed; i < entries.size(); i += size_t( 1 ) << len )
+            entries[i] = static_cast<unsigned short>( ( symbol << 4 ) | len );
+    }
+    return true;
+}
+
+// Inflates a zlib stream (RFC 1950, 1951) of known decompressed size, as PNG and the OpenEXR ZIP codec store them.
+// The Adler-32 checksum is not verified.
+class Inflater
+{
+public:
+    Inflater( const unsigned char* data, size_t size ) : m_data( data ), m_size( size ), m_pos( 0 ), m_bits( 0 ), m_count( 0 ) {}
+
+    // Fails unless the stream decodes to exactly size bytes.
+    bool zlib( unsigned char* out, size_t size );
+
+private:
+    void refill()
+    {
+        while( m_count <= 56 && m_pos < m_size )
+        {
+            m_bits |= static_cast<unsigned long long>( m_data[m_pos++] ) << m_count;
+            m_count += 8;
+        }
+    }
+
+    bool bits( unsigned int n, unsigned int& value )
+    {
+        refill();
+        if( n > m_count )
+            return false;
+        value = static_cast<unsigned int>( m_bits & ( ( 1ull << n ) - 1 ) );
+        m_bits >>= n;
+        m_count -= n;
+        return true;
+    }
+
+    bool symbol( const HuffmanTable& table, unsigned int& value )
+    {
+        refill();
+        const unsigned int entry = table.entries[m_bits & ( ( 1u << table.bits ) - 1 )];
+        const unsigned int len   = entry & 15u;
+        if( !len || len > m_count )
+            return false;
+        m_bits >>= len;
+        m_count -= len;
+        value = entry >> 4;
+        return true;
+    }
+
+    bool dynamicTables( HuffmanTable& literals, HuffmanTable& distances );
+    bool codes( const HuffmanTable& literals, const HuffmanTable& distances, unsigned char* out, size_t size, size_t& pos );
+
+    const unsigned char* m_data;
+    size_t               m_size;
+    size_t               m_pos;
+    unsigned long long   m_bits;  // Input bits not consumed yet, the next one is bit 0.
+    unsigned int         m_count; // Valid bits in m_bits.
+};
+
+bool Inflater::zlib( unsigned char* out, size_t size )
+{
+    unsigned int cmf, flg;
+    if( !bits( 8, cmf ) || !bits( 8, flg ) || ( cmf & 15u ) != 8 || ( cmf * 256 + flg ) % 31 != 0 || ( flg & 32u ) )
+        return false; // Not deflate, or a preset dictionary.
+
+    size_t       pos   = 0;
+    unsigned int final = 0;
+    while( !final )
+    {
+        unsigned int type;
+        if( !bits( 1, final ) || !bits( 2, type ) )
+            return false;
+
+        if( type == 0 ) // Stored
+        {
+            const unsigned int skip = m_count & 7u;
+            m_bits >>= skip;
+            m_count -= skip;
+            unsigned int len, nlen;
+            if( !bits( 16, len ) || !bits( 16, nlen ) || len != ( ~nlen & 0xFFFFu ) || len > size - pos )
+                return false;
+            for( unsigned int i = 0; i < len; ++i )
+            {
+                unsigned int value;
+                if( !bits( 8, value ) )
+                    return false;
+                out[pos++] = static_cast<unsigned char>( value );
+            }
+        }
+        else if( type == 1 ) // Fixed Huffman codes
+        {
+            unsigned char lengths[288 + 30];
+            memset( lengths, 8, 144 );
+            memset( lengths + 144, 9, 112 );
+            memset( lengths + 256, 7, 24 );
+            memset( lengths + 280, 8, 8 );
+            memset( lengths + 288, 5, 30 );
+            HuffmanTable literals, distances;
+            literals.build( lengths, 288 );
+            distances.build( lengths + 288, 30 );
+            if( !codes( literals, distances, out, size, pos ) )
+                return false;
+        }
+        else if( type == 2 ) // Dynamic Huffman codes
+        {
+            HuffmanTable literals, distances;
+            if( !dynamicTables( literals, distances ) || !codes( literals, distances, out, size, pos ) )
+                return false;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return pos == size;
+}
+
+bool Inflater::dynamicTables( HuffmanTable& literals, HuffmanTable& distances )
+{
+    static const unsigned char order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    unsigned int hlit, hdist, hclen;
+    if( !bits( 5, hlit ) || !bits( 5, hdist ) || !bits( 4, hclen ) )
+        return false;
+    hlit += 257;
+    hdist += 1;
+    hclen += 4;
+    if( hlit > 286 || hdist > 30 )
+        return false;
+
+    unsigned char lengths[286 + 30] = { 0 };
+    for( unsigned int i = 0; i < hclen; ++i )
+    {
+        unsigned int len;
+        if( !bits( 3, len ) )
+            return false;
+        lengths[order[i]] = static_cast<unsigned char>( len );
+    }
+    HuffmanTable code_lengths;
+    if( !code_lengths.build( lengths, 19 ) )
+        return false;
+
+    // Literal/length and distance code lengths form one run length coded sequence.
+    for( unsigned int i = 0; i < hlit + hdist; )
+    {
+        unsigned int sym;
+        if( !symbol( code_lengths, sym ) )
+            return false;
+        if( sym < 16 )
+        {
+            lengths[i++] = static_cast<unsigned char>( sym );
+            continue;
+        }
+        unsigned int repeat;
+        unsigned char value = 0;
+        if( sym == 16 )
+        {
+            if( i == 0 || !bits( 2, repeat ) )
+                return false;
+            value = lengths[i - 1];
+            repeat += 3;
+        }
+        else if( sym == 17 )
+        {
+            if( !bits( 3, repeat ) )
+                return false;
+            repeat += 3;
+        }
+        else
+        {
+            if( !bits( 7, repeat ) )
+                return false;
+            repeat += 11;
+        }
+        if( repeat > hlit + hdist - i )
+            return false;
+        while( repeat-- )
+            lengths[i++] = value;
+    }
+
+    return lengths[256] != 0 && literals.build( lengths, hlit ) && distances.build( lengths + hlit, hdist );
+}
+
+bool Inflater::codes( const HuffmanTable& literals, const HuffmanTable& distances, unsigned char* out, size_t size, size_t& pos )
+{
+    static const unsigned short length_base[29]  = { 3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                                     31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static const unsigned char  length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    static const unsigned short distance_base[30] = { 1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+                                                      193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    static const unsigned char  distance_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    for( ;; )
+    {
+        unsigned int sym;
+        if( !symbol( literals, sym ) )
+            return false;
+        if( sym < 256 )
+        {
+            if( pos == size )
+                return false;
+            out[pos++] = static_cast<unsigned char>( sym );
+        }
+        else if( sym == 256 )
+        {
+            return true;
+        }
+        else
+        {
+            sym -= 257;
+            unsigned int extra, dist;
+            if( sym >= 29 || !bits( length_extra[sym], extra ) )
+                return false;
+            const size_t length = length_base[sym] + extra;
+            if( !symbol( distances, dist ) || dist >= 30 || !bits( distance_extra[dist], extra ) )
+                return false;
+            const size_t distance = distance_base[dist] + extra;
+            if( distance > pos || length > size - pos )
+                return false;
+            // Byte by byte, the source may overlap the bytes being written.
+            const unsigned char* src = out + pos - distance;
+            unsigned char*       dst = out + pos;
+            for( size_t i = 0; i < length; ++i )
+                dst[i] = src[i];
+            pos += length;
+        }
+    }
+}
+
+
+//------------------------------------------------------------------------------
+//
+//  PPM and PFM
+//
+//------------------------------------------------------------------------------
+
+// Next whitespace separated word of a PNM style header, skipping comments.
+bool headerToken( const std::vector<unsigned char>& file, size_t& pos, std::string& token )
+{
+    for( ;; )
+    {
+        while( pos < file.size() && isspace( file[pos] ) )
+            ++pos;
+        if( pos == file.size() || file[pos] != '#' )
+            break;
+        while( pos < file.size() && file[pos] != '\n' )
+            ++pos;
+    }
+    token.clear();
+    while( pos < file.size() && !isspace( file[pos] ) )
+        token += static_cast<char>( file[pos++] );
+    return !token.empty();
+}
+
+bool headerNumber( const std::vector<unsigned char>& file, size_t& pos, double& value )
+{
+    std::string token;
+    if( !headerToken( file, pos, token ) )
+        return false;
+    char* end;
+    value = strtod( token.c_str(), &end );
+    return *end == '\0';
+}
+
+
+//------------------------------------------------------------------------------
+//
+//  PNG
+//
+//------------------------------------------------------------------------------
+
+inline unsigned char paeth( int a, int b, int c )
+{
+    const int p  = a + b - c;
+    const int pa = abs( p - a );
+    const int pb = abs( p - b );
+    const int pc = abs( p - c );
+    if( pa <= pb && pa <= pc )
+        return static_cast<unsigned char>( a );
+    return static_cast<unsigned char>( pb <= pc ? b : c );
+}
+
+// Reverses the filter of one row in place. previous is the unfiltered row above, zeros for the first row.
+bool unfilterPngRow( unsigned int filter, unsigned char* row, const unsigned char* previous, size_t row_bytes, size_t bpp )
+{
+    switch( filter )
+    {
+        case 0: // None
+            return true;
+        case 1: // Sub
+            for( size_t i = bpp; i < row_bytes; ++i )
+                row[i] = static_cast<unsigned char>( row[i] + row[i - bpp] );
+            return true;
+        case 2: // Up
+            for( size_t i = 0; i < row_bytes; ++i )
+                row[i] = static_cast<unsigned char>( row[i] + previous[i] );
+            return true;
+        case 3: // Average
+            for( size_t i = 0; i < row_bytes; ++i )
+                row[i] = static_cast<unsigned char>( row[i] + ( ( i >= bpp ? row[i - bpp] : 0 ) + previous[i] ) / 2 );
+            return true;
+        case 4: // Paeth
+            for( size_t i = 0; i < row_bytes; ++i )
+                row[i] = static_cast<unsigned char>(
+                    row[i] + ( i >= bpp ? paeth( row[i - bpp], previous[i], previous[i - bpp] ) : paeth( 0, previous[i], 0 ) ) );
+            return true;
+        default:
+            return false;
+    }
+}
+
+
+//------------------------------------------------------------------------------
+//
+//  OpenEXR
+//
+//------------------------------------------------------------------------------
+
+enum ExrPixelType
+{
+    EXR_UINT  = 0,
+    EXR_HALF  = 1,
+    EXR_FLOAT = 2
+};
+
+struct ExrChannelInfo
+{
+    std::string name;
+    int         type;
+    size_t      offset; // Of the channel's values in a scanline.
+};
+
+inline float exrValue( const unsigned char* line, const ExrChannelInfo& channel, unsigned int x )
+{
+    switch( channel.type )
+    {
+        case EXR_HALF:
+            return sutil::halfToFloat( get<unsigned short>( line + channel.offset + 2 * size_t( x ) ) );
+        case EXR_FLOAT:
+            return get<float>( line + channel.offset + 4 * size_t( x ) );
+        default:
+            return static_cast<float>( get<unsigned int>( line + channel.offset + 4 * size_t( x ) ) );
+    }
+}
+
+// Inverse of the delta predictor and byte interleaving of the RLE and ZIP codecs.
+void exrUnpredict( std::vector<unsigned char>& predicted, std::vector<unsigned char>& raw )
+{
+    for( size_t i = 1; i < predicted.size(); ++i )
+        predicted[i] = static_cast<unsigned char>( int( predicted[i - 1] ) + int( predicted[i] ) - 128 );
+
+    raw.resize( predicted.size() );
+    const size_t half = ( predicted.size() + 1 ) / 2;
+    for( size_t i = 0; i < raw.size(); ++i )
+        raw[i] = predicted[( i & 1 ) ? half + i / 2 : i / 2];
+}
+
+bool exrRunLengthDecode( const unsigned char* data, size_t size, std::vector<unsigned char>& out, size_t expected )
+{
+    out.clear();
+    const unsigned char* end = data + size;
+    while( data < end )
+    {
+        const int count = static_cast<signed char>( *data++ );
+        if( count < 0 )
+        {
+            if( end - data < -count )
+                return false;
+            out.insert( out.end(), data, data - count );
+            data -= count;
+        }
+        else
+        {
+            if( data == end )
+                return false;
+            out.insert( out.end(), size_t( count ) + 1, *data++ );
+        }
+        if( out.size() > expected )
+            return false;
+    }
+    return out.size() == expected;
+}
+
+} // end anonymous namespace
+
+
+sutil::FloatImage::FloatImage()
+    : width( 0 )
+    , height( 0 )
+    , linear( false )
+{
+}
+
+
+bool sutil::readPPM( const char* filename, FloatImage& image )
+{
+    std::vector<unsigned char> file;
+    if( !readFile( "readPPM", filename, file ) )
+        return false;
+
+    size_t      pos = 0;
+    std::string magic;
+    double      width, height, max_value;
+    if( !headerToken( file, pos, magic ) || ( magic != "P5" && magic != "P6" ) )
+        return fail( "readPPM", filename, "only binary PPM (P6) and PGM (P5) files are supported" );
+    if( !headerNumber( file, pos, width ) || !headerNumber( file, pos, height ) || !headerNumber( file, pos, max_value ) ||
+        width < 1 || height < 1 || max_value < 1 || max_value > 65535 )
+        return fail( "readPPM", filename, "invalid header" );
+    ++pos; // A single whitespace character ends the header.
+
+    const unsigned int channels = magic == "P6" ? 3 : 1;
+    const size_t       bytes    = max_value < 256 ? 1 : 2; // 16-bit samples are big endian.
+    image.width  = static_cast<unsigned int>( width );
+    image.height = static_cast<unsigned int>( height );
+    image.linear = false;
+    const size_t samples = size_t( image.width ) * image.height * channels;
+    if( pos > file.size() || file.size() - pos < samples * bytes )
+        return fail( "readPPM", filename, "file is truncated" );
+
+    image.pixels.resize( size_t( image.width ) * image.height * 3 );
+    const unsigned char* src   = file.data() + pos;
+    const float          scale = static_cast<float>( 1.0 / max_value );
+    for( size_t i = 0; i < samples; ++i )
+    {
+        const unsigned int value = bytes == 1 ? src[i] : ( static_cast<unsigned int>( src[2 * i] ) << 8 ) | src[2 * i + 1];
+        if( channels == 3 )
+            image.pixels[i] = value * scale;
+        else
+            image.pixels[3 * i] = image.pixels[3 * i + 1] = image.pixels[3 * i + 2] = value * scale;
+    }
+    return true;
+}
+
+
+bool sutil::readPFM( const char* filename, FloatImage& image )
+{
+    std::vector<unsigned char> file;
+    if( !readFile( "readPFM", filename, file ) )
+        return false;
+
+    size_t      pos = 0;
+    std::string magic;
+    double      width, height, scale;
+    if( !headerToken( file, pos, magic ) || ( magic != "PF" && magic != "Pf" ) )
+        return fail( "readPFM", filename, "not a PFM file" );
+    if( !headerNumber( file, pos, width ) || !headerNumber( file, pos, height ) || !headerNumber( file, pos, scale ) ||
+        width < 1 || height < 1 || scale == 0.0 )
+        return fail( "readPFM", filename, "invalid header" );
+    ++pos;
+
+    const unsigned int channels = magic == "PF" ? 3 : 1;
+    image.width  = static_cast<unsigned int>( width );
+    image.height = static_cast<unsigned int>( height );
+    image.linear = true;
+    const size_t row_samples = size_t( image.width ) * channels;
+    if( pos > file.size() || file.size() - pos < row_samples * image.height * sizeof( float ) )
+        return fail( "readPFM", filename, "file is truncated" );
+
+    // Rows are stored bottom-up, a positive scale marks big endian data.
+    image.pixels.resize( size_t( image.width ) * image.height * 3 );
+    for( unsigned int y = 0; y < image.height; ++y )
+    {
+        const unsigned char* src = file.data() + pos + ( image.height - 1 - y ) * row_samples * sizeof( float );
+        float*               dst = image.pixels.data() + size_t( y ) * image.width * 3;
+        for( size_t i = 0; i < row_samples; ++i, src += sizeof( float ) )
+        {
+            unsigned char bytes[4] = { src[0], src[1], src[2], src[3] };
+            if( scale > 0.0 )
+            {
+                std::swap( bytes[0], bytes[3] );
+                std::swap( bytes[1], bytes[2] );
+            }
+            const float value = get<float>( bytes );
+            if( channels == 3 )
+                dst[i] = value;
+            else
+                dst[3 * i] = dst[3 * i + 1] = dst[3 * i + 2] = value;
+        }
+    }
+    return true;
+}
+
+
+bool sutil::readPNG( const char* filename, FloatImage& image )
+{
+    std::vector<unsigned char> file;
+    if( !readFile( "readPNG", filename, file ) )
+        return false;
+
+    static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    if( file.size() < 8 || memcmp( file.data(), signature, 8 ) != 0 )
+        return fail( "readPNG", filename, "not a PNG file" );
+
+    unsigned int               width = 0, height = 0, depth = 0, color = 0, interlace = 0;
+    std::vector<unsigned char> palette, compressed;
+    for( size_t pos = 8; pos + 12 <= file.size(); )
+    {
+        const size_t         length = getBigEndian( &file[pos] );
+        const char*          type   = reinterpret_cast<const char*>( &file[pos + 4] );
+        const unsigned char* data   = &file[pos + 8];
+        if( length > file.size() - pos - 12 )
+            return fail( "readPNG", filename, "file is truncated" );
+
+        if( memcmp( type, "IHDR", 4 ) == 0 && length >= 13 )
+        {
+            width     = getBigEndian( data );
+            height    = getBigEndian( data + 4 );
+            depth     = data[8];
+            color     = data[9];
+            interlace = data[12];
+            if( data[10] != 0 || data[11] != 0 )
+                return fail( "readPNG", filename, "unknown compression or filter method" );
+        }
+        else if( memcmp( type, "PLTE", 4 ) == 0 )
+            palette.assign( data, data + length );
+        else if( memcmp( type, "IDAT", 4 ) == 0 )
+            compressed.insert( compressed.end(), data, data + length );
+        else if( memcmp( type, "IEND", 4 ) == 0 )
+            break;
+        pos += 12 + length;
+    }
+
+    static const unsigned int color_channels[7] = { 1, 0, 3, 1, 2, 0, 4 };
+    if( width == 0 || height == 0 || color > 6 || color_channels[color] == 0 || compressed.empty() )
+        return fail( "readPNG", filename, "invalid file" );
+    if( interlace )
+        return fail( "readPNG", filename, "interlaced files are not supported" );
+    if( color == 3 ? ( depth != 8 || palette.size() < 3 ) : ( depth != 8 && depth != 16 ) )
+        return fail( "readPNG", filename, "only 8-bit palettes and 8 or 16 bits per channel are supported" );
+
+    const unsigned int channels  = color_channels[color];
+    const size_t       bpp       = channels * depth / 8;
+    const size_t       row_bytes = width * bpp;
+    std::vector<unsigned char> raw( height * ( row_bytes + 1 ) );
+    Inflater inflater( compressed.data(), compressed.size() );
+    if( !inflater.zlib( raw.data(), raw.size() ) )
+        return fail( "readPNG", filename, "corrupt image data" );
+
+    // Each row is predicted from the row above, so unfiltering is sequential.
+    const std::vector<unsigned char> zeros( row_bytes, 0 );
+    const unsigned char*             previous = zeros.data();
+    for( unsigned int y = 0; y < height; ++y )
+    {
+        unsigned char* row = &raw[y * ( row_bytes + 1 )];
+        if( !unfilterPngRow( row[0], row + 1, previous, row_bytes, bpp ) )
+            return fail( "readPNG", filename, "unknown filter type" );
+        previous = row + 1;
+    }
+
+    image.width  = width;
+    image.height = height;
+    image.linear = false;
+    image.pixels.resize( size_t( width ) * height * 3 );
+    const size_t palette_size = palette.size() / 3;
+    parallelFor( height, [&]( size_t begin, size_t end ) {
+        for( size_t y = begin; y < end; ++y )
+        {
+            const unsigned char* src = &raw[y * ( row_bytes + 1 ) + 1];
+            float*               dst = &image.pixels[y * width * 3];
+            for( unsigned int x = 0; x < width; ++x, src += bpp, dst += 3 )
+            {
+                if( color == 3 )
+                {
+                    const unsigned char* entry = &palette[3 * std::min<size_t>( src[0], palette_size - 1 )];
+                    for( int c = 0; c < 3; ++c )
+                        dst[c] = entry[c] * ( 1.0f / 255.0f );
+                    continue;
+                }
+                float sample[3];
+                for( unsigned int c = 0; c < std::min( channels, 3u ); ++c )
+                    sample[c] = depth == 8 ? src[c] * ( 1.0f / 255.0f )
+                                           : ( ( static_cast<unsigned int>( src[2 * c] ) << 8 ) | src[2 * c + 1] ) * ( 1.0f / 65535.0f );
+                const bool grey = channels < 3;
+                dst[0] = sample[0];
+                dst[1] = grey ? sample[0] : sample[1];
+                dst[2] = grey ? sample[0] : sample[2];
+            }
+        }
+    }, 16 );
+    return true;
+}
+
+
+bool sutil::readEXR( const char* filename, FloatImage& image )
+{
+    std::vector<unsigned char> file;
+    if( !readFile( "readEXR", filename, file ) )
+        return false;
+
+    if( file.size() < 8 || get<int>( file.data() ) != 20000630 )
+        return fail( "readEXR", filename, "not an OpenEXR file" );
+    const unsigned int version = get<unsigned int>( file.data() + 4 );
+    if( ( version & 0xFFu ) != 2 || ( version & 0x1A00u ) ) // Tiled, deep or multi-part
+        return fail( "readEXR", filename, "only single part scanline files are supported" );
+
+    std::vector<ExrChannelInfo> channels;
+    int    compression = -1;
+    int    window[4]   = { 0, 0, -1, -1 }; // xMin, yMin, xMax, yMax
+    size_t pos         = 8;
+    for( ;; )
+    {
+        const size_t name_end = std::find( file.begin() + pos, file.end(), 0 ) - file.begin();
+        if( name_end == file.size() )
+            return fail( "readEXR", filename, "header is truncated" );
+        const std::string name( file.begin() + pos, file.begin() + name_end );
+        pos = name_end + 1;
+        if( name.empty() )
+            break;
+
+        const size_t type_end = std::find( file.begin() + pos, file.end(), 0 ) - file.begin();
+        if( type_end + 5 > file.size() )
+            return fail( "readEXR", filename, "header is truncated" );
+        const size_t size = get<unsigned int>( &file[type_end + 1] );
+        pos = type_end + 5;
+        if( size > file.size() - pos )
+            return fail( "readEXR", filename, "header is truncated" );
+        const unsigned char* value = &file[pos];
+
+        if( name == "channels" )
+        {
+            for( size_t i = 0; i < size && value[i]; )
+            {
+                ExrChannelInfo channel;
+                while( i < size && value[i] )
+                    channel.name += static_cast<char>( value[i++] );
+                if( size - i < 17 )
+                    return fail( "readEXR", filename, "invalid channel list" );
+                channel.type = get<int>( value + i + 1 );
+                if( get<int>( value + i + 9 ) != 1 || get<int>( value + i + 13 ) != 1 )
+                    return fail( "readEXR", filename, "subsampled channels are not supported" );
+                if( channel.type < EXR_UINT || channel.type > EXR_FLOAT )
+                    return fail( "readEXR", filename, "unknown pixel type" );
+                channels.push_back( channel );
+                i += 17;
+            }
+        }
+        else if( name == "compression" && size >= 1 )
+        {
+            compression = value[0];
+        }
+        else if( name == "dataWindow" && size >= 16 )
+        {
+            for( int i = 0; i < 4; ++i )
+                window[i] = get<int>( value + 4 * i );
+        }
+        pos += size;
+    }
+
+    if( window[2] < window[0] || window[3] < window[1] || channels.empty() )
+        return fail( "readEXR", filename, "invalid header" );
+    unsigned int block_lines;
+    switch( compression )
+    {
+        case 0: // NONE
+        case 1: // RLE
+        case 2: // ZIPS
+            block_lines = 1;
+            break;
+        case 3: // ZIP
+            block_lines = 16;
+            break;
+        default:
+            return fail( "readEXR", filename, "only NONE, RLE, ZIPS and ZIP compression are supported" );
+    }
+
+    const unsigned int width  = static_cast<unsigned int>( window[2] - window[0] + 1 );
+    const unsigned int height = static_cast<unsigned int>( window[3] - window[1] + 1 );
+    size_t line_bytes = 0;
+    for( size_t c = 0; c < channels.size(); ++c )
+    {
+        channels[c].offset = line_bytes;
+        line_bytes += size_t( width ) * ( channels[c].type == EXR_HALF ? 2 : 4 );
+    }
+
+    int rgb[3] = { -1, -1, -1 };
+    int grey   = -1;
+    for( size_t c = 0; c < channels.size(); ++c )
+    {
+        const std::string& name = channels[c].name;
+        if( name == "R" || name == "G" || name == "B" )
+            rgb[name == "R" ? 0 : name == "G" ? 1 : 2] = static_cast<int>( c );
+        else if( name == "Y" )
+            grey = static_cast<int>( c );
+    }
+    if( rgb[0] < 0 || rgb[1] < 0 || rgb[2] < 0 )
+    {
+        if( grey < 0 )
+            return fail( "readEXR", filename, "no R, G, B or Y channels" );
+        rgb[0] = rgb[1] = rgb[2] = grey;
+    }
+
+    const size_t blocks = ( height + block_lines - 1 ) / block_lines;
+    if( file.size() - pos < blocks * 8 )
+        return fail( "readEXR", filename, "file is truncated" );
+    const unsigned char* offsets = &file[pos];
+
+    image.width  = width;
+    image.height = height;
+    image.linear = true;
+    image.pixels.resize( size_t( width ) * height * 3 );
+
+    // Blocks are independent and decoded in parallel.
+    std::atomic<bool> corrupt( false );
+    parallelFor( blocks, [&]( size_t begin, size_t end ) {
+        std::vector<unsigned char> unpacked, raw;
+        for( size_t b = begin; b < end && !corrupt; ++b )
+        {
+            const unsigned long long offset = get<unsigned long long>( offsets + 8 * b );
+            if( offset > file.size() - 8 )
+            {
+                corrupt = true;
+                break;
+            }
+            const long long    first  = static_cast<long long>( get<int>( &file[offset] ) ) - window[1];
+            const unsigned int packed = get<unsigned int>( &file[offset + 4] );
+            if( first < 0 || first >= height || first % block_lines != 0 || packed > file.size() - offset - 8 )
+            {
+                corrupt = true;
+                break;
+            }
+            const unsigned int   lines    = std::min<unsigned int>( block_lines, height - static_cast<unsigned int>( first ) );
+            const size_t         expected = lines * line_bytes;
+            const unsigned char* data     = &file[offset + 8];
+
+            // Blocks which do not get smaller are stored uncompressed.
+            const unsigned char* pixels = data;
+            if( packed != expected )
+            {
+                bool ok = compression == 1 && exrRunLengthDecode( data, packed, unpacked, expected );
+                if( compression >= 2 )
+                {
+                    unpacked.resize( expected );
+                    ok = Inflater( data, packed ).zlib( unpacked.data(), expected );
+                }
+                if( !ok )
+                {
+                    corrupt = true;
+                    break;
+                }
+                exrUnpredict( unpacked, raw );
+                pixels = raw.data();
+            }
+
+            for( unsigned int l = 0; l < lines; ++l )
+            {
+                const unsigned char* line = pixels + l * line_bytes;
+                float*               dst  = &image.pixels[( size_t( first ) + l ) * width * 3];
+                for( unsigned int x = 0; x < width; ++x )
+                    for( int c = 0; c < 3; ++c )
+                        *dst++ = exrValue( line, channels[rgb[c]], x );
+            }
+        }
+    } );
+
+    if( corrupt )
+        return fail( "readEXR", filename, "corrupt image data" );
+    return true;
+}
+
+
+bool sutil::readImageFile( const std::string& filename, FloatImage& image )
+{
+    ProfileScope profile( "read image", filename.c_str() );
+    std::string suffix = filename.length() > 4 ? filename.substr( filename.length() - 4 ) : std::string();
+    std::transform( suffix.begin(), suffix.end(), suffix.begin(), ::tolower );
+
+    if( suffix == ".exr" )
+        return readEXR( filename.c_str(), image );
+    if( suffix == ".pfm" )
+        return readPFM( filename.c_str(), image );
+    if( suffix == ".png" )
+        return readPNG( filename.c_str(), image );
+    if( suffix == ".ppm" || suffix == ".pgm" )
+        return readPPM( filename.c_str(), image );
+
+    std::cerr << "ERROR: Unrecognized image file extension: " << filename << std::endl;
+    return false;
+}
@@ -0,0 +1,64 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <sutilapi.h>
+
+#include <string>
+#include <vector>
+
+// Readers for the image files the samples write, so renders can be compared against gold images.
+// Only what ImageWriter and common tools produce is supported: binary PPM (P5, P6) and PFM, non-interlaced
+// PNG with 8 or 16 bits per channel, and single part scanline OpenEXR with NONE, RLE, ZIPS or ZIP compression.
+// Alpha is dropped. Errors are reported on std::cerr.
+
+namespace sutil
+{
+
+struct FloatImage
+{
+    SUTILAPI FloatImage();
+
+    unsigned int       width;
+    unsigned int       height;
+    std::vector<float> pixels; // width * height RGB pixels, top-down.
+    bool               linear; // .exr and .pfm hold linear values; .png and .ppm values are sRGB encoded, scaled to [0, 1].
+};
+
+SUTILAPI bool readPPM( const char* filename, FloatImage& image );
+SUTILAPI bool readPFM( const char* filename, FloatImage& image );
+SUTILAPI bool readPNG( const char* filename, FloatImage& image );
+
+// Channels R, G and B, or Y for a grey image. Other layers are ignored.
+SUTILAPI bool readEXR( const char* filename, FloatImage& image );
+
+// Read an image with the type based on the extension: .exr, .pfm, .png or .ppm.
+SUTILAPI bool readImageFile( const std::string& filename, FloatImage& image );
+
+} // end namespace sutil
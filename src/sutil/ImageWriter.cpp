@@ -0,0 +1,1115 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sutil/ImageWriter.h>
+#include <sutil/ColorSpace.h>
+#include <sutil/HalfFloat.h>
+#include <sutil/Parallel.h>
+#include <sutil/Profiler.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Part of the stb_image_write implementation compiled into sutil. Returns a malloc'ed zlib stream.
+unsigned char* stbi_zlib_compress( unsigned char* data, int data_len, int* out_len, int quality );
+
+using namespace optix;
+
+// All writers store little endian data as the file formats demand, which is the host byte order on the supported platforms.
+
+namespace
+{
+
+const unsigned int kBlockLines = 16; // Scanlines per EXR ZIP block and per parallel PNG chunk.
+
+// Source pixel (x, y) in top-down order.
+inline const float* sourcePixel( const float* pixels, unsigned int width, unsigned int height,
+                                 unsigned int components, bool bottom_up, unsigned int x, unsigned int y )
+{
+    const size_t row = bottom_up ? height - 1 - y : y;
+    return pixels + ( row * width + x ) * components;
+}
+
+template<typename T>
+inline void put( std::vector<unsigned char>& out, const T& value )
+{
+    const unsigned char* p = reinterpret_cast<const unsigned char*>( &value );
+    out.insert( out.end(), p, p + sizeof( T ) );
+}
+
+inline void putString( std::vector<unsigned char>& out, const char* s )
+{
+    out.insert( out.end(), s, s + strlen( s ) + 1 );
+}
+
+inline void putBigEndian( std::vector<unsigned char>& out, unsigned int value )
+{
+    out.push_back( static_cast<unsigned char>( value >> 24 ) );
+    out.push_back( static_cast<unsigned char>( value >> 16 ) );
+    out.push_back( static_cast<unsigned char>( value >> 8 ) );
+    out.push_back( static_cast<unsigned char>( value ) );
+}
+
+bool writeFile( const char* filename, const std::vector<unsigned char>& header, const std::vector< std::vector<unsigned char> >& blocks )
+{
+    FILE* file = fopen( filename, "wb" );
+    if( !file )
+    {
+        std::cerr << "ERROR: Could not open '" << filename << "' for writing." << std::endl;
+        return false;
+    }
+    bool success = fwrite( header.data(), 1, header.size(), file ) == header.size();
+    for( size_t i = 0; i < blocks.size() && success; ++i )
+        success = fwrite( blocks[i].data(), 1, blocks[i].size(), file ) == blocks[i].size();
+    success = ( fclose( file ) == 0 ) && success;
+    if( !success )
+        std::cerr << "ERROR: Could not write '" << filename << "'." << std::endl;
+    return success;
+}
+
+//------------------------------------------------------------------------------
+//
+//  zlib helpers
+//
+//------------------------------------------------------------------------------
+
+unsigned int adler32( const unsigned char* data, size_t size )
+{
+    unsigned int a = 1, b = 0;
+    while( size )
+    {
+        const size_t n = std::min<size_t>( size, 5552 ); // Largest n before b can overflow.
+        for( size_t i = 0; i < n; ++i )
+        {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521u;
+        b %= 65521u;
+        data += n;
+        size -= n;
+    }
+    return ( b << 16 ) | a;
+}
+
+// Checksum of the concatenation of two buffers from their checksums (from zlib).
+unsigned int adler32Combine( unsigned int adler1, unsigned int adler2, size_t size2 )
+{
+    const unsigned int base = 65521u;
+    const unsigned int rem  = static_cast<unsigned int>( size2 % base );
+    unsigned int sum1 = adler1 & 0xFFFFu;
+    unsigned int sum2 = static_cast<unsigned int>( ( static_cast<unsigned long long>( rem ) * sum1 ) % base );
+    sum1 += ( adler2 & 0xFFFFu ) + base - 1;
+    sum2 += ( adler1 >> 16 ) + ( adler2 >> 16 ) + base - rem;
+    if( sum1 >= base ) sum1 -= base;
+    if( sum1 >= base ) sum1 -= base;
+    if( sum2 >= ( base << 1 ) ) sum2 -= ( base << 1 );
+    if( sum2 >= base ) sum2 -= base;
+    return sum1 | ( sum2 << 16 );
+}
+
+unsigned int crc32( unsigned int crc, const unsigned char* data, size_t size )
+{
+    static unsigned int table[256];
+    static bool         initialized = false; // Written once before any parallel work.
+    if( !initialized )
+    {
+        for( unsigned int i = 0; i < 256; ++i )
+        {
+            unsigned int c = i;
+            for( int k = 0; k < 8; ++k )
+                c = ( c & 1 ) ? 0xEDB88320u ^ ( c >> 1 ) : c >> 1;
+            table[i] = c;
+        }
+        initialized = true;
+    }
+    crc = ~crc;
+    for( size_t i = 0; i < size; ++i )
+        crc = table[( crc ^ data[i] ) & 0xFF] ^ ( crc >> 8 );
+    return ~crc;
+}
+
+// Compress into a complete zlib stream. Returns false when stb fails.
+bool zlibCompress( std::vector<unsigned char>& data, std::vector<unsigned char>& out )
+{
+    int size = 0;
+    unsigned char* z = stbi_zlib_compress( data.data(), static_cast<int>( data.size() ), &size, 8 );
+    if( !z )
+        return false;
+    out.assign( z, z + size );
+    free( z );
+    return true;
+}
+
+// LSB first bit reader over a deflate stream.
+struct BitReader
+{
+    const unsigned char* data;
+    size_t               size;
+    size_t               bit;
+
+    unsigned int get( unsigned int count )
+    {
+        unsigned int value = 0;
+        for( unsigned int i = 0; i < count; ++i, ++bit )
+        {
+            if( ( bit >> 3 ) >= size )
+                throw Exception( "Deflate stream ended early" );
+            value |= ( ( data[bit >> 3] >> ( bit & 7 ) ) & 1u ) << i;
+        }
+        return value;
+    }
+
+    // Huffman codes are stored most significant bit first.
+    unsigned int getCode( unsigned int count )
+    {
+        unsigned int value = 0;
+        for( unsigned int i = 0; i < count; ++i )
+            value = ( value << 1 ) | get( 1 );
+        return value;
+    }
+};
+
+// stb writes a single final block with fixed Huffman codes. Returns the bit position after its end-of-block code.
+size_t fixedHuffmanBlockEnd( const unsigned char* deflate, size_t size )
+{
+    static const unsigned char lengthExtra[29]   = { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0 };
+    static const unsigned char distanceExtra[30] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+
+    BitReader reader = { deflate, size, 3 }; // Skip BFINAL and BTYPE.
+    for( ;; )
+    {
+        unsigned int symbol;
+        unsigned int code = reader.getCode( 7 );
+        if( code <= 0x17 )
+            symbol = 256 + code;
+        else
+        {
+            code = ( code << 1 ) | reader.get( 1 );
+            if( 0x30 <= code && code <= 0xBF )
+                symbol = code - 0x30;
+            else if( 0xC0 <= code && code <= 0xC7 )
+                symbol = 280 + code - 0xC0;
+            else
+                symbol = 144 + ( ( code << 1 ) | reader.get( 1 ) ) - 0x190;
+        }
+
+        if( symbol == 256 )
+            return reader.bit;
+        if( symbol > 256 )
+        {
+            if( symbol > 285 )
+                throw Exception( "Invalid deflate length code" );
+            reader.get( lengthExtra[symbol - 257] );
+            const unsigned int distance = reader.getCode( 5 );
+            if( distance >= 30 )
+                throw Exception( "Invalid deflate distance code" );
+            reader.get( distanceExtra[distance] );
+        }
+    }
+}
+
+// Turn a zlib stream into raw deflate data which can be followed by further deflate data:
+// the final bit is cleared and a sync flush (empty stored block) ends the data on a byte boundary.
+void zlibToDeflateChunk( const std::vector<unsigned char>& zlib, std::vector<unsigned char>& chunk )
+{
+    const unsigned char* deflate = zlib.data() + 2;  // Skip the zlib header,
+    const size_t         size    = zlib.size() - 6;  // and the Adler-32 trailer.
+
+    const size_t end = fixedHuffmanBlockEnd( deflate, size );
+
+    chunk.assign( deflate, deflate + ( end + 7 ) / 8 );
+    chunk[0] &= 0xFE; // BFINAL = 0
+
+    // The bits after the end-of-block code are zero, which reads as a non-final stored block header (0, 00).
+    // A byte more is needed when less than three bits are left.
+    const size_t padding = ( 8 - ( end & 7 ) ) & 7;
+    if( padding < 3 )
+        chunk.push_back( 0 );
+    chunk.push_back( 0x00 ); // LEN = 0
+    chunk.push_back( 0x00 );
+    chunk.push_back( 0xFF ); // NLEN = ~0
+    chunk.push_back( 0xFF );
+}
+
+//------------------------------------------------------------------------------
+//
+//  OpenEXR
+//
+//------------------------------------------------------------------------------
+
+void putAttribute( std::vector<unsigned char>& out, const char* name, const char* type, const std::vector<unsigned char>& value )
+{
+    putString( out, name );
+    putString( out, type );
+    put( out, static_cast<int>( value.size() ) );
+    out.insert( out.end(), value.begin(), value.end() );
+}
+
+// Channels must be in alphabetical order, which is also their order inside the scanlines.
+void exrHeader( std::vector<unsigned char>& out, unsigned int width, unsigned int height, const std::vector<sutil::ExrChannel>& channels,
+                sutil::ExrCompression compression )
+{
+    put( out, 20000630 ); // Magic number.
+    put( out, 2 );        // Version 2, single part scanline file.
+
+    std::vector<unsigned char> list;
+    for( size_t c = 0; c < channels.size(); ++c )
+    {
+        putString( list, channels[c].name.c_str() );
+        put( list, channels[c].half ? 1 : 2 ); // HALF or FLOAT
+        put( list, 0 );                        // pLinear and reserved
+        put( list, 1 );                        // xSampling
+        put( list, 1 );                        // ySampling
+    }
+    list.push_back( 0 );
+    putAttribute( out, "channels", "chlist", list );
+
+    std::vector<unsigned char> value( 1, static_cast<unsigned char>( compression ) );
+    putAttribute( out, "compression", "compression", value );
+
+    std::vector<unsigned char> box;
+    put( box, 0 );
+    put( box, 0 );
+    put( box, static_cast<int>( width ) - 1 );
+    put( box, static_cast<int>( height ) - 1 );
+    putAttribute( out, "dataWindow", "box2i", box );
+    putAttribute( out, "displayWindow", "box2i", box );
+
+    value.assign( 1, 0 ); // INCREASING_Y
+    putAttribute( out, "lineOrder", "lineOrder", value );
+
+    value.clear();
+    put( value, 1.0f );
+    putAttribute( out, "pixelAspectRatio", "float", value );
+
+    value.clear();
+    put( value, 0.0f );
+    put( value, 0.0f );
+    putAttribute( out, "screenWindowCenter", "v2f", value );
+
+    value.clear();
+    put( value, 1.0f );
+    putAttribute( out, "screenWindowWidth", "float", value );
+
+    out.push_back( 0 ); // End of header.
+}
+
+// Channels B, G, R of an RGB image.
+void exrHeader( std::vector<unsigned char>& out, unsigned int width, unsigned int height, bool half, sutil::ExrCompression compression )
+{
+    std::vector<sutil::ExrChannel> channels( 3 );
+    const char* names[3] = { "B", "G", "R" };
+    for( int c = 0; c < 3; ++c )
+    {
+        channels[c].name = names[c];
+        channels[c].half = half;
+    }
+    exrHeader( out, width, height, channels, compression );
+}
+
+// Byte interleaving and delta predictor applied before zlib by the OpenEXR ZIP codec.
+void exrZipPrepare( const std::vector<unsigned char>& raw, std::vector<unsigned char>& prepared )
+{
+    prepared.resize( raw.size() );
+    const size_t half = ( raw.size() + 1 ) / 2;
+    for( size_t i = 0; i < raw.size(); ++i )
+        prepared[( i & 1 ) ? half + i / 2 : i / 2] = raw[i];
+
+    unsigned char previous = prepared.empty() ? 0 : prepared[0];
+    for( size_t i = 1; i < prepared.size(); ++i )
+    {
+        const unsigned char current = prepared[i];
+        prepared[i] = static_cast<unsigned char>( int( current ) - int( previous ) + ( 128 + 256 ) );
+        previous = current;
+    }
+}
+
+// One EXR scanline from a row of pixels: all B values, then all G values, then all R values.
+void exrLine( const float* row, unsigned int width, unsigned int components, bool half, unsigned char* dst )
+{
+    for( int c = 2; c >= 0; --c )
+    {
+        for( unsigned int x = 0; x < width; ++x )
+        {
+            const float v = row[x * components + c];
+            if( half )
+            {
+                const unsigned short h = sutil::floatToHalf( v );
+                memcpy( dst, &h, 2 );
+                dst += 2;
+            }
+            else
+            {
+                memcpy( dst, &v, 4 );
+                dst += 4;
+            }
+        }
+    }
+}
+
+// One channel of an EXR scanline, y counts from the top.
+unsigned char* exrChannelLine( const sutil::ExrChannel& channel, unsigned int width, unsigned int height, bool bottom_up,
+                               unsigned int y, unsigned char* dst )
+{
+    const size_t row = bottom_up ? height - 1 - y : y;
+    const float* src = channel.pixels + row * width * channel.stride;
+    for( unsigned int x = 0; x < width; ++x, src += channel.stride )
+    {
+        if( channel.half )
+        {
+            const unsigned short h = sutil::floatToHalf( *src );
+            memcpy( dst, &h, 2 );
+            dst += 2;
+        }
+        else
+        {
+            memcpy( dst, src, 4 );
+            dst += 4;
+        }
+    }
+    return dst;
+}
+
+// A scanline block with its y coordinate and data size. Returns false when compression fails.
+bool exrBlock( const std::vector<unsigned char>& raw, unsigned int y0, sutil::ExrCompression compression,
+               std::vector<unsigned char>& prepared, std::vector<unsigned char>& compressed, std::vector<unsigned char>& block )
+{
+    const std::vector<unsigned char>* data = &raw;
+    if( compression == sutil::EXR_COMPRESSION_ZIP )
+    {
+        exrZipPrepare( raw, prepared );
+        if( !zlibCompress( prepared, compressed ) )
+            return false;
+        if( compressed.size() < raw.size() ) // Incompressible blocks are stored as they are.
+            data = &compressed;
+    }
+
+    block.clear();
+    put( block, static_cast<int>( y0 ) );
+    put( block, static_cast<int>( data->size() ) );
+    block.insert( block.end(), data->begin(), data->end() );
+    return true;
+}
+
+//------------------------------------------------------------------------------
+//
+//  PNG
+//
+//------------------------------------------------------------------------------
+
+// Three big endian 16-bit channels per pixel. The clamped linear values are sRGB encoded.
+void png16Line( const float* row, unsigned int width, unsigned int components, unsigned char* dst )
+{
+    for( unsigned int x = 0; x < width; ++x )
+    {
+        const float* src = row + x * components;
+        for( int c = 0; c < 3; ++c )
+        {
+            const float v = sutil::linearToSrgb( std::min( std::max( src[c], 0.0f ), 1.0f ) );
+            const unsigned int q = static_cast<unsigned int>( v * 65535.0f + 0.5f );
+            *dst++ = static_cast<unsigned char>( q >> 8 );
+            *dst++ = static_cast<unsigned char>( q );
+        }
+    }
+}
+
+// RGB8 from the BGRA8 layout of the display output.
+void png8Line( const unsigned char* bgra, unsigned int width, unsigned char* dst )
+{
+    for( unsigned int x = 0; x < width; ++x, bgra += 4 )
+    {
+        *dst++ = bgra[2];
+        *dst++ = bgra[1];
+        *dst++ = bgra[0];
+    }
+}
+
+// Append the filter type and the filtered row. Picks the filter with the smallest sum of absolute
+// signed differences, like stb_image_write. previous is null for the first row of the image.
+void filterPngRow( const unsigned char* current, const unsigned char* previous, size_t row_bytes, size_t bpp,
+                   std::vector<unsigned char> ( &candidate )[5], std::vector<unsigned char>& filtered )
+{
+    int best = 0;
+    long long best_sum = -1;
+    for( int f = 0; f < 5; ++f )
+    {
+        candidate[f].resize( row_bytes );
+        long long sum = 0;
+        for( size_t i = 0; i < row_bytes; ++i )
+        {
+            const int a = ( i >= bpp ) ? current[i - bpp] : 0;
+            const int b = previous ? previous[i] : 0;
+            const int c = ( i >= bpp && previous ) ? previous[i - bpp] : 0;
+            int predictor = 0;
+            switch( f )
+            {
+                case 1: predictor = a; break;
+                case 2: predictor = b; break;
+                case 3: predictor = ( a + b ) >> 1; break;
+                case 4:
+                {
+                    const int p  = a + b - c;
+                    const int pa = abs( p - a ), pb = abs( p - b ), pc = abs( p - c );
+                    predictor = ( pa <= pb && pa <= pc ) ? a : ( pb <= pc ) ? b : c;
+                    break;
+                }
+            }
+            candidate[f][i] = static_cast<unsigned char>( current[i] - predictor );
+            sum += abs( static_cast<signed char>( candidate[f][i] ) );
+        }
+        if( best_sum < 0 || sum < best_sum )
+        {
+            best     = f;
+            best_sum = sum;
+        }
+    }
+    filtered.push_back( static_cast<unsigned char>( best ) );
+    filtered.insert( filtered.end(), candidate[best].begin(), candidate[best].end() );
+}
+
+// Length, type, data and CRC of a PNG chunk.
+void putPngChunk( std::vector<unsigned char>& out, const char* type, const unsigned char* data, size_t size )
+{
+    putBigEndian( out, static_cast<unsigned int>( size ) );
+    const size_t start = out.size();
+    out.insert( out.end(), type, type + 4 );
+    out.insert( out.end(), data, data + size );
+    putBigEndian( out, crc32( 0, out.data() + start, out.size() - start ) );
+}
+
+bool seekFile( FILE* file, unsigned long long offset )
+{
+#if defined( _WIN32 )
+    return _fseeki64( file, static_cast<__int64>( offset ), SEEK_SET ) == 0;
+#else
+    return fseeko( file, static_cast<off_t>( offset ), SEEK_SET ) == 0;
+#endif
+}
+
+// Signature, IHDR for RGB with 8 or 16 bits per channel, and the sRGB chunk.
+void pngHeader( std::vector<unsigned char>& out, unsigned int width, unsigned int height, unsigned int bits )
+{
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    out.insert( out.end(), signature, signature + 8 );
+
+    // Colour type 2 (RGB), deflate, adaptive filtering, no interlace.
+    std::vector<unsigned char> ihdr;
+    putBigEndian( ihdr, width );
+    putBigEndian( ihdr, height );
+    ihdr.insert( ihdr.end(), { static_cast<unsigned char>( bits ), 2, 0, 0, 0 } );
+    putPngChunk( out, "IHDR", ihdr.data(), ihdr.size() );
+
+    const unsigned char intent = 0; // Perceptual rendering intent.
+    putPngChunk( out, "sRGB", &intent, 1 );
+}
+
+} // end anonymous namespace
+
+
+bool sutil::writeEXR( const char* filename, const float* pixels, unsigned int width, unsigned int height,
+                      unsigned int components, bool bottom_up, bool half, sutil::ExrCompression compression )
+{
+    if( !pixels || width == 0 || height == 0 || components < 3 )
+    {
+        std::cerr << "ERROR: writeEXR() invalid image for '" << filename << "'." << std::endl;
+        return false;
+    }
+
+    std::vector<ExrChannel> channels( 3 );
+    const char* names[3] = { "R", "G", "B" };
+    for( int c = 0; c < 3; ++c )
+    {
+        channels[c].name   = names[c];
+        channels[c].pixels = pixels + c;
+        channels[c].stride = components;
+        channels[c].half   = half;
+    }
+    return writeEXR( filename, channels, width, height, bottom_up, compression );
+}
+
+
+bool sutil::writeEXR( const char* filename, const std::vector<ExrChannel>& channels, unsigned int width, unsigned int height,
+                      bool bottom_up, ExrCompression compression )
+{
+    if( channels.empty() || width == 0 || height == 0 )
+    {
+        std::cerr << "ERROR: writeEXR() invalid image for '" << filename << "'." << std::endl;
+        return false;
+    }
+
+    std::vector<ExrChannel> sorted( channels );
+    std::sort( sorted.begin(), sorted.end(), []( const ExrChannel& a, const ExrChannel& b ) { return a.name < b.name; } );
+    size_t line_bytes = 0;
+    for( size_t c = 0; c < sorted.size(); ++c )
+    {
+        if( !sorted[c].pixels || sorted[c].stride == 0 || sorted[c].name.empty() || ( c > 0 && sorted[c].name == sorted[c - 1].name ) )
+        {
+            std::cerr << "ERROR: writeEXR() invalid channel '" << sorted[c].name << "' for '" << filename << "'." << std::endl;
+            return false;
+        }
+        line_bytes += size_t( width ) * ( sorted[c].half ? 2 : 4 );
+    }
+
+    const unsigned int lines_per_block = ( compression == EXR_COMPRESSION_ZIP ) ? kBlockLines : 1;
+    const size_t       num_blocks      = ( height + lines_per_block - 1 ) / lines_per_block;
+
+    std::vector<unsigned char> header;
+    exrHeader( header, width, height, sorted, compression );
+
+    std::vector< std::vector<unsigned char> > blocks( num_blocks );
+    bool failed = false;
+
+    sutil::parallelFor( num_blocks, [&]( size_t begin, size_t end )
+    {
+        std::vector<unsigned char> raw, prepared, compressed;
+        for( size_t b = begin; b < end; ++b )
+        {
+            const unsigned int y0    = static_cast<unsigned int>( b * lines_per_block );
+            const unsigned int lines = std::min( lines_per_block, height - y0 );
+
+            raw.resize( size_t( lines ) * line_bytes );
+            for( unsigned int y = y0; y < y0 + lines; ++y )
+            {
+                unsigned char* dst = raw.data() + size_t( y - y0 ) * line_bytes;
+                for( size_t c = 0; c < sorted.size(); ++c )
+                    dst = exrChannelLine( sorted[c], width, height, bottom_up, y, dst );
+            }
+
+            if( !exrBlock( raw, y0, compression, prepared, compressed, blocks[b] ) )
+                failed = true;
+        }
+    }, 4 );
+
+    if( failed )
+    {
+        std::cerr << "ERROR: writeEXR() compression failed for '" << filename << "'." << std::endl;
+        return false;
+    }
+
+    // The offset table follows the header.
+    unsigned long long offset = header.size() + num_blocks * sizeof( unsigned long long );
+    for( size_t b = 0; b < num_blocks; ++b )
+    {
+        put( header, offset );
+        offset += blocks[b].size();
+    }
+
+    return writeFile( filename, header, blocks );
+}
+
+
+bool sutil::writePFM( const char* filename, const float* pixels, unsigned int width, unsigned int height,
+                      unsigned int components, bool bottom_up )
+{
+    if( !pixels || width == 0 || height == 0 || components < 3 )
+    {
+        std::cerr << "ERROR: writePFM() invalid image for '" << filename << "'." << std::endl;
+        return false;
+    }
+
+    char text[64];
+    snprintf( text, sizeof( text ), "PF\n%u %u\n-1.0\n", width, height ); // Negative scale: little endian.
+    std::vector<unsigned char> header( text, text + strlen( text ) );
+
+    // PFM rows are stored bottom-up.
+    std::vector< std::vector<unsigned char> > rows( 1 );
+    rows[0].resize( size_t( width ) * height * 3 * sizeof( float ) );
+    float* dst = reinterpret_cast<float*>( rows[0].data() );
+    for( unsigned int y = height; y-- > 0; )
+    {
+        for( unsigned int x = 0; x < width; ++x )
+        {
+            const float* src = sourcePixel( pixels, width, height, components, bottom_up, x, y );
+            *dst++ = src[0];
+            *dst++ = src[1];
+            *dst++ = src[2];
+        }
+    }
+
+    return writeFile( filename, header, rows );
+}
+
+
+bool sutil::writePNG16( const char* filename, const float* pixels, unsigned int width, unsigned int height,
+                        unsigned int components, bool bottom_up )
+{
+    if( !pixels || width == 0 || height == 0 || components < 3 )
+    {
+        std::cerr << "ERROR: writePNG16() invalid image for '" << filename << "'." << std::endl;
+        return false;
+    }
+
+    crc32( 0, 0, 0 ); // Build the table before going parallel.
+
+    const size_t bpp        = 6; // Bytes per pixel, three big endian 16-bit channels.
+    const size_t num_chunks = ( height + kBlockLines - 1 ) / kBlockLines;
+
+    // Every chunk of scanlines is filtered and deflated on its own. The chunks are
+    // concatenated into a single zlib stream, separated by sync flushes.
+    std::vector< std::vector<unsigned char> > chunks( num_chunks );
+    std::vector<unsigned int>                 checksums( num_chunks );
+    std::vector<size_t>                       sizes( num_chunks );
+
+    try
+    {
+        sutil::parallelFor( num_chunks, [&]( size_t begin, size_t end )
+        {
+            std::vector<unsigned char> previous( width * bpp ), current( width * bpp ), filtered, zlib;
+            std::vector<unsigned char> candidate[5];
+
+            for( size_t chunk = begin; chunk < end; ++chunk )
+            {
+                const unsigned int y0    = static_cast<unsigned int>( chunk * kBlockLines );
+                const unsigned int lines = std::min( kBlockLines, height - y0 );
+
+                filtered.clear();
+                for( unsigned int y = ( y0 == 0 ) ? 0 : y0 - 1; y < y0 + lines; ++y )
+                {
+                    current.swap( previous );
+                    png16Line( sourcePixel( pixels, width, height, components, bottom_up, 0, y ), width, components, current.data() );
+                    if( y < y0 )
+                        continue; // Only needed as the previous row of the first line of this chunk.
+
+                    filterPngRow( current.data(), y != 0 ? previous.data() : nullptr, width * bpp, bpp, candidate, filtered );
+                }
+
+                checksums[chunk] = adler32( filtered.data(), filtered.size() );
+                sizes[chunk]     = filtered.size();
+                if( !zlibCompress( filtered, zlib ) )
+                    throw Exception( "zlib compression failed" );
+
+                if( chunk + 1 < num_chunks )
+                    zlibToDeflateChunk( zlib, chunks[chunk] );
+                else
+                    chunks[chunk].assign( zlib.begin() + 2, zlib.end() - 4 ); // The last block stays final.
+            }
+        }, 1 );
+    }
+    catch( const Exception& e )
+    {
+        std::cerr << "ERROR: writePNG16() " << e.getErrorString() << " for '" << filename << "'." << std::endl;
+        return false;
+    }
+
+    unsigned int adler = 1;
+    for( size_t chunk = 0; chunk < num_chunks; ++chunk )
+        adler = adler32Combine( adler, checksums[chunk], sizes[chunk] );
+
+    size_t idat_size = 2 + 4;
+    for( size_t chunk = 0; chunk < num_chunks; ++chunk )
+        idat_size += chunks[chunk].size();
+    if( idat_size > 0x7FFFFFFFu )
+    {
+        std::cerr << "ERROR: writePNG16() image too large for '" << filename << "'." << std::endl;
+        return false;
+    }
+
+    std::vector<unsigned char> header;
+    pngHeader( header, width, height, 16 );
+
+    // One IDAT chunk holding the zlib stream. Its CRC covers the type and all data.
+    const unsigned char idat_start[6] = { 'I', 'D', 'A', 'T', 0x78, 0x5E };
+    putBigEndian( header, static_cast<unsigned int>( idat_size ) );
+    header.insert( header.end(), idat_start, idat_start + 6 );
+    unsigned int crc = crc32( 0, idat_start, 6 );
+    for( size_t chunk = 0; chunk < num_chunks; ++chunk )
+        crc = crc32( crc, chunks[chunk].data(), chunks[chunk].size() );
+
+    std::vector<unsigned char> trailer;
+    putBigEndian( trailer, adler );
+    crc = crc32( crc, trailer.data(), trailer.size() );
+    putBigEndian( trailer, crc );
+    putPngChunk( trailer, "IEND", nullptr, 0 );
+    chunks.push_back( trailer );
+
+    return writeFile( filename, header, chunks );
+}
+
+
+bool sutil::writeFloatImageToFile( const char* filename, const float* pixels, unsigned int width, unsigned int height,
+                                   unsigned int components )
+{
+    ProfileScope profile( "write image", filename );
+    std::string suffix;
+    const std::string fn( filename );
+    if( fn.length() > 4 )
+        suffix = fn.substr( fn.length() - 4 );
+
+    if( suffix == ".exr" )
+        return writeEXR( filename, pixels, width, height, components, true, true, EXR_COMPRESSION_ZIP );
+    if( suffix == ".pfm" )
+        return writePFM( filename, pixels, width, height, components, true );
+    if( suffix == ".png" )
+        return writePNG16( filename, pixels, width, height, components, true );
+
+    std::cerr << "ERROR: Unrecognized float image file extension: " << filename << std::endl;
+    return false;
+}
+
+
+void sutil::writeFloatBufferToFile( const char* filename, Buffer buffer )
+{
+    RTsize buffer_width, buffer_height;
+    buffer->getSize( buffer_width, buffer_height );
+
+    unsigned int components = 0;
+    switch( buffer->getFormat() )
+    {
+        case RT_FORMAT_FLOAT3: components = 3; break;
+        case RT_FORMAT_FLOAT4: components = 4; break;
+        default:
+            throw Exception( "writeFloatBufferToFile() needs a float3 or float4 buffer" );
+    }
+
+    const float* pixels = static_cast<const float*>( buffer->map( 0, RT_BUFFER_MAP_READ ) );
+    const bool success = writeFloatImageToFile( filename, pixels, static_cast<unsigned int>( buffer_width ),
+                                                static_cast<unsigned int>( buffer_height ), components );
+    buffer->unmap();
+
+    if( !success )
+        throw Exception( std::string( "Failed to write image: " ) + filename );
+}
+
+
+sutil::StreamingImageWriter::StreamingImageWriter()
+    : m_file( nullptr ),
+      m_type( TYPE_PFM ),
+      m_width( 0 ),
+      m_height( 0 ),
+      m_lineBytes( 0 ),
+      m_blockLines( 1 ),
+      m_linesWritten( 0 ),
+      m_linesEncoded( 0 ),
+      m_headerBytes( 0 ),
+      m_adler( 1 ),
+      m_bytes( 0 ),
+      m_failed( false )
+{
+}
+
+
+sutil::StreamingImageWriter::~StreamingImageWriter()
+{
+    if( m_file )
+    {
+        fclose( m_file );
+        remove( m_filename.c_str() );
+    }
+}
+
+
+bool sutil::StreamingImageWriter::open( const std::string& filename, unsigned int width, unsigned int height, bool png16 )
+{
+    m_filename = filename;
+    if( m_file || width == 0 || height == 0 )
+        return fail( "open() invalid image" );
+
+    const std::string suffix = filename.length() > 4 ? filename.substr( filename.length() - 4 ) : std::string();
+    if( suffix == ".exr" )
+        m_type = TYPE_EXR;
+    else if( suffix == ".pfm" )
+        m_type = TYPE_PFM;
+    else if( suffix == ".png" )
+        m_type = png16 ? TYPE_PNG16 : TYPE_PNG8;
+    else
+        return fail( "can only stream .exr, .pfm and .png files" );
+
+    m_width        = width;
+    m_height       = height;
+    m_blockLines   = kBlockLines;
+    m_linesWritten = 0;
+    m_linesEncoded = 0;
+    m_adler        = 1;
+    m_bytes        = 0;
+    m_failed       = false;
+    m_pending.clear();
+    m_previousLine.clear();
+    m_offsets.clear();
+
+    std::vector<unsigned char> header;
+    switch( m_type )
+    {
+        case TYPE_EXR:
+        {
+            m_lineBytes = size_t( width ) * 3 * 2;
+            exrHeader( header, width, height, true, EXR_COMPRESSION_ZIP );
+            m_headerBytes = header.size();
+            // Room for the offset table, filled in by close().
+            header.resize( header.size() + ( ( height + kBlockLines - 1 ) / kBlockLines ) * sizeof( unsigned long long ), 0 );
+            break;
+        }
+        case TYPE_PFM:
+        {
+            m_lineBytes = size_t( width ) * 3 * sizeof( float );
+            char text[64];
+            snprintf( text, sizeof( text ), "PF\n%u %u\n-1.0\n", width, height ); // Negative scale: little endian.
+            header.assign( text, text + strlen( text ) );
+            m_headerBytes = header.size();
+            break;
+        }
+        case TYPE_PNG8:
+        case TYPE_PNG16:
+        {
+            crc32( 0, 0, 0 ); // Build the table before going parallel.
+            m_lineBytes = size_t( width ) * ( m_type == TYPE_PNG16 ? 6 : 3 );
+            pngHeader( header, width, height, m_type == TYPE_PNG16 ? 16 : 8 );
+            // The zlib stream spans all IDAT chunks. Its header gets a chunk of its own.
+            const unsigned char zlib_header[2] = { 0x78, 0x5E };
+            putPngChunk( header, "IDAT", zlib_header, 2 );
+            m_headerBytes = header.size();
+            break;
+        }
+    }
+
+    m_file = fopen( filename.c_str(), "wb" );
+    if( !m_file )
+    {
+        std::cerr << "ERROR: Could not open '" << filename << "' for writing." << std::endl;
+        return false;
+    }
+    return write( header.data(), header.size() );
+}
+
+
+bool sutil::StreamingImageWriter::takesFloat() const
+{
+    return m_type != TYPE_PNG8;
+}
+
+
+unsigned char* sutil::StreamingImageWriter::appendLine()
+{
+    m_pending.resize( m_pending.size() + m_lineBytes );
+    return m_pending.data() + m_pending.size() - m_lineBytes;
+}
+
+
+bool sutil::StreamingImageWriter::writeLines( const float* pixels, unsigned int lines, unsigned int components, bool bottom_up )
+{
+    if( !m_file || m_failed )
+        return false;
+    if( m_type == TYPE_PNG8 )
+        return fail( "writeLines() needs BGRA8 lines" );
+    if( !pixels || components < 3 || lines > m_height - m_linesWritten )
+        return fail( "writeLines() invalid lines" );
+
+    for( unsigned int i = 0; i < lines; ++i )
+    {
+        const float*   row = pixels + size_t( bottom_up ? lines - 1 - i : i ) * m_width * components;
+        unsigned char* dst = appendLine();
+        if( m_type == TYPE_EXR )
+            exrLine( row, m_width, components, true, dst );
+        else if( m_type == TYPE_PNG16 )
+            png16Line( row, m_width, components, dst );
+        else
+        {
+            float* rgb = reinterpret_cast<float*>( dst );
+            for( unsigned int x = 0; x < m_width; ++x, row += components )
+            {
+                *rgb++ = row[0];
+                *rgb++ = row[1];
+                *rgb++ = row[2];
+            }
+        }
+    }
+    m_linesWritten += lines;
+    return encode( m_linesWritten == m_height );
+}
+
+
+bool sutil::StreamingImageWriter::writeLines( const unsigned char* bgra, unsigned int lines, bool bottom_up )
+{
+    if( !m_file || m_failed )
+        return false;
+    if( m_type != TYPE_PNG8 )
+        return fail( "writeLines() needs float lines" );
+    if( !bgra || lines > m_height - m_linesWritten )
+        return fail( "writeLines() invalid lines" );
+
+    for( unsigned int i = 0; i < lines; ++i )
+        png8Line( bgra + size_t( bottom_up ? lines - 1 - i : i ) * m_width * 4, m_width, appendLine() );
+    m_linesWritten += lines;
+    return encode( m_linesWritten == m_height );
+}
+
+
+// Encodes and writes all complete blocks of pending lines, and the incomplete one after the last line.
+bool sutil::StreamingImageWriter::encode( bool last )
+{
+    const size_t pending_lines = m_pending.size() / m_lineBytes;
+    const size_t num_blocks    = last ? ( pending_lines + m_blockLines - 1 ) / m_blockLines : pending_lines / m_blockLines;
+    if( num_blocks == 0 )
+        return true;
+    const size_t encoded_lines = std::min( pending_lines, num_blocks * m_blockLines );
+
+    std::vector< std::vector<unsigned char> > blocks( num_blocks );
+    std::vector<unsigned int>                 checksums( num_blocks );
+    std::vector<size_t>                       sizes( num_blocks );
+    try
+    {
+        sutil::parallelFor( num_blocks, [&]( size_t begin, size_t end )
+        {
+            std::vector<unsigned char> raw, prepared, compressed, filtered, zlib, deflate;
+            std::vector<unsigned char> candidate[5];
+            for( size_t b = begin; b < end; ++b )
+            {
+                const size_t               first = b * m_blockLines;
+                const unsigned int         lines = static_cast<unsigned int>( std::min<size_t>( m_blockLines, pending_lines - first ) );
+                const unsigned int         y0    = m_linesEncoded + static_cast<unsigned int>( first );
+                const unsigned char* const src   = m_pending.data() + first * m_lineBytes;
+
+                switch( m_type )
+                {
+                    case TYPE_EXR:
+                        raw.assign( src, src + lines * m_lineBytes );
+                        if( !exrBlock( raw, y0, EXR_COMPRESSION_ZIP, prepared, compressed, blocks[b] ) )
+                            throw Exception( "compression failed" );
+                        break;
+
+                    case TYPE_PFM:
+                        // PFM lines are stored bottom-up, the block goes into the file reversed.
+                        blocks[b].resize( lines * m_lineBytes );
+                        for( unsigned int i = 0; i < lines; ++i )
+                            memcpy( blocks[b].data() + ( lines - 1 - i ) * m_lineBytes, src + i * m_lineBytes, m_lineBytes );
+                        break;
+
+                    case TYPE_PNG8:
+                    case TYPE_PNG16:
+                    {
+                        const size_t bpp = ( m_type == TYPE_PNG16 ) ? 6 : 3;
+                        filtered.clear();
+                        for( unsigned int i = 0; i < lines; ++i )
+                        {
+                            const unsigned char* previous = i > 0 ? src + ( i - 1 ) * m_lineBytes :
+                                                            y0 > 0 ? ( first > 0 ? src - m_lineBytes : m_previousLine.data() ) : nullptr;
+                            filterPngRow( src + i * m_lineBytes, previous, m_lineBytes, bpp, candidate, filtered );
+                        }
+                        checksums[b] = adler32( filtered.data(), filtered.size() );
+                        sizes[b]     = filtered.size();
+                        if( !zlibCompress( filtered, zlib ) )
+                            throw Exception( "compression failed" );
+                        // Every block ends with a sync flush, close() adds the final block.
+                        zlibToDeflateChunk( zlib, deflate );
+                        blocks[b].clear();
+                        putPngChunk( blocks[b], "IDAT", deflate.data(), deflate.size() );
+                        break;
+                    }
+                }
+            }
+        }, 1 );
+    }
+    catch( const Exception& e )
+    {
+        return fail( e.getErrorString().c_str() );
+    }
+
+    for( size_t b = 0; b < num_blocks; ++b )
+    {
+        const unsigned int y0    = m_linesEncoded + static_cast<unsigned int>( b * m_blockLines );
+        const unsigned int lines = static_cast<unsigned int>( std::min<size_t>( m_blockLines, pending_lines - b * m_blockLines ) );
+        if( m_type == TYPE_EXR )
+            m_offsets.push_back( m_bytes );
+        else if( m_type == TYPE_PFM )
+        {
+            if( !seekFile( m_file, m_headerBytes + ( m_height - y0 - lines ) * static_cast<unsigned long long>( m_lineBytes ) ) )
+                return fail( "seek failed" );
+        }
+        else
+            m_adler = adler32Combine( m_adler, checksums[b], sizes[b] );
+
+        if( !write( blocks[b].data(), blocks[b].size() ) )
+            return false;
+    }
+
+    m_previousLine.assign( m_pending.begin() + ( encoded_lines - 1 ) * m_lineBytes, m_pending.begin() + encoded_lines * m_lineBytes );
+    m_pending.erase( m_pending.begin(), m_pending.begin() + encoded_lines * m_lineBytes );
+    m_linesEncoded += static_cast<unsigned int>( encoded_lines );
+    return true;
+}
+
+
+bool sutil::StreamingImageWriter::write( const void* data, size_t size )
+{
+    if( fwrite( data, 1, size, m_file ) != size )
+        return fail( "write failed" );
+    m_bytes += size;
+    return true;
+}
+
+
+bool sutil::StreamingImageWriter::fail( const char* message )
+{
+    std::cerr << "ERROR: StreamingImageWriter " << message << " for '" << m_filename << "'." << std::endl;
+    m_failed = true;
+    return false;
+}
+
+
+bool sutil::StreamingImageWriter::close()
+{
+    if( !m_file )
+        return false;
+
+    bool success = !m_failed;
+    if( success && m_linesEncoded != m_height )
+        success = fail( "close() before all lines were written" );
+
+    if( success && m_type == TYPE_EXR )
+    {
+        success = seekFile( m_file, m_headerBytes ) &&
+                  fwrite( m_offsets.data(), sizeof( unsigned long long ), m_offsets.size(), m_file ) == m_offsets.size();
+    }
+    else if( success )
+    {
+        std::vector<unsigned char> trailer;
+        if( m_type != TYPE_PFM )
+        {
+            // An empty final stored block ends the deflate data, the Adler-32 checksum the zlib stream.
+            std::vector<unsigned char> end = { 0x01, 0x00, 0x00, 0xFF, 0xFF };
+            putBigEndian( end, m_adler );
+            putPngChunk( trailer, "IDAT", end.data(), end.size() );
+            putPngChunk( trailer, "IEND", nullptr, 0 );
+        }
+        success = write( trailer.data(), trailer.size() );
+    }
+
+    success = ( fclose( m_file ) == 0 ) && success;
+    m_file  = nullptr;
+    if( !success )
+    {
+        std::cerr << "ERROR: Could not write '" << m_filename << "'." << std::endl;
+        remove( m_filename.c_str() );
+    }
+    return success;
+}
@@ -0,0 +1,148 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <optixu/optixpp_namespace.h>
+#include <sutilapi.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Writers for linear float images, e.g. the accumulation buffer.
+// pixels holds width * height pixels of 'components' floats (3 or 4). Only RGB is written.
+// bottom_up marks OptiX buffer row order (row 0 is the bottom of the image).
+// Large images are encoded in parallel over blocks of scanlines.
+
+namespace sutil
+{
+
+// Values are the OpenEXR compression codes. Only these two are implemented, there is no PIZ encoder.
+enum ExrCompression
+{
+    EXR_COMPRESSION_NONE = 0,
+    EXR_COMPRESSION_ZIP  = 3 // zlib over blocks of 16 scanlines
+};
+
+// Single part scanline OpenEXR with HALF or FLOAT channels B, G, R.
+SUTILAPI bool writeEXR( const char* filename, const float* pixels, unsigned int width, unsigned int height,
+                        unsigned int components, bool bottom_up, bool half, ExrCompression compression );
+
+// One channel of a multi-channel EXR file. Layers are channels with a common prefix,
+// e.g. "normal.X", "normal.Y" and "normal.Z"; the default layer has no prefix (R, G, B, Z).
+struct ExrChannel
+{
+    ExrChannel() : pixels( 0 ), stride( 1 ), half( true ) {}
+
+    std::string  name;
+    const float* pixels; // Value of the first pixel, width * height values in the row order of the image.
+    unsigned int stride; // Floats from one pixel to the next.
+    bool         half;   // HALF, otherwise FLOAT.
+};
+
+// Single part scanline OpenEXR with any number of channels, in any order.
+SUTILAPI bool writeEXR( const char* filename, const std::vector<ExrChannel>& channels, unsigned int width, unsigned int height,
+                        bool bottom_up, ExrCompression compression );
+
+// Portable float map, three channels.
+SUTILAPI bool writePFM( const char* filename, const float* pixels, unsigned int width, unsigned int height,
+                        unsigned int components, bool bottom_up );
+
+// 16-bit per channel RGB PNG. The clamped linear values are sRGB encoded, like the 8-bit display output.
+SUTILAPI bool writePNG16( const char* filename, const float* pixels, unsigned int width, unsigned int height,
+                          unsigned int components, bool bottom_up );
+
+// Write bottom-up float pixels with the type based on the extension:
+// .exr (half, ZIP), .pfm, or .png (16-bit). Returns false for unknown extensions and write failures.
+SUTILAPI bool writeFloatImageToFile( const char* filename, const float* pixels, unsigned int width, unsigned int height,
+                                     unsigned int components );
+
+// Write a FLOAT3 or FLOAT4 buffer with the type based on the extension:
+// .exr (half, ZIP), .pfm, or .png (16-bit). The buffer must be readable on the host (no RT_BUFFER_GPU_LOCAL).
+// Throws an Exception on failure, like writeBufferToFile().
+SUTILAPI void writeFloatBufferToFile( const char* filename, optix::Buffer buffer );
+
+// Writes an image a few scanlines at a time, top to bottom, so an image larger than memory can be
+// produced in strips. Only the lines which do not fill a block yet are held. The type follows the
+// extension: .exr (half, ZIP) and .pfm take float lines, .png takes BGRA8 lines (8-bit RGB output)
+// or, with png16, float lines like writePNG16().
+class StreamingImageWriter
+{
+public:
+    SUTILAPI StreamingImageWriter();
+    SUTILAPI ~StreamingImageWriter(); // Removes an unfinished file.
+
+    SUTILAPI bool open( const std::string& filename, unsigned int width, unsigned int height, bool png16 );
+    SUTILAPI bool takesFloat() const;
+
+    // Append the next 'lines' scanlines. bottom_up: the first row of pixels is the lowest line.
+    SUTILAPI bool writeLines( const float* pixels, unsigned int lines, unsigned int components, bool bottom_up );
+    SUTILAPI bool writeLines( const unsigned char* bgra, unsigned int lines, bool bottom_up );
+
+    // Completes the file. Fails unless all lines were written.
+    SUTILAPI bool close();
+
+    SUTILAPI unsigned long long bytesWritten() const { return m_bytes; }
+
+private:
+    enum Type
+    {
+        TYPE_EXR,
+        TYPE_PFM,
+        TYPE_PNG8,
+        TYPE_PNG16
+    };
+
+    StreamingImageWriter( const StreamingImageWriter& );
+    StreamingImageWriter& operator=( const StreamingImageWriter& );
+
+    unsigned char* appendLine();
+    bool encode( bool last );
+    bool write( const void* data, size_t size );
+    bool fail( const char* message );
+
+    std::string                m_filename;
+    FILE*                      m_file;
+    Type                       m_type;
+    unsigned int               m_width;
+    unsigned int               m_height;
+    size_t                     m_lineBytes;    // One line in the file's layout.
+    unsigned int               m_blockLines;
+    unsigned int               m_linesWritten; // Lines passed to writeLines().
+    unsigned int               m_linesEncoded; // Lines in the file.
+    std::vector<unsigned char> m_pending;      // Lines not encoded yet, in the file's layout.
+    std::vector<unsigned char> m_previousLine; // PNG filters look at the line above.
+    unsigned long long         m_headerBytes;
+    std::vector<unsigned long long> m_offsets; // EXR line offset table, written last.
+    unsigned int               m_adler;        // PNG zlib checksum of the filtered lines.
+    unsigned long long         m_bytes;
+    bool                       m_failed;
+};
+
+} // end namespace sutil
@@ -0,0 +1,231 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sutil/LocalSocket.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#if !defined(_WIN32)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+const size_t MAX_LINE_LENGTH = 64 * 1024;
+
+#if !defined(_WIN32)
+
+// A peer which went away must not terminate the process with SIGPIPE. Linux uses MSG_NOSIGNAL on send instead.
+void disableSigpipe( int fd )
+{
+#if defined(SO_NOSIGPIPE)
+    const int on = 1;
+    setsockopt( fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof( on ) );
+#else
+    (void)fd;
+#endif
+}
+
+bool makeAddress( const std::string& path, sockaddr_un& address )
+{
+    memset( &address, 0, sizeof( address ) );
+    address.sun_family = AF_UNIX;
+    if( path.empty() || path.size() >= sizeof( address.sun_path ) )
+    {
+        std::cerr << "ERROR: Socket path '" << path << "' is empty or longer than "
+                  << sizeof( address.sun_path ) - 1 << " characters." << std::endl;
+        return false;
+    }
+    memcpy( address.sun_path, path.c_str(), path.size() );
+    return true;
+}
+
+int connectAddress( const sockaddr_un& address )
+{
+    const int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if( fd < 0 )
+        return -1;
+    if( connect( fd, reinterpret_cast<const sockaddr*>( &address ), sizeof( address ) ) != 0 )
+    {
+        close( fd );
+        return -1;
+    }
+    disableSigpipe( fd );
+    return fd;
+}
+
+#endif
+
+} // end anonymous namespace
+
+
+namespace sutil
+{
+
+#if !defined(_WIN32)
+
+int listenLocalSocket( const std::string& path )
+{
+    sockaddr_un address;
+    if( !makeAddress( path, address ) )
+        return -1;
+
+    // A socket file which nobody accepts on is left over from a server which did not shut down.
+    const int probe = connectAddress( address );
+    if( probe >= 0 )
+    {
+        close( probe );
+        std::cerr << "ERROR: Another server is listening on " << path << "." << std::endl;
+        return -1;
+    }
+    unlink( path.c_str() );
+
+    const int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if( fd < 0 ||
+        bind( fd, reinterpret_cast<const sockaddr*>( &address ), sizeof( address ) ) != 0 ||
+        listen( fd, 8 ) != 0 )
+    {
+        std::cerr << "ERROR: Cannot listen on " << path << ": " << strerror( errno ) << std::endl;
+        if( fd >= 0 )
+            close( fd );
+        return -1;
+    }
+    return fd;
+}
+
+int acceptLocalSocket( int server )
+{
+    for( ;; )
+    {
+        const int fd = accept( server, 0, 0 );
+        if( fd >= 0 )
+            disableSigpipe( fd );
+        if( fd >= 0 || errno != EINTR )
+            return fd;
+    }
+}
+
+int connectLocalSocket( const std::string& path )
+{
+    sockaddr_un address;
+    if( !makeAddress( path, address ) )
+        return -1;
+    const int fd = connectAddress( address );
+    if( fd < 0 )
+        std::cerr << "ERROR: Cannot connect to " << path << ": " << strerror( errno ) << std::endl;
+    return fd;
+}
+
+bool readLocalSocketLine( int socket, std::string& line )
+{
+    // Requests and replies are short, reading single bytes keeps the rest of the stream in the socket.
+    line.clear();
+    for( ;; )
+    {
+        char c;
+        const ssize_t n = recv( socket, &c, 1, 0 );
+        if( n < 0 && errno == EINTR )
+            continue;
+        if( n <= 0 )
+            return false;
+        if( c == '\n' )
+            return true;
+        if( line.size() >= MAX_LINE_LENGTH )
+            return false;
+        line.push_back( c );
+    }
+}
+
+bool writeLocalSocketLine( int socket, const std::string& line )
+{
+    const std::string data = line + '\n';
+#if defined(MSG_NOSIGNAL)
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    size_t sent = 0;
+    while( sent < data.size() )
+    {
+        const ssize_t n = send( socket, data.data() + sent, data.size() - sent, flags );
+        if( n < 0 && errno == EINTR )
+            continue;
+        if( n <= 0 )
+            return false;
+        sent += n;
+    }
+    return true;
+}
+
+void closeLocalSocket( int socket )
+{
+    if( socket >= 0 )
+        close( socket );
+}
+
+#else
+
+int listenLocalSocket( const std::string& path )
+{
+    std::cerr << "ERROR: Local sockets are not supported on this platform." << std::endl;
+    return -1;
+}
+
+int acceptLocalSocket( int server )
+{
+    return -1;
+}
+
+int connectLocalSocket( const std::string& path )
+{
+    std::cerr << "ERROR: Local sockets are not supported on this platform." << std::endl;
+    return -1;
+}
+
+bool readLocalSocketLine( int socket, std::string& line )
+{
+    return false;
+}
+
+bool writeLocalSocketLine( int socket, const std::string& line )
+{
+    return false;
+}
+
+void closeLocalSocket( int socket )
+{
+}
+
+#endif
+
+} // end namespace sutil
@@ -0,0 +1,60 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <sutilapi.h>
+
+#include <string>
+
+// Line based stream sockets on a filesystem path (Unix domain sockets), used by the render
+// server and its client. Sockets are plain file descriptors, -1 is invalid. Windows has no
+// support here: all functions fail.
+
+namespace sutil
+{
+
+// Create a listening socket at path. A stale socket file of an exited process is replaced;
+// fails when another process is still listening on path.
+SUTILAPI int listenLocalSocket( const std::string& path );
+
+// Wait for the next connection on a listening socket.
+SUTILAPI int acceptLocalSocket( int server );
+
+SUTILAPI int connectLocalSocket( const std::string& path );
+
+// Read up to the next '\n', which is not stored. Fails at the end of the stream, on errors
+// and on lines longer than 64 KB.
+SUTILAPI bool readLocalSocketLine( int socket, std::string& line );
+
+// Send line followed by '\n'. line must not contain '\n'.
+SUTILAPI bool writeLocalSocketLine( int socket, const std::string& line );
+
+SUTILAPI void closeLocalSocket( int socket );
+
+} // end namespace sutil
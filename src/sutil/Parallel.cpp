@@ -0,0 +1,209 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sutil/Parallel.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+
+unsigned int sutil::numWorkerThreads()
+{
+    const unsigned int n = std::thread::hardware_concurrency();
+    return n ? n : 1u;
+}
+
+
+sutil::ThreadPool::ThreadPool( unsigned int num_threads )
+    : m_quit( false )
+{
+    if( num_threads == 0 )
+        num_threads = numWorkerThreads();
+    for( unsigned int i = 0; i < num_threads; ++i )
+        m_threads.push_back( std::thread( &ThreadPool::worker, this ) );
+}
+
+
+sutil::ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_quit = true;
+    }
+    m_work.notify_all();
+    for( size_t i = 0; i < m_threads.size(); ++i )
+        m_threads[i].join();
+}
+
+
+std::future<void> sutil::ThreadPool::submit( const std::function<void()>& task )
+{
+    Task packaged( task );
+    std::future<void> result = packaged.get_future();
+    if( m_threads.empty() )
+    {
+        packaged();
+        return result;
+    }
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_tasks.push_back( std::move( packaged ) );
+    }
+    m_work.notify_one();
+    return result;
+}
+
+
+unsigned int sutil::ThreadPool::size() const
+{
+    return static_cast<unsigned int>( m_threads.size() );
+}
+
+
+void sutil::ThreadPool::worker()
+{
+    for( ;; )
+    {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock( m_mutex );
+            m_work.wait( lock, [this]() { return m_quit || !m_tasks.empty(); } );
+            if( m_tasks.empty() )
+                return;
+            task = std::move( m_tasks.front() );
+            m_tasks.pop_front();
+        }
+        task(); // Exceptions end up in the future.
+    }
+}
+
+
+sutil::ThreadPool& sutil::defaultThreadPool()
+{
+    // The calling thread of parallelFor is the remaining worker. The pool is never destroyed:
+    // joining threads during static destruction can hang when sutil is a DLL.
+    static ThreadPool* pool = new ThreadPool( std::max( numWorkerThreads(), 2u ) - 1 );
+    return *pool;
+}
+
+
+namespace
+{
+
+// Shared between a parallelFor call and its helper tasks. Helpers which start
+// after all chunks were handed out return without touching func, so the caller
+// only waits for helpers which are actually working.
+struct ParallelForState
+{
+    std::atomic<size_t>     next;
+    size_t                  count;
+    size_t                  chunk;
+    const std::function<void(size_t, size_t)>* func;
+
+    std::mutex              mutex;
+    std::condition_variable done;
+    unsigned int            active;
+    std::exception_ptr      error;
+
+    void work()
+    {
+        for( ;; )
+        {
+            const size_t begin = next.fetch_add( chunk );
+            if( begin >= count )
+                return;
+            try
+            {
+                ( *func )( begin, std::min( begin + chunk, count ) );
+            }
+            catch( ... )
+            {
+                std::lock_guard<std::mutex> lock( mutex );
+                if( !error )
+                    error = std::current_exception();
+                next = count; // Stop handing out further chunks.
+            }
+        }
+    }
+
+    void help()
+    {
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            if( next >= count )
+                return;
+            ++active;
+        }
+        work();
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            --active;
+        }
+        done.notify_all();
+    }
+};
+
+} // end anonymous namespace
+
+
+void sutil::parallelFor( size_t count, const std::function<void(size_t, size_t)>& func, size_t grain )
+{
+    if( count == 0 )
+        return;
+
+    grain = std::max<size_t>( grain, 1 );
+
+    // Over-decompose a little so uneven chunks still balance across the workers.
+    const size_t num_threads = std::min<size_t>( numWorkerThreads(), ( count + grain - 1 ) / grain );
+    const size_t chunk       = std::max<size_t>( grain, count / ( num_threads * 4 ) );
+
+    if( num_threads <= 1 )
+    {
+        func( 0, count );
+        return;
+    }
+
+    std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>();
+    state->next   = 0;
+    state->count  = count;
+    state->chunk  = chunk;
+    state->func   = &func;
+    state->active = 0;
+
+    ThreadPool& pool = defaultThreadPool();
+    for( size_t i = 1; i < num_threads; ++i )
+        pool.submit( [state]() { state->help(); } );
+    state->work(); // The calling thread takes part as well.
+
+    std::unique_lock<std::mutex> lock( state->mutex );
+    state->done.wait( lock, [&state]() { return state->active == 0; } );
+    if( state->error )
+        std::rethrow_exception( state->error );
+}
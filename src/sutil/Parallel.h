@@ -0,0 +1,92 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <sutilapi.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sutil
+{
+
+// Number of worker threads used by parallelFor (the hardware concurrency, at least one).
+SUTILAPI unsigned int numWorkerThreads();
+
+// A fixed set of worker threads running submitted tasks in submission order.
+// Several independent users (e.g. render sessions) can share one pool.
+class ThreadPool
+{
+public:
+    // num_threads == 0 uses numWorkerThreads().
+    SUTILAPI explicit ThreadPool( unsigned int num_threads = 0 );
+    SUTILAPI ~ThreadPool(); // Runs the tasks which are still queued, then joins the threads.
+
+    // The returned future becomes ready when the task has run and rethrows its exception.
+    SUTILAPI std::future<void> submit( const std::function<void()>& task );
+
+    SUTILAPI unsigned int size() const;
+
+private:
+    ThreadPool( const ThreadPool& );
+    ThreadPool& operator=( const ThreadPool& );
+
+    void worker();
+
+    typedef std::packaged_task<void()> Task;
+
+    std::vector<std::thread>  m_threads;
+    std::deque<Task>          m_tasks;
+    bool                      m_quit;
+    std::mutex                m_mutex;
+    std::condition_variable   m_work;     // Signals queued tasks and m_quit.
+};
+
+// The pool used by parallelFor, created with numWorkerThreads() - 1 threads on first use.
+SUTILAPI ThreadPool& defaultThreadPool();
+
+// Split the index range [0, count) into contiguous chunks of at least grain
+// elements and call func(begin, end) for each chunk on the calling thread and
+// the threads of defaultThreadPool(). Blocks until all chunks have been
+// processed. The first exception thrown by any chunk is rethrown on the calling
+// thread. Calls from several threads at once, and from inside func, share the
+// pool's threads: the calling thread always works on its own chunks, so a busy
+// pool slows a call down but never blocks it.
+SUTILAPI void parallelFor(
+        size_t count,                                            // Number of work items
+        const std::function<void(size_t begin, size_t end)>& func, // Called once per chunk
+        size_t grain = 1 );                                      // Minimum chunk size
+
+} // end namespace sutil
@@ -0,0 +1,230 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sutil/PartialImage.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+
+// File layout: PartialHeader, then width * height * 4 floats.
+struct PartialHeader
+{
+    char               magic[4];
+    unsigned int       version;
+    unsigned int       width;
+    unsigned int       height;
+    unsigned int       frame_begin;
+    unsigned int       frame_end;
+    unsigned long long scene_hash;
+};
+
+const unsigned int PARTIAL_VERSION = 1;
+
+bool readHeader( FILE* file, const std::string& filename, sutil::PartialImageInfo& info )
+{
+    PartialHeader header;
+    if( fread( &header, sizeof( header ), 1, file ) != 1 || memcmp( header.magic, "PTPR", 4 ) != 0 ||
+        header.version != PARTIAL_VERSION )
+    {
+        std::cerr << "ERROR: " << filename << " is not a partial image." << std::endl;
+        return false;
+    }
+    info.width       = header.width;
+    info.height      = header.height;
+    info.frame_begin = header.frame_begin;
+    info.frame_end   = header.frame_end;
+    info.scene_hash  = header.scene_hash;
+    return true;
+}
+
+} // end anonymous namespace
+
+
+sutil::PartialImageInfo::PartialImageInfo()
+    : width( 0 ),
+      height( 0 ),
+      frame_begin( 0 ),
+      frame_end( 0 ),
+      scene_hash( 0 )
+{
+}
+
+
+bool sutil::writePartialImage( const std::string& filename, const PartialImageInfo& info, const float* sum_count )
+{
+    PartialHeader header;
+    memset( &header, 0, sizeof( header ) );
+    memcpy( header.magic, "PTPR", 4 );
+    header.version     = PARTIAL_VERSION;
+    header.width       = info.width;
+    header.height      = info.height;
+    header.frame_begin = info.frame_begin;
+    header.frame_end   = info.frame_end;
+    header.scene_hash  = info.scene_hash;
+
+    // Written under a temporary name, a merge must never pick up a half written partial.
+    const std::string temp_filename = filename + ".tmp";
+    FILE* file = fopen( temp_filename.c_str(), "wb" );
+    if( !file )
+    {
+        std::cerr << "ERROR: writePartialImage() failed to create " << temp_filename << std::endl;
+        return false;
+    }
+    const size_t count = size_t( info.width ) * info.height * 4;
+    bool success = fwrite( &header, sizeof( header ), 1, file ) == 1 &&
+                   fwrite( sum_count, sizeof( float ), count, file ) == count;
+    success = ( fclose( file ) == 0 ) && success;
+
+    if( success )
+    {
+        remove( filename.c_str() ); // rename() does not replace existing files on Windows.
+        success = rename( temp_filename.c_str(), filename.c_str() ) == 0;
+    }
+    if( !success )
+    {
+        std::cerr << "ERROR: writePartialImage() failed to write " << filename << std::endl;
+        remove( temp_filename.c_str() );
+    }
+    return success;
+}
+
+
+bool sutil::readPartialImageInfo( const std::string& filename, PartialImageInfo& info )
+{
+    FILE* file = fopen( filename.c_str(), "rb" );
+    if( !file )
+    {
+        std::cerr << "ERROR: Unable to open " << filename << std::endl;
+        return false;
+    }
+    const bool success = readHeader( file, filename, info );
+    fclose( file );
+    return success;
+}
+
+
+bool sutil::readPartialImage( const std::string& filename, PartialImageInfo& info, std::vector<float>& sum_count )
+{
+    FILE* file = fopen( filename.c_str(), "rb" );
+    if( !file )
+    {
+        std::cerr << "ERROR: Unable to open " << filename << std::endl;
+        return false;
+    }
+    bool success = readHeader( file, filename, info );
+    if( success )
+    {
+        sum_count.resize( size_t( info.width ) * info.height * 4 );
+        success = fread( sum_count.data(), sizeof( float ), sum_count.size(), file ) == sum_count.size();
+        if( !success )
+            std::cerr << "ERROR: " << filename << " is truncated." << std::endl;
+    }
+    fclose( file );
+    return success;
+}
+
+
+bool sutil::mergePartialImages( const std::vector<std::string>& filenames, PartialImageInfo& info, std::vector<float>& sum_count )
+{
+    if( filenames.empty() )
+        return false;
+
+    // Headers first, so mismatches are found before any pixel data is read.
+    std::vector<std::pair<PartialImageInfo, std::string> > partials( filenames.size() );
+    for( size_t i = 0; i < filenames.size(); ++i )
+    {
+        partials[i].second = filenames[i];
+        if( !readPartialImageInfo( filenames[i], partials[i].first ) )
+            return false;
+
+        const PartialImageInfo& first = partials[0].first;
+        const PartialImageInfo& p     = partials[i].first;
+        if( p.width != first.width || p.height != first.height || p.scene_hash != first.scene_hash )
+        {
+            std::cerr << "ERROR: " << filenames[i] << " belongs to a different image than " << filenames[0] << std::endl;
+            return false;
+        }
+    }
+
+    // A canonical order makes the floating point sum independent of the order of the arguments.
+    std::sort( partials.begin(), partials.end(),
+               []( const std::pair<PartialImageInfo, std::string>& a, const std::pair<PartialImageInfo, std::string>& b )
+               { return a.first.frame_begin < b.first.frame_begin; } );
+
+    for( size_t i = 1; i < partials.size(); ++i )
+    {
+        const PartialImageInfo& prev = partials[i - 1].first;
+        const PartialImageInfo& p    = partials[i].first;
+        if( p.frame_begin < prev.frame_end )
+        {
+            std::cerr << "ERROR: Frames " << p.frame_begin << " to " << prev.frame_end - 1 << " are in both "
+                      << partials[i - 1].second << " and " << partials[i].second << std::endl;
+            return false;
+        }
+        if( p.frame_begin > prev.frame_end )
+            std::cerr << "WARNING: Frames " << prev.frame_end << " to " << p.frame_begin - 1 << " are missing." << std::endl;
+    }
+
+    info             = partials.front().first;
+    info.frame_end   = partials.back().first.frame_end;
+
+    std::vector<double> sums( size_t( info.width ) * info.height * 4, 0.0 );
+    std::vector<float>  partial;
+    for( size_t i = 0; i < partials.size(); ++i )
+    {
+        PartialImageInfo partial_info;
+        if( !readPartialImage( partials[i].second, partial_info, partial ) )
+            return false;
+        for( size_t j = 0; j < sums.size(); ++j )
+            sums[j] += partial[j];
+    }
+
+    sum_count.resize( sums.size() );
+    for( size_t j = 0; j < sums.size(); ++j )
+        sum_count[j] = static_cast<float>( sums[j] );
+    return true;
+}
+
+
+void sutil::resolvePartialImage( const std::vector<float>& sum_count, std::vector<float>& rgba )
+{
+    rgba.resize( sum_count.size() );
+    for( size_t i = 0; i < sum_count.size(); i += 4 )
+    {
+        const float inv_count = sum_count[i + 3] > 0.0f ? 1.0f / sum_count[i + 3] : 0.0f;
+        rgba[i + 0] = sum_count[i + 0] * inv_count;
+        rgba[i + 1] = sum_count[i + 1] * inv_count;
+        rgba[i + 2] = sum_count[i + 2] * inv_count;
+        rgba[i + 3] = 1.0f;
+    }
+}
@@ -0,0 +1,238 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sutil/Profiler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+
+namespace
+{
+
+const size_t MAX_EVENTS = 1u << 20;
+
+struct ProfileEvent
+{
+    const char*  name;
+    std::string  detail;
+    unsigned int thread;
+    double       begin;    // Microseconds.
+    double       duration;
+};
+
+struct Profiler
+{
+    Profiler()
+        : start( std::chrono::steady_clock::now() )
+        , dropped( 0 )
+    {
+    }
+
+    std::chrono::steady_clock::time_point        start;
+    std::mutex                                   mutex;
+    std::vector<ProfileEvent>                    events;
+    unsigned long long                           dropped;
+    std::vector<sutil::ProfileStat>              stats;
+    std::map<std::string, size_t>                statIndex;
+    std::map<std::thread::id, unsigned int>      threads;  // Small trace ids in order of appearance.
+};
+
+std::atomic<bool> g_enabled( false );
+
+Profiler& profiler()
+{
+    static Profiler instance;
+    return instance;
+}
+
+void writeJsonString( FILE* file, const char* text )
+{
+    fputc( '"', file );
+    for( ; *text; ++text )
+    {
+        const unsigned char c = static_cast<unsigned char>( *text );
+        if( c == '"' || c == '\\' )
+            fprintf( file, "\\%c", c );
+        else if( c < 0x20 )
+            fprintf( file, "\\u%04x", c );
+        else
+            fputc( c, file );
+    }
+    fputc( '"', file );
+}
+
+} // end anonymous namespace
+
+
+void sutil::setProfilingEnabled( bool enabled )
+{
+    profiler(); // Starts the clock.
+    g_enabled = enabled;
+}
+
+
+bool sutil::profilingEnabled()
+{
+    return g_enabled.load( std::memory_order_relaxed );
+}
+
+
+double sutil::profileClock()
+{
+    return std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now() - profiler().start ).count();
+}
+
+
+void sutil::recordProfileEvent( const char* name, const std::string& detail, double beginMicroseconds, double endMicroseconds )
+{
+    Profiler& p = profiler();
+    const double duration = endMicroseconds - beginMicroseconds;
+    std::lock_guard<std::mutex> lock( p.mutex );
+
+    std::map<std::string, size_t>::iterator it = p.statIndex.find( name );
+    if( it == p.statIndex.end() )
+    {
+        ProfileStat stat;
+        stat.name         = name;
+        stat.count        = 0;
+        stat.totalSeconds = 0.0;
+        stat.lastSeconds  = 0.0;
+        stat.maxSeconds   = 0.0;
+        it = p.statIndex.insert( std::make_pair( stat.name, p.stats.size() ) ).first;
+        p.stats.push_back( stat );
+    }
+    ProfileStat& stat = p.stats[it->second];
+    ++stat.count;
+    stat.lastSeconds   = duration * 1e-6;
+    stat.totalSeconds += stat.lastSeconds;
+    stat.maxSeconds    = std::max( stat.maxSeconds, stat.lastSeconds );
+
+    if( p.events.size() >= MAX_EVENTS )
+    {
+        ++p.dropped;
+        return;
+    }
+    const std::thread::id id = std::this_thread::get_id();
+    std::map<std::thread::id, unsigned int>::const_iterator thread = p.threads.find( id );
+    if( thread == p.threads.end() )
+        thread = p.threads.insert( std::make_pair( id, static_cast<unsigned int>( p.threads.size() ) ) ).first;
+
+    ProfileEvent event;
+    event.name     = name;
+    event.detail   = detail;
+    event.thread   = thread->second;
+    event.begin    = beginMicroseconds;
+    event.duration = duration;
+    p.events.push_back( event );
+}
+
+
+std::vector<sutil::ProfileStat> sutil::profileStats()
+{
+    Profiler& p = profiler();
+    std::lock_guard<std::mutex> lock( p.mutex );
+    return p.stats;
+}
+
+
+bool sutil::writeChromeTrace( const std::string& filename )
+{
+    FILE* file = fopen( filename.c_str(), "w" );
+    if( !file )
+    {
+        std::cerr << "ERROR: writeChromeTrace() cannot create " << filename << std::endl;
+        return false;
+    }
+
+    Profiler& p = profiler();
+    std::lock_guard<std::mutex> lock( p.mutex );
+    fprintf( file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n" );
+    for( size_t i = 0; i < p.events.size(); ++i )
+    {
+        const ProfileEvent& event = p.events[i];
+        fprintf( file, "{\"name\": " );
+        writeJsonString( file, event.name );
+        fprintf( file, ", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f", event.thread, event.begin, event.duration );
+        if( !event.detail.empty() )
+        {
+            fprintf( file, ", \"args\": {\"detail\": " );
+            writeJsonString( file, event.detail.c_str() );
+            fputc( '}', file );
+        }
+        fprintf( file, "}%s\n", i + 1 < p.events.size() ? "," : "" );
+    }
+    fprintf( file, "]}\n" );
+
+    const bool written = !ferror( file );
+    if( fclose( file ) != 0 || !written )
+    {
+        std::cerr << "ERROR: writeChromeTrace() cannot write " << filename << std::endl;
+        return false;
+    }
+    if( p.dropped )
+        std::cerr << "Trace " << filename << " holds the first " << p.events.size() << " events, " << p.dropped << " more were only counted" << std::endl;
+    return true;
+}
+
+
+void sutil::printProfileSummary( std::ostream& out )
+{
+    std::vector<ProfileStat> stats = profileStats();
+    std::stable_sort( stats.begin(), stats.end(),
+                      []( const ProfileStat& a, const ProfileStat& b ) { return a.totalSeconds > b.totalSeconds; } );
+
+    size_t width = 5;
+    for( size_t i = 0; i < stats.size(); ++i )
+        width = std::max( width, stats[i].name.size() );
+
+    const std::ios::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+    out << std::left << std::setw( static_cast<int>( width ) ) << "stage" << std::right
+        << std::setw( 10 ) << "count" << std::setw( 14 ) << "total ms" << std::setw( 12 ) << "mean ms" << std::setw( 12 ) << "max ms" << "\n";
+    out << std::fixed << std::setprecision( 3 );
+    for( size_t i = 0; i < stats.size(); ++i )
+    {
+        const ProfileStat& stat = stats[i];
+        out << std::left << std::setw( static_cast<int>( width ) ) << stat.name << std::right
+            << std::setw( 10 ) << stat.count
+            << std::setw( 14 ) << stat.totalSeconds * 1e3
+            << std::setw( 12 ) << stat.totalSeconds * 1e3 / stat.count
+            << std::setw( 12 ) << stat.maxSeconds * 1e3 << "\n";
+    }
+    out.flush();
+    out.flags( flags );
+    out.precision( precision );
+}
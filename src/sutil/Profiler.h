@@ -0,0 +1,107 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <sutilapi.h>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace sutil
+{
+
+// Scoped timers for the stages of startup and rendering. Profiling is off by default; a disabled
+// ProfileScope costs one call which reads a flag, nothing is allocated or recorded. When enabled,
+// every scope records an event (name, optional detail, thread, begin and duration) and updates the
+// statistics of its name. The events can be written as a Chrome trace (chrome://tracing, Perfetto),
+// the statistics are printed as a table or shown in an overlay.
+//
+// Names must be string literals (or outlive the profiler), details are copied. Scopes may nest and
+// may run on any thread. After one million events only the statistics are updated.
+
+struct ProfileStat
+{
+    std::string        name;
+    unsigned long long count;
+    double             totalSeconds;
+    double             lastSeconds;
+    double             maxSeconds;
+};
+
+SUTILAPI void setProfilingEnabled( bool enabled );
+SUTILAPI bool profilingEnabled();
+
+// Microseconds since the profiler clock started.
+SUTILAPI double profileClock();
+
+// Records a finished scope, normally called by ~ProfileScope().
+SUTILAPI void recordProfileEvent( const char* name, const std::string& detail, double beginMicroseconds, double endMicroseconds );
+
+class ProfileScope
+{
+public:
+    explicit ProfileScope( const char* name )
+        : m_name( profilingEnabled() ? name : 0 )
+        , m_begin( m_name ? profileClock() : 0.0 )
+    {
+    }
+
+    ProfileScope( const char* name, const std::string& detail )
+        : m_name( profilingEnabled() ? name : 0 )
+        , m_begin( m_name ? profileClock() : 0.0 )
+    {
+        if( m_name )
+            m_detail = detail;
+    }
+
+    ~ProfileScope()
+    {
+        if( m_name )
+            recordProfileEvent( m_name, m_detail, m_begin, profileClock() );
+    }
+
+private:
+    ProfileScope( const ProfileScope& );
+    ProfileScope& operator=( const ProfileScope& );
+
+    const char* m_name;
+    double      m_begin;
+    std::string m_detail;
+};
+
+// Statistics per name, in the order the names were first recorded.
+SUTILAPI std::vector<ProfileStat> profileStats();
+
+// Chrome trace event JSON with one complete ("X") event per recorded scope.
+SUTILAPI bool writeChromeTrace( const std::string& filename );
+
+// Table of the statistics, sorted by total time.
+SUTILAPI void printProfileSummary( std::ostream& out );
+
+} // end namespace sutil
@@ -0,0 +1,377 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sutil/ToneMap.h>
+#include <sutil/Parallel.h>
+
+#include <cmath>
+#include <cstring>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#  define SUTIL_TONEMAP_SSE2 1
+#  include <emmintrin.h>
+#endif
+
+using namespace optix;
+
+namespace
+{
+
+const unsigned int DITHER_SIZE = 64;
+
+// Constants of Hable's filmic curve.
+const float FILMIC_A     = 0.15f; // Shoulder strength
+const float FILMIC_B     = 0.50f; // Linear strength
+const float FILMIC_C     = 0.10f; // Linear angle
+const float FILMIC_D     = 0.20f; // Toe strength
+const float FILMIC_E     = 0.02f; // Toe numerator
+const float FILMIC_F     = 0.30f; // Toe denominator
+const float FILMIC_WHITE = 11.2f;
+const float FILMIC_BIAS  = 2.0f;  // Exposure bias of the reference implementation.
+
+const float REINHARD_LIMIT = 1.5f;
+
+struct DitherTable
+{
+    DitherTable()
+    {
+        for( unsigned int y = 0; y < DITHER_SIZE; ++y )
+            for( unsigned int x = 0; x < DITHER_SIZE; ++x )
+            {
+                // Same hash as the device tonemap program, so host and device images match.
+                unsigned int h = x * 73856093u ^ y * 19349663u;
+                h ^= h >> 16;
+                h *= 0x7feb352du;
+                h ^= h >> 15;
+                h *= 0x846ca68bu;
+                h ^= h >> 16;
+                // Sum of two uniform values: triangular distribution in [-1, 1), shifted by half a code
+                // because quantize() truncates.
+                values[y * DITHER_SIZE + x] = ( h & 0xffff ) / 65536.0f + ( h >> 16 ) / 65536.0f - 0.5f;
+            }
+    }
+
+    float values[DITHER_SIZE * DITHER_SIZE];
+};
+
+const DitherTable& ditherTable()
+{
+    static const DitherTable table;
+    return table;
+}
+
+inline float hable( float x )
+{
+    return ( x * ( FILMIC_A * x + FILMIC_C * FILMIC_B ) + FILMIC_D * FILMIC_E ) /
+           ( x * ( FILMIC_A * x + FILMIC_B ) + FILMIC_D * FILMIC_F ) - FILMIC_E / FILMIC_F;
+}
+
+inline float aces( float x )
+{
+    x *= 0.6f;
+    return x * ( 2.51f * x + 0.03f ) / ( x * ( 2.43f * x + 0.59f ) + 0.14f );
+}
+
+// sRGB encoding with three square roots instead of powf, like the device code (max. error < 0.001).
+inline float encodeSrgb( float x )
+{
+    if( !( x > 0.0031308f ) )
+        return x > 0.0f ? 12.92f * x : 0.0f;
+    const float s1 = sqrtf( x );
+    const float s2 = sqrtf( s1 );
+    const float s3 = sqrtf( s2 );
+    return 0.662002687f * s1 + 0.684122060f * s2 - 0.323583601f * s3 - 0.0225411470f * x;
+}
+
+// Saturate and scale like make_color(), plus the dither offset. NaN maps to 0. Black stays black.
+inline unsigned int quantize( float x, float dither )
+{
+    const float s = x > 0.0f ? ( x < 1.0f ? x : 1.0f ) : 0.0f;
+    const float q = s * 255.99f + ( s > 0.0f ? dither : 0.0f );
+    return q > 0.0f ? ( q < 255.0f ? static_cast<unsigned int>( q ) : 255u ) : 0u;
+}
+
+void toneMapPixel( const float* p, float scale, sutil::ToneMapOperator op, float dither, unsigned char* bgra )
+{
+    float r = p[0] * scale;
+    float g = p[1] * scale;
+    float b = p[2] * scale;
+
+    switch( op )
+    {
+        case sutil::TONEMAP_REINHARD:
+        {
+            const float s = 1.0f / ( 1.0f + ( 0.3f * r + 0.6f * g + 0.1f * b ) / REINHARD_LIMIT );
+            r *= s;
+            g *= s;
+            b *= s;
+            break;
+        }
+        case sutil::TONEMAP_ACES:
+            r = aces( r );
+            g = aces( g );
+            b = aces( b );
+            break;
+        case sutil::TONEMAP_FILMIC:
+        {
+            const float w = 1.0f / hable( FILMIC_WHITE );
+            r = hable( FILMIC_BIAS * r ) * w;
+            g = hable( FILMIC_BIAS * g ) * w;
+            b = hable( FILMIC_BIAS * b ) * w;
+            break;
+        }
+        default:
+            break;
+    }
+
+    bgra[0] = static_cast<unsigned char>( quantize( encodeSrgb( b ), dither ) );
+    bgra[1] = static_cast<unsigned char>( quantize( encodeSrgb( g ), dither ) );
+    bgra[2] = static_cast<unsigned char>( quantize( encodeSrgb( r ), dither ) );
+    bgra[3] = 255;
+}
+
+#ifdef SUTIL_TONEMAP_SSE2
+
+inline __m128 select( __m128 mask, __m128 a, __m128 b )
+{
+    return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) );
+}
+
+inline __m128 hable4( __m128 x )
+{
+    const __m128 num = _mm_add_ps( _mm_mul_ps( x, _mm_add_ps( _mm_mul_ps( _mm_set1_ps( FILMIC_A ), x ), _mm_set1_ps( FILMIC_C * FILMIC_B ) ) ),
+                                   _mm_set1_ps( FILMIC_D * FILMIC_E ) );
+    const __m128 den = _mm_add_ps( _mm_mul_ps( x, _mm_add_ps( _mm_mul_ps( _mm_set1_ps( FILMIC_A ), x ), _mm_set1_ps( FILMIC_B ) ) ),
+                                   _mm_set1_ps( FILMIC_D * FILMIC_F ) );
+    return _mm_sub_ps( _mm_div_ps( num, den ), _mm_set1_ps( FILMIC_E / FILMIC_F ) );
+}
+
+inline __m128 aces4( __m128 x )
+{
+    x = _mm_mul_ps( x, _mm_set1_ps( 0.6f ) );
+    const __m128 num = _mm_mul_ps( x, _mm_add_ps( _mm_mul_ps( _mm_set1_ps( 2.51f ), x ), _mm_set1_ps( 0.03f ) ) );
+    const __m128 den = _mm_add_ps( _mm_mul_ps( x, _mm_add_ps( _mm_mul_ps( _mm_set1_ps( 2.43f ), x ), _mm_set1_ps( 0.59f ) ) ),
+                                   _mm_set1_ps( 0.14f ) );
+    return _mm_div_ps( num, den );
+}
+
+inline __m128 encodeSrgb4( __m128 x )
+{
+    const __m128 s1   = _mm_sqrt_ps( _mm_max_ps( x, _mm_setzero_ps() ) );
+    const __m128 s2   = _mm_sqrt_ps( s1 );
+    const __m128 s3   = _mm_sqrt_ps( s2 );
+    const __m128 poly = _mm_sub_ps( _mm_sub_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( 0.662002687f ), s1 ),
+                                                            _mm_mul_ps( _mm_set1_ps( 0.684122060f ), s2 ) ),
+                                                _mm_mul_ps( _mm_set1_ps( 0.323583601f ), s3 ) ),
+                                    _mm_mul_ps( _mm_set1_ps( 0.0225411470f ), x ) );
+    // _mm_max_ps returns the second operand for NaN, so NaN ends up in the linear segment as 0.
+    const __m128 lin  = _mm_mul_ps( _mm_set1_ps( 12.92f ), _mm_max_ps( x, _mm_setzero_ps() ) );
+    return select( _mm_cmpgt_ps( x, _mm_set1_ps( 0.0031308f ) ), poly, lin );
+}
+
+inline __m128i quantize4( __m128 x, __m128 dither )
+{
+    const __m128 s = _mm_min_ps( _mm_max_ps( x, _mm_setzero_ps() ), _mm_set1_ps( 1.0f ) );
+    const __m128 q = _mm_add_ps( _mm_mul_ps( s, _mm_set1_ps( 255.99f ) ), _mm_and_ps( _mm_cmpgt_ps( s, _mm_setzero_ps() ), dither ) );
+    return _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( q, _mm_setzero_ps() ), _mm_set1_ps( 255.0f ) ) );
+}
+
+// Four pixels starting at p. Returns the number of pixels done, the rest is left to the scalar code.
+unsigned int toneMapRow4( const float* p, unsigned int width, unsigned int components, float scale, sutil::ToneMapOperator op,
+                          const float* dither, unsigned char* bgra )
+{
+    const __m128 vscale = _mm_set1_ps( scale );
+    const __m128 white  = _mm_set1_ps( 1.0f / hable( FILMIC_WHITE ) );
+
+    unsigned int x = 0;
+    for( ; x + 4 <= width; x += 4, p += 4 * components, bgra += 16 )
+    {
+        __m128 r, g, b;
+        if( components == 4 )
+        {
+            __m128 p0 = _mm_loadu_ps( p );
+            __m128 p1 = _mm_loadu_ps( p + 4 );
+            __m128 p2 = _mm_loadu_ps( p + 8 );
+            __m128 p3 = _mm_loadu_ps( p + 12 );
+            _MM_TRANSPOSE4_PS( p0, p1, p2, p3 );
+            r = p0;
+            g = p1;
+            b = p2;
+        }
+        else
+        {
+            r = _mm_setr_ps( p[0], p[3], p[6], p[9] );
+            g = _mm_setr_ps( p[1], p[4], p[7], p[10] );
+            b = _mm_setr_ps( p[2], p[5], p[8], p[11] );
+        }
+        r = _mm_mul_ps( r, vscale );
+        g = _mm_mul_ps( g, vscale );
+        b = _mm_mul_ps( b, vscale );
+
+        switch( op )
+        {
+            case sutil::TONEMAP_REINHARD:
+            {
+                const __m128 lum = _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( 0.3f ), r ), _mm_mul_ps( _mm_set1_ps( 0.6f ), g ) ),
+                                               _mm_mul_ps( _mm_set1_ps( 0.1f ), b ) );
+                const __m128 s   = _mm_div_ps( _mm_set1_ps( 1.0f ),
+                                               _mm_add_ps( _mm_set1_ps( 1.0f ), _mm_div_ps( lum, _mm_set1_ps( REINHARD_LIMIT ) ) ) );
+                r = _mm_mul_ps( r, s );
+                g = _mm_mul_ps( g, s );
+                b = _mm_mul_ps( b, s );
+                break;
+            }
+            case sutil::TONEMAP_ACES:
+                r = aces4( r );
+                g = aces4( g );
+                b = aces4( b );
+                break;
+            case sutil::TONEMAP_FILMIC:
+            {
+                const __m128 bias = _mm_set1_ps( FILMIC_BIAS );
+                r = _mm_mul_ps( hable4( _mm_mul_ps( bias, r ) ), white );
+                g = _mm_mul_ps( hable4( _mm_mul_ps( bias, g ) ), white );
+                b = _mm_mul_ps( hable4( _mm_mul_ps( bias, b ) ), white );
+                break;
+            }
+            default:
+                break;
+        }
+
+        const __m128  d  = _mm_loadu_ps( dither + ( x & ( DITHER_SIZE - 1 ) ) );
+        const __m128i bi = quantize4( encodeSrgb4( b ), d );
+        const __m128i gi = quantize4( encodeSrgb4( g ), d );
+        const __m128i ri = quantize4( encodeSrgb4( r ), d );
+        const __m128i packed = _mm_or_si128( _mm_or_si128( bi, _mm_slli_epi32( gi, 8 ) ),
+                                             _mm_or_si128( _mm_slli_epi32( ri, 16 ), _mm_set1_epi32( static_cast<int>( 0xff000000u ) ) ) );
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( bgra ), packed );
+    }
+    return x;
+}
+
+#endif // SUTIL_TONEMAP_SSE2
+
+} // end anonymous namespace
+
+
+sutil::ToneMapSettings::ToneMapSettings()
+    : op( TONEMAP_REINHARD ),
+      exposure( 0.0f ),
+      dither( true )
+{
+}
+
+
+const char* sutil::toneMapOperatorName( ToneMapOperator op )
+{
+    switch( op )
+    {
+        case TONEMAP_LINEAR:   return "linear";
+        case TONEMAP_REINHARD: return "reinhard";
+        case TONEMAP_ACES:     return "aces";
+        case TONEMAP_FILMIC:   return "filmic";
+    }
+    return "unknown";
+}
+
+
+bool sutil::toneMapOperatorFromName( const std::string& name, ToneMapOperator& op )
+{
+    for( int i = TONEMAP_LINEAR; i <= TONEMAP_FILMIC; ++i )
+    {
+        if( name == toneMapOperatorName( static_cast<ToneMapOperator>( i ) ) )
+        {
+            op = static_cast<ToneMapOperator>( i );
+            return true;
+        }
+    }
+    return false;
+}
+
+
+float sutil::ditherOffset( unsigned int x, unsigned int y )
+{
+    return ditherTable().values[( y & ( DITHER_SIZE - 1 ) ) * DITHER_SIZE + ( x & ( DITHER_SIZE - 1 ) )];
+}
+
+
+void sutil::toneMap( const float* pixels, unsigned int width, unsigned int height, unsigned int components,
+                     const ToneMapSettings& settings, unsigned char* bgra )
+{
+    const float scale = exp2f( settings.exposure );
+    const float* dither_values = settings.dither ? ditherTable().values : nullptr;
+
+    float no_dither[DITHER_SIZE];
+    memset( no_dither, 0, sizeof( no_dither ) );
+
+    parallelFor( height, [&]( size_t begin, size_t end )
+    {
+        for( size_t y = begin; y < end; ++y )
+        {
+            const float*   src    = pixels + y * width * components;
+            unsigned char* dst    = bgra + y * width * 4;
+            const float*   dither = dither_values ? dither_values + ( y & ( DITHER_SIZE - 1 ) ) * DITHER_SIZE : no_dither;
+
+            unsigned int x = 0;
+#ifdef SUTIL_TONEMAP_SSE2
+            x = toneMapRow4( src, width, components, scale, settings.op, dither, dst );
+#endif
+            for( ; x < width; ++x )
+                toneMapPixel( src + x * components, scale, settings.op, dither[x & ( DITHER_SIZE - 1 )], dst + x * 4 );
+        }
+    }, 16 );
+}
+
+
+void sutil::toneMapBuffer( Buffer buffer, const ToneMapSettings& settings, std::vector<unsigned char>& bgra )
+{
+    RTsize width, height;
+    buffer->getSize( width, height );
+
+    unsigned int components = 0;
+    switch( buffer->getFormat() )
+    {
+        case RT_FORMAT_FLOAT3: components = 3; break;
+        case RT_FORMAT_FLOAT4: components = 4; break;
+        default:
+            throw Exception( "toneMapBuffer() needs a float3 or float4 buffer" );
+    }
+
+    bgra.resize( width * height * 4 );
+    const float* pixels = static_cast<const float*>( buffer->map( 0, RT_BUFFER_MAP_READ ) );
+    try
+    {
+        toneMap( pixels, static_cast<unsigned int>( width ), static_cast<unsigned int>( height ), components, settings, bgra.data() );
+    }
+    catch( ... )
+    {
+        buffer->unmap();
+        throw;
+    }
+    buffer->unmap();
+}
@@ -0,0 +1,77 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <optixu/optixpp_namespace.h>
+#include <sutilapi.h>
+
+#include <string>
+#include <vector>
+
+namespace sutil
+{
+
+// Display transforms from linear radiance to 8-bit sRGB. The same operators are
+// implemented on the device by the tonemap entry point of the path tracer; the
+// enum values are shared with it.
+enum ToneMapOperator
+{
+    TONEMAP_LINEAR   = 0, // Clamp only.
+    TONEMAP_REINHARD = 1, // Luminance based Reinhard, c / (1 + L / 1.5).
+    TONEMAP_ACES     = 2, // Narkowicz' fit of the ACES reference rendering transform.
+    TONEMAP_FILMIC   = 3  // Hable's filmic curve (Uncharted 2), white point 11.2.
+};
+
+struct ToneMapSettings
+{
+    SUTILAPI ToneMapSettings();
+
+    ToneMapOperator op;       // Default TONEMAP_REINHARD.
+    float           exposure; // In stops, applied before the operator. Default 0.
+    bool            dither;   // Add triangular noise of +-1 code before quantizing to 8 bits. Default true.
+};
+
+SUTILAPI const char* toneMapOperatorName( ToneMapOperator op );
+// "linear", "reinhard", "aces" or "filmic". Returns false for anything else.
+SUTILAPI bool toneMapOperatorFromName( const std::string& name, ToneMapOperator& op );
+
+// Dither offset in codes for pixel (x, y), added before truncating to 8 bits. Triangular noise
+// in [-0.5, 1.5), so the average rounds instead of truncating. The pattern repeats every 64 pixels.
+SUTILAPI float ditherOffset( unsigned int x, unsigned int y );
+
+// Tonemap float pixels with 3 or 4 components into BGRA8 pixels, the layout of an
+// RT_FORMAT_UNSIGNED_BYTE4 output buffer. Rows keep their order. Alpha is set to 255.
+// Uses SSE2 four pixels at a time where available and runs over rows in parallel.
+SUTILAPI void toneMap( const float* pixels, unsigned int width, unsigned int height, unsigned int components,
+                       const ToneMapSettings& settings, unsigned char* bgra );
+
+// Tonemap a FLOAT3 or FLOAT4 buffer, which must be readable on the host.
+SUTILAPI void toneMapBuffer( optix::Buffer buffer, const ToneMapSettings& settings, std::vector<unsigned char>& bgra );
+
+} // end namespace sutil
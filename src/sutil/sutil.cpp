@@ -40,6 +40,7 @@
 #include <sutil/sutil.h>
 #include <sutil/HDRLoader.h>
 #include <sutil/PPMLoader.h>
+#include <sutil/Profiler.h>
 #include <sampleConfig.h>
 #include <sutil/stb/stb_image_write.h>
 
@@ -60,8 +61,10 @@
 #  endif
 #  include<windows.h>
 #  include<mmsystem.h>
+#  include<psapi.h>
 #else // Apple and Linux both use this 
 #  include<sys/time.h>
+#  include<sys/resource.h>
 #  include <unistd.h>
 #  include <dirent.h>
 #endif
@@ -242,43 +245,30 @@ void sutil::handleError( RTcontext context, RTresult code, const char* file,
 }
 
 
-const char* sutil::samplesDir()
+// The environment variable overrides the configured directory if it exists.
+static std::string findDirectory( const char* variable, const char* configured )
 {
-    static char s[512];
-
-    // Allow for overrides.
-    const char* dir = getenv( "OPTIX_SAMPLES_SDK_DIR" );
-    if (dir) {
-        strcpy(s, dir);
-        return s;
-    }
-
-    // Return hardcoded path if it exists.
-    if( dirExists( SAMPLES_DIR ) )
-        return SAMPLES_DIR;
-
-    // Last resort.
+    const char* dir = getenv( variable );
+    if( dir )
+        return dir;
+    if( dirExists( configured ) )
+        return configured;
     return ".";
 }
 
 
-const char* sutil::samplesPTXDir()
+const char* sutil::samplesDir()
 {
-    static char s[512];
-
-    // Allow for overrides.
-    const char* dir = getenv( "OPTIX_SAMPLES_SDK_PTX_DIR" );
-    if (dir) {
-        strcpy(s, dir);
-        return s;
-    }
+    // Looked up once, render sessions on several threads share the result.
+    static const std::string dir = findDirectory( "OPTIX_SAMPLES_SDK_DIR", SAMPLES_DIR );
+    return dir.c_str();
+}
 
-    // Return hardcoded path if it exists.
-    if( dirExists(SAMPLES_PTX_DIR) )
-        return SAMPLES_PTX_DIR;
 
-    // Last resort.
-    return ".";
+const char* sutil::samplesPTXDir()
+{
+    static const std::string dir = findDirectory( "OPTIX_SAMPLES_SDK_PTX_DIR", SAMPLES_PTX_DIR );
+    return dir.c_str();
 }
 
 
@@ -442,27 +432,44 @@ void sutil::writeBufferToFile( const char* filename, Buffer buffer)
 
 void sutil::writeBufferToFile( const char* filename, RTbuffer buffer)
 {
-    GLsizei width, height;
     RTsize buffer_width, buffer_height;
 
     GLvoid* imageData;
     RT_CHECK_ERROR( rtBufferMap( buffer, &imageData) );
 
     RT_CHECK_ERROR( rtBufferGetSize2D(buffer, &buffer_width, &buffer_height) );
+
+    RTformat buffer_format;
+    RT_CHECK_ERROR( rtBufferGetFormat(buffer, &buffer_format) );
+
+    try {
+        writeImageToFile( filename, imageData, static_cast<unsigned int>(buffer_width), static_cast<unsigned int>(buffer_height), buffer_format );
+    } catch( ... ) {
+        rtBufferUnmap( buffer );
+        throw;
+    }
+
+    // Now unmap the buffer
+    RT_CHECK_ERROR( rtBufferUnmap(buffer) );
+}
+
+
+void sutil::writeImageToFile( const char* filename, const void* imageData, unsigned int buffer_width, unsigned int buffer_height, RTformat buffer_format )
+{
+    ProfileScope profile( "write image", filename );
+    GLsizei width, height;
+
     width  = static_cast<GLsizei>(buffer_width);
     height = static_cast<GLsizei>(buffer_height);
 
     std::vector<unsigned char> pix(width * height * 3);
 
-    RTformat buffer_format;
-    RT_CHECK_ERROR( rtBufferGetFormat(buffer, &buffer_format) );
-
     switch(buffer_format) {
         case RT_FORMAT_UNSIGNED_BYTE4:
             // Data is BGRA and upside down, so we need to swizzle to RGB
             for(int j = height-1; j >= 0; --j) {
                 unsigned char *dst = &pix[0] + (3*width*(height-1-j));
-                unsigned char *src = ((unsigned char*)imageData) + (4*width*j);
+                const unsigned char *src = ((const unsigned char*)imageData) + (4*width*j);
                 for(int i = 0; i < width; i++) {
                     *dst++ = *(src + 2);
                     *dst++ = *(src + 1);
@@ -476,7 +483,7 @@ void sutil::writeBufferToFile( const char* filename, RTbuffer buffer)
             // This buffer is upside down
             for(int j = height-1; j >= 0; --j) {
                 unsigned char *dst = &pix[0] + width*(height-1-j);
-                float* src = ((float*)imageData) + (3*width*j);
+                const float* src = ((const float*)imageData) + (3*width*j);
                 for(int i = 0; i < width; i++) {
                     int P = static_cast<int>((*src++) * 255.0f);
                     unsigned int Clamped = P < 0 ? 0 : P > 0xff ? 0xff : P;
@@ -493,7 +500,7 @@ void sutil::writeBufferToFile( const char* filename, RTbuffer buffer)
             // This buffer is upside down
             for(int j = height-1; j >= 0; --j) {
                 unsigned char *dst = &pix[0] + (3*width*(height-1-j));
-                float* src = ((float*)imageData) + (3*width*j);
+                const float* src = ((const float*)imageData) + (3*width*j);
                 for(int i = 0; i < width; i++) {
                     for(int elem = 0; elem < 3; ++elem) {
                         int P = static_cast<int>((*src++) * 255.0f);
@@ -508,7 +515,7 @@ void sutil::writeBufferToFile( const char* filename, RTbuffer buffer)
             // This buffer is upside down
             for(int j = height-1; j >= 0; --j) {
                 unsigned char *dst = &pix[0] + (3*width*(height-1-j));
-                float* src = ((float*)imageData) + (4*width*j);
+                const float* src = ((const float*)imageData) + (4*width*j);
                 for(int i = 0; i < width; i++) {
                     for(int elem = 0; elem < 3; ++elem) {
                         int P = static_cast<int>((*src++) * 255.0f);
@@ -523,9 +530,8 @@ void sutil::writeBufferToFile( const char* filename, RTbuffer buffer)
             break;
 
         default:
-            fprintf(stderr, "Unrecognized buffer data type or format.\n");
-            exit(2);
-            break;
+            // Also called from encoder threads, which must not exit the process.
+            throw Exception( "Unrecognized buffer data type or format." );
     }
 
     std::string suffix;
@@ -543,9 +549,6 @@ void sutil::writeBufferToFile( const char* filename, RTbuffer buffer)
     } else {
         throw Exception( std::string("Unrecognized output image file extension: ") + filename );
     }
-
-    // Now unmap the buffer
-    RT_CHECK_ERROR( rtBufferUnmap(buffer) );
 }
 
 
@@ -688,6 +691,15 @@ void sutil::displayBufferGL( optix::Buffer buffer )
 }
 
 
+void sutil::displayImageGL( const unsigned char* bgra, unsigned int width, unsigned int height )
+{
+    // The pixels are sRGB already. Rows of 4 bytes are always aligned.
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+    glRasterPos2f( 0.0f, 0.0f );
+    glDrawPixels( static_cast<GLsizei>( width ), static_cast<GLsizei>( height ), GL_BGRA, GL_UNSIGNED_BYTE, bgra );
+}
+
+
 namespace
 {
     const float FPS_UPDATE_INTERVAL = 0.5;  //seconds
@@ -872,6 +884,26 @@ double sutil::currentTime()
 }
 
 
+size_t sutil::peakMemoryUsage()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if( !GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) )
+        return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if( getrusage( RUSAGE_SELF, &usage ) )
+        return 0;
+#  if defined(__APPLE__)
+    return static_cast<size_t>( usage.ru_maxrss );        // Bytes.
+#  else
+    return static_cast<size_t>( usage.ru_maxrss ) * 1024; // Kilobytes.
+#  endif
+#endif
+}
+
+
 void sutil::sleep( int seconds )
 {
 #if defined(_WIN32)
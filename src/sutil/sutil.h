@@ -133,10 +133,26 @@ void SUTILAPI writeBufferToFile(
         const char* filename,               // Image file to be created
         RTbuffer buffer);                   // Buffer to be displayed
 
+// Write host memory laid out like a Buffer of the given format (bottom-up rows, BGRA for
+// RT_FORMAT_UNSIGNED_BYTE4) to an image file with type based on extension
+void SUTILAPI writeImageToFile(
+        const char* filename,               // Image file to be created
+        const void* data,                   // Pixel data
+        unsigned int width,                 // Image width
+        unsigned int height,                // Image height
+        RTformat format);                   // Pixel format
+
 
 // Display contents of buffer, where the OpenGL context is managed by caller.
 void SUTILAPI displayBufferGL(
         optix::Buffer buffer ); // Buffer to be displayed
+
+// Display host memory laid out like an RT_FORMAT_UNSIGNED_BYTE4 buffer (bottom-up rows of
+// BGRA8), e.g. an image tonemapped on the host. The OpenGL context is managed by the caller.
+void SUTILAPI displayImageGL(
+        const unsigned char* bgra,          // Pixel data
+        unsigned int width,                 // Image width
+        unsigned int height );              // Image height
         
 // Display frames per second, where the OpenGL context
 // is managed by the caller.
@@ -192,5 +208,8 @@ void SUTILAPI parseDimensions(
 // Get current time in seconds for benchmarking/timing purposes.
 double SUTILAPI currentTime();
 
+// Peak resident memory of the process in bytes, 0 where unknown.
+size_t SUTILAPI peakMemoryUsage();
+
 } // end namespace sutil
 